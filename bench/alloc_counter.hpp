@@ -0,0 +1,78 @@
+#pragma once
+
+// Counts heap allocations by replacing the global operator new and delete.
+// Replacement functions cannot be inline, so include this from exactly one
+// translation unit of a benchmark executable.
+//
+// Every allocation form has its matching deallocation forms here: plain,
+// array, nothrow, and sized and aligned ones, all on malloc and free (or
+// aligned_alloc). They are kept out of line, since once inlined into a caller
+// GCC sees free() on a pointer from operator new and warns
+// (-Wmismatched-new-delete).
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace bench
+{
+    inline std::atomic<size_t> allocations{0};
+
+    inline void *allocate(std::size_t size) noexcept
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        return std::malloc(size ? size : 1);
+    }
+
+    inline void *allocate(std::size_t size, std::align_val_t alignment) noexcept
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        std::size_t align = static_cast<std::size_t>(alignment);
+        // aligned_alloc wants a size that is a multiple of the alignment
+        std::size_t rounded = (size + align - 1) / align * align;
+        return std::aligned_alloc(align, rounded ? rounded : align);
+    }
+
+    inline void *allocateOrThrow(std::size_t size)
+    {
+        if (void *p = allocate(size))
+            return p;
+        throw std::bad_alloc();
+    }
+
+    inline void *allocateOrThrow(std::size_t size, std::align_val_t alignment)
+    {
+        if (void *p = allocate(size, alignment))
+            return p;
+        throw std::bad_alloc();
+    }
+}
+
+[[gnu::noinline]] void *operator new(std::size_t size) { return bench::allocateOrThrow(size); }
+[[gnu::noinline]] void *operator new[](std::size_t size) { return bench::allocateOrThrow(size); }
+[[gnu::noinline]] void *operator new(std::size_t size, const std::nothrow_t &) noexcept { return bench::allocate(size); }
+[[gnu::noinline]] void *operator new[](std::size_t size, const std::nothrow_t &) noexcept { return bench::allocate(size); }
+[[gnu::noinline]] void *operator new(std::size_t size, std::align_val_t alignment) { return bench::allocateOrThrow(size, alignment); }
+[[gnu::noinline]] void *operator new[](std::size_t size, std::align_val_t alignment) { return bench::allocateOrThrow(size, alignment); }
+[[gnu::noinline]] void *operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return bench::allocate(size, alignment);
+}
+[[gnu::noinline]] void *operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return bench::allocate(size, alignment);
+}
+
+[[gnu::noinline]] void operator delete(void *p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete[](void *p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void *p, const std::nothrow_t &) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete[](void *p, const std::nothrow_t &) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept { std::free(p); }
@@ -0,0 +1,294 @@
+// Wakeup-to-handler latency of a market data connection: how long a book
+// notification takes from the moment MockExchange hands it to its socket to
+// the moment a read handler on our I/O thread starts on it. Each mode opens
+// its own wss:// connection, subscribes and records every stamped frame.
+//
+//   ./MockExchange --stamp --rate 2000 &
+//   ./FeedWakeupBench [--endpoint host:port] [--seconds N] [--io-core N] [--rcvbuf bytes] [--modes epoll,busy-poll]
+//
+// epoll runs the io_context with run() and default socket options, as the
+// client does by default. busy-poll spins on poll() with TCP_NODELAY and the
+// given receive buffer, pinned to --io-core: the client's --low-latency mode.
+// The second connection resumes the first one's TLS session. Busy polling
+// needs a core of its own; on a machine with fewer cores than busy threads
+// plus the mock, it competes with the sender and the numbers show that.
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include "latency_histogram.hpp"
+#include "net_tuning.hpp"
+#include "thread_util.hpp"
+
+namespace
+{
+    namespace asio = boost::asio;
+
+    struct Mode
+    {
+        std::string name;
+        NetworkTuning network;
+    };
+
+    const std::string SentKey = "\"sent_ns\":";
+
+    // Client to server frames must be masked; a zero mask leaves the payload as is
+    std::string maskedTextFrame(const std::string &payload)
+    {
+        std::string frame;
+        frame.push_back(static_cast<char>(0x81));
+        if (payload.size() < 126)
+        {
+            frame.push_back(static_cast<char>(0x80 | payload.size()));
+        }
+        else
+        {
+            frame.push_back(static_cast<char>(0x80 | 126));
+            frame.push_back(static_cast<char>(payload.size() >> 8));
+            frame.push_back(static_cast<char>(payload.size()));
+        }
+        frame.append(4, '\0');
+        return frame + payload;
+    }
+
+    class FeedConnection
+    {
+    public:
+        FeedConnection(asio::io_context &io, asio::ssl::context &ssl, const NetworkTuning &network,
+                       TlsSessionCache &sessions, LatencyHistogram &latency)
+            : stream(io, ssl), network(network), sessions(sessions), latency(latency) {}
+
+        // Blocking connect, TLS and WebSocket handshakes and subscription, then reads asynchronously
+        bool open(const std::string &host, const std::string &port, const std::vector<std::string> &channels)
+        {
+            asio::ip::tcp::resolver resolver(stream.get_executor());
+            boost::system::error_code ec;
+            asio::connect(stream.lowest_layer(), resolver.resolve(host, port), ec);
+            if (ec)
+            {
+                std::cerr << "connect: " << ec.message() << std::endl;
+                return false;
+            }
+            applySocketOptions(stream.lowest_layer().native_handle(), network.socket);
+            if (network.reuseTlsSessions)
+                sessions.resume(stream.native_handle());
+            stream.handshake(asio::ssl::stream_base::client, ec);
+            if (ec)
+            {
+                std::cerr << "TLS handshake: " << ec.message() << std::endl;
+                return false;
+            }
+
+            std::string upgrade = "GET /ws/api/v2/ HTTP/1.1\r\nHost: " + host +
+                                  "\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                                  "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+            asio::write(stream, asio::buffer(upgrade), ec);
+            size_t headerEnd;
+            while (!ec && (headerEnd = in.find("\r\n\r\n")) == std::string::npos)
+            {
+                size_t n = stream.read_some(asio::buffer(chunk), ec);
+                in.append(chunk.data(), n);
+            }
+            if (ec || in.compare(0, 12, "HTTP/1.1 101") != 0)
+            {
+                std::cerr << "WebSocket upgrade refused" << std::endl;
+                return false;
+            }
+            in.erase(0, headerEnd + 4);
+            // Any TLS 1.3 session ticket has come in with the upgrade response
+            sessions.remember(stream.native_handle());
+
+            std::string channelList;
+            for (const auto &channel : channels)
+                channelList += (channelList.empty() ? "\"" : ",\"") + channel + "\"";
+            asio::write(stream, asio::buffer(maskedTextFrame("{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"public/subscribe\",\"params\":{\"channels\":[" + channelList + "]}}")), ec);
+            if (ec)
+                return false;
+            read();
+            return true;
+        }
+
+        void close()
+        {
+            boost::system::error_code ec;
+            stream.lowest_layer().close(ec);
+        }
+
+    private:
+        void read()
+        {
+            stream.async_read_some(asio::buffer(chunk), [this](const boost::system::error_code &ec, size_t n)
+                                   {
+                // Every frame of this read woke the thread at the same moment
+                int64_t handlerAt = unixNanos();
+                if (ec)
+                    return;
+                in.append(chunk.data(), n);
+                parseFrames(handlerAt);
+                read(); });
+        }
+
+        // Unmasked server frames; only the stamped text frames are measured
+        void parseFrames(int64_t handlerAt)
+        {
+            size_t offset = 0;
+            for (;;)
+            {
+                if (in.size() - offset < 2)
+                    break;
+                const unsigned char *p = reinterpret_cast<const unsigned char *>(in.data() + offset);
+                uint64_t length = p[1] & 0x7f;
+                size_t header = 2;
+                if (length == 126)
+                {
+                    if (in.size() - offset < 4)
+                        break;
+                    length = (uint64_t(p[2]) << 8) | p[3];
+                    header = 4;
+                }
+                else if (length == 127)
+                {
+                    if (in.size() - offset < 10)
+                        break;
+                    length = 0;
+                    for (int i = 0; i < 8; ++i)
+                        length = (length << 8) | p[2 + i];
+                    header = 10;
+                }
+                if (in.size() - offset < header + length)
+                    break;
+                std::string_view payload(in.data() + offset + header, length);
+                size_t at = payload.rfind(SentKey);
+                if (at != std::string_view::npos)
+                {
+                    int64_t sentAt = std::strtoll(payload.data() + at + SentKey.size(), nullptr, 10);
+                    latency.record(handlerAt > sentAt ? handlerAt - sentAt : 0);
+                }
+                offset += header + length;
+            }
+            in.erase(0, offset);
+        }
+
+        asio::ssl::stream<asio::ip::tcp::socket> stream;
+        const NetworkTuning &network;
+        TlsSessionCache &sessions;
+        LatencyHistogram &latency;
+        std::array<char, 65536> chunk;
+        std::string in;
+    };
+
+    void usage(const char *program)
+    {
+        std::cerr << "Usage: " << program << " [--endpoint host:port] [--seconds N] [--io-core N] [--rcvbuf bytes] [--modes epoll,busy-poll]" << std::endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::string host = "localhost";
+    std::string port = "8443";
+    int seconds = 10;
+    int ioCore = -1;
+    int receiveBuffer = 0;
+    std::string modeList = "epoll,busy-poll";
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--endpoint" && i + 1 < argc)
+        {
+            std::string endpoint = argv[++i];
+            size_t colon = endpoint.rfind(':');
+            host = endpoint.substr(0, colon);
+            if (colon != std::string::npos)
+                port = endpoint.substr(colon + 1);
+        }
+        else if (arg == "--seconds" && i + 1 < argc)
+        {
+            seconds = std::atoi(argv[++i]);
+        }
+        else if (arg == "--io-core" && i + 1 < argc)
+        {
+            ioCore = std::atoi(argv[++i]);
+        }
+        else if (arg == "--rcvbuf" && i + 1 < argc)
+        {
+            receiveBuffer = std::atoi(argv[++i]);
+        }
+        else if (arg == "--modes" && i + 1 < argc)
+        {
+            modeList = argv[++i];
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<Mode> modes;
+    std::istringstream names(modeList);
+    std::string name;
+    while (std::getline(names, name, ','))
+    {
+        Mode mode{name, NetworkTuning()};
+        if (name == "epoll")
+        {
+            mode.network.socket.noDelay = false;
+        }
+        else if (name == "busy-poll")
+        {
+            mode.network.busyPoll = true;
+            mode.network.ioCore = ioCore;
+            mode.network.socket.receiveBuffer = receiveBuffer;
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+        modes.push_back(mode);
+    }
+
+    asio::ssl::context ssl(asio::ssl::context::tls_client);
+    ssl.set_verify_mode(asio::ssl::verify_none);
+    TlsSessionCache sessions;
+    const std::vector<std::string> channels = {"book.BTC-PERPETUAL.100ms", "book.ETH-PERPETUAL.100ms"};
+
+    for (const Mode &mode : modes)
+    {
+        asio::io_context io;
+        LatencyHistogram latency;
+        FeedConnection connection(io, ssl, mode.network, sessions, latency);
+        uint64_t resumedBefore = sessions.resumed();
+        if (!connection.open(host, port, channels))
+        {
+            return 1;
+        }
+        std::thread ioThread([&]
+                             { runIoContext(io, mode.network.busyPoll); });
+        if (!pinThreadToCore(ioThread, mode.network.ioCore))
+        {
+            std::cerr << "Could not pin the I/O thread to core " << mode.network.ioCore << std::endl;
+        }
+        // Skip the subscription's first second, while the connection warms up
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        latency.reset();
+        std::this_thread::sleep_for(std::chrono::seconds(seconds));
+        asio::post(io, [&]
+                   { connection.close(); io.stop(); });
+        ioThread.join();
+
+        std::cout << mode.name << " (TLS " << (sessions.resumed() > resumedBefore ? "resumed" : "full handshake")
+                  << "): " << latency.describe() << std::endl;
+    }
+    return 0;
+}
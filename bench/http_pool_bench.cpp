@@ -0,0 +1,94 @@
+// Per-request REST latency: the old one-shot cURL path against HttpConnectionPool,
+// both talking to a local HTTPS stand-in.
+//
+//   ./HttpPoolBench [requests]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "http_pool.hpp"
+#include "local_https_server.hpp"
+
+namespace
+{
+    const std::string payload = "{\"id\":1,\"jsonrpc\":\"2.0\",\"method\":\"private/buy\",\"params\":{\"amount\":20.0,\"instrument_name\":\"ETH-PERPETUAL\",\"price\":20.0,\"type\":\"limit\"}}";
+
+    size_t discard(void *, size_t size, size_t nmemb, void *)
+    {
+        return size * nmemb;
+    }
+
+    // What sendRequest used to do for every call
+    void oneShotRequest(const std::string &url)
+    {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+        CURL *curl = curl_easy_init();
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl, CURLOPT_POST, 1L);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, payload.c_str());
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+        struct curl_slist *headers = curl_slist_append(NULL, "Content-Type: application/json");
+        headers = curl_slist_append(headers, "Authorization: Bearer token");
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discard);
+        curl_easy_perform(curl);
+        curl_slist_free_all(headers);
+        curl_easy_cleanup(curl);
+        curl_global_cleanup();
+    }
+
+    void report(const std::string &name, std::vector<double> samples, size_t handshakes)
+    {
+        std::sort(samples.begin(), samples.end());
+        double total = 0;
+        for (double s : samples)
+            total += s;
+        auto pct = [&](double p)
+        { return samples[std::min(samples.size() - 1, (size_t)(p * samples.size()))]; };
+        std::cout << name << ": mean " << total / samples.size() << " us, p50 " << pct(0.50)
+                  << " us, p99 " << pct(0.99) << " us, max " << samples.back()
+                  << " us, TLS handshakes " << handshakes << "\n";
+    }
+
+    std::vector<double> measure(size_t requests, const std::function<void()> &request)
+    {
+        std::vector<double> samples;
+        samples.reserve(requests);
+        for (size_t i = 0; i < requests; ++i)
+        {
+            auto start = std::chrono::steady_clock::now();
+            request();
+            auto end = std::chrono::steady_clock::now();
+            samples.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+        }
+        return samples;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t requests = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 500;
+
+    bench::LocalHttpsServer server;
+    const std::string url = server.url() + "private/buy";
+    std::cout << "Local HTTPS stand-in on " << server.url() << ", " << requests << " requests each\n";
+
+    auto before = server.handshakes();
+    auto oneShot = measure(requests, [&]
+                           { oneShotRequest(url); });
+    report("one-shot cURL ", oneShot, server.handshakes() - before);
+
+    HttpConnectionPool pool(server.url(), 2);
+    pool.setVerifyPeer(false);
+    before = server.handshakes();
+    pool.prewarm("public/test");
+    auto pooled = measure(requests, [&]
+                          { pool.post("private/buy", payload, "token"); });
+    report("connection pool", pooled, server.handshakes() - before);
+    return 0;
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+// Minimal keep-alive HTTPS stand-in for benchmarks. Answers every POST with a
+// fixed JSON-RPC body over a self-signed certificate generated at startup, so
+// no files or network access are needed.
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+
+namespace bench
+{
+    // Loads a freshly generated P-256 key and self-signed certificate into ctx
+    inline void useSelfSignedCertificate(boost::asio::ssl::context &ctx)
+    {
+        EVP_PKEY *pkey = EVP_EC_gen("P-256");
+        X509 *cert = X509_new();
+        X509_set_version(cert, 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+        X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+        X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 3600);
+        X509_set_pubkey(cert, pkey);
+        X509_NAME *name = X509_get_subject_name(cert);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *)"localhost", -1, -1, 0);
+        X509_set_issuer_name(cert, name);
+        X509_sign(cert, pkey, EVP_sha256());
+
+        SSL_CTX_use_certificate(ctx.native_handle(), cert);
+        SSL_CTX_use_PrivateKey(ctx.native_handle(), pkey);
+        X509_free(cert);
+        EVP_PKEY_free(pkey);
+    }
+
+    class LocalHttpsServer
+    {
+    public:
+        explicit LocalHttpsServer(std::string responseBody = "{\"jsonrpc\":\"2.0\",\"id\":1,\"result\":\"ok\"}")
+            : body(std::move(responseBody)),
+              ssl(boost::asio::ssl::context::tls_server),
+              acceptor(io, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0))
+        {
+            useSelfSignedCertificate(ssl);
+            accept();
+            thread = std::thread([this]
+                                 { io.run(); });
+        }
+
+        ~LocalHttpsServer()
+        {
+            io.stop();
+            thread.join();
+        }
+
+        unsigned short port() const { return acceptor.local_endpoint().port(); }
+        std::string url() const { return "https://127.0.0.1:" + std::to_string(port()) + "/"; }
+
+        // Number of TLS handshakes completed, i.e. connections the client had to open
+        size_t handshakes() const { return handshakeCount.load(); }
+
+    private:
+        using Stream = boost::asio::ssl::stream<boost::asio::ip::tcp::socket>;
+
+        struct Session : std::enable_shared_from_this<Session>
+        {
+            Session(LocalHttpsServer &server, boost::asio::ip::tcp::socket socket)
+                : server(server), stream(std::move(socket), server.ssl) {}
+
+            void start()
+            {
+                auto self = shared_from_this();
+                stream.async_handshake(boost::asio::ssl::stream_base::server, [self](const boost::system::error_code &ec)
+                                       {
+                    if (ec)
+                        return;
+                    self->server.handshakeCount++;
+                    self->readHeaders(); });
+            }
+
+            void readHeaders()
+            {
+                auto self = shared_from_this();
+                boost::asio::async_read_until(stream, buffer, "\r\n\r\n", [self](const boost::system::error_code &ec, size_t headerBytes)
+                                              {
+                    if (ec)
+                        return;
+                    std::string headers(boost::asio::buffers_begin(self->buffer.data()),
+                                        boost::asio::buffers_begin(self->buffer.data()) + headerBytes);
+                    self->buffer.consume(headerBytes);
+                    size_t contentLength = 0;
+                    auto pos = headers.find("Content-Length:");
+                    if (pos == std::string::npos)
+                        pos = headers.find("content-length:");
+                    if (pos != std::string::npos)
+                        contentLength = std::stoul(headers.substr(pos + 15));
+                    self->readBody(contentLength); });
+            }
+
+            void readBody(size_t contentLength)
+            {
+                auto self = shared_from_this();
+                size_t missing = contentLength > buffer.size() ? contentLength - buffer.size() : 0;
+                boost::asio::async_read(stream, buffer, boost::asio::transfer_exactly(missing), [self, contentLength](const boost::system::error_code &ec, size_t)
+                                        {
+                    if (ec)
+                        return;
+                    self->buffer.consume(contentLength);
+                    self->respond(); });
+            }
+
+            void respond()
+            {
+                auto self = shared_from_this();
+                response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nConnection: keep-alive\r\nContent-Length: " +
+                           std::to_string(server.body.size()) + "\r\n\r\n" + server.body;
+                boost::asio::async_write(stream, boost::asio::buffer(response), [self](const boost::system::error_code &ec, size_t)
+                                         {
+                    if (!ec)
+                        self->readHeaders(); });
+            }
+
+            LocalHttpsServer &server;
+            Stream stream;
+            boost::asio::streambuf buffer;
+            std::string response;
+        };
+
+        void accept()
+        {
+            acceptor.async_accept([this](const boost::system::error_code &ec, boost::asio::ip::tcp::socket socket)
+                                  {
+                if (!ec)
+                {
+                    socket.set_option(boost::asio::ip::tcp::no_delay(true));
+                    std::make_shared<Session>(*this, std::move(socket))->start();
+                }
+                accept(); });
+        }
+
+        std::string body;
+        boost::asio::io_context io;
+        boost::asio::ssl::context ssl;
+        boost::asio::ip::tcp::acceptor acceptor;
+        std::atomic<size_t> handshakeCount{0};
+        std::thread thread;
+    };
+}
@@ -0,0 +1,64 @@
+// Hot-path cost of a LOG_* call with the background writer running, compared
+// with what the client used to do (std::cout with std::endl).
+//
+//   ./LoggerBench [calls]
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "logger.hpp"
+
+namespace
+{
+    double nsPer(std::chrono::steady_clock::duration elapsed, size_t count)
+    {
+        return std::chrono::duration<double, std::nano>(elapsed).count() / count;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t calls = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    const std::string instrument = "ETH-PERPETUAL";
+
+    Logger &logger = Logger::instance();
+    logger.start("logger_bench.tclog", LogLevel::Info, LogLevel::Off);
+
+    // Stay below the ring capacity per burst so we measure the call, not drops
+    size_t done = 0;
+    std::chrono::steady_clock::duration logTime{};
+    while (done < calls)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < 512 && done < calls; ++i, ++done)
+        {
+            LOG_INFO("{} bid {} @ {} (change_id {})", instrument, 1250.0, 2650.15, (uint64_t)done);
+        }
+        logTime += std::chrono::steady_clock::now() - start;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < calls; ++i)
+    {
+        LOG_DEBUG("filtered out {}", i);
+    }
+    auto filteredTime = std::chrono::steady_clock::now() - start;
+    logger.stop();
+
+    std::ofstream sink("/dev/null");
+    const size_t streamCalls = std::min<size_t>(calls, 200000);
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < streamCalls; ++i)
+    {
+        sink << instrument << " bid " << 1250.0 << " @ " << 2650.15 << " (change_id " << i << ")" << std::endl;
+    }
+    auto streamTime = std::chrono::steady_clock::now() - start;
+
+    std::cout << "LOG_INFO, 4 args:        " << nsPer(logTime, calls) << " ns/call, dropped " << logger.dropped() << "\n";
+    std::cout << "LOG_DEBUG, filtered out: " << nsPer(filteredTime, calls) << " ns/call\n";
+    std::cout << "ostream << std::endl:    " << nsPer(streamTime, streamCalls) << " ns/call (to /dev/null)\n";
+    return 0;
+}
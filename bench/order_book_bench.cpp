@@ -0,0 +1,165 @@
+// Book update cost on a captured book.* feed, one frame per line. Checks
+// first that a book resyncs from a REST snapshot taken mid-interval.
+//
+//   ./OrderBookBench [feed.jsonl] [passes]
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "alloc_counter.hpp"
+#include "order_book.hpp"
+#include "notification_parser.hpp"
+
+using json = nlohmann::json;
+
+namespace
+{
+    double nsPer(std::chrono::steady_clock::duration elapsed, size_t count)
+    {
+        return std::chrono::duration<double, std::nano>(elapsed).count() / count;
+    }
+
+    BookUpdate delta(uint64_t prevChangeId, uint64_t changeId, std::vector<LevelUpdate> bids, std::vector<LevelUpdate> asks)
+    {
+        BookUpdate update;
+        update.instrument = "ETH-PERPETUAL";
+        update.prevChangeId = prevChangeId;
+        update.changeId = changeId;
+        update.bids = std::move(bids);
+        update.asks = std::move(asks);
+        return update;
+    }
+
+    // On 100ms and agg2 channels a delta covers many change_ids, and a REST
+    // snapshot's usually falls inside one, so no delta continues from it
+    bool resyncsMidInterval()
+    {
+        size_t requests = 0;
+        BookManager books([&](const std::string &)
+                          { ++requests; });
+        BookUpdate streamed = delta(0, 10, {{BookAction::New, 100, 1}}, {{BookAction::New, 101, 1}});
+        streamed.snapshot = true;
+        books.onUpdate(0, streamed);
+
+        // 10 -> 20 is lost, so 20 -> 30 is a gap and is buffered with 30 -> 40
+        books.onUpdate(0, delta(20, 30, {{BookAction::Change, 99, 3}}, {{BookAction::New, 102, 1}}));
+        books.onUpdate(0, delta(30, 40, {}, {{BookAction::Delete, 101, 0}}));
+        BookUpdate snapshot = delta(0, 25, {{BookAction::New, 100, 2}, {BookAction::New, 99, 1}}, {{BookAction::New, 101, 1}});
+        snapshot.snapshot = true;
+        books.onSnapshot(0, snapshot);
+
+        const OrderBook *book = books.find(0);
+        bool ok = requests == 1 && book && book->changeId() == 40 && book->bidDepth() == 2 && book->askDepth() == 1 &&
+                  book->amount(book->bid(0)) == 2 && book->amount(book->bid(1)) == 3 && book->price(*book->bestAsk()) == 102;
+
+        // A later gap resyncs from a snapshot that no buffered delta reaches past,
+        // so the next live delta is the one straddling it
+        books.onUpdate(0, delta(50, 60, {}, {}));
+        snapshot.changeId = 65;
+        books.onSnapshot(0, snapshot);
+        ok = ok && requests == 2 && books.onUpdate(0, delta(60, 70, {}, {})) && books.find(0)->changeId() == 70;
+        return ok;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (!resyncsMidInterval())
+    {
+        std::cerr << "Book did not resync from a mid-interval snapshot" << std::endl;
+        return 1;
+    }
+
+    std::string path = argc > 1 ? argv[1] : BENCH_DATA_DIR "/book_ETH-PERPETUAL.jsonl";
+    size_t passes = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200;
+
+    std::ifstream in(path);
+    if (!in)
+    {
+        std::cerr << "Cannot open " << path << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> frames;
+    std::vector<BookUpdate> updates;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        BookUpdate update;
+        if (parseBookNotification(json::parse(line)["params"]["data"], update))
+        {
+            frames.push_back(line);
+            updates.push_back(update);
+        }
+    }
+    if (updates.empty() || !updates.front().snapshot)
+    {
+        std::cerr << "Feed must start with a snapshot" << std::endl;
+        return 1;
+    }
+    std::cout << frames.size() << " frames from " << path << ", " << passes << " passes\n";
+
+    // Applying typed updates only
+    OrderBook book;
+    size_t rejected = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t pass = 0; pass < passes; ++pass)
+    {
+        for (const auto &update : updates)
+        {
+            rejected += !book.apply(update);
+        }
+    }
+    auto applyTime = std::chrono::steady_clock::now() - start;
+
+    // Top of book lookups
+    double checksum = 0;
+    const size_t lookups = 10000000;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < lookups; ++i)
+    {
+        checksum += book.price(*book.bestBid()) + book.price(*book.bestAsk());
+    }
+    auto lookupTime = std::chrono::steady_clock::now() - start;
+
+    // Frame to book through nlohmann, as on_message used to do it
+    BookUpdate reused;
+    size_t before = bench::allocations.load();
+    start = std::chrono::steady_clock::now();
+    for (const auto &frame : frames)
+    {
+        json message = json::parse(frame);
+        parseBookNotification(message["params"]["data"], reused);
+        book.apply(reused);
+    }
+    auto domTime = std::chrono::steady_clock::now() - start;
+    size_t domAllocations = bench::allocations.load() - before;
+
+    // Frame to book through the streaming parser, as on_message does it now
+    FrameView view;
+    before = bench::allocations.load();
+    start = std::chrono::steady_clock::now();
+    for (const auto &frame : frames)
+    {
+        scanFrame(frame, view);
+        parseBookData(view.data, reused);
+        book.apply(reused);
+    }
+    auto streamTime = std::chrono::steady_clock::now() - start;
+    size_t streamAllocations = bench::allocations.load() - before;
+
+    std::cout << "apply update:         " << nsPer(applyTime, updates.size() * passes) << " ns/update"
+              << (rejected ? " (" + std::to_string(rejected) + " rejected)" : "") << "\n";
+    std::cout << "best bid + best ask:  " << nsPer(lookupTime, lookups) << " ns/lookup (checksum " << checksum << ")\n";
+    std::cout << "nlohmann + apply:     " << nsPer(domTime, frames.size()) << " ns/frame, "
+              << (double)domAllocations / frames.size() << " allocations/frame\n";
+    std::cout << "streaming + apply:    " << nsPer(streamTime, frames.size()) << " ns/frame, "
+              << (double)streamAllocations / frames.size() << " allocations/frame\n";
+    std::cout << "final book: " << book.bidDepth() << " bids, " << book.askDepth() << " asks, best "
+              << book.price(*book.bestBid()) << " / " << book.price(*book.bestAsk()) << "\n";
+    return 0;
+}
@@ -0,0 +1,483 @@
+// Google Benchmark suite for the client's hot paths, driven by the sample
+// frames in bench/data so it needs no network. Every benchmark reports heap
+// allocations per operation next to the time.
+//
+//   ./TradingClientBench [--benchmark_filter=...]
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "alloc_counter.hpp"
+#include "book_analytics.hpp"
+#include "feed_handler.hpp"
+#include "notification_parser.hpp"
+#include "order_book.hpp"
+#include "order_cache.hpp"
+#include "order_encoder.hpp"
+#include "order_messages.hpp"
+#include "rate_limiter.hpp"
+#include "shared_book.hpp"
+#include "sharded_feed.hpp"
+
+namespace
+{
+    std::vector<std::string> readLines(const std::string &path)
+    {
+        std::ifstream in(path);
+        std::vector<std::string> lines;
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (!line.empty())
+                lines.push_back(line);
+        }
+        return lines;
+    }
+
+    // Sample book.* feed, starting with a snapshot so it can be replayed in a loop
+    const std::vector<std::string> &bookFrames()
+    {
+        static const std::vector<std::string> frames = readLines(BENCH_DATA_DIR "/book_ETH-PERPETUAL.jsonl");
+        return frames;
+    }
+
+    // Measures allocations made while the benchmark loop runs
+    class AllocationCounter
+    {
+    public:
+        explicit AllocationCounter(benchmark::State &state) : state(state), start(bench::allocations.load()) {}
+        ~AllocationCounter()
+        {
+            state.counters["allocs/op"] = benchmark::Counter(double(bench::allocations.load() - start), benchmark::Counter::kAvgIterations);
+        }
+
+    private:
+        benchmark::State &state;
+        size_t start;
+    };
+}
+
+// Processing-thread work for one WebSocket frame: scan, decode, apply, top of book
+static void BM_HandleBookFrame(benchmark::State &state)
+{
+    const auto &frames = bookFrames();
+    if (frames.empty())
+    {
+        state.SkipWithError("missing bench/data/book_ETH-PERPETUAL.jsonl");
+        return;
+    }
+    RpcDispatcher rpc;
+    LatencyHistogram feedLatency;
+    FeedHandler handler(rpc, feedLatency, [](const std::string &) {});
+    InboundFrame frame;
+    size_t longest = 0;
+    for (const auto &f : frames)
+        longest = std::max(longest, f.size());
+    frame.payload.reserve(longest);
+
+    // One pass first so the books and the reused update have grown to size
+    for (const auto &f : frames)
+    {
+        frame.payload.assign(f);
+        handler.handleFrame(frame);
+    }
+
+    size_t next = 0;
+    AllocationCounter counter(state);
+    for (auto _ : state)
+    {
+        // The ring hands over the payload in place, so refilling a reserved buffer stands in for it
+        frame.payload.assign(frames[next]);
+        handler.handleFrame(frame);
+        next = next + 1 == frames.size() ? 0 : next + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HandleBookFrame);
+
+// Order book apply alone, on updates decoded up front
+static void BM_ApplyBookUpdate(benchmark::State &state)
+{
+    std::vector<BookUpdate> updates;
+    for (const auto &f : bookFrames())
+    {
+        FrameView view;
+        BookUpdate update;
+        if (scanFrame(f, view) == FrameKind::Subscription && parseBookData(view.data, update))
+            updates.push_back(std::move(update));
+    }
+    if (updates.empty())
+    {
+        state.SkipWithError("missing bench/data/book_ETH-PERPETUAL.jsonl");
+        return;
+    }
+    OrderBook book(updates.front().instrument);
+    for (const auto &update : updates)
+        book.apply(update);
+
+    size_t next = 0;
+    AllocationCounter counter(state);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(book.apply(updates[next]));
+        next = next + 1 == updates.size() ? 0 : next + 1;
+    }
+}
+BENCHMARK(BM_ApplyBookUpdate);
+
+// BookAnalytics::onUpdate after each apply, with the AVX2 kernels (1) or the scalar ones (0)
+static void BM_BookAnalyticsUpdate(benchmark::State &state)
+{
+    std::vector<BookUpdate> updates;
+    for (const auto &f : bookFrames())
+    {
+        FrameView view;
+        BookUpdate update;
+        if (scanFrame(f, view) == FrameKind::Subscription && parseBookData(view.data, update))
+            updates.push_back(std::move(update));
+    }
+    if (updates.empty())
+    {
+        state.SkipWithError("missing bench/data/book_ETH-PERPETUAL.jsonl");
+        return;
+    }
+    BookAnalytics::useSimd(state.range(0) != 0);
+    if (state.range(0) && !BookAnalytics::simd())
+    {
+        state.SkipWithError("no AVX2 on this CPU");
+        return;
+    }
+    OrderBook book(updates.front().instrument);
+    BookAnalytics analytics;
+    for (const auto &update : updates)
+    {
+        book.apply(update);
+        analytics.onUpdate(book, update);
+    }
+
+    size_t next = 0;
+    AllocationCounter counter(state);
+    for (auto _ : state)
+    {
+        book.apply(updates[next]);
+        analytics.onUpdate(book, updates[next]);
+        benchmark::DoNotOptimize(analytics.metrics().microprice);
+        next = next + 1 == updates.size() ? 0 : next + 1;
+    }
+    BookAnalytics::useSimd(true);
+}
+BENCHMARK(BM_BookAnalyticsUpdate)->Arg(1)->Arg(0);
+
+// Apply followed by a publish of the top 10 levels to shared memory, the
+// writer's cost per update next to BM_ApplyBookUpdate
+static void BM_SharedBookPublish(benchmark::State &state)
+{
+    std::vector<BookUpdate> updates;
+    for (const auto &f : bookFrames())
+    {
+        FrameView view;
+        BookUpdate update;
+        if (scanFrame(f, view) == FrameKind::Subscription && parseBookData(view.data, update))
+            updates.push_back(std::move(update));
+    }
+    if (updates.empty())
+    {
+        state.SkipWithError("missing bench/data/book_ETH-PERPETUAL.jsonl");
+        return;
+    }
+    SharedBookWriter writer("/trading_bench_" + std::to_string(getpid()), 16, 10);
+    if (!writer.ok())
+    {
+        state.SkipWithError("shared memory unavailable");
+        return;
+    }
+    SharedBookPublisher publisher(writer);
+    OrderBook book(updates.front().instrument);
+    for (const auto &update : updates)
+    {
+        book.apply(update);
+        publisher.publish(0, book);
+    }
+
+    // The updates repeat, so their change_ids are renumbered to keep growing
+    // and every publish is written rather than skipped as stale
+    uint64_t changeId = book.changeId();
+    size_t next = 0;
+    AllocationCounter counter(state);
+    for (auto _ : state)
+    {
+        updates[next].prevChangeId = changeId;
+        updates[next].changeId = ++changeId;
+        book.apply(updates[next]);
+        publisher.publish(0, book);
+        next = next + 1 == updates.size() ? 0 : next + 1;
+    }
+}
+BENCHMARK(BM_SharedBookPublish);
+
+// A reader process's copy of one slot, with the given number of levels per side
+static void BM_SharedBookRead(benchmark::State &state)
+{
+    std::vector<BookUpdate> updates;
+    for (const auto &f : bookFrames())
+    {
+        FrameView view;
+        BookUpdate update;
+        if (scanFrame(f, view) == FrameKind::Subscription && parseBookData(view.data, update))
+            updates.push_back(std::move(update));
+    }
+    if (updates.empty())
+    {
+        state.SkipWithError("missing bench/data/book_ETH-PERPETUAL.jsonl");
+        return;
+    }
+    std::string name = "/trading_bench_" + std::to_string(getpid());
+    SharedBookWriter writer(name, 16, 10);
+    SharedBookReader reader;
+    std::string error;
+    if (!writer.ok() || !reader.open(name, error))
+    {
+        state.SkipWithError("shared memory unavailable");
+        return;
+    }
+    OrderBook book(updates.front().instrument);
+    for (const auto &update : updates)
+        book.apply(update);
+    writer.publish(writer.slotFor(book.instrument()), book);
+
+    SharedBookSnapshot snapshot;
+    const uint32_t levels = static_cast<uint32_t>(state.range(0));
+    AllocationCounter counter(state);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(reader.read(0, snapshot, levels));
+    }
+}
+BENCHMARK(BM_SharedBookRead)->Arg(1)->Arg(10);
+
+// REST body for private/buy as placeOrder builds it
+static void BM_BuildBuyRequest(benchmark::State &state)
+{
+    uint64_t id = 0;
+    AllocationCounter counter(state);
+    for (auto _ : state)
+    {
+        std::string body = makeRpcRequest(++id, "private/buy", buyParams("ETH-PERPETUAL", 2650.15, 20)).dump();
+        benchmark::DoNotOptimize(body.data());
+    }
+}
+BENCHMARK(BM_BuildBuyRequest);
+
+// REST body for private/edit as modifyOrder builds it
+static void BM_BuildEditRequest(benchmark::State &state)
+{
+    uint64_t id = 0;
+    const std::string orderId = "ETH-3300007919";
+    AllocationCounter counter(state);
+    for (auto _ : state)
+    {
+        std::string body = makeRpcRequest(++id, "private/edit", editParams(orderId, 2651.5, 40)).dump();
+        benchmark::DoNotOptimize(body.data());
+    }
+}
+BENCHMARK(BM_BuildEditRequest);
+
+// Same private/buy body from the pre-rendered template, checked against the nlohmann bytes first
+static void BM_EncodeBuyRequest(benchmark::State &state)
+{
+    OrderEncoder encoder;
+    std::string expected = makeRpcRequest(7, "private/buy", buyParams("ETH-PERPETUAL", 2650.15, 20)).dump();
+    if (encoder.encodeOrder(7, "ETH-PERPETUAL", OrderEncoder::Side::Buy, OrderEncoder::Type::Limit, 2650.15, 20) != expected)
+    {
+        state.SkipWithError("encoded body differs from nlohmann::json::dump()");
+        return;
+    }
+
+    uint64_t id = 0;
+    AllocationCounter counter(state);
+    for (auto _ : state)
+    {
+        std::string_view body = encoder.encodeOrder(++id, "ETH-PERPETUAL", OrderEncoder::Side::Buy, OrderEncoder::Type::Limit, 2650.15, 20);
+        benchmark::DoNotOptimize(body.data());
+    }
+}
+BENCHMARK(BM_EncodeBuyRequest);
+
+// The same order in ETH-PERPETUAL's ticks (0.05) and lots (1), as sent once its instrument spec is loaded
+static void BM_EncodeBuyRequestTicks(benchmark::State &state)
+{
+    OrderEncoder encoder;
+    const TickScale scale = TickScale::fromSizes(0.05, 1);
+    std::string expected = makeRpcRequest(7, "private/buy", buyParams("ETH-PERPETUAL", 2650.15, 20)).dump();
+    if (encoder.encodeOrder(7, "ETH-PERPETUAL", OrderEncoder::Side::Buy, OrderEncoder::Type::Limit, scale, 53003, 20) != expected)
+    {
+        state.SkipWithError("encoded body differs from nlohmann::json::dump()");
+        return;
+    }
+
+    uint64_t id = 0;
+    AllocationCounter counter(state);
+    for (auto _ : state)
+    {
+        std::string_view body = encoder.encodeOrder(++id, "ETH-PERPETUAL", OrderEncoder::Side::Buy, OrderEncoder::Type::Limit, scale, 53003, 20);
+        benchmark::DoNotOptimize(body.data());
+    }
+}
+BENCHMARK(BM_EncodeBuyRequestTicks);
+
+static void BM_EncodeEditRequest(benchmark::State &state)
+{
+    OrderEncoder encoder;
+    const std::string orderId = "ETH-3300007919";
+    std::string expected = makeRpcRequest(7, "private/edit", editParams(orderId, 2651.5, 40)).dump();
+    if (encoder.encodeEdit(7, orderId, 2651.5, 40) != expected)
+    {
+        state.SkipWithError("encoded body differs from nlohmann::json::dump()");
+        return;
+    }
+
+    uint64_t id = 0;
+    AllocationCounter counter(state);
+    for (auto _ : state)
+    {
+        std::string_view body = encoder.encodeEdit(++id, orderId, 2651.5, 40);
+        benchmark::DoNotOptimize(body.data());
+    }
+}
+BENCHMARK(BM_EncodeEditRequest);
+
+// A 25-order private/get_open_orders response
+static void BM_ParseOpenOrders(benchmark::State &state)
+{
+    std::ifstream in(BENCH_DATA_DIR "/get_open_orders.json");
+    const std::string response((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::vector<OpenOrder> orders;
+    std::string error;
+    if (!parseOpenOrders(response, orders, error))
+    {
+        state.SkipWithError("missing or invalid bench/data/get_open_orders.json");
+        return;
+    }
+
+    AllocationCounter counter(state);
+    for (auto _ : state)
+    {
+        parseOpenOrders(response, orders, error);
+        benchmark::DoNotOptimize(orders.data());
+    }
+    state.SetItemsProcessed(state.iterations() * orders.size());
+}
+BENCHMARK(BM_ParseOpenOrders);
+
+// Pre-cancel check against the order cache seeded from the same 25 orders, in place of a REST round trip
+static void BM_OrderCacheIsOpen(benchmark::State &state)
+{
+    std::ifstream in(BENCH_DATA_DIR "/get_open_orders.json");
+    const std::string response((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::vector<OpenOrder> orders;
+    std::string error;
+    if (!parseOpenOrders(response, orders, error) || orders.empty())
+    {
+        state.SkipWithError("cannot parse get_open_orders.json");
+        return;
+    }
+    OrderCache cache;
+    cache.seed(orders, 0);
+
+    size_t i = 0;
+    AllocationCounter counter(state);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(cache.isOpen(orders[i++ % orders.size()].orderId));
+    }
+}
+BENCHMARK(BM_OrderCacheIsOpen);
+
+// Charging an order against the local credit model, as every send does before it goes out
+static void BM_RateLimiterAcquire(benchmark::State &state)
+{
+    // Pools that never run dry, so every request takes the path an unthrottled order takes
+    RateLimitConfig config;
+    config.matching = {1e18, 1e18, 1};
+    RateLimiter limiter(config);
+
+    AllocationCounter counter(state);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(limiter.tryAcquire(classifyRequest("private/buy")));
+    }
+}
+BENCHMARK(BM_RateLimiterAcquire);
+
+// Top of book slot handed back and forth between two shards, each publishing
+// while it owns it. A shard that has lost the slot must never write again: a
+// shard that has just published finds its own top there unless the slot has
+// moved on.
+static void BM_TopOfBookHandover(benchmark::State &state)
+{
+    TopOfBookBoard board;
+    const uint32_t slot = board.slotFor("ETH-PERPETUAL");
+    OrderBook books[2];
+    for (uint32_t shard = 0; shard < 2; ++shard)
+    {
+        BookUpdate snapshot;
+        snapshot.snapshot = true;
+        snapshot.changeId = 1;
+        snapshot.bids.push_back({BookAction::New, double(shard + 1), 1});
+        books[shard].apply(snapshot);
+    }
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> overwritten{0};
+    // One turn: take the slot, publish and check, then hand it to the other shard
+    auto turn = [&](uint32_t shard)
+    {
+        uint32_t previous;
+        if (board.owner(slot) != shard && !board.tryTakeOver(slot, shard, 1, previous))
+        {
+            return false;
+        }
+        // A stale write lands just after this one, so look for a while
+        for (int i = 0; i < 64 && board.publish(slot, shard, books[shard]); ++i)
+        {
+            TopOfBook top;
+            board.read(slot, top);
+            if (top.bidPrice != shard + 1 && board.owner(slot) == shard)
+            {
+                overwritten.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        board.requestOwner(slot, 1 - shard);
+        return true;
+    };
+    board.requestOwner(slot, 0);
+    std::thread other([&]
+                      {
+        while (!done.load(std::memory_order_relaxed))
+        {
+            turn(1);
+        } });
+
+    uint64_t turns = 0;
+    for (auto _ : state)
+    {
+        turns += turn(0);
+    }
+    done = true;
+    other.join();
+    if (overwritten.load() != 0)
+    {
+        state.SkipWithError("a shard wrote the slot after losing it");
+        return;
+    }
+    state.counters["turns"] = benchmark::Counter(double(turns));
+}
+BENCHMARK(BM_TopOfBookHandover);
+
+BENCHMARK_MAIN();
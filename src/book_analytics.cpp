@@ -0,0 +1,299 @@
+#include "book_analytics.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define TC_HAVE_AVX2_KERNELS 1
+#endif
+
+namespace
+{
+    // Running totals of levels from..size-1, continuing from level from-1
+    using ScanKernel = void (*)(const double *price, const double *amount, double *cumAmount, double *cumNotional,
+                                size_t from, size_t size);
+    // First level whose running total reaches target, size if none does
+    using SearchKernel = size_t (*)(const double *cum, size_t size, double target);
+
+    void scanScalar(const double *price, const double *amount, double *cumAmount, double *cumNotional, size_t from, size_t size)
+    {
+        double total = from > 0 ? cumAmount[from - 1] : 0;
+        double notional = from > 0 ? cumNotional[from - 1] : 0;
+        for (size_t i = from; i < size; ++i)
+        {
+            total += amount[i];
+            notional += price[i] * amount[i];
+            cumAmount[i] = total;
+            cumNotional[i] = notional;
+        }
+    }
+
+    size_t searchScalar(const double *cum, size_t size, double target)
+    {
+        size_t i = 0;
+        while (i < size && cum[i] < target)
+            ++i;
+        return i;
+    }
+
+#ifdef TC_HAVE_AVX2_KERNELS
+    // Inclusive prefix sum of four doubles: within each 128-bit half, then the low half's total into the high half
+    __attribute__((target("avx2"))) inline __m256d prefix4(__m256d v)
+    {
+        v = _mm256_add_pd(v, _mm256_castsi256_pd(_mm256_slli_si256(_mm256_castpd_si256(v), 8)));
+        __m256d low = _mm256_permute4x64_pd(v, _MM_SHUFFLE(1, 1, 1, 1));
+        return _mm256_add_pd(v, _mm256_blend_pd(_mm256_setzero_pd(), low, 0b1100));
+    }
+
+    __attribute__((target("avx2"))) void scanAvx2(const double *price, const double *amount, double *cumAmount,
+                                                  double *cumNotional, size_t from, size_t size)
+    {
+        __m256d total = _mm256_set1_pd(from > 0 ? cumAmount[from - 1] : 0);
+        __m256d notional = _mm256_set1_pd(from > 0 ? cumNotional[from - 1] : 0);
+        size_t i = from;
+        for (; i + 4 <= size; i += 4)
+        {
+            __m256d a = _mm256_loadu_pd(amount + i);
+            __m256d pa = _mm256_mul_pd(_mm256_loadu_pd(price + i), a);
+            total = _mm256_add_pd(prefix4(a), total);
+            notional = _mm256_add_pd(prefix4(pa), notional);
+            _mm256_storeu_pd(cumAmount + i, total);
+            _mm256_storeu_pd(cumNotional + i, notional);
+            // Carry the last lane into the next block
+            total = _mm256_permute4x64_pd(total, _MM_SHUFFLE(3, 3, 3, 3));
+            notional = _mm256_permute4x64_pd(notional, _MM_SHUFFLE(3, 3, 3, 3));
+        }
+        if (i < size)
+        {
+            scanScalar(price, amount, cumAmount, cumNotional, i, size);
+        }
+    }
+
+    __attribute__((target("avx2"))) size_t searchAvx2(const double *cum, size_t size, double target)
+    {
+        const __m256d goal = _mm256_set1_pd(target);
+        size_t i = 0;
+        for (; i + 4 <= size; i += 4)
+        {
+            int mask = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(cum + i), goal, _CMP_GE_OQ));
+            if (mask)
+                return i + __builtin_ctz(mask);
+        }
+        return i + searchScalar(cum + i, size - i, target);
+    }
+
+    bool cpuHasAvx2()
+    {
+        return __builtin_cpu_supports("avx2");
+    }
+#else
+    bool cpuHasAvx2()
+    {
+        return false;
+    }
+#endif
+
+    struct Kernels
+    {
+        ScanKernel scan;
+        SearchKernel search;
+        bool simd;
+    };
+
+    Kernels pickKernels(bool allowSimd)
+    {
+#ifdef TC_HAVE_AVX2_KERNELS
+        if (allowSimd && cpuHasAvx2())
+            return {scanAvx2, searchAvx2, true};
+#endif
+        return {scanScalar, searchScalar, false};
+    }
+
+    Kernels kernels = pickKernels(true);
+
+    template <bool Bids>
+    bool better(int64_t a, int64_t b)
+    {
+        return Bids ? a > b : a < b;
+    }
+
+    // Level i counted from the top of the book's side
+    template <bool Bids>
+    const PriceLevel &level(const OrderBook &book, size_t i)
+    {
+        return Bids ? book.bid(i) : book.ask(i);
+    }
+
+    template <bool Bids>
+    size_t sideDepth(const OrderBook &book)
+    {
+        return Bids ? book.bidDepth() : book.askDepth();
+    }
+
+    void shift(DepthLadder &ladder, size_t to, size_t from, size_t count)
+    {
+        std::memmove(ladder.ticks + to, ladder.ticks + from, count * sizeof(int64_t));
+        std::memmove(ladder.price + to, ladder.price + from, count * sizeof(double));
+        std::memmove(ladder.amount + to, ladder.amount + from, count * sizeof(double));
+    }
+
+    double vwap(const DepthLadder &ladder, double amount)
+    {
+        if (amount <= 0)
+            return 0;
+        size_t last = kernels.search(ladder.cumAmount, ladder.size, amount);
+        if (last == ladder.size)
+            return 0;
+        double before = last > 0 ? ladder.cumAmount[last - 1] : 0;
+        double notional = last > 0 ? ladder.cumNotional[last - 1] : 0;
+        return (notional + ladder.price[last] * (amount - before)) / amount;
+    }
+}
+
+BookAnalytics::BookAnalytics(const BookAnalyticsConfig &config)
+    : depth(std::min(config.depth, DepthLadder::MaxDepth)), fillLots(config.fillLots)
+{
+}
+
+bool BookAnalytics::simd()
+{
+    return kernels.simd;
+}
+
+void BookAnalytics::useSimd(bool enabled)
+{
+    kernels = pickKernels(enabled);
+}
+
+void BookAnalytics::onUpdate(const OrderBook &book, const BookUpdate &update)
+{
+    size_t bidFrom = 0;
+    size_t askFrom = 0;
+    if (update.snapshot || update.prevChangeId != lastChangeId)
+    {
+        // A snapshot, or the book moved on without us (a resync's replayed deltas): start from the book
+        rebuild<true>(bidLadder, book);
+        rebuild<false>(askLadder, book);
+    }
+    else
+    {
+        bidFrom = applyLevels<true>(bidLadder, update.bids, book);
+        askFrom = applyLevels<false>(askLadder, update.asks, book);
+    }
+    lastChangeId = update.changeId;
+
+    kernels.scan(bidLadder.price, bidLadder.amount, bidLadder.cumAmount, bidLadder.cumNotional, bidFrom, bidLadder.size);
+    kernels.scan(askLadder.price, askLadder.amount, askLadder.cumAmount, askLadder.cumNotional, askFrom, askLadder.size);
+    computeMetrics(book);
+}
+
+// Applies the update's levels that fall within the top N and returns the first level changed
+template <bool Bids>
+size_t BookAnalytics::applyLevels(DepthLadder &ladder, const std::vector<LevelUpdate> &levels, const OrderBook &book)
+{
+    const TickScale &scale = book.scale();
+    size_t changed = DepthLadder::MaxDepth;
+    // Whether the ladder holds every level of the side. Past its end there may
+    // be levels only the book knows about, so a level can only be appended
+    // there while this holds; otherwise the refill below picks it up.
+    bool whole = ladder.size < depth;
+    for (const LevelUpdate &update : levels)
+    {
+        int64_t ticks = scale.ticks(update.price);
+        int64_t lots = update.action == BookAction::Delete ? 0 : scale.lots(update.amount);
+        size_t i = std::lower_bound(ladder.ticks, ladder.ticks + ladder.size, ticks, better<Bids>) - ladder.ticks;
+        if (i < ladder.size && ladder.ticks[i] == ticks)
+        {
+            if (lots == 0)
+            {
+                shift(ladder, i, i + 1, ladder.size - i - 1);
+                ladder.size--;
+            }
+            else
+            {
+                ladder.amount[i] = scale.amount(lots);
+            }
+        }
+        else if (lots != 0 && i < depth && (i < ladder.size || whole))
+        {
+            // A full ladder drops its last level, which is now below the top N
+            whole = whole && ladder.size < depth;
+            size_t kept = std::min(ladder.size, depth - 1);
+            shift(ladder, i + 1, i, kept - i);
+            ladder.size = kept + 1;
+            ladder.ticks[i] = ticks;
+            ladder.price[i] = scale.price(ticks);
+            ladder.amount[i] = scale.amount(lots);
+        }
+        else
+        {
+            whole = whole && lots == 0;
+            continue;
+        }
+        changed = std::min(changed, i);
+    }
+    // Deletes pull the levels below the top N up into it
+    if (ladder.size < depth && ladder.size < sideDepth<Bids>(book))
+    {
+        changed = std::min(changed, ladder.size);
+        refill<Bids>(ladder, book);
+    }
+    return std::min(changed, ladder.size);
+}
+
+template <bool Bids>
+void BookAnalytics::rebuild(DepthLadder &ladder, const OrderBook &book)
+{
+    ladder.size = 0;
+    refill<Bids>(ladder, book);
+}
+
+// Appends the book's levels below the ladder until it holds the top N
+template <bool Bids>
+void BookAnalytics::refill(DepthLadder &ladder, const OrderBook &book)
+{
+    const TickScale &scale = book.scale();
+    size_t end = std::min(depth, sideDepth<Bids>(book));
+    for (size_t i = ladder.size; i < end; ++i)
+    {
+        const PriceLevel &next = level<Bids>(book, i);
+        ladder.ticks[i] = next.ticks;
+        ladder.price[i] = scale.price(next.ticks);
+        ladder.amount[i] = scale.amount(next.lots);
+    }
+    ladder.size = std::max(ladder.size, end);
+}
+
+void BookAnalytics::computeMetrics(const OrderBook &book)
+{
+    current.changeId = book.changeId();
+    current.twoSided = bidLadder.size > 0 && askLadder.size > 0;
+    current.bestBid = bidLadder.size ? bidLadder.price[0] : 0;
+    current.bestAsk = askLadder.size ? askLadder.price[0] : 0;
+    if (!current.twoSided)
+    {
+        current.mid = current.microprice = current.spread = current.imbalance = 0;
+        current.buyVwap = current.sellVwap = 0;
+        return;
+    }
+
+    const double bidSize = bidLadder.amount[0];
+    const double askSize = askLadder.amount[0];
+    current.spread = current.bestAsk - current.bestBid;
+    current.mid = (current.bestBid + current.bestAsk) / 2;
+    current.microprice = (current.bestBid * askSize + current.bestAsk * bidSize) / (bidSize + askSize);
+
+    const double bidDepth = bidLadder.cumAmount[bidLadder.size - 1];
+    const double askDepth = askLadder.cumAmount[askLadder.size - 1];
+    current.imbalance = (bidDepth - askDepth) / (bidDepth + askDepth);
+
+    const double fill = book.scale().amount(fillLots);
+    current.buyVwap = vwap(askLadder, fill);
+    current.sellVwap = vwap(bidLadder, fill);
+}
+
+double BookAnalytics::vwapToFill(bool buy, double amount) const
+{
+    return vwap(buy ? askLadder : bidLadder, amount);
+}
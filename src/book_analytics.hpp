@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "order_book.hpp"
+
+struct BookAnalyticsConfig
+{
+    size_t depth = 10;      // levels per side the top-N figures cover; 0 turns analytics off
+    int64_t fillLots = 100; // size of the VWAP-to-fill figures, in lots so it suits every instrument
+};
+
+// Figures derived from one book, as of changeId
+struct BookMetrics
+{
+    uint64_t changeId = 0;
+    bool twoSided = false; // the rest is only meaningful with both sides present
+    double bestBid = 0;
+    double bestAsk = 0;
+    double mid = 0;
+    double microprice = 0; // mid weighted towards the side with less size at the top
+    double spread = 0;
+    double imbalance = 0; // (bid - ask) / (bid + ask) size over the top N levels, -1..1
+    double buyVwap = 0;   // average price to buy fillLots against the asks, 0 if the top N is too thin
+    double sellVwap = 0;  // same, selling into the bids
+};
+
+// One side's top levels as structure-of-arrays, best first, with running
+// totals so the cumulative depth at level i is a load rather than a loop
+struct DepthLadder
+{
+    static constexpr size_t MaxDepth = 64;
+
+    alignas(32) int64_t ticks[MaxDepth];
+    alignas(32) double price[MaxDepth];
+    alignas(32) double amount[MaxDepth];
+    alignas(32) double cumAmount[MaxDepth];   // amount of levels 0..i
+    alignas(32) double cumNotional[MaxDepth]; // price * amount of levels 0..i
+    size_t size = 0;
+};
+
+// Keeps the figures above current as a book changes. Each update is applied
+// to the top-N ladders level by level, only the levels it touches are
+// converted from ticks and lots, and the running totals are rebuilt from the
+// first changed level down, so a delta never rescans the book. The totals are
+// prefix sums over contiguous doubles, done four levels at a time with AVX2
+// where the CPU has it and in scalar code otherwise.
+class BookAnalytics
+{
+public:
+    explicit BookAnalytics(const BookAnalyticsConfig &config = BookAnalyticsConfig());
+
+    // book is the state after update was applied to it
+    void onUpdate(const OrderBook &book, const BookUpdate &update);
+
+    const BookMetrics &metrics() const { return current; }
+    const DepthLadder &bids() const { return bidLadder; }
+    const DepthLadder &asks() const { return askLadder; }
+    // Average price to buy (against the asks) or sell the amount; 0 if the top N is too thin
+    double vwapToFill(bool buy, double amount) const;
+
+    // True if the AVX2 kernels are in use
+    static bool simd();
+    // Benchmarks only: false forces the scalar kernels, true restores the CPU's best
+    static void useSimd(bool enabled);
+
+private:
+    template <bool Bids>
+    size_t applyLevels(DepthLadder &ladder, const std::vector<LevelUpdate> &levels, const OrderBook &book);
+    template <bool Bids>
+    void rebuild(DepthLadder &ladder, const OrderBook &book);
+    template <bool Bids>
+    void refill(DepthLadder &ladder, const OrderBook &book);
+    void computeMetrics(const OrderBook &book);
+
+    size_t depth;
+    int64_t fillLots;
+    uint64_t lastChangeId = 0;
+    DepthLadder bidLadder;
+    DepthLadder askLadder;
+    BookMetrics current;
+};
@@ -0,0 +1,179 @@
+#include "book_conflator.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    // Sets the level's lots, keeping a delete as lots 0 unless the levels are a whole book
+    void setLevel(std::vector<PriceLevel> &levels, int64_t ticks, int64_t lots, bool wholeBook)
+    {
+        auto it = std::lower_bound(levels.begin(), levels.end(), ticks, [](const PriceLevel &level, int64_t price)
+                                   { return level.ticks < price; });
+        if (it != levels.end() && it->ticks == ticks)
+        {
+            if (lots == 0 && wholeBook)
+                levels.erase(it);
+            else
+                it->lots = lots;
+        }
+        else if (lots != 0 || !wholeBook)
+        {
+            levels.insert(it, PriceLevel{ticks, lots});
+        }
+    }
+
+    void mergeLevels(std::vector<PriceLevel> &levels, const std::vector<LevelUpdate> &updates, const TickScale &scale, bool wholeBook)
+    {
+        for (const LevelUpdate &update : updates)
+        {
+            int64_t lots = update.action == BookAction::Delete ? 0 : scale.lots(update.amount);
+            setLevel(levels, scale.ticks(update.price), lots, wholeBook);
+        }
+    }
+
+    void toUpdates(const std::vector<PriceLevel> &levels, const TickScale &scale, bool snapshot, std::vector<LevelUpdate> &out)
+    {
+        out.clear();
+        for (const PriceLevel &level : levels)
+        {
+            BookAction action = level.lots == 0 ? BookAction::Delete : snapshot ? BookAction::New
+                                                                                : BookAction::Change;
+            out.push_back(LevelUpdate{action, scale.price(level.ticks), scale.amount(level.lots)});
+        }
+    }
+}
+
+void BookConflator::push(uint32_t instrumentId, const OrderBook &book, const BookUpdate &update)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (instrumentId >= entries.size())
+    {
+        entries.resize(instrumentId + 1);
+    }
+    Entry &entry = entries[instrumentId];
+    counters.updates++;
+    counters.pendingLevels -= entry.bids.size() + entry.asks.size();
+
+    const bool wasPending = entry.pending;
+    if (entry.instrument.empty())
+    {
+        entry.instrument = book.instrument();
+    }
+    entry.scale = book.scale();
+    if (!update.snapshot && update.prevChangeId != entry.lastPushed)
+    {
+        // The book moved on without us, e.g. through a resync's replayed deltas
+        takeBook(entry, book);
+    }
+    else
+    {
+        merge(entry, update);
+        // A whole book only grows as far as the book does; a run of deltas could grow without end
+        if (!entry.snapshot && entry.bids.size() + entry.asks.size() > MaxPendingLevels)
+        {
+            takeBook(entry, book);
+        }
+    }
+    entry.changeId = update.changeId;
+    entry.lastPushed = update.changeId;
+    entry.timestamp = update.timestamp;
+
+    counters.pendingLevels += entry.bids.size() + entry.asks.size();
+    counters.peakPendingLevels = std::max(counters.peakPendingLevels, counters.pendingLevels);
+    if (wasPending)
+    {
+        entry.merged++;
+        counters.conflated++;
+        return;
+    }
+    entry.pending = true;
+    entry.merged = 1;
+    pendingIds.push_back(instrumentId);
+    ready.notify_one();
+}
+
+void BookConflator::merge(Entry &entry, const BookUpdate &update)
+{
+    if (update.snapshot || !entry.pending)
+    {
+        entry.bids.clear();
+        entry.asks.clear();
+        entry.snapshot = update.snapshot;
+        entry.prevChangeId = update.prevChangeId;
+    }
+    mergeLevels(entry.bids, update.bids, entry.scale, entry.snapshot);
+    mergeLevels(entry.asks, update.asks, entry.scale, entry.snapshot);
+}
+
+// Replaces the entry with the whole book, from which any consumer can restart
+void BookConflator::takeBook(Entry &entry, const OrderBook &book)
+{
+    counters.fullBooks++;
+    entry.snapshot = true;
+    entry.prevChangeId = 0;
+    entry.bids.clear();
+    entry.asks.clear();
+    for (size_t i = book.bidDepth(); i-- > 0;)
+    {
+        entry.bids.push_back(book.bid(i));
+    }
+    for (size_t i = 0; i < book.askDepth(); ++i)
+    {
+        entry.asks.push_back(book.ask(i));
+    }
+}
+
+bool BookConflator::pop(ConflatedBook &out, std::chrono::microseconds timeout)
+{
+    TickScale scale;
+    bool snapshot;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!ready.wait_for(lock, timeout, [this]
+                            { return stopped || !pendingIds.empty(); }) ||
+            stopped)
+        {
+            return false;
+        }
+        uint32_t id = pendingIds.front();
+        pendingIds.pop_front();
+        Entry &entry = entries[id];
+
+        out.instrumentId = id;
+        out.merged = entry.merged;
+        out.update.instrument = entry.instrument;
+        out.update.snapshot = snapshot = entry.snapshot;
+        out.update.changeId = entry.changeId;
+        out.update.prevChangeId = entry.prevChangeId;
+        out.update.timestamp = entry.timestamp;
+        scale = entry.scale;
+        takenBids.swap(entry.bids);
+        takenAsks.swap(entry.asks);
+        entry.bids.clear();
+        entry.asks.clear();
+        entry.pending = false;
+
+        counters.pendingLevels -= takenBids.size() + takenAsks.size();
+        counters.delivered++;
+    }
+    toUpdates(takenBids, scale, snapshot, out.update.bids);
+    toUpdates(takenAsks, scale, snapshot, out.update.asks);
+    return true;
+}
+
+void BookConflator::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+    }
+    ready.notify_all();
+}
+
+BookConflator::Stats BookConflator::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats stats = counters;
+    stats.pending = pendingIds.size();
+    return stats;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "order_book.hpp"
+
+// Changes to one instrument's book since its consumer last took them
+struct ConflatedBook
+{
+    uint32_t instrumentId = 0;
+    // Continues from the change_id of the previous update taken for the
+    // instrument, or is a snapshot; either way OrderBook::apply accepts it
+    BookUpdate update;
+    uint32_t merged = 0; // feed updates folded into this one
+};
+
+// Hands book updates from the processing thread to a slower consumer without
+// queueing them. Each instrument has at most one pending entry, and an update
+// for an instrument that is still pending is merged into it level by level,
+// the latest amount winning. The consumer takes instruments in the order they
+// became pending. Memory is bounded by the number of instruments and
+// MaxPendingLevels whatever the input rate: an entry that would grow past it
+// is replaced by the whole book.
+class BookConflator
+{
+public:
+    using Consumer = std::function<void(const ConflatedBook &book)>;
+
+    static constexpr size_t MaxPendingLevels = 1024;
+
+    struct Stats
+    {
+        uint64_t updates = 0;   // pushed by the processing thread
+        uint64_t delivered = 0; // taken by the consumer
+        uint64_t conflated = 0; // merged into an entry that was already pending
+        uint64_t fullBooks = 0; // entries replaced by the whole book
+        size_t pending = 0;     // instruments waiting for the consumer
+        size_t pendingLevels = 0;
+        size_t peakPendingLevels = 0;
+    };
+
+    // Processing thread; book is the state after update was applied
+    void push(uint32_t instrumentId, const OrderBook &book, const BookUpdate &update);
+    // Single consumer: takes the instrument that has waited longest, false if
+    // none became pending within timeout or stop() was called
+    bool pop(ConflatedBook &out, std::chrono::microseconds timeout);
+    void stop();
+
+    Stats stats() const;
+
+private:
+    struct Entry
+    {
+        std::string instrument;
+        TickScale scale;
+        bool pending = false;
+        bool snapshot = false;
+        uint64_t prevChangeId = 0;
+        uint64_t changeId = 0;
+        uint64_t lastPushed = 0; // change_id of the last update pushed, pending or not
+        int64_t timestamp = 0;
+        uint32_t merged = 0;
+        // Ascending by ticks; lots 0 deletes the level unless the entry is a snapshot
+        std::vector<PriceLevel> bids;
+        std::vector<PriceLevel> asks;
+    };
+
+    void merge(Entry &entry, const BookUpdate &update);
+    void takeBook(Entry &entry, const OrderBook &book);
+
+    mutable std::mutex mutex;
+    std::condition_variable ready;
+    bool stopped = false;
+    std::vector<Entry> entries;       // by instrument id
+    std::deque<uint32_t> pendingIds;  // each pending instrument once, oldest first
+    Stats counters;
+    // Consumer only: levels swapped out of an entry, converted outside the lock
+    std::vector<PriceLevel> takenBids;
+    std::vector<PriceLevel> takenAsks;
+};
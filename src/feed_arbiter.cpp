@@ -0,0 +1,53 @@
+#include "feed_arbiter.hpp"
+
+FeedArbiter::FeedArbiter(uint32_t legs, uint32_t capacity)
+    : legCount(legs), capacity(capacity), slots(new Slot[capacity]), stats(new LegStats[legs])
+{
+}
+
+bool FeedArbiter::offer(uint32_t slot, uint32_t leg, uint64_t changeId, int64_t receivedAt)
+{
+    if (slot >= capacity || leg >= legCount)
+    {
+        return false;
+    }
+    Slot &s = slots[slot];
+    Winner &winner = s.recent[changeId % History];
+
+    uint64_t latest = s.latest.load(std::memory_order_acquire);
+    while (changeId > latest)
+    {
+        if (s.latest.compare_exchange_weak(latest, changeId, std::memory_order_acq_rel))
+        {
+            winner.changeId.store(0, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            winner.receivedAt.store(receivedAt, std::memory_order_relaxed);
+            winner.changeId.store(changeId, std::memory_order_release);
+            stats[leg].wins.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    stats[leg].duplicates.fetch_add(1, std::memory_order_relaxed);
+    // The entry may be rewritten for a later change_id while it is read, so check it again afterwards
+    if (winner.changeId.load(std::memory_order_acquire) == changeId)
+    {
+        int64_t winnerAt = winner.receivedAt.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (winner.changeId.load(std::memory_order_relaxed) == changeId)
+        {
+            int64_t behind = receivedAt - winnerAt;
+            stats[leg].lag.record(behind > 0 ? behind : 0);
+            return false;
+        }
+    }
+    stats[leg].unmeasured.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+double FeedArbiter::winRate(uint32_t leg) const
+{
+    uint64_t won = wins(leg);
+    uint64_t offered = won + duplicates(leg);
+    return offered ? (double)won / offered : 0;
+}
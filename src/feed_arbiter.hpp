@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include "latency_histogram.hpp"
+
+// First-wins arbitration between redundant feed legs carrying the same books.
+// Each leg keeps its own books from its own connection and offers every
+// change_id it applies; the first offer of a change_id wins and is published,
+// later offers of it (or of anything older) are duplicates. A single CAS per
+// update decides, so legs never wait for each other, and a leg that stalls or
+// drops simply stops winning while the others carry on.
+class FeedArbiter
+{
+public:
+    // Recent winners remembered per book, for timing the legs that lose
+    static constexpr uint32_t History = 8;
+
+    FeedArbiter(uint32_t legs, uint32_t capacity);
+
+    // True if leg is the first to offer changeId for slot. Otherwise the offer
+    // is counted as a duplicate and, if the winner is still remembered, the
+    // time leg was behind it is recorded; if not, the offer is counted as
+    // unmeasured, since the leg is more than History updates behind.
+    bool offer(uint32_t slot, uint32_t leg, uint64_t changeId, int64_t receivedAt);
+
+    uint32_t legs() const { return legCount; }
+    uint64_t wins(uint32_t leg) const { return stats[leg].wins.load(std::memory_order_relaxed); }
+    uint64_t duplicates(uint32_t leg) const { return stats[leg].duplicates.load(std::memory_order_relaxed); }
+    // Share of the updates leg offered that it won, 0..1
+    double winRate(uint32_t leg) const;
+    // How long after the winning leg this leg received the updates it lost
+    const LatencyHistogram &lag(uint32_t leg) const { return stats[leg].lag; }
+    // Duplicates that came too late to be timed: the lag histogram leaves
+    // these out, so a leg with many of them is slower than it shows
+    uint64_t unmeasured(uint32_t leg) const { return stats[leg].unmeasured.load(std::memory_order_relaxed); }
+
+private:
+    struct Winner
+    {
+        std::atomic<uint64_t> changeId{0}; // 0 while the entry is being written
+        std::atomic<int64_t> receivedAt{0};
+    };
+
+    struct alignas(64) Slot
+    {
+        std::atomic<uint64_t> latest{0}; // highest change_id won so far
+        Winner recent[History];          // indexed by change_id % History
+    };
+
+    struct LegStats
+    {
+        std::atomic<uint64_t> wins{0};
+        std::atomic<uint64_t> duplicates{0};
+        std::atomic<uint64_t> unmeasured{0};
+        LatencyHistogram lag;
+    };
+
+    const uint32_t legCount;
+    const uint32_t capacity;
+    std::unique_ptr<Slot[]> slots;
+    std::unique_ptr<LegStats[]> stats;
+};
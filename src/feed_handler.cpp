@@ -0,0 +1,210 @@
+#include "feed_handler.hpp"
+
+#include "logger.hpp"
+#include "notification_parser.hpp"
+
+using json = nlohmann::json;
+
+FeedHandler::FeedHandler(RpcDispatcher &rpc, LatencyHistogram &feedLatency, BookManager::SnapshotRequest requestSnapshot)
+    : rpc(rpc), feedLatency(feedLatency), bookManager(std::move(requestSnapshot))
+{
+}
+
+void FeedHandler::handleFrame(InboundFrame &inboundFrame)
+{
+    if (inboundFrame.kind == InboundFrame::BookSnapshot)
+    {
+        applyBookSnapshot(inboundFrame.payload);
+        return;
+    }
+
+    // Market data is decoded in place; only RPC responses and rare frames go through nlohmann
+    const std::string &payload = inboundFrame.payload;
+    FrameView frame;
+    try
+    {
+        FrameKind kind = scanFrame(payload, frame);
+        if (recorder)
+        {
+            recorder->record(inboundFrame.receivedUnixNs, inboundFrame.receivedAt, inboundFrame.connectionId, frame.channel, payload);
+        }
+        switch (kind)
+        {
+        case FrameKind::Subscription:
+        {
+            updateCount++;
+            LOG_DEBUG("Update #{}", updateCount);
+            uint32_t channelId = channelIds.find(frame.channel);
+            if (channelId == InstrumentRegistry::NotFound)
+            {
+                channelId = registerChannel(frame.channel);
+            }
+            const uint32_t instrumentId = channelInstrument[channelId];
+            if (instrumentId == OrdersChannel || instrumentId == TradesChannel)
+            {
+                applyOrderNotification(instrumentId, frame.data);
+            }
+            else if (instrumentId != InstrumentRegistry::NotFound)
+            {
+                if (!parseBookData(frame.data, bookUpdate))
+                {
+                    LOG_ERROR("Error parsing book notification on {}", frame.channel);
+                }
+                else if (const OrderBook *book = bookManager.onUpdate(instrumentId, bookUpdate))
+                {
+                    recordFeedLatency(inboundFrame, bookUpdate.timestamp);
+                    const BookAnalytics *figures = nullptr;
+                    if (analyticsConfig.depth > 0)
+                    {
+                        if (instrumentId >= bookAnalytics.size())
+                        {
+                            bookAnalytics.resize(instrumentId + 1, BookAnalytics(analyticsConfig));
+                        }
+                        bookAnalytics[instrumentId].onUpdate(*book, bookUpdate);
+                        figures = &bookAnalytics[instrumentId];
+                    }
+                    if (bookListener)
+                    {
+                        bookListener(instrumentId, *book, bookUpdate);
+                    }
+                    printTopOfBook(*book, figures);
+                }
+                else
+                {
+                    LOG_WARN("{} resyncing after change_id gap", bookUpdate.instrument);
+                }
+            }
+            else
+            {
+                LOG_INFO("Data updated on {}: {}", frame.channel, frame.data);
+            }
+            break;
+        }
+        case FrameKind::Response:
+            // Responses to our own requests carry the id we sent
+            rpc.complete(frame.id, json::parse(payload));
+            break;
+        case FrameKind::Other:
+        {
+            json response = json::parse(payload);
+            if (response.contains("params") && response["params"].contains("error"))
+            {
+                LOG_ERROR("Error: {}", response["params"]["error"].dump());
+            }
+            break;
+        }
+        case FrameKind::Malformed:
+            LOG_ERROR("Error parsing WebSocket message: malformed frame");
+            break;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        LOG_ERROR("Error parsing WebSocket message: {}", e.what());
+    }
+}
+
+void FeedHandler::applyOrderNotification(uint32_t channelKind, std::string_view data)
+{
+    if (!orderCache)
+    {
+        LOG_INFO("Order update: {}", data);
+        return;
+    }
+    if (channelKind == OrdersChannel)
+    {
+        if (!parseOrderUpdates(data, orderUpdates))
+        {
+            LOG_ERROR("Error parsing order notification: {}", data);
+            return;
+        }
+        for (const OpenOrder &order : orderUpdates)
+        {
+            orderCache->onOrder(order);
+            LOG_INFO("Order {} {} {} @ {} ({} filled of {})", order.orderId, order.orderState, order.instrument,
+                     order.price, order.filledAmount, order.amount);
+        }
+    }
+    else
+    {
+        if (!parseOrderTrades(data, orderTrades))
+        {
+            LOG_ERROR("Error parsing trade notification: {}", data);
+            return;
+        }
+        for (const OrderTrade &trade : orderTrades)
+        {
+            orderCache->onTrade(trade);
+        }
+    }
+}
+
+void FeedHandler::applyBookSnapshot(const std::string &response)
+{
+    try
+    {
+        auto responseJson = json::parse(response);
+        BookUpdate snapshot;
+        if (responseJson.contains("result") && parseBookSnapshot(responseJson["result"], snapshot))
+        {
+            bookManager.onSnapshot(instrumentIds.intern(snapshot.instrument), snapshot);
+            return;
+        }
+        LOG_ERROR("Unexpected order book snapshot: {}", response);
+    }
+    catch (const std::exception &e)
+    {
+        LOG_ERROR("Error parsing order book snapshot: {}", e.what());
+    }
+}
+
+// First frame on a channel: book.<instrument>.<interval> channels get the instrument's id
+uint32_t FeedHandler::registerChannel(std::string_view channel)
+{
+    uint32_t channelId = channelIds.intern(channel);
+    uint32_t instrumentId = InstrumentRegistry::NotFound;
+    std::string_view instrument = bookChannelInstrument(channel);
+    if (!instrument.empty())
+    {
+        instrumentId = instrumentIds.intern(instrument);
+    }
+    else if (channel.substr(0, 12) == "user.orders.")
+    {
+        instrumentId = OrdersChannel;
+    }
+    else if (channel.substr(0, 12) == "user.trades.")
+    {
+        instrumentId = TradesChannel;
+    }
+    channelInstrument.resize(channelIds.size(), InstrumentRegistry::NotFound);
+    channelInstrument[channelId] = instrumentId;
+    return channelId;
+}
+
+// Exchange timestamps are in ms and the clocks are not synchronised, so small negative values count as 0
+void FeedHandler::recordFeedLatency(const InboundFrame &frame, int64_t exchangeTimestampMs)
+{
+    if (exchangeTimestampMs <= 0)
+    {
+        return;
+    }
+    int64_t delay = frame.receivedUnixNs - exchangeTimestampMs * 1000000;
+    feedLatency.record(delay > 0 ? delay : 0);
+}
+
+void FeedHandler::printTopOfBook(const OrderBook &book, const BookAnalytics *figures)
+{
+    const PriceLevel empty{0, 0};
+    const PriceLevel *bid = book.bestBid() ? book.bestBid() : &empty;
+    const PriceLevel *ask = book.bestAsk() ? book.bestAsk() : &empty;
+    if (figures && figures->metrics().twoSided)
+    {
+        const BookMetrics &m = figures->metrics();
+        LOG_INFO("{} bid {} @ {} | ask {} @ {} (change_id {}) mid {} micro {} spread {} imbalance {} vwap buy {} sell {}",
+                 book.instrument(), book.amount(*bid), book.price(*bid), book.amount(*ask), book.price(*ask), book.changeId(),
+                 m.mid, m.microprice, m.spread, m.imbalance, m.buyVwap, m.sellVwap);
+        return;
+    }
+    LOG_INFO("{} bid {} @ {} | ask {} @ {} (change_id {})", book.instrument(),
+             book.amount(*bid), book.price(*bid), book.amount(*ask), book.price(*ask), book.changeId());
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "book_analytics.hpp"
+#include "feed_recorder.hpp"
+#include "instrument_registry.hpp"
+#include "latency_histogram.hpp"
+#include "order_book.hpp"
+#include "order_cache.hpp"
+#include "rpc_dispatcher.hpp"
+
+// Frame handed from the WebSocket thread to the processing thread
+struct InboundFrame
+{
+    enum Kind : uint8_t
+    {
+        WebSocket,   // payload is a raw WebSocket frame
+        BookSnapshot // payload is a public/get_order_book response fetched for a resync
+    };
+    Kind kind = WebSocket;
+    std::string payload;
+    int64_t receivedAt = 0;     // steady clock, ns, when on_message ran
+    int64_t receivedUnixNs = 0; // wall clock at the same moment, compared with exchange timestamps
+    uint32_t connectionId = 0;  // WebSocket session the frame arrived on
+};
+
+// Everything the processing thread does with an inbound frame: market data is
+// decoded in place into the local books, responses are handed to the RPC
+// dispatcher. Holds no connection, so it can be driven from recorded frames.
+class FeedHandler
+{
+public:
+    // Called with every book that an update left valid and the update itself, on the processing thread
+    using BookListener = std::function<void(uint32_t instrumentId, const OrderBook &book, const BookUpdate &update)>;
+
+    FeedHandler(RpcDispatcher &rpc, LatencyHistogram &feedLatency, BookManager::SnapshotRequest requestSnapshot);
+
+    void handleFrame(InboundFrame &frame);
+    void applyBookSnapshot(const std::string &response);
+    // Copies every WebSocket frame into recorder before handling it; nullptr stops recording
+    void setRecorder(FeedRecorder *recorder) { this->recorder = recorder; }
+    void setBookListener(BookListener listener) { bookListener = std::move(listener); }
+    // Applies user.orders.* and user.trades.* notifications to orders; nullptr only logs them
+    void setOrderCache(OrderCache *orders) { orderCache = orders; }
+    // Tick and lot grid for books created from now on; set before frames arrive
+    void setScaleLookup(BookManager::ScaleLookup lookup) { bookManager.setScaleLookup(std::move(lookup)); }
+    // Keeps BookAnalytics current for every book; set before frames arrive, depth 0 (the default) turns it off
+    void setAnalytics(const BookAnalyticsConfig &config) { analyticsConfig = config; }
+    // Figures for a book, nullptr until it has had an update with analytics on
+    const BookAnalytics *analytics(uint32_t instrumentId) const
+    {
+        return instrumentId < bookAnalytics.size() ? &bookAnalytics[instrumentId] : nullptr;
+    }
+
+    const BookManager &books() const { return bookManager; }
+    const InstrumentRegistry &instruments() const { return instrumentIds; }
+    uint64_t updates() const { return updateCount; }
+
+private:
+    // channelInstrument values of the private order channels
+    static constexpr uint32_t OrdersChannel = InstrumentRegistry::NotFound - 1;
+    static constexpr uint32_t TradesChannel = InstrumentRegistry::NotFound - 2;
+
+    uint32_t registerChannel(std::string_view channel);
+    void applyOrderNotification(uint32_t channelKind, std::string_view data);
+    void recordFeedLatency(const InboundFrame &frame, int64_t exchangeTimestampMs);
+    void printTopOfBook(const OrderBook &book, const BookAnalytics *figures);
+
+    RpcDispatcher &rpc;
+    LatencyHistogram &feedLatency;
+    FeedRecorder *recorder = nullptr;
+    BookListener bookListener;
+    OrderCache *orderCache = nullptr;
+    std::vector<OpenOrder> orderUpdates; // reused for every user.orders notification
+    std::vector<OrderTrade> orderTrades;
+    // Channels seen so far, each mapped to the instrument id of its book, a
+    // private order channel, or NotFound for other channels
+    InstrumentRegistry channelIds;
+    std::vector<uint32_t> channelInstrument;
+    InstrumentRegistry instrumentIds;
+    // Local L2 books built from book.* notifications, indexed by instrument id
+    BookManager bookManager;
+    BookAnalyticsConfig analyticsConfig{0};
+    std::vector<BookAnalytics> bookAnalytics; // by instrument id, like the books
+    BookUpdate bookUpdate; // reused for every notification
+    uint64_t updateCount = 0;
+};
@@ -0,0 +1,453 @@
+#include "feed_recorder.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "logger.hpp"
+
+namespace
+{
+    // Bytes kept prefaulted ahead of the write position
+    constexpr uint64_t PrefaultAhead = uint64_t(4) << 20;
+    constexpr size_t PageSize = 4096;
+
+    uint64_t alignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    int64_t wallClockNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    CaptureFile::IndexEntry *indexOf(CaptureFile::Header *header)
+    {
+        return header->index;
+    }
+
+    const CaptureFile::IndexEntry *indexOf(const CaptureFile::Header *header)
+    {
+        return header->index;
+    }
+}
+
+struct FeedRecorder::Segment
+{
+    std::string path;
+    int fd = -1;
+    char *base = nullptr;
+    size_t size = 0;
+    uint64_t prefaulted = CaptureFile::HeaderSize;
+
+    CaptureFile::Header *header() const { return reinterpret_cast<CaptureFile::Header *>(base); }
+};
+
+FeedRecorder::FeedRecorder(const RecorderConfig &config) : config(config)
+{
+    this->config.maxFileBytes = std::max<size_t>(alignUp(config.maxFileBytes, PageSize), CaptureFile::HeaderSize + PageSize);
+
+    std::time_t now = std::time(nullptr);
+    std::tm utc;
+    gmtime_r(&now, &utc);
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &utc);
+    sessionName = config.prefix + "-" + stamp;
+
+    std::error_code ec;
+    std::filesystem::create_directories(config.directory, ec);
+    if (ec)
+    {
+        LOG_ERROR("Cannot create capture directory {}: {}", config.directory, ec.message());
+    }
+
+    active = createSegment();
+    if (active && !activate(*active))
+    {
+        retireSpare(*active);
+        active.reset();
+    }
+    if (active)
+    {
+        writePos = CaptureFile::HeaderSize;
+        nextIndexAt = writePos;
+        published = active;
+    }
+    helper = std::thread(&FeedRecorder::helperLoop, this);
+}
+
+FeedRecorder::~FeedRecorder()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    helper.join();
+
+    if (active)
+        finish(*active);
+    if (spare)
+        retireSpare(*spare);
+    for (auto &segment : retired)
+        finish(*segment);
+}
+
+std::string FeedRecorder::currentFile() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return published ? published->path : std::string();
+}
+
+bool FeedRecorder::record(int64_t receivedUnixNs, int64_t receivedAt, uint32_t connectionId, std::string_view channel, std::string_view payload)
+{
+    const uint64_t need = alignUp(sizeof(CaptureFile::RecordHeader) + channel.size() + payload.size(), CaptureFile::Alignment);
+    if (need > config.maxFileBytes - CaptureFile::HeaderSize || channel.size() > UINT16_MAX)
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    bool expired = activeSinceUnixNs != 0 && config.maxFileAge.count() > 0 &&
+                   receivedUnixNs - activeSinceUnixNs >= std::chrono::nanoseconds(config.maxFileAge).count();
+    if (!active || writePos + need > active->size || expired)
+    {
+        if (!rollover())
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+
+    CaptureFile::Header *header = active->header();
+    if (activeSinceUnixNs == 0)
+    {
+        activeSinceUnixNs = receivedUnixNs;
+        header->createdUnixNs = receivedUnixNs;
+    }
+
+    char *out = active->base + writePos;
+    CaptureFile::RecordHeader record{};
+    record.payloadSize = (uint32_t)payload.size();
+    record.channelSize = (uint16_t)channel.size();
+    record.connectionId = connectionId;
+    record.receivedUnixNs = receivedUnixNs;
+    record.receivedAt = receivedAt;
+    std::memcpy(out, &record, sizeof(record));
+    std::memcpy(out + sizeof(record), channel.data(), channel.size());
+    std::memcpy(out + sizeof(record) + channel.size(), payload.data(), payload.size());
+    // Padding is already zero: the file is created sparse and only ever appended to
+
+    const uint64_t recordStart = writePos;
+    writePos += need;
+    header->committed.store(writePos, std::memory_order_release);
+
+    if (recordStart >= nextIndexAt)
+    {
+        uint32_t count = header->indexCount.load(std::memory_order_relaxed);
+        if (count < header->indexCapacity)
+        {
+            indexOf(header)[count] = CaptureFile::IndexEntry{receivedUnixNs, recordStart};
+            header->indexCount.store(count + 1, std::memory_order_release);
+        }
+        nextIndexAt = recordStart + header->indexSpacing;
+    }
+
+    writeHint.store(writePos, std::memory_order_relaxed);
+    recorded.fetch_add(1, std::memory_order_relaxed);
+    recordedBytes.fetch_add(need, std::memory_order_relaxed);
+    return true;
+}
+
+// Switches to the file the helper prepared, or creates one here if it is not ready
+bool FeedRecorder::rollover()
+{
+    std::shared_ptr<Segment> next;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        next = std::move(spare);
+    }
+    if (!next)
+    {
+        inlineRollovers.fetch_add(1, std::memory_order_relaxed);
+        next = createSegment();
+    }
+    if (!next || !activate(*next))
+    {
+        if (next)
+        {
+            retireSpare(*next);
+        }
+        return false;
+    }
+
+    std::shared_ptr<Segment> previous = std::move(active);
+    active = std::move(next);
+    writePos = CaptureFile::HeaderSize;
+    nextIndexAt = writePos;
+    activeSinceUnixNs = 0;
+    writeHint.store(writePos, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        published = active;
+        if (previous)
+            retired.push_back(std::move(previous));
+    }
+    wake.notify_one();
+    LOG_INFO("Capture rolled over to {}", active->path);
+    return true;
+}
+
+bool FeedRecorder::activate(Segment &segment)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "-%04llu.tccap", (unsigned long long)++sequence);
+    std::string path = (std::filesystem::path(config.directory) / (sessionName + name)).string();
+    if (std::rename(segment.path.c_str(), path.c_str()) != 0)
+    {
+        LOG_ERROR("Cannot rename capture file {}: {}", segment.path, std::strerror(errno));
+        return false;
+    }
+    segment.path = path;
+    // Counted here, not when created, so spares removed unused are not
+    filesOpened.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+std::shared_ptr<FeedRecorder::Segment> FeedRecorder::createSegment()
+{
+    // Named when it becomes active, so file names follow recording order
+    auto segment = std::make_shared<Segment>();
+    segment->path = (std::filesystem::path(config.directory) / (sessionName + ".spare" + std::to_string(spares.fetch_add(1)))).string();
+    segment->size = config.maxFileBytes;
+
+    segment->fd = ::open(segment->path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (segment->fd < 0)
+    {
+        LOG_ERROR("Cannot create capture file {}: {}", segment->path, std::strerror(errno));
+        return nullptr;
+    }
+    if (::ftruncate(segment->fd, (off_t)segment->size) != 0)
+    {
+        LOG_ERROR("Cannot size capture file {}: {}", segment->path, std::strerror(errno));
+        ::close(segment->fd);
+        return nullptr;
+    }
+    void *mapping = ::mmap(nullptr, segment->size, PROT_READ | PROT_WRITE, MAP_SHARED, segment->fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        LOG_ERROR("Cannot map capture file {}: {}", segment->path, std::strerror(errno));
+        ::close(segment->fd);
+        return nullptr;
+    }
+    segment->base = static_cast<char *>(mapping);
+
+    CaptureFile::Header *header = new (segment->base) CaptureFile::Header;
+    std::memcpy(header->magic, CaptureFile::Magic, sizeof(CaptureFile::Magic));
+    header->headerSize = CaptureFile::HeaderSize;
+    header->indexCapacity = CaptureFile::IndexCapacity;
+    header->indexSpacing = std::max<uint64_t>((segment->size - CaptureFile::HeaderSize) / CaptureFile::IndexCapacity, PageSize);
+    header->createdUnixNs = 0;
+    header->indexCount.store(0, std::memory_order_relaxed);
+    header->closed.store(0, std::memory_order_relaxed);
+    header->committed.store(CaptureFile::HeaderSize, std::memory_order_release);
+    return segment;
+}
+
+// Removes a file that was never written to
+void FeedRecorder::retireSpare(Segment &segment)
+{
+    std::string path = segment.path;
+    finish(segment);
+    std::remove(path.c_str());
+}
+
+// Marks the file closed, cuts it down to the data written and releases the mapping
+void FeedRecorder::finish(Segment &segment)
+{
+    if (!segment.base)
+        return;
+    CaptureFile::Header *header = segment.header();
+    uint64_t end = header->committed.load(std::memory_order_acquire);
+    if (header->createdUnixNs == 0)
+        header->createdUnixNs = wallClockNs();
+    header->closed.store(1, std::memory_order_release);
+    ::msync(segment.base, segment.size, MS_ASYNC);
+    ::munmap(segment.base, segment.size);
+    segment.base = nullptr;
+    if (::ftruncate(segment.fd, (off_t)end) != 0)
+    {
+        LOG_WARN("Cannot truncate capture file {}: {}", segment.path, std::strerror(errno));
+    }
+    ::close(segment.fd);
+    segment.fd = -1;
+}
+
+// Keeps a spare file ready, prefaults the active one ahead of the writer and finishes retired files
+void FeedRecorder::helperLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping)
+    {
+        std::vector<std::shared_ptr<Segment>> finished;
+        finished.swap(retired);
+        bool needSpare = !spare;
+        std::shared_ptr<Segment> current = published;
+        lock.unlock();
+
+        for (auto &segment : finished)
+            finish(*segment);
+        finished.clear();
+
+        std::shared_ptr<Segment> created = needSpare ? createSegment() : nullptr;
+
+#ifdef MADV_POPULATE_WRITE
+        // Populates page tables without touching the contents, so it is safe next to the writer
+        if (current)
+        {
+            uint64_t target = std::min<uint64_t>(alignUp(writeHint.load(std::memory_order_relaxed) + PrefaultAhead, PageSize), current->size);
+            if (target > current->prefaulted)
+            {
+                uint64_t from = current->prefaulted & ~uint64_t(PageSize - 1);
+                ::madvise(current->base + from, target - from, MADV_POPULATE_WRITE);
+                current->prefaulted = target;
+            }
+        }
+#endif
+        current.reset();
+
+        lock.lock();
+        if (created)
+            spare = std::move(created);
+        if (!stopping && retired.empty())
+            wake.wait_for(lock, std::chrono::milliseconds(10));
+    }
+}
+
+CaptureReader::CaptureReader(const std::string &path)
+{
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        failure = std::string("cannot open: ") + std::strerror(errno);
+        return;
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || (size_t)info.st_size < CaptureFile::HeaderSize)
+    {
+        failure = "not a capture file";
+        return;
+    }
+    size = (size_t)info.st_size;
+    void *mapping = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        failure = std::string("cannot map: ") + std::strerror(errno);
+        return;
+    }
+    base = static_cast<const char *>(mapping);
+    if (std::memcmp(base, CaptureFile::Magic, sizeof(CaptureFile::Magic)) != 0)
+    {
+        failure = "not a capture file";
+        return;
+    }
+    header = reinterpret_cast<const CaptureFile::Header *>(base);
+    pos = header->headerSize;
+}
+
+CaptureReader::~CaptureReader()
+{
+    if (base)
+        ::munmap(const_cast<char *>(base), size);
+    if (fd >= 0)
+        ::close(fd);
+}
+
+uint64_t CaptureReader::committed() const
+{
+    // A file that was truncated after we mapped it still has everything up to committed
+    return header ? std::min<uint64_t>(header->committed.load(std::memory_order_acquire), size) : 0;
+}
+
+bool CaptureReader::closed() const
+{
+    return header && header->closed.load(std::memory_order_acquire) != 0;
+}
+
+int64_t CaptureReader::created() const
+{
+    return header ? header->createdUnixNs : 0;
+}
+
+bool CaptureReader::next(CapturedFrame &frame)
+{
+    uint64_t end = committed();
+    if (pos + sizeof(CaptureFile::RecordHeader) > end)
+        return false;
+    CaptureFile::RecordHeader record;
+    std::memcpy(&record, base + pos, sizeof(record));
+    uint64_t length = alignUp(sizeof(record) + record.channelSize + record.payloadSize, CaptureFile::Alignment);
+    if (pos + length > end)
+        return false;
+
+    const char *p = base + pos + sizeof(record);
+    frame.receivedUnixNs = record.receivedUnixNs;
+    frame.receivedAt = record.receivedAt;
+    frame.connectionId = record.connectionId;
+    frame.channel = std::string_view(p, record.channelSize);
+    frame.payload = std::string_view(p + record.channelSize, record.payloadSize);
+    pos += length;
+    return true;
+}
+
+void CaptureReader::rewind()
+{
+    if (header)
+        pos = header->headerSize;
+}
+
+void CaptureReader::seek(int64_t unixNs)
+{
+    if (!header)
+        return;
+    rewind();
+    uint32_t count = header->indexCount.load(std::memory_order_acquire);
+    const CaptureFile::IndexEntry *index = indexOf(header);
+    const CaptureFile::IndexEntry *it = std::upper_bound(index, index + count, unixNs, [](int64_t value, const CaptureFile::IndexEntry &entry)
+                                                         { return value < entry.receivedUnixNs; });
+    if (it != index)
+        pos = (it - 1)->offset;
+
+    // Walk forward from the nearest index entry to the exact record
+    uint64_t start = pos;
+    CapturedFrame frame;
+    while (next(frame))
+    {
+        if (frame.receivedUnixNs >= unixNs)
+            break;
+        start = pos;
+    }
+    pos = start;
+}
+
+std::vector<std::string> listCaptureFiles(const std::string &directory, const std::string &prefix)
+{
+    std::vector<std::string> files;
+    std::error_code ec;
+    for (const auto &entry : std::filesystem::directory_iterator(directory, ec))
+    {
+        std::string name = entry.path().filename().string();
+        if (entry.path().extension() == ".tccap" && name.compare(0, prefix.size(), prefix) == 0)
+            files.push_back(entry.path().string());
+    }
+    // Names carry the session start time and a sequence number, so name order is recording order
+    std::sort(files.begin(), files.end());
+    return files;
+}
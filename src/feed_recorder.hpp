@@ -0,0 +1,180 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Append-only capture of raw WebSocket frames in memory-mapped files.
+//
+// Each file starts with a fixed header region holding the committed end of
+// the data and a small time index, followed by 8 byte aligned records. A
+// record is copied into the mapping and then published by a release store of
+// the committed offset, so a reader can map a file that is still being written
+// and see only complete records. Files roll over by size or age; a helper
+// thread creates the next file ahead of time, prefaults pages ahead of the
+// writer and truncates finished files, so the recording thread never does
+// more than a memcpy outside a rollover.
+
+namespace CaptureFile
+{
+    constexpr char Magic[8] = {'T', 'C', 'C', 'A', 'P', '0', '0', '1'};
+    constexpr size_t HeaderSize = 16384; // first record starts here
+    constexpr size_t Alignment = 8;
+
+    struct IndexEntry
+    {
+        int64_t receivedUnixNs;
+        uint64_t offset; // of the first record at or after receivedUnixNs
+    };
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t headerSize;
+        uint32_t indexCapacity;
+        uint64_t indexSpacing;   // data bytes between index entries
+        int64_t createdUnixNs;   // 0 until the file receives its first record
+        std::atomic<uint64_t> committed; // end of the last complete record
+        std::atomic<uint32_t> indexCount;
+        std::atomic<uint32_t> closed; // 1 once the writer has finished the file
+        char reserved[24];
+        IndexEntry index[1];     // indexCapacity entries follow
+    };
+
+    constexpr uint32_t IndexCapacity = (HeaderSize - offsetof(Header, index)) / sizeof(IndexEntry);
+
+    struct RecordHeader
+    {
+        uint32_t payloadSize;
+        uint16_t channelSize;
+        uint16_t reserved;
+        uint32_t connectionId;
+        uint32_t padding;
+        int64_t receivedUnixNs; // wall clock at on_message
+        int64_t receivedAt;     // steady clock at on_message
+        // channel bytes, payload bytes, zero padding to Alignment
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "committed offset must be lock-free to share through a mapping");
+}
+
+struct RecorderConfig
+{
+    std::string directory = "captures";
+    std::string prefix = "feed";
+    size_t maxFileBytes = size_t(256) << 20;
+    std::chrono::seconds maxFileAge{3600};
+};
+
+// One recorded frame. The views point into the reader's mapping.
+struct CapturedFrame
+{
+    int64_t receivedUnixNs = 0;
+    int64_t receivedAt = 0;
+    uint32_t connectionId = 0;
+    std::string_view channel;
+    std::string_view payload;
+};
+
+class FeedRecorder
+{
+public:
+    explicit FeedRecorder(const RecorderConfig &config);
+    ~FeedRecorder();
+
+    FeedRecorder(const FeedRecorder &) = delete;
+    FeedRecorder &operator=(const FeedRecorder &) = delete;
+
+    // Appends one frame. Called from a single thread. Returns false if the frame was dropped.
+    bool record(int64_t receivedUnixNs, int64_t receivedAt, uint32_t connectionId, std::string_view channel, std::string_view payload);
+
+    uint64_t frames() const { return recorded.load(std::memory_order_relaxed); }
+    uint64_t bytes() const { return recordedBytes.load(std::memory_order_relaxed); }
+    // Files recorded into; spare files prepared but never used are not counted
+    uint64_t files() const { return filesOpened.load(std::memory_order_relaxed); }
+    uint64_t drops() const { return dropped.load(std::memory_order_relaxed); }
+    // Rollovers where the next file was not ready and had to be created inline
+    uint64_t slowRollovers() const { return inlineRollovers.load(std::memory_order_relaxed); }
+    std::string currentFile() const;
+
+private:
+    struct Segment;
+
+    std::shared_ptr<Segment> createSegment();
+    bool rollover();
+    bool activate(Segment &segment);
+    static void retireSpare(Segment &segment);
+    void helperLoop();
+    static void finish(Segment &segment);
+
+    RecorderConfig config;
+    std::string sessionName; // prefix plus start time, shared by every file of this recorder
+    uint64_t sequence = 0;              // of active files, used by the recording thread
+    std::atomic<uint64_t> spares{0};    // files are created by both threads
+
+    // Recording thread state
+    std::shared_ptr<Segment> active;
+    uint64_t writePos = 0;
+    uint64_t nextIndexAt = 0;
+    int64_t activeSinceUnixNs = 0;
+
+    // Shared with the helper thread
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::shared_ptr<Segment> spare;
+    std::shared_ptr<Segment> published; // copy of active for prefaulting
+    std::vector<std::shared_ptr<Segment>> retired;
+    std::atomic<uint64_t> writeHint{0};
+    bool stopping = false;
+    std::thread helper;
+
+    std::atomic<uint64_t> recorded{0};
+    std::atomic<uint64_t> recordedBytes{0};
+    std::atomic<uint64_t> filesOpened{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> inlineRollovers{0};
+};
+
+// Reads a capture file, including one that is still being written: next()
+// returns false at the current end and can be called again later.
+class CaptureReader
+{
+public:
+    explicit CaptureReader(const std::string &path);
+    ~CaptureReader();
+
+    CaptureReader(const CaptureReader &) = delete;
+    CaptureReader &operator=(const CaptureReader &) = delete;
+
+    bool valid() const { return header != nullptr; }
+    const std::string &error() const { return failure; }
+
+    bool next(CapturedFrame &frame);
+    // Positions at the first record received at or after unixNs, using the index
+    void seek(int64_t unixNs);
+    void rewind();
+
+    // The writer has finished; once next() returns false there is nothing more to come
+    bool closed() const;
+    uint64_t committed() const;
+    int64_t created() const;
+
+private:
+    std::string failure;
+    int fd = -1;
+    const char *base = nullptr;
+    size_t size = 0;
+    const CaptureFile::Header *header = nullptr;
+    uint64_t pos = CaptureFile::HeaderSize;
+};
+
+// Capture files of one recording session, oldest first
+std::vector<std::string> listCaptureFiles(const std::string &directory, const std::string &prefix = "");
@@ -0,0 +1,133 @@
+#include "fixed_point.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    // Powers of ten that are exact doubles
+    constexpr double Pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    constexpr int MaxExponent = 22;
+}
+
+DecimalStep DecimalStep::fromDouble(double step)
+{
+    DecimalStep result;
+    if (!(step > 0) || !std::isfinite(step))
+    {
+        return result;
+    }
+    // Shortest round-trip digits, e.g. "2.5e-01"
+    char text[32];
+    auto end = std::to_chars(text, text + sizeof(text), step, std::chars_format::scientific).ptr;
+    char *e = std::find(text, end, 'e');
+    int64_t mantissa = 0;
+    int digits = 0;
+    for (char *p = text; p < e; ++p)
+    {
+        if (*p != '.')
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            ++digits;
+        }
+    }
+    int exponent = 0;
+    std::from_chars(e + 1 + (e[1] == '+'), end, exponent);
+    exponent -= digits - 1;
+    // Drop trailing zeros so 10 is 1e1 rather than 10e0
+    while (mantissa % 10 == 0 && mantissa != 0)
+    {
+        mantissa /= 10;
+        ++exponent;
+    }
+    if (exponent < -MaxExponent || exponent > MaxExponent)
+    {
+        return result;
+    }
+    result.mantissa = mantissa;
+    result.exponent = exponent;
+    result.perUnit = 1.0 / result.value();
+    return result;
+}
+
+double DecimalStep::value() const
+{
+    return exponent < 0 ? mantissa / Pow10[-exponent] : mantissa * Pow10[exponent];
+}
+
+bool DecimalStep::isMultiple(double x) const
+{
+    double q = x * perUnit;
+    return std::fabs(q - (double)units(x)) < 1e-6;
+}
+
+double DecimalStep::toDouble(int64_t units) const
+{
+    // units * mantissa is exact below 2^53, and one division by an exact power
+    // of ten rounds once, giving the double closest to the decimal value
+    double scaled = (double)(units * mantissa);
+    return exponent < 0 ? scaled / Pow10[-exponent] : scaled * Pow10[exponent];
+}
+
+char *DecimalStep::write(char *out, int64_t units) const
+{
+    int64_t value = units * mantissa;
+    if (value < 0)
+    {
+        *out++ = '-';
+        value = -value;
+    }
+    char digits[24];
+    char *digitsEnd = std::to_chars(digits, digits + sizeof(digits), (uint64_t)value).ptr;
+    int count = (int)(digitsEnd - digits);
+
+    if (exponent >= 0)
+    {
+        std::memcpy(out, digits, count);
+        out += count;
+        if (value != 0)
+        {
+            std::memset(out, '0', exponent);
+            out += exponent;
+        }
+        std::memcpy(out, ".0", 2);
+        return out + 2;
+    }
+
+    int fraction = -exponent;
+    // Trailing zeros of the fraction are not written
+    while (fraction > 0 && count > 1 && digits[count - 1] == '0')
+    {
+        --count;
+        --fraction;
+    }
+    if (fraction == 0)
+    {
+        std::memcpy(out, digits, count);
+        out += count;
+        std::memcpy(out, ".0", 2);
+        return out + 2;
+    }
+    if (value == 0)
+    {
+        std::memcpy(out, "0.0", 3);
+        return out + 3;
+    }
+    if (count > fraction)
+    {
+        std::memcpy(out, digits, count - fraction);
+        out += count - fraction;
+        *out++ = '.';
+        std::memcpy(out, digits + count - fraction, fraction);
+        return out + fraction;
+    }
+    *out++ = '0';
+    *out++ = '.';
+    std::memset(out, '0', fraction - count);
+    out += fraction - count;
+    std::memcpy(out, digits, count);
+    return out + count;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+
+// A decimal step such as a tick size: 0.05 is held as 5e-2. Prices and amounts
+// become whole numbers of steps, so comparing, adding and matching them is
+// exact, and they convert back either to the nearest double or to an exact
+// decimal string.
+struct DecimalStep
+{
+    int64_t mantissa = 1;
+    int exponent = -8;
+    double perUnit = 1e8; // 1 / step, so conversions multiply instead of divide
+
+    // Shortest decimal form of step, e.g. 0.05 -> 5e-2. Non-positive steps give the default 1e-8.
+    static DecimalStep fromDouble(double step);
+
+    double value() const;
+    // Nearest whole number of steps. Inline and without std::llround, since
+    // every book level goes through it.
+    int64_t units(double x) const
+    {
+        double q = x * perUnit;
+        return (int64_t)(q >= 0 ? q + 0.5 : q - 0.5);
+    }
+    // Whether x is a whole number of steps, allowing for the binary rounding of decimal input
+    bool isMultiple(double x) const;
+    // Closest double to units * step
+    double toDouble(int64_t units) const;
+    // Exact decimal text of units * step, never in exponent form. Whole values
+    // end in ".0" and the fraction has no trailing zeros, so ordinary prices and
+    // amounts read the same as nlohmann::json writes them. Needs up to 48 bytes.
+    char *write(char *out, int64_t units) const;
+};
+
+// Integer grid of one instrument: prices in ticks, amounts in lots. The default
+// 1e-8 grid holds any price or amount the exchange sends exactly, for
+// instruments whose metadata is not loaded.
+struct TickScale
+{
+    DecimalStep tick;
+    DecimalStep lot;
+
+    static TickScale fromSizes(double tickSize, double lotSize)
+    {
+        return TickScale{DecimalStep::fromDouble(tickSize), DecimalStep::fromDouble(lotSize)};
+    }
+
+    int64_t ticks(double price) const { return tick.units(price); }
+    int64_t lots(double amount) const { return lot.units(amount); }
+    double price(int64_t ticks) const { return tick.toDouble(ticks); }
+    double amount(int64_t lots) const { return lot.toDouble(lots); }
+};
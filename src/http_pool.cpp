@@ -0,0 +1,317 @@
+#include "http_pool.hpp"
+
+#include "logger.hpp"
+
+namespace
+{
+    //  Used by cURL to write the response from the server into a string.
+    size_t WriteCallback(void *contents, size_t size, size_t nmemb, void *userp)
+    {
+        ((std::string *)userp)->append((char *)contents, size * nmemb);
+        return size * nmemb;
+    }
+
+    struct CurlGlobal
+    {
+        CurlGlobal() { curl_global_init(CURL_GLOBAL_DEFAULT); }
+        ~CurlGlobal() { curl_global_cleanup(); }
+    };
+}
+
+void ensureCurlGlobalInit()
+{
+    static CurlGlobal global;
+}
+
+HttpConnectionPool::HttpConnectionPool(const std::string &baseUrl, size_t size) : baseUrl(baseUrl)
+{
+    ensureCurlGlobalInit();
+
+    share = curl_share_init();
+    curl_share_setopt(share, CURLSHOPT_LOCKFUNC, &HttpConnectionPool::lockShare);
+    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, &HttpConnectionPool::unlockShare);
+    curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        idle.push_back(createHandle());
+    }
+}
+
+HttpConnectionPool::~HttpConnectionPool()
+{
+    for (auto &handle : handles)
+    {
+        curl_slist_free_all(handle->headers);
+        curl_easy_cleanup(handle->curl);
+    }
+    curl_share_cleanup(share);
+}
+
+// Runs for every socket cURL opens, before it connects
+int HttpConnectionPool::configureSocket(void *userp, curl_socket_t fd, curlsocktype)
+{
+    SocketOptions options = static_cast<HttpConnectionPool *>(userp)->socketOptions;
+    // TCP_NODELAY is cURL's own option
+    options.noDelay = false;
+    if (!applySocketOptions(fd, options))
+    {
+        LOG_WARN("Could not set the REST socket's receive buffer to {} bytes", options.receiveBuffer);
+    }
+    return CURL_SOCKOPT_OK;
+}
+
+void HttpConnectionPool::lockShare(CURL *, curl_lock_data data, curl_lock_access, void *userp)
+{
+    static_cast<HttpConnectionPool *>(userp)->shareLocks[data].lock();
+}
+
+void HttpConnectionPool::unlockShare(CURL *, curl_lock_data data, void *userp)
+{
+    static_cast<HttpConnectionPool *>(userp)->shareLocks[data].unlock();
+}
+
+// Hands out an idle handle, growing the pool if every handle is busy
+HttpConnectionPool::Handle *HttpConnectionPool::acquire()
+{
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        if (!idle.empty())
+        {
+            Handle *handle = idle.back();
+            idle.pop_back();
+            return handle;
+        }
+    }
+    return createHandle();
+}
+
+HttpConnectionPool::Handle *HttpConnectionPool::createHandle()
+{
+    auto handle = std::make_unique<Handle>();
+    CURL *curl = curl_easy_init();
+    curl_easy_setopt(curl, CURLOPT_SHARE, share);
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPIDLE, 30L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPINTVL, 15L);
+    curl_easy_setopt(curl, CURLOPT_TCP_NODELAY, socketOptions.noDelay ? 1L : 0L);
+    curl_easy_setopt(curl, CURLOPT_SOCKOPTFUNCTION, &HttpConnectionPool::configureSocket);
+    curl_easy_setopt(curl, CURLOPT_SOCKOPTDATA, this);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &handle->response);
+    // HTTP/2 where the server offers it over TLS, so batches share one connection
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    if (!verifyPeer)
+    {
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+    }
+    handle->curl = curl;
+    handle->headers = curl_slist_append(nullptr, "Content-Type: application/json");
+
+    Handle *raw = handle.get();
+    std::lock_guard<std::mutex> lock(poolMutex);
+    handles.push_back(std::move(handle));
+    return raw;
+}
+
+void HttpConnectionPool::release(Handle *handle)
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    idle.push_back(handle);
+}
+
+void HttpConnectionPool::prepare(Handle &handle, const std::string &endpoint, std::string_view body, const std::string &token)
+{
+    // Header list only changes when the token does
+    if (token != handle.token)
+    {
+        curl_slist_free_all(handle.headers);
+        handle.headers = curl_slist_append(nullptr, "Content-Type: application/json");
+        if (!token.empty())
+        {
+            handle.headers = curl_slist_append(handle.headers, ("Authorization: Bearer " + token).c_str());
+        }
+        handle.token = token;
+    }
+
+    handle.url.assign(baseUrl).append(endpoint);
+    handle.response.clear();
+    curl_easy_setopt(handle.curl, CURLOPT_URL, handle.url.c_str());
+    // Not copied: body must outlive the transfer, which it does since post() and postBatch() block
+    curl_easy_setopt(handle.curl, CURLOPT_POSTFIELDS, body.data());
+    curl_easy_setopt(handle.curl, CURLOPT_POSTFIELDSIZE, (long)body.size());
+    curl_easy_setopt(handle.curl, CURLOPT_HTTPHEADER, handle.headers);
+}
+
+std::string HttpConnectionPool::post(const std::string &endpoint, std::string_view body, const std::string &token)
+{
+    Handle *handle = acquire();
+    prepare(*handle, endpoint, body, token);
+
+    CURLcode res = curl_easy_perform(handle->curl);
+    std::string readBuffer;
+    if (res != CURLE_OK)
+    {
+        LOG_ERROR("cURL Error: {}", curl_easy_strerror(res));
+    }
+    else
+    {
+        readBuffer.swap(handle->response);
+    }
+
+    release(handle);
+    return readBuffer;
+}
+
+void HttpConnectionPool::perform(CURLM *multi, const std::vector<Handle *> &batch, std::vector<CURLcode> &results)
+{
+    // Overwritten by each transfer's result; anything left over never completed
+    results.assign(batch.size(), CURLE_FAILED_INIT);
+    for (Handle *handle : batch)
+    {
+        curl_multi_add_handle(multi, handle->curl);
+    }
+
+    int running = 0;
+    do
+    {
+        if (curl_multi_perform(multi, &running) != CURLM_OK)
+        {
+            break;
+        }
+        if (running)
+        {
+            curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+        }
+    } while (running);
+
+    CURLMsg *msg;
+    int queued;
+    while ((msg = curl_multi_info_read(multi, &queued)))
+    {
+        if (msg->msg != CURLMSG_DONE)
+        {
+            continue;
+        }
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            if (batch[i]->curl == msg->easy_handle)
+            {
+                results[i] = msg->data.result;
+                break;
+            }
+        }
+    }
+
+    for (Handle *handle : batch)
+    {
+        curl_multi_remove_handle(multi, handle->curl);
+    }
+}
+
+std::vector<HttpResult> HttpConnectionPool::postBatch(const std::vector<HttpRequest> &requests, const std::string &token,
+                                                      size_t maxConnections)
+{
+    std::vector<HttpResult> results(requests.size());
+    if (requests.empty())
+    {
+        return results;
+    }
+
+    std::vector<Handle *> batch;
+    for (const HttpRequest &request : requests)
+    {
+        Handle *handle = acquire();
+        prepare(*handle, request.endpoint, request.body, token);
+        // Wait for a multiplexed connection rather than opening another one
+        curl_easy_setopt(handle->curl, CURLOPT_PIPEWAIT, 1L);
+        batch.push_back(handle);
+    }
+
+    CURLM *multi = curl_multi_init();
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)maxConnections);
+    std::vector<CURLcode> codes;
+    perform(multi, batch, codes);
+    curl_multi_cleanup(multi);
+
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        HttpResult &result = results[i];
+        Handle *handle = batch[i];
+        if (codes[i] == CURLE_OK)
+        {
+            result.ok = true;
+            result.response.swap(handle->response);
+            curl_off_t total = 0;
+            curl_easy_getinfo(handle->curl, CURLINFO_TOTAL_TIME_T, &total);
+            result.elapsedNs = (int64_t)total * 1000;
+        }
+        else
+        {
+            result.error = curl_easy_strerror(codes[i]);
+        }
+        curl_easy_setopt(handle->curl, CURLOPT_PIPEWAIT, 0L);
+        release(handle);
+    }
+    return results;
+}
+
+void HttpConnectionPool::prewarm(const std::string &endpoint)
+{
+    const std::string body = "{\"id\":0,\"jsonrpc\":\"2.0\",\"method\":\"" + endpoint + "\",\"params\":{}}";
+
+    // Run every handle at once so each one opens its own connection into the shared cache
+    std::vector<Handle *> batch;
+    for (size_t i = 0; i < handles.size(); ++i)
+    {
+        batch.push_back(acquire());
+    }
+
+    CURLM *multi = curl_multi_init();
+    // Not multiplexed, or over HTTP/2 they could all end up on one connection.
+    // post() runs each handle on its own, so concurrent posts need one each.
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_NOTHING);
+    for (Handle *handle : batch)
+    {
+        prepare(*handle, endpoint, body, "");
+    }
+    std::vector<CURLcode> codes;
+    perform(multi, batch, codes);
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        if (codes[i] != CURLE_OK)
+        {
+            LOG_WARN("cURL prewarm error: {}", curl_easy_strerror(codes[i]));
+        }
+        release(batch[i]);
+    }
+    curl_multi_cleanup(multi);
+}
+
+void HttpConnectionPool::setVerifyPeer(bool verify)
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    verifyPeer = verify;
+    for (auto &handle : handles)
+    {
+        curl_easy_setopt(handle->curl, CURLOPT_SSL_VERIFYPEER, verify ? 1L : 0L);
+        curl_easy_setopt(handle->curl, CURLOPT_SSL_VERIFYHOST, verify ? 2L : 0L);
+    }
+}
+
+void HttpConnectionPool::setSocketOptions(const SocketOptions &options)
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    socketOptions = options;
+    for (auto &handle : handles)
+    {
+        curl_easy_setopt(handle->curl, CURLOPT_TCP_NODELAY, options.noDelay ? 1L : 0L);
+    }
+}
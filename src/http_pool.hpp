@@ -0,0 +1,91 @@
+#pragma once
+
+#include <curl/curl.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "net_tuning.hpp"
+
+// Runs curl_global_init exactly once for the whole process. It is not thread
+// safe and re-running it per request was costing us a full library setup.
+void ensureCurlGlobalInit();
+
+// One request of a postBatch call
+struct HttpRequest
+{
+    std::string endpoint;
+    std::string body;
+};
+
+struct HttpResult
+{
+    bool ok = false;       // a response arrived; its body may still hold a JSON-RPC error
+    std::string response;
+    std::string error;     // cURL error when !ok
+    int64_t elapsedNs = 0; // request sent to response received
+};
+
+// Pool of reusable cURL easy handles that share one connection, DNS and TLS
+// session cache, so REST calls ride on already-open keep-alive connections
+// instead of doing a TCP+TLS handshake every time.
+class HttpConnectionPool
+{
+public:
+    explicit HttpConnectionPool(const std::string &baseUrl, size_t size = 4);
+    ~HttpConnectionPool();
+
+    HttpConnectionPool(const HttpConnectionPool &) = delete;
+    HttpConnectionPool &operator=(const HttpConnectionPool &) = delete;
+
+    // Opens every pooled connection up front so the first order does not pay for the handshake
+    void prewarm(const std::string &endpoint = "public/test");
+
+    // POSTs a JSON body to baseUrl + endpoint. Returns the response body, empty on error.
+    std::string post(const std::string &endpoint, std::string_view body, const std::string &token = "");
+    // POSTs every request at once through a cURL multi handle and returns the
+    // results in request order. Requests are multiplexed over HTTP/2 when the
+    // server offers it, otherwise spread over at most maxConnections
+    // keep-alive connections, so a batch costs about one round trip.
+    std::vector<HttpResult> postBatch(const std::vector<HttpRequest> &requests, const std::string &token = "",
+                                      size_t maxConnections = 8);
+
+    // Only meant for local stand-ins that use a self-signed certificate
+    void setVerifyPeer(bool verify);
+    // For connections opened from now on; call before prewarm()
+    void setSocketOptions(const SocketOptions &options);
+
+    size_t size() const { return handles.size(); }
+
+private:
+    struct Handle
+    {
+        CURL *curl = nullptr;
+        curl_slist *headers = nullptr;
+        std::string token; // token the cached headers were built for
+        std::string url;
+        std::string response;
+    };
+
+    Handle *acquire();
+    Handle *createHandle();
+    void release(Handle *handle);
+    void prepare(Handle &handle, const std::string &endpoint, std::string_view body, const std::string &token);
+    // Runs the prepared handles to completion on multi; results[i] belongs to batch[i]
+    void perform(CURLM *multi, const std::vector<Handle *> &batch, std::vector<CURLcode> &results);
+
+    static int configureSocket(void *userp, curl_socket_t fd, curlsocktype purpose);
+    static void lockShare(CURL *, curl_lock_data data, curl_lock_access, void *userp);
+    static void unlockShare(CURL *, curl_lock_data data, void *userp);
+
+    std::string baseUrl;
+    CURLSH *share = nullptr;
+    std::mutex shareLocks[CURL_LOCK_DATA_LAST];
+
+    std::vector<std::unique_ptr<Handle>> handles;
+    std::vector<Handle *> idle;
+    std::mutex poolMutex;
+    bool verifyPeer = true;
+    SocketOptions socketOptions;
+};
@@ -0,0 +1,68 @@
+#include "instrument_registry.hpp"
+
+InstrumentRegistry::InstrumentRegistry() : slots(64, 0)
+{
+}
+
+// FNV-1a
+uint64_t InstrumentRegistry::hash(std::string_view name)
+{
+    uint64_t h = 1469598103934665603ull;
+    for (unsigned char c : name)
+    {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+uint32_t InstrumentRegistry::find(std::string_view name) const
+{
+    const size_t mask = slots.size() - 1;
+    const uint64_t h = hash(name);
+    for (size_t i = h & mask;; i = (i + 1) & mask)
+    {
+        uint32_t slot = slots[i];
+        if (slot == 0)
+            return NotFound;
+        uint32_t id = slot - 1;
+        if (hashes[id] == h && names[id] == name)
+            return id;
+    }
+}
+
+uint32_t InstrumentRegistry::intern(std::string_view name)
+{
+    uint32_t id = find(name);
+    if (id != NotFound)
+        return id;
+
+    // Keep the table at most half full so probe sequences stay short
+    if ((names.size() + 1) * 2 > slots.size())
+        grow();
+
+    id = (uint32_t)names.size();
+    const uint64_t h = hash(name);
+    names.emplace_back(name);
+    hashes.push_back(h);
+    const size_t mask = slots.size() - 1;
+    size_t i = h & mask;
+    while (slots[i] != 0)
+        i = (i + 1) & mask;
+    slots[i] = id + 1;
+    return id;
+}
+
+void InstrumentRegistry::grow()
+{
+    std::vector<uint32_t> larger(slots.size() * 2, 0);
+    const size_t mask = larger.size() - 1;
+    for (uint32_t id = 0; id < names.size(); ++id)
+    {
+        size_t i = hashes[id] & mask;
+        while (larger[i] != 0)
+            i = (i + 1) & mask;
+        larger[i] = id + 1;
+    }
+    slots.swap(larger);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Interns names (instruments, channels) into dense ids 0..n-1 so per-instrument
+// state can live in plain vectors. Lookups hash the string_view in place, so
+// finding a known name never allocates. Not thread safe; each registry belongs
+// to one thread.
+class InstrumentRegistry
+{
+public:
+    static constexpr uint32_t NotFound = UINT32_MAX;
+
+    InstrumentRegistry();
+
+    uint32_t find(std::string_view name) const;
+    // Returns the existing id or assigns the next one
+    uint32_t intern(std::string_view name);
+
+    const std::string &name(uint32_t id) const { return names[id]; }
+    size_t size() const { return names.size(); }
+
+    // FNV-1a, shared with the other open-addressing tables keyed by name and
+    // with shard placement, so it must stay stable across runs and versions
+    static uint64_t hash(std::string_view name);
+
+private:
+    void grow();
+
+    std::vector<uint32_t> slots; // id + 1, 0 marks an empty slot
+    std::vector<uint64_t> hashes; // per id, so growing does not rehash strings
+    std::deque<std::string> names; // stable, name(id) references stay valid
+};
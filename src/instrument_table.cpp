@@ -0,0 +1,266 @@
+#include "instrument_table.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace
+{
+    constexpr const char *CacheMagic = "# tcinstruments 1";
+
+    constexpr const char *KindNames[] = {"future", "option", "spot", "future_combo", "option_combo", "unknown"};
+
+    int64_t nowUnixMs()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    std::string joinCurrencies(const std::vector<std::string> &currencies)
+    {
+        std::string joined;
+        for (const auto &currency : currencies)
+        {
+            joined += joined.empty() ? currency : "," + currency;
+        }
+        return joined;
+    }
+
+    // Shortest text that reads back as the same double
+    std::string formatDouble(double value)
+    {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.17g", value);
+        // %.17g always round-trips; prefer the short form when it does too
+        char shorter[32];
+        std::snprintf(shorter, sizeof(shorter), "%.15g", value);
+        return std::strtod(shorter, nullptr) == value ? shorter : text;
+    }
+
+    std::vector<std::string> split(const std::string &line, char separator)
+    {
+        std::vector<std::string> fields;
+        std::string field;
+        std::istringstream in(line);
+        while (std::getline(in, field, separator))
+        {
+            fields.push_back(field);
+        }
+        return fields;
+    }
+
+    bool parseDouble(const std::string &text, double &out)
+    {
+        char *end = nullptr;
+        out = std::strtod(text.c_str(), &end);
+        return !text.empty() && *end == '\0';
+    }
+}
+
+const char *instrumentKindName(InstrumentKind kind)
+{
+    return KindNames[(size_t)kind];
+}
+
+InstrumentKind parseInstrumentKind(std::string_view name)
+{
+    for (size_t i = 0; i < (size_t)InstrumentKind::Unknown; ++i)
+    {
+        if (name == KindNames[i])
+        {
+            return (InstrumentKind)i;
+        }
+    }
+    return InstrumentKind::Unknown;
+}
+
+const DecimalStep &InstrumentSpec::tickAt(double price) const
+{
+    // The exchange lists the steps by ascending above_price; the last one below the price wins
+    const DecimalStep *tick = &scale.tick;
+    for (size_t i = 0; i < tickStepCount && price > tickSteps[i].abovePrice; ++i)
+    {
+        tick = &tickSteps[i].tick;
+    }
+    return *tick;
+}
+
+bool InstrumentSpec::validateOrder(double price, double amount, std::string &error) const
+{
+    if (!(price > 0) || !tickAt(price).isMultiple(price))
+    {
+        error = "price " + formatDouble(price) + " is not a multiple of the tick size " + formatDouble(tickAt(price).value());
+        return false;
+    }
+    if (amount < minTradeAmount() || !scale.lot.isMultiple(amount))
+    {
+        error = "amount " + formatDouble(amount) + " is not a multiple of the minimum trade amount " + formatDouble(minTradeAmount());
+        return false;
+    }
+    return true;
+}
+
+void InstrumentTable::add(std::string_view instrument, const InstrumentSpec &spec)
+{
+    uint32_t id = names.intern(instrument);
+    if (id >= specs.size())
+    {
+        specs.resize(id + 1);
+    }
+    specs[id] = spec;
+}
+
+const InstrumentSpec *InstrumentTable::find(std::string_view instrument) const
+{
+    uint32_t id = names.find(instrument);
+    return id == InstrumentRegistry::NotFound ? nullptr : &specs[id];
+}
+
+// One line per instrument:
+//   name  kind  tick_size  min_trade_amount  contract_size  expiration  above:tick,above:tick|-
+bool InstrumentTable::save(const std::string &path) const
+{
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::trunc);
+        if (!out)
+        {
+            return false;
+        }
+        out << CacheMagic << ' ' << fetchedUnixSeconds << ' ' << joinCurrencies(currencies) << '\n';
+        for (uint32_t id = 0; id < specs.size(); ++id)
+        {
+            const InstrumentSpec &spec = specs[id];
+            out << names.name(id) << '\t' << instrumentKindName(spec.kind) << '\t' << formatDouble(spec.tickSize()) << '\t'
+                << formatDouble(spec.minTradeAmount()) << '\t' << formatDouble(spec.contractSize) << '\t' << spec.expiration << '\t';
+            if (spec.tickStepCount == 0)
+            {
+                out << '-';
+            }
+            for (size_t i = 0; i < spec.tickStepCount; ++i)
+            {
+                out << (i ? "," : "") << formatDouble(spec.tickSteps[i].abovePrice) << ':' << formatDouble(spec.tickSteps[i].tick.value());
+            }
+            out << '\n';
+        }
+        if (!out.flush())
+        {
+            return false;
+        }
+    }
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+bool InstrumentTable::load(const std::string &path, const std::vector<std::string> &wanted, std::chrono::seconds maxAge)
+{
+    std::ifstream in(path);
+    std::string line;
+    if (!in || !std::getline(in, line))
+    {
+        return false;
+    }
+    std::vector<std::string> header = split(line, ' ');
+    if (header.size() != 5 || line.compare(0, std::string(CacheMagic).size(), CacheMagic) != 0 ||
+        header[4] != joinCurrencies(wanted))
+    {
+        return false;
+    }
+    int64_t fetched = std::atoll(header[3].c_str());
+    int64_t now = nowUnixMs();
+    if (fetched <= 0 || now / 1000 - fetched > maxAge.count())
+    {
+        return false;
+    }
+
+    InstrumentTable loaded;
+    loaded.currencies = wanted;
+    loaded.fetchedUnixSeconds = fetched;
+    while (std::getline(in, line))
+    {
+        std::vector<std::string> fields = split(line, '\t');
+        InstrumentSpec spec;
+        double tickSize, minTradeAmount;
+        if (fields.size() != 7 || !parseDouble(fields[2], tickSize) || !parseDouble(fields[3], minTradeAmount) ||
+            !parseDouble(fields[4], spec.contractSize))
+        {
+            return false;
+        }
+        spec.kind = parseInstrumentKind(fields[1]);
+        spec.scale = TickScale::fromSizes(tickSize, minTradeAmount);
+        spec.expiration = std::atoll(fields[5].c_str());
+        if (fields[6] != "-")
+        {
+            for (const std::string &step : split(fields[6], ','))
+            {
+                size_t colon = step.find(':');
+                double above, tick;
+                if (colon == std::string::npos || spec.tickStepCount == InstrumentSpec::MaxTickSteps ||
+                    !parseDouble(step.substr(0, colon), above) || !parseDouble(step.substr(colon + 1), tick))
+                {
+                    return false;
+                }
+                spec.tickSteps[spec.tickStepCount++] = {above, DecimalStep::fromDouble(tick)};
+            }
+        }
+        if (spec.expiration > 0 && spec.expiration <= now)
+        {
+            continue;
+        }
+        loaded.add(fields[0], spec);
+    }
+    *this = std::move(loaded);
+    return true;
+}
+
+bool parseInstruments(std::string_view response, InstrumentTable &table, std::string &error)
+{
+    json parsed = json::parse(response.begin(), response.end(), nullptr, false);
+    if (parsed.is_discarded())
+    {
+        error = "malformed response";
+        return false;
+    }
+    if (parsed.contains("error"))
+    {
+        error = parsed["error"].dump();
+        return false;
+    }
+    if (!parsed.contains("result") || !parsed["result"].is_array())
+    {
+        error = "response has no result";
+        return false;
+    }
+    try
+    {
+        for (const auto &entry : parsed["result"])
+        {
+            InstrumentSpec spec;
+            spec.kind = parseInstrumentKind(entry.value("kind", std::string()));
+            spec.scale = TickScale::fromSizes(entry.at("tick_size").get<double>(), entry.at("min_trade_amount").get<double>());
+            spec.contractSize = entry.value("contract_size", 1.0);
+            spec.expiration = entry.value("expiration_timestamp", int64_t(0));
+            if (entry.contains("tick_size_steps") && entry["tick_size_steps"].is_array())
+            {
+                for (const auto &step : entry["tick_size_steps"])
+                {
+                    if (spec.tickStepCount == InstrumentSpec::MaxTickSteps)
+                    {
+                        break;
+                    }
+                    spec.tickSteps[spec.tickStepCount++] = {step.at("above_price").get<double>(),
+                                                            DecimalStep::fromDouble(step.at("tick_size").get<double>())};
+                }
+            }
+            table.add(entry.at("instrument_name").get<std::string>(), spec);
+        }
+    }
+    catch (const json::exception &e)
+    {
+        error = e.what();
+        return false;
+    }
+    return true;
+}
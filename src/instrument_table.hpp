@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "fixed_point.hpp"
+#include "instrument_registry.hpp"
+
+// Trading rules of every instrument the client may touch, loaded once at
+// startup from public/get_instruments and kept in a file so a warm restart
+// does not need the REST round trips.
+
+enum class InstrumentKind : uint8_t
+{
+    Future,
+    Option,
+    Spot,
+    FutureCombo,
+    OptionCombo,
+    Unknown
+};
+
+// Deribit's name for kind ("future", "option", ...) and back
+const char *instrumentKindName(InstrumentKind kind);
+InstrumentKind parseInstrumentKind(std::string_view name);
+
+struct InstrumentSpec
+{
+    static constexpr size_t MaxTickSteps = 4;
+
+    // Above abovePrice the tick is coarser than tick_size (options)
+    struct TickStep
+    {
+        double abovePrice;
+        DecimalStep tick;
+    };
+
+    TickScale scale; // tick_size and min_trade_amount, which every amount is a multiple of
+    double contractSize = 1;
+    int64_t expiration = 0; // ms since the epoch
+    InstrumentKind kind = InstrumentKind::Unknown;
+    uint8_t tickStepCount = 0;
+    std::array<TickStep, MaxTickSteps> tickSteps{};
+
+    double tickSize() const { return scale.tick.value(); }
+    double minTradeAmount() const { return scale.lot.value(); }
+    // Tick that applies to an order at price
+    const DecimalStep &tickAt(double price) const;
+    // Whether the exchange would accept the price and amount. Sets error otherwise.
+    bool validateOrder(double price, double amount, std::string &error) const;
+};
+
+// Instruments indexed by the dense ids of an InstrumentRegistry. Not
+// thread-safe: build it on one thread, then share it read-only.
+class InstrumentTable
+{
+public:
+    // Replaces the spec if the instrument is already known
+    void add(std::string_view instrument, const InstrumentSpec &spec);
+    const InstrumentSpec *find(std::string_view instrument) const;
+    const std::string &name(uint32_t id) const { return names.name(id); }
+    size_t size() const { return specs.size(); }
+
+    // Currencies the table covers and when it was fetched, kept with the cache
+    std::vector<std::string> currencies;
+    int64_t fetchedUnixSeconds = 0;
+
+    // Writes the table to path through a temporary file
+    bool save(const std::string &path) const;
+    // Reads a file written by save. Fails if it is missing, malformed, older
+    // than maxAge or for other currencies. Expired instruments are skipped.
+    bool load(const std::string &path, const std::vector<std::string> &wanted, std::chrono::seconds maxAge);
+
+private:
+    InstrumentRegistry names;
+    std::vector<InstrumentSpec> specs;
+};
+
+// Adds the instruments of a public/get_instruments response to table. Returns
+// false, with error set to the server's error object or the parse failure, otherwise.
+bool parseInstruments(std::string_view response, InstrumentTable &table, std::string &error);
+
+// Where the instrument table comes from
+struct InstrumentCacheConfig
+{
+    std::vector<std::string> currencies{"BTC", "ETH"};
+    std::string cacheFile = "instruments.tsv"; // empty disables the cache
+    std::chrono::seconds maxAge{24 * 3600};
+};
@@ -0,0 +1,74 @@
+#include "latency_histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+size_t LatencyHistogram::bucketIndex(uint64_t value)
+{
+    if (value < SubBuckets)
+        return (size_t)value;
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - SubBucketBits + 1;
+    size_t top = (size_t)(value >> shift); // in [HalfSubBuckets, SubBuckets)
+    return SubBuckets + (size_t)(shift - 1) * HalfSubBuckets + (top - HalfSubBuckets);
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t index)
+{
+    if (index < SubBuckets)
+        return index;
+    size_t offset = index - SubBuckets;
+    int shift = (int)(offset / HalfSubBuckets) + 1;
+    uint64_t top = offset % HalfSubBuckets + HalfSubBuckets;
+    return (top << shift) + ((uint64_t(1) << shift) - 1);
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const
+{
+    uint64_t samples = count();
+    if (samples == 0)
+        return 0;
+    uint64_t target = (uint64_t)std::ceil(fraction * (double)samples);
+    target = std::max<uint64_t>(1, std::min(target, samples));
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BucketCount; ++i)
+    {
+        seen += counts[i].load(std::memory_order_relaxed);
+        if (seen >= target)
+            return std::min(bucketUpperBound(i), max());
+    }
+    // Buckets and total are read at slightly different moments while recording continues
+    return max();
+}
+
+LatencyHistogram::Summary LatencyHistogram::summary() const
+{
+    Summary s;
+    s.count = count();
+    s.p50 = percentile(0.50);
+    s.p99 = percentile(0.99);
+    s.p999 = percentile(0.999);
+    s.max = max();
+    s.mean = s.count ? (double)sum.load(std::memory_order_relaxed) / (double)s.count : 0.0;
+    return s;
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto &bucket : counts)
+        bucket.store(0, std::memory_order_relaxed);
+    total.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    maxValue.store(0, std::memory_order_relaxed);
+}
+
+std::string LatencyHistogram::describe() const
+{
+    Summary s = summary();
+    char text[160];
+    std::snprintf(text, sizeof(text), "n=%llu p50=%.1fus p99=%.1fus p99.9=%.1fus max=%.1fus",
+                  (unsigned long long)s.count, s.p50 / 1e3, s.p99 / 1e3, s.p999 / 1e3, s.max / 1e3);
+    return text;
+}
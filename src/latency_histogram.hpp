@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// HDR-style histogram of nanosecond latencies. Values below 2^SubBucketBits
+// are counted exactly; above that every power-of-two range is split into
+// 2^(SubBucketBits-1) linear buckets, giving about 1.5% relative precision
+// over the whole 64-bit range. Recording is a couple of relaxed atomic adds,
+// so any thread can record while another reads percentiles.
+class LatencyHistogram
+{
+public:
+    static constexpr int SubBucketBits = 7;
+
+    struct Summary
+    {
+        uint64_t count;
+        uint64_t p50;
+        uint64_t p99;
+        uint64_t p999;
+        uint64_t max;
+        double mean;
+    };
+
+    void record(uint64_t nanos)
+    {
+        counts[bucketIndex(nanos)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(nanos, std::memory_order_relaxed);
+        uint64_t seen = maxValue.load(std::memory_order_relaxed);
+        while (nanos > seen && !maxValue.compare_exchange_weak(seen, nanos, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    uint64_t max() const { return maxValue.load(std::memory_order_relaxed); }
+
+    // Value at or below which the given fraction (0..1) of samples fall
+    uint64_t percentile(double fraction) const;
+    Summary summary() const;
+    void reset();
+
+    // "n=... p50=...us p99=...us p99.9=...us max=...us"
+    std::string describe() const;
+
+    static size_t bucketIndex(uint64_t value);
+    // Largest value that maps to the bucket
+    static uint64_t bucketUpperBound(size_t index);
+
+private:
+    static constexpr size_t SubBuckets = size_t(1) << SubBucketBits;
+    static constexpr size_t HalfSubBuckets = SubBuckets / 2;
+    static constexpr size_t BucketCount = SubBuckets + (64 - SubBucketBits) * HalfSubBuckets;
+
+    std::array<std::atomic<uint64_t>, BucketCount> counts{};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> maxValue{0};
+};
+
+// Monotonic time in ns, for intervals measured inside the process
+inline int64_t steadyNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Wall-clock time in ns, for comparing with exchange timestamps
+inline int64_t unixNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,319 @@
+#include "logger.hpp"
+
+#include <charconv>
+#include <iostream>
+
+namespace
+{
+    // Marks the owning thread's buffer as retired when the thread exits, so the
+    // writer can free it once drained
+    struct RetireOnExit
+    {
+        std::atomic<bool> *retired = nullptr;
+        ~RetireOnExit()
+        {
+            if (retired)
+                retired->store(true, std::memory_order_release);
+        }
+    };
+
+    template <typename T>
+    void append(std::vector<char> &out, const T &value)
+    {
+        const char *bytes = reinterpret_cast<const char *>(&value);
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    template <typename T>
+    bool read(const char *&p, const char *end, T &value)
+    {
+        if ((size_t)(end - p) < sizeof(T))
+            return false;
+        std::memcpy(&value, p, sizeof(T));
+        p += sizeof(T);
+        return true;
+    }
+
+    int64_t unixNanos()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    }
+}
+
+const char *logLevelName(LogLevel level)
+{
+    switch (level)
+    {
+    case LogLevel::Debug:
+        return "DEBUG";
+    case LogLevel::Info:
+        return "INFO";
+    case LogLevel::Warn:
+        return "WARN";
+    case LogLevel::Error:
+        return "ERROR";
+    default:
+        return "OFF";
+    }
+}
+
+LogSite::LogSite(LogLevel level, const char *format, const char *file, int line)
+    : level(level), format(format), file(file), line(line)
+{
+    id = Logger::instance().registerSite(this);
+}
+
+std::string formatLogMessage(std::string_view format, const char *args, size_t size)
+{
+    std::string out;
+    out.reserve(format.size() + size);
+    const char *p = args;
+    const char *end = args + size;
+
+    for (size_t i = 0; i < format.size(); ++i)
+    {
+        if (format[i] != '{' || i + 1 >= format.size() || format[i + 1] != '}')
+        {
+            out += format[i];
+            continue;
+        }
+        ++i;
+
+        uint8_t tag;
+        if (!read(p, end, tag))
+        {
+            out += "{}";
+            continue;
+        }
+        char number[32];
+        switch ((LogArg)tag)
+        {
+        case LogArg::Int:
+        {
+            int64_t value = 0;
+            read(p, end, value);
+            out.append(number, std::to_chars(number, number + sizeof(number), value).ptr);
+            break;
+        }
+        case LogArg::Uint:
+        {
+            uint64_t value = 0;
+            read(p, end, value);
+            out.append(number, std::to_chars(number, number + sizeof(number), value).ptr);
+            break;
+        }
+        case LogArg::Double:
+        {
+            double value = 0;
+            read(p, end, value);
+            out.append(number, std::to_chars(number, number + sizeof(number), value).ptr);
+            break;
+        }
+        case LogArg::Bool:
+        {
+            uint8_t value = 0;
+            read(p, end, value);
+            out += value ? "true" : "false";
+            break;
+        }
+        case LogArg::String:
+        {
+            uint16_t length = 0;
+            read(p, end, length);
+            length = (uint16_t)std::min<size_t>(length, end - p);
+            out.append(p, length);
+            p += length;
+            break;
+        }
+        default:
+            // Corrupt record, stop decoding arguments
+            p = end;
+            out += "{?}";
+        }
+    }
+    return out;
+}
+
+Logger &Logger::instance()
+{
+    static Logger logger;
+    return logger;
+}
+
+Logger::~Logger()
+{
+    stop();
+}
+
+bool Logger::start(const std::string &path, LogLevel minLevel, LogLevel echo)
+{
+    if (running)
+        return true;
+    file = std::fopen(path.c_str(), "wb");
+    if (!file)
+    {
+        std::cerr << "Cannot open log file " << path << std::endl;
+        return false;
+    }
+    std::fwrite(LogFile::Magic, 1, sizeof(LogFile::Magic), file);
+    sitesWritten = 0;
+    writeCalibration();
+
+    echoLevel = echo;
+    minimumLevel = minLevel;
+    running = true;
+    writer = std::thread(&Logger::writerLoop, this);
+    return true;
+}
+
+void Logger::stop()
+{
+    if (!running.exchange(false))
+        return;
+    minimumLevel = LogLevel::Off;
+    writer.join();
+    drain();
+    writeCalibration();
+    std::fclose(file);
+    file = nullptr;
+}
+
+uint32_t Logger::registerSite(LogSite *site)
+{
+    std::lock_guard<std::mutex> lock(sitesMutex);
+    sites.push_back(site);
+    return (uint32_t)(sites.size() - 1);
+}
+
+uint64_t Logger::dropped() const
+{
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    uint64_t total = retiredDrops;
+    for (const auto &buffer : buffers)
+        total += buffer->ring.drops();
+    return total;
+}
+
+Logger::ThreadBuffer *Logger::threadBuffer()
+{
+    static thread_local ThreadBuffer *buffer = nullptr;
+    static thread_local RetireOnExit retire;
+    if (!buffer)
+    {
+        auto owned = std::make_unique<ThreadBuffer>();
+        buffer = owned.get();
+        retire.retired = &buffer->retired;
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        buffers.push_back(std::move(owned));
+    }
+    return buffer;
+}
+
+void Logger::writerLoop()
+{
+    auto lastCalibration = std::chrono::steady_clock::now();
+    auto lastFlush = lastCalibration;
+    bool dirty = false;
+    while (running.load(std::memory_order_relaxed))
+    {
+        size_t written = drain();
+        dirty |= written > 0;
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastCalibration > std::chrono::seconds(1))
+        {
+            writeCalibration();
+            lastCalibration = now;
+        }
+        if (dirty && now - lastFlush > std::chrono::milliseconds(100))
+        {
+            std::fflush(file);
+            lastFlush = now;
+            dirty = false;
+        }
+        if (written == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+// Moves everything queued so far to the file, oldest first
+size_t Logger::drain()
+{
+    pending.clear();
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        for (auto it = buffers.begin(); it != buffers.end();)
+        {
+            ThreadBuffer &buffer = **it;
+            bool retired = buffer.retired.load(std::memory_order_acquire);
+            while (buffer.ring.pop([this](LogRecord &record)
+                                   { pending.push_back(record); }))
+            {
+            }
+            if (retired)
+            {
+                retiredDrops += buffer.ring.drops();
+                it = buffers.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+    if (pending.empty())
+        return 0;
+
+    std::stable_sort(pending.begin(), pending.end(), [](const LogRecord &a, const LogRecord &b)
+                     { return a.tsc < b.tsc; });
+
+    std::lock_guard<std::mutex> lock(sitesMutex);
+    for (; sitesWritten < sites.size(); ++sitesWritten)
+        writeSite(*sites[sitesWritten]);
+
+    batch.clear();
+    const LogLevel echo = echoLevel.load(std::memory_order_relaxed);
+    for (const LogRecord &record : pending)
+    {
+        batch.push_back(LogFile::LogEntryRecord);
+        append(batch, record.tsc);
+        append(batch, record.site);
+        append(batch, record.size);
+        batch.insert(batch.end(), record.args, record.args + record.size);
+
+        const LogSite &site = *sites[record.site];
+        if (site.level >= echo)
+        {
+            std::ostream &console = site.level >= LogLevel::Warn ? std::cerr : std::cout;
+            console << formatLogMessage(site.format, record.args, record.size) << '\n';
+        }
+    }
+    std::fwrite(batch.data(), 1, batch.size(), file);
+    std::cout.flush();
+    return pending.size();
+}
+
+void Logger::writeCalibration()
+{
+    std::vector<char> record;
+    record.push_back(LogFile::CalibrationRecord);
+    append(record, readTsc());
+    append(record, unixNanos());
+    std::fwrite(record.data(), 1, record.size(), file);
+}
+
+void Logger::writeSite(const LogSite &site)
+{
+    std::vector<char> record;
+    uint16_t length = (uint16_t)std::strlen(site.format);
+    record.push_back(LogFile::SiteRecord);
+    append(record, site.id);
+    append(record, (uint8_t)site.level);
+    append(record, length);
+    record.insert(record.end(), site.format, site.format + length);
+    std::fwrite(record.data(), 1, record.size(), file);
+}
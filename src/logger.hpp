@@ -0,0 +1,218 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "spsc_ring.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Low-latency binary logger. A log call only copies a call-site id, a TSC
+// timestamp and the raw argument bytes into the calling thread's lock-free
+// ring. A background thread drains every ring, writes binary records to the
+// log file in batches and, for levels at or above the echo level, formats the
+// message for the console. TradingLogDecoder turns the file back into text.
+//
+//   LOG_INFO("Order placed: {} @ {}", instrument, price);
+
+enum class LogLevel : uint8_t
+{
+    Debug,
+    Info,
+    Warn,
+    Error,
+    Off
+};
+
+const char *logLevelName(LogLevel level);
+
+// One per LOG_* statement, registered the first time the statement runs
+struct LogSite
+{
+    LogSite(LogLevel level, const char *format, const char *file, int line);
+
+    const LogLevel level;
+    const char *const format;
+    const char *const file;
+    const int line;
+    uint32_t id;
+};
+
+// Fixed-size slot in a thread's ring
+struct LogRecord
+{
+    static constexpr size_t ArgCapacity = 256 - 16;
+
+    uint64_t tsc;
+    uint32_t site;
+    uint16_t size; // bytes used in args
+    char args[ArgCapacity];
+};
+
+// Argument type tags in the encoded argument bytes
+enum class LogArg : uint8_t
+{
+    Int = 'i',
+    Uint = 'u',
+    Double = 'd',
+    Bool = 'b',
+    String = 's'
+};
+
+// Binary file layout: an 8 byte magic followed by records, each starting with one of these
+namespace LogFile
+{
+    constexpr char Magic[8] = {'T', 'C', 'L', 'O', 'G', '0', '0', '1'};
+    constexpr char SiteRecord = 'S';        // u32 id, u8 level, u16 length, format bytes
+    constexpr char CalibrationRecord = 'C'; // u64 tsc, i64 unix time in ns
+    constexpr char LogEntryRecord = 'L';    // u64 tsc, u32 site, u16 size, argument bytes
+}
+
+// Substitutes encoded arguments into the {} placeholders of format
+std::string formatLogMessage(std::string_view format, const char *args, size_t size);
+
+inline uint64_t readTsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+class Logger
+{
+public:
+    static Logger &instance();
+
+    // Opens the binary log and starts the writer thread
+    bool start(const std::string &path, LogLevel minLevel = LogLevel::Info, LogLevel echoLevel = LogLevel::Info);
+    // Drains every buffer, writes the rest and stops the writer thread
+    void stop();
+
+    bool enabled(LogLevel level) const
+    {
+        return level >= minimumLevel.load(std::memory_order_relaxed);
+    }
+    void setEchoLevel(LogLevel level) { echoLevel.store(level, std::memory_order_relaxed); }
+
+    uint32_t registerSite(LogSite *site);
+
+    template <typename... Args>
+    void log(const LogSite &site, const Args &...args)
+    {
+        ThreadBuffer *buffer = threadBuffer();
+        buffer->ring.push([&](LogRecord &record)
+                          {
+            record.tsc = readTsc();
+            record.site = site.id;
+            record.size = 0;
+            (encode(record, args), ...); });
+    }
+
+    // Records lost because a thread's ring was full
+    uint64_t dropped() const;
+
+private:
+    struct ThreadBuffer
+    {
+        ThreadBuffer() : ring(1024, OverflowPolicy::DropNewest) {}
+        SpscRing<LogRecord> ring;
+        std::atomic<bool> retired{false}; // owning thread has exited
+    };
+
+    Logger() = default;
+    ~Logger();
+
+    ThreadBuffer *threadBuffer();
+    void writerLoop();
+    size_t drain();
+    void writeCalibration();
+    void writeSite(const LogSite &site);
+
+    template <typename T>
+    static void put(LogRecord &record, LogArg tag, const T &value)
+    {
+        if (record.size + 1 + sizeof(T) > LogRecord::ArgCapacity)
+            return;
+        record.args[record.size++] = (char)tag;
+        std::memcpy(record.args + record.size, &value, sizeof(T));
+        record.size += sizeof(T);
+    }
+
+    static void putString(LogRecord &record, const char *data, size_t length)
+    {
+        if (record.size + 1 + sizeof(uint16_t) > LogRecord::ArgCapacity)
+            return;
+        length = std::min(length, LogRecord::ArgCapacity - record.size - 1 - sizeof(uint16_t));
+        uint16_t stored = (uint16_t)length;
+        record.args[record.size++] = (char)LogArg::String;
+        std::memcpy(record.args + record.size, &stored, sizeof(stored));
+        std::memcpy(record.args + record.size + sizeof(stored), data, length);
+        record.size += sizeof(stored) + length;
+    }
+
+    template <typename T>
+    static void encode(LogRecord &record, const T &value)
+    {
+        if constexpr (std::is_same_v<T, bool>)
+            put(record, LogArg::Bool, (uint8_t)value);
+        else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+            put(record, LogArg::Int, (int64_t)value);
+        else if constexpr (std::is_integral_v<T>)
+            put(record, LogArg::Uint, (uint64_t)value);
+        else if constexpr (std::is_floating_point_v<T>)
+            put(record, LogArg::Double, (double)value);
+        else if constexpr (std::is_convertible_v<const T &, std::string_view>)
+        {
+            std::string_view text(value);
+            putString(record, text.data(), text.size());
+        }
+        else
+            static_assert(std::is_same_v<T, void>, "unsupported log argument type");
+    }
+
+    std::atomic<LogLevel> minimumLevel{LogLevel::Off};
+    std::atomic<LogLevel> echoLevel{LogLevel::Info};
+
+    std::mutex sitesMutex;
+    std::vector<LogSite *> sites;
+    size_t sitesWritten = 0;
+
+    mutable std::mutex buffersMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    uint64_t retiredDrops = 0;
+
+    FILE *file = nullptr;
+    std::vector<char> batch;
+    std::vector<LogRecord> pending;
+    std::atomic<bool> running{false};
+    std::thread writer;
+};
+
+#define TC_LOG(level, format, ...)                                                       \
+    do                                                                                   \
+    {                                                                                    \
+        if (Logger::instance().enabled(level))                                           \
+        {                                                                                \
+            static LogSite tcLogSite(level, format, __FILE__, __LINE__);                 \
+            Logger::instance().log(tcLogSite, ##__VA_ARGS__);                            \
+        }                                                                                \
+    } while (0)
+
+#define LOG_DEBUG(format, ...) TC_LOG(LogLevel::Debug, format, ##__VA_ARGS__)
+#define LOG_INFO(format, ...) TC_LOG(LogLevel::Info, format, ##__VA_ARGS__)
+#define LOG_WARN(format, ...) TC_LOG(LogLevel::Warn, format, ##__VA_ARGS__)
+#define LOG_ERROR(format, ...) TC_LOG(LogLevel::Error, format, ##__VA_ARGS__)
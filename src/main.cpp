@@ -1,520 +1,315 @@
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
 #include <iostream>
+#include <limits>
+#include <sstream>
 #include <string>
-#include <unordered_set>
-#include <curl/curl.h>
-#include <nlohmann/json.hpp>
-#include <websocketpp/config/asio_client.hpp>
-#include <websocketpp/client.hpp>
-#include <websocketpp/common/thread.hpp>
-#include <thread>
+#include <vector>
 #include <chrono>
+#include <nlohmann/json.hpp>
+#include "trading_client.hpp"
+#include "logger.hpp"
+#include "session_script.hpp"
 
-typedef websocketpp::client<websocketpp::config::asio_tls_client> client;
 using json = nlohmann::json;
 
-//  Used by cURL to write the response from the server into a string.
-size_t WriteCallback(void *contents, size_t size, size_t nmemb, void *userp)
+// How long the menu waits for the WebSocket session before giving up on an order
+constexpr std::chrono::seconds SessionTimeout{10};
+
+// Set by SIGINT or SIGTERM to end a script's run
+std::atomic<bool> stopRequested{false};
+
+void requestStop(int)
 {
-    ((std::string *)userp)->append((char *)contents, size * nmemb);
-    return size * nmemb;
+    stopRequested = true;
 }
 
-class TradingClient
+// Connects if needed; false if the session is not up and authenticated in time
+bool ensureSession(TradingClient &client)
 {
-private:
-    std::string clientId;
-    std::string clientSecretId;
-    std::string accessToken;
-    const std::string baseUrl = "https://test.deribit.com/api/v2/";
-    const std::string wsUrl = "wss://test.deribit.com/ws/api/v2/";
-    client wsClient;
-    websocketpp::connection_hdl hdl;
-    std::thread wsThread;
-    bool isConnected = false;
-    std::unordered_set<std::string> subscribed_instruments;
-    static int update_counter;
-
-    // Function to send a cURL request
-    std::string sendRequest(const std::string &endpoint, const json &payload, const std::string &token = "")
+    if (!client.connected())
     {
-        std::string readBuffer;
-        CURL *curl;
-        CURLcode res;
-
-        curl_global_init(CURL_GLOBAL_DEFAULT);
-        curl = curl_easy_init();
-
-        if (curl)
-        {
-            std::string url = baseUrl + endpoint; // Combine base URL and endpoint
-            curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-            curl_easy_setopt(curl, CURLOPT_POST, 1L);
-
-            std::string jsonStr = payload.dump();
-            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, jsonStr.c_str());
-
-            struct curl_slist *headers = NULL;
-            headers = curl_slist_append(headers, "Content-Type: application/json");
-            if (!token.empty())
-            {
-                headers = curl_slist_append(headers, ("Authorization: Bearer " + token).c_str());
-            }
-            curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
-
-            res = curl_easy_perform(curl);
-            if (res != CURLE_OK)
-            {
-                std::cerr << "cURL Error: " << curl_easy_strerror(res) << std::endl;
-            }
-
-            curl_slist_free_all(headers);
-            curl_easy_cleanup(curl);
-        }
-
-        curl_global_cleanup();
-        return readBuffer;
+        client.connectWebSocket();
     }
-
-public:
-    const std::string &getAccessToken() const
+    if (!client.waitForSession(SessionTimeout))
     {
-        return accessToken;
+        std::cerr << "WebSocket session not ready. Please try again.\n";
+        return false;
     }
-    // Constructor
-    TradingClient(const std::string &id, const std::string &secretId) : clientId(id), clientSecretId(secretId)
+    return true;
+}
+
+// Prints the outcome of an order request sent over the WebSocket
+void printOrderResponse(const json &response, const std::string &action)
+{
+    if (response.contains("error"))
     {
-        wsClient.clear_access_channels(websocketpp::log::alevel::all);
-        wsClient.clear_error_channels(websocketpp::log::elevel::all);
-        wsClient.init_asio();
-        wsClient.set_open_handler(std::bind(&TradingClient::on_open, this, std::placeholders::_1));
-        wsClient.set_message_handler(std::bind(&TradingClient::on_message, this, std::placeholders::_1, std::placeholders::_2));
-        wsClient.set_close_handler(std::bind(&TradingClient::on_close, this, std::placeholders::_1));
+        LOG_ERROR("Error Details: {}", response["error"].dump());
     }
-    // Destructor
-    ~TradingClient()
+    else
     {
-        if (wsThread.joinable())
-        {
-            wsClient.stop();
-            wsThread.join();
-        }
+        LOG_INFO("{} successfully: {}", action, response["result"].dump());
     }
+}
 
-    void on_open(websocketpp::connection_hdl hdl)
-    {
-        this->hdl = hdl;
-        isConnected = true;
-        std::cout << "WebSocket connection established." << std::endl;
-    }
-    // Output From websocket
-    void on_message(websocketpp::connection_hdl hdl, client::message_ptr msg)
+// Prints one line per order of a batch and a summary
+void printBatchResults(const std::vector<OrderResult> &results, const std::string &action)
+{
+    size_t succeeded = 0;
+    for (const OrderResult &result : results)
     {
-        std::string received_msg = msg->get_payload();
-        try
+        if (result.ok)
         {
-            json response = json::parse(received_msg);
-            if (response.contains("params"))
-            {
-                update_counter++;
-                std::cout << "Update #" << update_counter << std::endl;
-                auto params = response["params"];
-                if (params.contains("data"))
-                {
-                    auto data = params["data"];
-                    static json previous_data;
-                    if (data != previous_data)
-                    {
-                        std::cout << "Data updated: " << data.dump(4) << std::endl;
-                        previous_data = data;
-                    }
-                    else
-                    {
-                        std::cout << "No new updates." << std::endl;
-                    }
-                }
-                else if (params.contains("error"))
-                {
-                    std::cout << "Error: " << params["error"].dump(4) << std::endl;
-                }
-            }
+            ++succeeded;
+            LOG_INFO("{} successfully: {}", action, result.orderId.empty() ? result.response["result"].dump() : result.orderId);
         }
-        catch (const std::exception &e)
+        else
         {
-            std::cerr << "Error parsing WebSocket message: " << e.what() << std::endl;
+            LOG_ERROR("{} failed: {}", result.orderId.empty() ? "Order" : result.orderId, result.error);
         }
     }
+    std::cout << succeeded << " of " << results.size() << " succeeded" << std::endl;
+}
 
-    void on_close(websocketpp::connection_hdl hdl)
+// Reads one line of comma or space separated instrument names
+std::vector<std::string> readInstrumentList()
+{
+    std::string line;
+    std::cin >> std::ws;
+    std::getline(std::cin, line);
+    for (char &c : line)
     {
-        isConnected = false;
-        std::cout << "WebSocket connection closed." << std::endl;
+        if (c == ',')
+            c = ' ';
     }
-    // Function to connect websocket
-    void connectWebSocket()
+    std::vector<std::string> instruments;
+    std::istringstream names(line);
+    std::string name;
+    while (names >> name)
     {
-        websocketpp::lib::error_code ec;
-        wsClient.set_tls_init_handler([](websocketpp::connection_hdl hdl) -> websocketpp::lib::shared_ptr<boost::asio::ssl::context>
-                                      {
-    websocketpp::lib::shared_ptr<boost::asio::ssl::context> ctx = 
-        websocketpp::lib::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::tlsv12_client);
-    try {
-        ctx->set_verify_mode(boost::asio::ssl::context::verify_none);
-        // Load certificates if needed
-        // ctx->load_verify_file("path_to_certificate.pem");
-    } catch (const std::exception &e) {
-        std::cerr << "Error initializing SSL context: " << e.what() << std::endl;
-    }
-    return ctx; });
-
-        client::connection_ptr con = wsClient.get_connection(wsUrl, ec);
-        if (ec)
-        {
-            std::cerr << "WebSocket connection error: " << ec.message() << std::endl;
-            return;
-        }
-
-        wsClient.connect(con);
-        wsThread = std::thread([&]()
-                               { wsClient.run(); });
+        instruments.push_back(name);
     }
+    return instruments;
+}
 
-    // Function to send message through websocket
-    void sendWebSocketMessage(const std::string &message)
-    {
-        if (isConnected)
-        {
-            // Start timer
-            auto start_time = std::chrono::high_resolution_clock::now();
-            wsClient.send(hdl, message, websocketpp::frame::opcode::text);
-        }
-        else
-        {
-            std::cerr << "Cannot send message. WebSocket not connected." << std::endl;
-        }
-    }
-    // Function for Subscribing to orderBook
-    void subscribeToOrderBook(const std::string &instrument, int duration_seconds)
+// Parses a whole decimal number; false, leaving value alone, on anything else
+template <typename T>
+bool parseNumber(const std::string &text, T &value)
+{
+    T parsed;
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), parsed);
+    if (error != std::errc() || end != text.data() + text.size() || text.empty())
     {
-        std::cout << "Subscribed to:" << instrument << std::endl;
-        subscribed_instruments.insert(instrument);
-        json payload = {
-            {"jsonrpc", "2.0"},
-            {"method", "public/subscribe"},
-            {"params", {{"channels", {"book." + instrument + ".100ms"}}}},
-            {"id", 1}};
-        sendWebSocketMessage(payload.dump());
-        std::thread([this, duration_seconds]
-                    {
-            std::this_thread::sleep_for(std::chrono::seconds(duration_seconds));
-            std::cout << "closing WebSocket connection after " << duration_seconds << " seconds." << std::endl;
-            wsClient.close(hdl, 1000, "Closing after timeout"); })
-            .detach();
+        return false;
     }
-    // Function to show subscription
-    void showSubscriptions()
+    value = parsed;
+    return true;
+}
+
+// Parses a comma separated list of core numbers, e.g. "2,3,4"; an empty entry leaves that thread unpinned
+bool parseCoreList(const std::string &list, std::vector<int> &cores)
+{
+    cores.clear();
+    std::istringstream in(list);
+    std::string core;
+    while (std::getline(in, core, ','))
     {
-        std::cout << "Subscribed to:" << std::endl;
-        for (const auto &instrument : subscribed_instruments)
+        int value = -1;
+        if (!core.empty() && (!parseNumber(core, value) || value < 0))
         {
-            std::cout << instrument << std::endl;
+            return false;
         }
+        cores.push_back(value);
     }
-    // Function to authenticate and get accesstoken
-    void authenticate()
-    {
-        json payload = {
-            {"id", 0},
-            {"method", "public/auth"},
-            {"params", {{"grant_type", "client_credentials"}, {"client_id", clientId}, {"client_secret", clientSecretId}}},
-            {"jsonrpc", "2.0"}};
+    return true;
+}
 
-        std::string res = sendRequest("public/auth", payload);
-        auto responseJson = json::parse(res);
-        if (responseJson.contains("result") && responseJson["result"].contains("access_token"))
-        {
-            accessToken = responseJson["result"]["access_token"];
-            std::cout << "Access token retrieved successfully." << std::endl;
-        }
-        else
+int main(int argc, char *argv[])
+{
+    // --record [directory] captures every WebSocket frame for later replay
+    // --shards N spreads book subscriptions over N connections, pinned with
+    // --shard-cores (processing threads) and --shard-io-cores (I/O threads)
+    // --legs N subscribes every book on N connections instead and keeps the
+    // first copy of each update (A/B arbitration); the core options apply too
+    // --book raw|100ms|agg2|<group>.<depth>.<interval> sets the default book channel
+    // --endpoint host[:port] connects there instead of test.deribit.com, e.g. to a MockExchange;
+    // --insecure skips certificate verification, which the mock's self-signed certificate needs
+    // --low-latency [core] busy-polls the WebSocket I/O threads instead of sleeping in
+    // epoll and pins the session's to core; give each its own isolated core
+    // --rcvbuf bytes sets the receive buffer of every WebSocket and REST socket
+    // --shm name publishes every book to that shared-memory segment, read with TradingBookReader
+    // --order-rate rate[,burst] sets the account's matching engine limit in orders per second
+    // (Deribit tier 4 default: 5,20); --no-rate-limit sends requests without pacing them locally
+    // --script file runs a session script (see session_script.hpp) instead of
+    // the menu, with credentials from DERIBIT_CLIENT_ID and DERIBIT_CLIENT_SECRET
+    PipelineConfig pipeline;
+    std::string scriptPath;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--record")
         {
-            std::cerr << "Failed to authenticate." << std::endl;
-            if (responseJson.contains("error"))
+            pipeline.record = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
             {
-                std::cerr << "Error Details: " << responseJson["error"].dump() << std::endl;
+                pipeline.recorder.directory = argv[++i];
             }
         }
-    }
-
-    // For placing order
-    void placeOrder(const std::string &instrument, const std::string &accessToken, double price, double amount)
-    {
-        json payload = {
-            {"jsonrpc", "2.0"},
-            {"method", "private/buy"},
-            {"params", {
-                           {"instrument_name", instrument},
-                           {"type", "limit"},
-                           {"price", price},
-                           {"amount", amount},
-                       }},
-            {"id", 1}};
-        std::string response = sendRequest("private/buy", payload, accessToken);
-        if (!response.empty())
-        {
-            try
-            {
-                auto responseJson = json::parse(response);
-                if (responseJson.contains("error") && responseJson["error"].contains("data") && responseJson["error"]["data"].contains("reason"))
-                {
-                    std::cerr << "Error Details: " << responseJson["error"]["data"]["reason"] << std::endl;
-                }
-                else if (responseJson.contains("message"))
-                {
-                    std::cerr << "Error Details: " << responseJson["message"] << std::endl;
-                }
-                else
-                {
-                    std::cout << "Order placed successfully." << std::endl;
-                }
-            }
-            catch (const std::exception &e)
+        else if (arg == "--shards" && i + 1 < argc)
+        {
+            if (!parseNumber(argv[++i], pipeline.sharding.shards))
             {
-                std::cerr << "Error parsing JSON response: " << e.what() << std::endl;
+                std::cerr << "Invalid --shards: " << argv[i] << " is not a number of connections" << std::endl;
+                return 1;
             }
         }
-        else
-        {
-            std::cout << "No response received or error occurred." << std::endl;
-        }
-    }
-    // Function to get all orders
-    void getAllOpenOrders()
-    {
-        json payload = {
-            {"jsonrpc", "2.0"},
-            {"method", "private/get_open_orders"},
-            {"params", {}},
-            {"id", 2}};
-
-        std::string res = sendRequest("private/get_open_orders", payload, accessToken);
-        try
+        else if (arg == "--legs" && i + 1 < argc)
         {
-            auto responseJson = json::parse(res);
-
-            if (responseJson.contains("result"))
+            if (!parseNumber(argv[++i], pipeline.sharding.shards))
             {
-                if (responseJson["result"].empty())
-                {
-                    std::cout << "No open orders found." << std::endl;
-                }
-                else
-                {
-                    auto orders = responseJson["result"];
-                    std::cout << "All Open Orders in detail: " << orders.dump(4) << std::endl;
-                    // Loop through orders safely
-                    for (const auto &order : orders)
-                    {
-
-                        if (order.contains("order_id"))
-                            std::cout << "Order ID: " << order["order_id"] << std::endl;
-
-                        if (order.contains("instrument_name"))
-                            std::cout << "Instrument: " << order["instrument_name"] << std::endl;
-
-                        if (order.contains("price"))
-                            std::cout << "Price: " << order["price"] << std::endl;
-
-                        if (order.contains("quantity"))
-                            std::cout << "Quantity: " << order["quantity"] << std::endl;
-                        else
-                            std::cout << "Quantity: N/A\n"
-                                      << std::endl;
-                    }
-                }
+                std::cerr << "Invalid --legs: " << argv[i] << " is not a number of connections" << std::endl;
+                return 1;
             }
-            else
+            pipeline.sharding.redundant = true;
+        }
+        else if (arg == "--book" && i + 1 < argc)
+        {
+            std::string error;
+            if (!BookChannel::parse(argv[++i], pipeline.bookChannel, error))
             {
-                std::cerr << "Failed to retrieve open orders: " << responseJson.dump(4) << std::endl;
+                std::cerr << "Invalid --book: " << error << std::endl;
+                return 1;
             }
         }
-        catch (const std::exception &e)
+        else if (arg == "--endpoint" && i + 1 < argc)
         {
-            std::cerr << "An error occurred: " << e.what() << std::endl;
+            bool verifyPeer = pipeline.endpoint.verifyPeer;
+            pipeline.endpoint = ExchangeEndpoint::forHost(argv[++i]);
+            pipeline.endpoint.verifyPeer = verifyPeer;
         }
-    }
-    // Function to cancel order
-    void cancelOrder(const std::string &accesstoken, const std::string &orderId)
-    {
-        json payload = {
-            {"jsonrpc", "2.0"},
-            {"method", "private/cancel"},
-            {"params", {{"order_id", orderId}}},
-            {"id", 3}};
-        std::string response = sendRequest("private/cancel", payload, accessToken);
-        auto responseJson = json::parse(response);
-        if (responseJson.contains("error"))
+        else if (arg == "--insecure")
         {
-            std::cerr << "Error cancelling order: " << responseJson["error"]["message"] << std::endl;
+            pipeline.endpoint.verifyPeer = false;
         }
-        else
+        else if (arg == "--low-latency")
         {
-            std::cout << "Cancelled Order: " << std::endl;
-        }
-    }
-    // Function to modify order
-    void modifyOrder(const std::string &accesstoken, const std::string &orderId, double newPrice, double newAmount)
-    {
-        json payload = {
-            {"jsonrpc", "2.0"},
-            {"method", "private/edit"},
-            {"params", {{"order_id", orderId}, {"price", newPrice}, {"amount", newAmount}}},
-            {"id", 4}};
-        std::string response = sendRequest("private/edit", payload, accessToken);
-        if (!response.empty())
-        {
-            try
+            pipeline.network.busyPoll = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
             {
-                auto responseJson = json::parse(response);
-                if (responseJson.contains("error") && responseJson["error"].contains("data") && responseJson["error"]["data"].contains("reason"))
-                {
-                    std::cerr << "Error Details: " << responseJson["error"]["data"]["reason"] << std::endl;
-                }
-                else if (responseJson.contains("message"))
+                if (!parseNumber(argv[++i], pipeline.network.ioCore) || pipeline.network.ioCore < 0)
                 {
-                    std::cerr << "Error Details: " << responseJson["message"] << std::endl;
-                }
-                else
-                {
-                    std::cout << "Order modified successfully." << std::endl;
+                    std::cerr << "Invalid --low-latency core: " << argv[i] << std::endl;
+                    return 1;
                 }
             }
-            catch (const std::exception &e)
+        }
+        else if (arg == "--rcvbuf" && i + 1 < argc)
+        {
+            if (!parseNumber(argv[++i], pipeline.network.socket.receiveBuffer) || pipeline.network.socket.receiveBuffer <= 0)
             {
-                std::cerr << "Error parsing JSON response: " << e.what() << std::endl;
+                std::cerr << "Invalid --rcvbuf: " << argv[i] << " is not a size in bytes" << std::endl;
+                return 1;
             }
         }
-        else
+        else if (arg == "--order-rate" && i + 1 < argc)
         {
-            std::cout << "No response received or error occurred." << std::endl;
-        }
-    }
-    // Function to get orderbook
-    void getOrderBook(const std::string &instrument, int depth)
-    {
-        json payload = {
-            {"jsonrpc", "2.0"},
-            {"method", "public/get_order_book"},
-            {"params", {{"instrument_name", instrument}, {"depth", depth}}},
-            {"id", 5}};
-
-        std::string response = sendRequest("public/get_order_book", payload);
-        auto responseJson = json::parse(response);
-
-        if (responseJson.contains("result"))
-        {
-            const auto &result = responseJson["result"];
-            std::cout << "Order Book for " << instrument << ":\n";
-            // Print general details
-            std::cout << result.dump(4) << std::endl;
-            // Print bids
-            if (result.contains("bids"))
+            std::string limit = argv[++i];
+            size_t comma = limit.find(',');
+            double rate = 0, burst = 0;
+            bool valid = parseNumber(limit.substr(0, comma), rate);
+            if (comma == std::string::npos)
             {
-                std::cout << "\nBids:\n";
-                for (const auto &bid : result["bids"])
-                {
-                    std::cout << "Price: " << bid[0] << ", Amount: " << bid[1] << '\n';
-                }
+                burst = 4 * rate;
             }
-            // Print asks
-            if (result.contains("asks"))
+            else
             {
-                std::cout << "\nAsks:\n";
-                for (const auto &ask : result["asks"])
-                {
-                    std::cout << "Price: " << ask[0] << ", Amount: " << ask[1] << '\n';
-                }
+                valid = valid && parseNumber(limit.substr(comma + 1), burst);
             }
-        }
-        else
-        {
-            std::cerr << "Failed to retrieve order book." << std::endl;
-            if (responseJson.contains("error"))
+            // At least one order's worth of burst, or nothing could ever go out
+            if (!valid || !std::isfinite(rate) || !std::isfinite(burst) || rate <= 0 || burst < 1)
             {
-                std::cerr << "Error Details: " << responseJson["error"].dump() << std::endl;
+                std::cerr << "Invalid --order-rate: " << limit << " is not rate[,burst] with rate > 0 and burst >= 1, e.g. 5,20" << std::endl;
+                return 1;
             }
+            CreditPoolConfig &matching = pipeline.rateLimits.matching;
+            matching.refillPerSecond = rate * matching.cost;
+            matching.capacity = burst * matching.cost;
         }
-    }
-    // Function to get position
-    void getPositions(const std::string &accessToken, const std::string &currency, const std::string &kind)
-    {
-        json payload = {
-            {"jsonrpc", "2.0"},
-            {"method", "private/get_positions"},
-            {"params", {
-                           {"currency", currency},
-                           {"kind", kind},
-                       }},
-            {"id", 6}};
-
-        std::string response = sendRequest("private/get_positions", payload, accessToken);
-
-        if (response.empty())
+        else if (arg == "--no-rate-limit")
         {
-            std::cout << "Currency is unavailable.\n";
-            return;
+            pipeline.rateLimits.enabled = false;
         }
-        else
+        else if (arg == "--shm" && i + 1 < argc)
+        {
+            pipeline.sharedBooks.name = argv[++i];
+        }
+        else if (arg == "--script" && i + 1 < argc)
         {
-            try
+            scriptPath = argv[++i];
+        }
+        else if (arg == "--shard-cores" && i + 1 < argc)
+        {
+            if (!parseCoreList(argv[++i], pipeline.sharding.processingCores))
             {
-                auto responseJson = json::parse(response);
-
-                if (responseJson.contains("result"))
-                {
-                    auto positions = responseJson["result"];
-                    std::cout << positions.dump(4) << std::endl;
-                }
-                else if (responseJson.contains("error") && responseJson["error"].contains("data") && responseJson["error"]["data"].contains("reason"))
-                {
-                    std::cerr << "Error Details: " << responseJson["error"]["data"]["reason"] << std::endl;
-                }
-                else if (responseJson.contains("message"))
-                {
-                    std::cerr << "Error Details: " << responseJson["message"] << std::endl;
-                }
-                else
-                {
-                    std::cerr << "Unexpected response format: " << response << "\n";
-                }
+                std::cerr << "Invalid --shard-cores: " << argv[i] << " is not a list of cores, e.g. 2,3" << std::endl;
+                return 1;
             }
-            catch (const std::exception &e)
+        }
+        else if (arg == "--shard-io-cores" && i + 1 < argc)
+        {
+            if (!parseCoreList(argv[++i], pipeline.sharding.ioCores))
             {
-                std::cerr << "Failed to parse response: " << e.what() << "\n";
-                std::cerr << "Raw response: " << response << "\n";
+                std::cerr << "Invalid --shard-io-cores: " << argv[i] << " is not a list of cores, e.g. 4,5" << std::endl;
+                return 1;
             }
         }
     }
-};
-int TradingClient::update_counter = 0;
 
-int main()
-{
-    std::string clientId, clientSecret;
+    // Binary log for everything the client does; Info and above are also echoed to the console
+    Logger::instance().start("trading_client.tclog", LogLevel::Info, LogLevel::Info);
 
-    // Input for public and private IDs
-    std::cout << "Enter your publicId: ";
-    std::cin >> clientId;
-    std::cout << "Enter your privateId: ";
-    std::cin >> clientSecret;
+    std::string clientId, clientSecret;
+    SessionScript script;
+    if (!scriptPath.empty())
+    {
+        // Checked before connecting, so a typo does not cost a login
+        std::string error;
+        if (!script.load(scriptPath, error))
+        {
+            std::cerr << "Invalid script: " << error << std::endl;
+            return 1;
+        }
+        const char *id = std::getenv("DERIBIT_CLIENT_ID");
+        const char *secret = std::getenv("DERIBIT_CLIENT_SECRET");
+        if (!id || !secret)
+        {
+            std::cerr << "--script needs DERIBIT_CLIENT_ID and DERIBIT_CLIENT_SECRET" << std::endl;
+            return 1;
+        }
+        clientId = id;
+        clientSecret = secret;
+    }
+    else
+    {
+        // Input for public and private IDs
+        std::cout << "Enter your publicId: ";
+        std::cin >> clientId;
+        std::cout << "Enter your privateId: ";
+        std::cin >> clientSecret;
+    }
 
     // Creating client object
-    TradingClient client(clientId, clientSecret);
+    TradingClient client(clientId, clientSecret, pipeline);
 
     // Authenticating
     client.authenticate();
 
+    // Tick sizes and trade amounts, from instruments.tsv when it is recent
+    client.loadInstruments();
+
     // Check for successful authentication
     const std::string accessToken = client.getAccessToken();
     if (accessToken.empty())
@@ -523,6 +318,13 @@ int main()
         return 1;
     }
 
+    if (!scriptPath.empty())
+    {
+        std::signal(SIGINT, requestStop);
+        std::signal(SIGTERM, requestStop);
+        return script.run(client, pipeline.bookChannel, stopRequested) ? 0 : 1;
+    }
+
     // Main menu loop
     while (true)
     {
@@ -534,14 +336,23 @@ int main()
         std::cout << "4. Modify Order\n";
         std::cout << "5. Cancel Order\n";
         std::cout << "6. Get Positions\n";
-        std::cout << "7. Subscribe to Orderbook\n";
+        std::cout << "7. Subscribe to Orderbooks\n";
         std::cout << "8. Show all subscriptions\n";
         std::cout << "9. Exit\n";
+        std::cout << "10. Place Order (WebSocket)\n";
+        std::cout << "11. Modify Order (WebSocket)\n";
+        std::cout << "12. Cancel Order (WebSocket)\n";
+        std::cout << "13. Show pipeline stats\n";
+        std::cout << "14. Show latency stats\n";
+        std::cout << "15. Unsubscribe from Orderbooks\n";
+        std::cout << "16. Move instrument to feed shard\n";
+        std::cout << "17. Place order ladder\n";
+        std::cout << "18. Cancel all orders of an instrument\n";
         std::cout << "Enter your choice: ";
 
         if (!(std::cin >> choice))
         {
-            std::cerr << "Invalid input. Please enter a number between 1 and 9.\n";
+            std::cerr << "Invalid input. Please enter a number between 1 and 18.\n";
             std::cin.clear();                                                   // Clear error state
             std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n'); // Discard invalid input
             continue;
@@ -563,7 +374,7 @@ int main()
 
             if (!std::cin.fail())
             {
-                client.placeOrder(instrument, accessToken, price, amount);
+                client.placeOrder(instrument, client.getAccessToken(), price, amount);
             }
             else
             {
@@ -614,7 +425,7 @@ int main()
 
             if (!std::cin.fail())
             {
-                client.modifyOrder(accessToken, orderId, price, amount);
+                client.modifyOrder(client.getAccessToken(), orderId, price, amount);
             }
             else
             {
@@ -630,7 +441,7 @@ int main()
             std::string orderId;
             std::cout << "Enter order ID: ";
             std::cin >> orderId;
-            client.cancelOrder(accessToken, orderId);
+            client.cancelOrder(client.getAccessToken(), orderId);
             break;
         }
         case 6:
@@ -641,38 +452,195 @@ int main()
             std::cin >> currency;
             std::cout << "Enter kind (e.g., future, option): ";
             std::cin >> kind;
-            client.getPositions(accessToken, currency, kind);
+            client.getPositions(client.getAccessToken(), currency, kind);
             break;
         }
         case 7:
         {
-            // Subscribe to Orderbook
+            // Subscribe to Orderbooks; they are sent once the session is up.
+            // name@channel picks the book channel, e.g. BTC-PERPETUAL@raw or ETH-PERPETUAL@none.10.100ms
+            std::cout << "Enter instrument names (comma separated, optionally name@channel): ";
+            std::vector<std::string> instruments = readInstrumentList();
+            if (instruments.empty())
+            {
+                break;
+            }
+            BookChannelGroups byChannel;
+            std::string error;
+            if (!groupByChannel(instruments, pipeline.bookChannel, byChannel, error))
+            {
+                std::cerr << error << std::endl;
+                break;
+            }
+            client.connectWebSocket();
+            for (const auto &group : byChannel)
+            {
+                client.subscribeToOrderBooks(group.second.second, group.second.first);
+            }
+            break;
+        }
+        case 8:
+            // Show all subscriptions
+            client.showSubscriptions();
+            break;
+
+        case 10:
+        {
+            // Place Order over the WebSocket session
             std::string instrument;
-            int duration;
+            double price, amount;
             std::cout << "Enter instrument name: ";
             std::cin >> instrument;
-            std::cout << "Enter subscription duration (seconds): ";
-            std::cin >> duration;
+            std::cout << "Enter price: ";
+            std::cin >> price;
+            std::cout << "Enter amount: ";
+            std::cin >> amount;
 
             if (!std::cin.fail())
             {
-                client.connectWebSocket();
-                std::this_thread::sleep_for(std::chrono::seconds(2)); // Wait for connection
-                client.subscribeToOrderBook(instrument, duration);
-                std::this_thread::sleep_for(std::chrono::seconds(duration));
+                if (ensureSession(client))
+                {
+                    printOrderResponse(client.placeOrderAsync(instrument, price, amount).get(), "Order placed");
+                }
             }
             else
             {
-                std::cerr << "Invalid input for duration. Please try again.\n";
+                std::cerr << "Invalid input for price or amount. Please try again.\n";
                 std::cin.clear();
                 std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
             }
             break;
         }
-        case 8:
-            // Show all subscriptions
-            client.showSubscriptions();
+        case 11:
+        {
+            // Modify Order over the WebSocket session
+            std::string orderId;
+            double price, amount;
+            std::cout << "Enter orderId: ";
+            std::cin >> orderId;
+            std::cout << "Enter new price: ";
+            std::cin >> price;
+            std::cout << "Enter new amount: ";
+            std::cin >> amount;
+
+            if (!std::cin.fail())
+            {
+                if (ensureSession(client))
+                {
+                    printOrderResponse(client.modifyOrderAsync(orderId, price, amount).get(), "Order modified");
+                }
+            }
+            else
+            {
+                std::cerr << "Invalid input for price or amount. Please try again.\n";
+                std::cin.clear();
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            }
+            break;
+        }
+        case 12:
+        {
+            // Cancel Order over the WebSocket session
+            std::string orderId;
+            std::cout << "Enter order ID: ";
+            std::cin >> orderId;
+            if (ensureSession(client))
+            {
+                printOrderResponse(client.cancelOrderAsync(orderId).get(), "Order cancelled");
+            }
+            break;
+        }
+        case 13:
+            // Show pipeline stats
+            client.showPipelineStats();
+            break;
+
+        case 14:
+            // Show latency stats
+            client.showLatencyStats();
+            break;
+
+        case 15:
+        {
+            // Unsubscribe from Orderbooks
+            std::cout << "Enter instrument names (comma separated): ";
+            std::vector<std::string> instruments = readInstrumentList();
+            if (!instruments.empty())
+            {
+                client.unsubscribeFromOrderBooks(instruments);
+            }
+            break;
+        }
+        case 16:
+        {
+            // Move instrument to another feed shard
+            if (client.feedShards() == 0)
+            {
+                std::cerr << "The feed is not sharded. Start with --shards N.\n";
+                break;
+            }
+            std::string instrument;
+            uint32_t shard;
+            std::cout << "Enter instrument name: ";
+            std::cin >> instrument;
+            std::cout << "Enter shard (0-" << client.feedShards() - 1 << "): ";
+            std::cin >> shard;
+
+            if (!std::cin.fail() && client.assignInstrumentToShard(instrument, shard))
+            {
+                std::cout << instrument << " assigned to shard " << shard << std::endl;
+            }
+            else
+            {
+                std::cerr << "Invalid shard. Please try again.\n";
+                std::cin.clear();
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            }
             break;
+        }
+        case 17:
+        {
+            // Place order ladder: count buys stepping down from the top price
+            std::string instrument;
+            double price, step, amount;
+            int count;
+            std::cout << "Enter instrument name: ";
+            std::cin >> instrument;
+            std::cout << "Enter top price: ";
+            std::cin >> price;
+            std::cout << "Enter price step: ";
+            std::cin >> step;
+            std::cout << "Enter amount per order: ";
+            std::cin >> amount;
+            std::cout << "Enter number of orders: ";
+            std::cin >> count;
+
+            if (!std::cin.fail() && count > 0)
+            {
+                std::vector<OrderRequest> ladder;
+                for (int i = 0; i < count; ++i)
+                {
+                    ladder.push_back({instrument, price - i * step, amount});
+                }
+                printBatchResults(client.placeOrders(ladder), "Order placed");
+            }
+            else
+            {
+                std::cerr << "Invalid input. Please try again.\n";
+                std::cin.clear();
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            }
+            break;
+        }
+        case 18:
+        {
+            // Cancel all orders of an instrument
+            std::string instrument;
+            std::cout << "Enter instrument name: ";
+            std::cin >> instrument;
+            printBatchResults(client.cancelAllByInstrument(instrument), "Order cancelled");
+            break;
+        }
 
         case 9:
             // Exit
@@ -680,7 +648,7 @@ int main()
             return 0;
 
         default:
-            std::cerr << "Invalid choice. Please select a number between 1 and 9.\n";
+            std::cerr << "Invalid choice. Please select a number between 1 and 18.\n";
             break;
         }
     }
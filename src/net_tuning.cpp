@@ -0,0 +1,82 @@
+#include "net_tuning.hpp"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+bool applySocketOptions(int fd, const SocketOptions &options)
+{
+    bool ok = true;
+    if (options.noDelay)
+    {
+        int one = 1;
+        ok = setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) == 0 && ok;
+    }
+    if (options.receiveBuffer > 0)
+    {
+        ok = setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &options.receiveBuffer, sizeof(options.receiveBuffer)) == 0 && ok;
+    }
+    return ok;
+}
+
+void runIoContext(boost::asio::io_context &io, bool busyPoll)
+{
+    if (!busyPoll)
+    {
+        io.run();
+        return;
+    }
+    // poll() stops the context once it is out of work, as run() would
+    while (!io.stopped())
+    {
+        io.poll();
+    }
+}
+
+TlsSessionCache::~TlsSessionCache()
+{
+    if (session)
+    {
+        SSL_SESSION_free(session);
+    }
+}
+
+void TlsSessionCache::resume(SSL *ssl)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (session)
+    {
+        SSL_set_session(ssl, session);
+    }
+}
+
+void TlsSessionCache::remember(SSL *ssl)
+{
+    if (SSL_session_reused(ssl))
+    {
+        resumedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        fullCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    // With TLS 1.3 the session comes in a ticket after the handshake and may not be here yet
+    SSL_SESSION *current = SSL_get0_session(ssl);
+    if (!current || !SSL_SESSION_is_resumable(current))
+    {
+        return;
+    }
+    // A copy, as OpenSSL marks a connection's own session unusable when the
+    // connection is dropped without a TLS shutdown, which is how most end
+    SSL_SESSION *latest = SSL_SESSION_dup(current);
+    if (!latest)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (session)
+    {
+        SSL_SESSION_free(session);
+    }
+    session = latest;
+}
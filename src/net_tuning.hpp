@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <boost/asio/io_context.hpp>
+#include <openssl/ssl.h>
+
+// Options set on every WebSocket and REST socket
+struct SocketOptions
+{
+    bool noDelay = true;   // TCP_NODELAY, so small order frames are not held back by Nagle
+    int receiveBuffer = 0; // SO_RCVBUF in bytes; 0 keeps the kernel default and its autotuning
+};
+
+// Opt-in low-latency settings for the WebSocket I/O threads. Busy polling
+// only pays off with the I/O thread alone on an isolated core: it keeps that
+// core at 100% and starves anything sharing it.
+struct NetworkTuning
+{
+    bool busyPoll = false; // spin on io_context::poll() instead of sleeping in epoll
+    int ioCore = -1;       // session I/O thread's core, -1 unpinned; shards use ShardedFeedConfig::ioCores
+    SocketOptions socket;
+    bool reuseTlsSessions = true; // resume the last TLS session when reconnecting
+};
+
+// Sets options on a socket; false if any setsockopt failed, with errno set
+bool applySocketOptions(int fd, const SocketOptions &options);
+
+// Runs io until it is stopped or runs out of work, as io.run() does. With
+// busyPoll the thread never blocks, so a handler runs as soon as its
+// completion is ready instead of after an epoll wakeup.
+void runIoContext(boost::asio::io_context &io, bool busyPoll);
+
+// The TLS session of a connection's last handshake, so a reconnect resumes
+// it with an abbreviated handshake instead of a full one. One per connection
+// owner; resume() and remember() may be called from different threads.
+class TlsSessionCache
+{
+public:
+    TlsSessionCache() = default;
+    ~TlsSessionCache();
+
+    TlsSessionCache(const TlsSessionCache &) = delete;
+    TlsSessionCache &operator=(const TlsSessionCache &) = delete;
+
+    // Offers the kept session to a connection that has not started its handshake
+    void resume(SSL *ssl);
+    // Keeps the session of a connection whose handshake has completed
+    void remember(SSL *ssl);
+
+    uint64_t resumed() const { return resumedCount.load(std::memory_order_relaxed); }
+    uint64_t fullHandshakes() const { return fullCount.load(std::memory_order_relaxed); }
+
+private:
+    std::mutex mutex;
+    SSL_SESSION *session = nullptr;
+    std::atomic<uint64_t> resumedCount{0};
+    std::atomic<uint64_t> fullCount{0};
+};
@@ -0,0 +1,278 @@
+#include "notification_parser.hpp"
+
+#include <charconv>
+
+namespace
+{
+    // Characters skip() has to look at inside objects and arrays
+    struct StructuralTable
+    {
+        bool flags[256] = {};
+        constexpr StructuralTable()
+        {
+            for (char ch : {'"', '{', '}', '[', ']'})
+                flags[(unsigned char)ch] = true;
+        }
+        constexpr bool operator[](unsigned char ch) const { return flags[ch]; }
+    };
+    constexpr StructuralTable structural;
+
+    // Minimal JSON cursor over a buffer we do not own
+    struct Cursor
+    {
+        const char *p;
+        const char *end;
+
+        explicit Cursor(std::string_view text) : p(text.data()), end(text.data() + text.size()) {}
+
+        void ws()
+        {
+            while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t'))
+                ++p;
+        }
+
+        bool consume(char c)
+        {
+            ws();
+            if (p < end && *p == c)
+            {
+                ++p;
+                return true;
+            }
+            return false;
+        }
+
+        bool peek(char c)
+        {
+            ws();
+            return p < end && *p == c;
+        }
+
+        // Returns the raw contents between the quotes; escapes are left as they are
+        bool string(std::string_view &out)
+        {
+            if (!consume('"'))
+                return false;
+            const char *start = p;
+            while (p < end && *p != '"')
+            {
+                if (*p == '\\')
+                    ++p;
+                ++p;
+            }
+            if (p >= end)
+                return false;
+            out = std::string_view(start, p - start);
+            ++p;
+            return true;
+        }
+
+        template <typename T>
+        bool number(T &out)
+        {
+            ws();
+            auto result = std::from_chars(p, end, out);
+            if (result.ec != std::errc())
+                return false;
+            p = result.ptr;
+            return true;
+        }
+
+        // Skips any value and returns its raw text
+        bool skip(std::string_view *raw = nullptr)
+        {
+            ws();
+            if (p >= end)
+                return false;
+            const char *start = p;
+            if (*p == '"')
+            {
+                std::string_view ignored;
+                if (!string(ignored))
+                    return false;
+            }
+            else if (*p == '{' || *p == '[')
+            {
+                int depth = 0;
+                while (p < end)
+                {
+                    char ch = *p++;
+                    if (!structural[(unsigned char)ch])
+                        continue;
+                    if (ch == '"')
+                    {
+                        while (p < end && *p != '"')
+                            p += *p == '\\' ? 2 : 1;
+                        ++p;
+                    }
+                    else if (ch == '{' || ch == '[')
+                        ++depth;
+                    else if (--depth == 0)
+                        break;
+                }
+                if (p > end || depth != 0)
+                    return false;
+            }
+            else
+            {
+                while (p < end && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\n' && *p != '\r' && *p != '\t')
+                    ++p;
+            }
+            if (raw)
+                *raw = std::string_view(start, p - start);
+            return true;
+        }
+
+        // Calls onMember(key) for each member; it must consume the value
+        template <typename F>
+        bool object(F &&onMember)
+        {
+            if (!consume('{'))
+                return false;
+            if (consume('}'))
+                return true;
+            do
+            {
+                std::string_view key;
+                if (!string(key) || !consume(':') || !onMember(key))
+                    return false;
+            } while (consume(','));
+            return consume('}');
+        }
+    };
+
+    bool parseAction(std::string_view action, BookAction &out)
+    {
+        if (action == "new")
+            out = BookAction::New;
+        else if (action == "change")
+            out = BookAction::Change;
+        else if (action == "delete")
+            out = BookAction::Delete;
+        else
+            return false;
+        return true;
+    }
+
+    // [[action, price, amount], ...] or, on grouped channels, [[price, amount], ...]
+    bool parseLevels(Cursor &c, std::vector<LevelUpdate> &out)
+    {
+        if (!c.consume('['))
+            return false;
+        if (c.consume(']'))
+            return true;
+        do
+        {
+            LevelUpdate level{BookAction::New, 0, 0};
+            if (!c.consume('['))
+                return false;
+            if (c.peek('"'))
+            {
+                std::string_view action;
+                if (!c.string(action) || !parseAction(action, level.action) || !c.consume(','))
+                    return false;
+            }
+            if (!c.number(level.price) || !c.consume(',') || !c.number(level.amount) || !c.consume(']'))
+                return false;
+            out.push_back(level);
+        } while (c.consume(','));
+        return c.consume(']');
+    }
+}
+
+FrameKind scanFrame(std::string_view payload, FrameView &frame)
+{
+    frame = FrameView();
+    Cursor c(payload);
+    bool hasParams = false;
+    bool ok = c.object([&](std::string_view key)
+                       {
+        if (key == "method")
+            return c.string(frame.method);
+        if (key == "params")
+        {
+            // Only note where channel and data are, data is decoded by the caller
+            hasParams = c.peek('{');
+            if (!hasParams)
+                return c.skip();
+            return c.object([&](std::string_view member)
+                            {
+                if (member == "channel")
+                    return c.string(frame.channel);
+                if (member == "data")
+                    return c.skip(&frame.data);
+                return c.skip(); });
+        }
+        if (key == "id")
+        {
+            frame.hasId = c.number(frame.id);
+            return frame.hasId || c.skip();
+        }
+        return c.skip(); });
+    if (!ok)
+        return FrameKind::Malformed;
+
+    if (frame.hasId)
+        return FrameKind::Response;
+    if (frame.method != "subscription" || !hasParams)
+        return FrameKind::Other;
+    return !frame.channel.empty() && !frame.data.empty() ? FrameKind::Subscription : FrameKind::Malformed;
+}
+
+bool parseBookData(std::string_view data, BookUpdate &update)
+{
+    update.clear();
+    // Grouped channels carry no type and always send the full depth
+    update.snapshot = true;
+    bool hasInstrument = false;
+    bool hasChangeId = false;
+
+    Cursor c(data);
+    bool ok = c.object([&](std::string_view key)
+                       {
+        if (key == "type")
+        {
+            std::string_view type;
+            if (!c.string(type))
+                return false;
+            update.snapshot = type == "snapshot";
+            return true;
+        }
+        if (key == "instrument_name")
+        {
+            std::string_view name;
+            if (!c.string(name))
+                return false;
+            update.instrument.assign(name.data(), name.size());
+            hasInstrument = true;
+            return true;
+        }
+        if (key == "change_id")
+            return hasChangeId = c.number(update.changeId);
+        if (key == "prev_change_id")
+            return c.number(update.prevChangeId);
+        if (key == "timestamp")
+            return c.number(update.timestamp);
+        if (key == "bids")
+            return parseLevels(c, update.bids);
+        if (key == "asks")
+            return parseLevels(c, update.asks);
+        return c.skip(); });
+    return ok && hasInstrument && hasChangeId;
+}
+
+bool isBookNotification(std::string_view payload)
+{
+    // The channel comes right after "method":"subscription","params":{ in Deribit's notifications
+    constexpr size_t Window = 96;
+    return payload.substr(0, Window).find("\"channel\":\"book.") != std::string_view::npos;
+}
+
+std::string_view bookChannelInstrument(std::string_view channel)
+{
+    if (channel.rfind("book.", 0) != 0)
+        return {};
+    std::string_view rest = channel.substr(5);
+    size_t dot = rest.find('.');
+    return dot == std::string_view::npos ? std::string_view() : rest.substr(0, dot);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include "order_book.hpp"
+
+// Streaming parser for the WebSocket frames that dominate our traffic. It walks
+// the payload in place, hands back views into it, and decodes book data
+// straight into a reusable BookUpdate, so a market data frame costs no heap
+// allocation once the update's buffers have grown to size. Everything that is
+// not a subscription notification is left to nlohmann::json.
+
+enum class FrameKind
+{
+    Subscription, // "method":"subscription", channel and data are set
+    Response,     // carries an "id", i.e. the answer to one of our requests
+    Other,        // heartbeats and any other notification
+    Malformed
+};
+
+struct FrameView
+{
+    std::string_view method;
+    std::string_view channel;
+    std::string_view data; // raw JSON text of params.data
+    uint64_t id = 0;
+    bool hasId = false;
+};
+
+// Classifies a frame and locates its parts without copying
+FrameKind scanFrame(std::string_view payload, FrameView &frame);
+
+// Whether a frame is a book.* notification, judged from its first bytes so the
+// I/O thread can afford it. Only these may be dropped when the inbound ring is
+// full, as a book resyncs after a gap; responses and user.* notifications may not.
+bool isBookNotification(std::string_view payload);
+
+// Instrument of a book.<instrument>.<interval> channel, empty for any other channel
+std::string_view bookChannelInstrument(std::string_view channel);
+
+// Decodes the data object of a book.* notification
+bool parseBookData(std::string_view data, BookUpdate &update);
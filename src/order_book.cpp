@@ -0,0 +1,262 @@
+#include "order_book.hpp"
+
+#include <algorithm>
+
+using json = nlohmann::json;
+
+namespace
+{
+    bool parseAction(const std::string &action, BookAction &out)
+    {
+        if (action == "new")
+            out = BookAction::New;
+        else if (action == "change")
+            out = BookAction::Change;
+        else if (action == "delete")
+            out = BookAction::Delete;
+        else
+            return false;
+        return true;
+    }
+
+    // Entries are [action, price, amount] in notifications and [price, amount] in snapshots
+    bool parseLevels(const json &levels, std::vector<LevelUpdate> &out)
+    {
+        for (const auto &level : levels)
+        {
+            LevelUpdate update;
+            if (level.size() == 3 && level[0].is_string())
+            {
+                if (!parseAction(level[0].get_ref<const std::string &>(), update.action))
+                    return false;
+                update.price = level[1].get<double>();
+                update.amount = level[2].get<double>();
+            }
+            else if (level.size() == 2)
+            {
+                update.action = BookAction::New;
+                update.price = level[0].get<double>();
+                update.amount = level[1].get<double>();
+            }
+            else
+            {
+                return false;
+            }
+            out.push_back(update);
+        }
+        return true;
+    }
+
+    // Sets or removes the level at price. Levels are kept sorted by `before`,
+    // which orders a worse price before a better one.
+    template <typename Before>
+    void setLevel(std::vector<PriceLevel> &levels, const LevelUpdate &update, const TickScale &scale, Before before)
+    {
+        int64_t ticks = scale.ticks(update.price);
+        auto it = std::lower_bound(levels.begin(), levels.end(), ticks, [&](const PriceLevel &level, int64_t price)
+                                   { return before(level.ticks, price); });
+        bool found = it != levels.end() && it->ticks == ticks;
+
+        int64_t lots = scale.lots(update.amount);
+        if (update.action == BookAction::Delete || lots == 0)
+        {
+            if (found)
+                levels.erase(it);
+        }
+        else if (found)
+        {
+            it->lots = lots;
+        }
+        else
+        {
+            levels.insert(it, PriceLevel{ticks, lots});
+        }
+    }
+}
+
+void BookUpdate::clear()
+{
+    instrument.clear();
+    snapshot = false;
+    changeId = 0;
+    prevChangeId = 0;
+    timestamp = 0;
+    bids.clear();
+    asks.clear();
+}
+
+bool parseBookNotification(const json &data, BookUpdate &update)
+{
+    update.clear();
+    if (!data.contains("instrument_name") || !data.contains("change_id"))
+        return false;
+    update.instrument = data["instrument_name"].get<std::string>();
+    update.changeId = data["change_id"].get<uint64_t>();
+    update.timestamp = data.value("timestamp", int64_t(0));
+    // Grouped channels carry no type and always send the full depth
+    update.snapshot = data.value("type", std::string("snapshot")) == "snapshot";
+    if (data.contains("prev_change_id"))
+        update.prevChangeId = data["prev_change_id"].get<uint64_t>();
+    return parseLevels(data.value("bids", json::array()), update.bids) &&
+           parseLevels(data.value("asks", json::array()), update.asks);
+}
+
+bool parseBookSnapshot(const json &result, BookUpdate &update)
+{
+    update.clear();
+    if (!result.contains("instrument_name") || !result.contains("change_id"))
+        return false;
+    update.instrument = result["instrument_name"].get<std::string>();
+    update.changeId = result["change_id"].get<uint64_t>();
+    update.timestamp = result.value("timestamp", int64_t(0));
+    update.snapshot = true;
+    return parseLevels(result.value("bids", json::array()), update.bids) &&
+           parseLevels(result.value("asks", json::array()), update.asks);
+}
+
+bool OrderBook::apply(const BookUpdate &update)
+{
+    if (update.snapshot)
+    {
+        reset();
+        hasSnapshot = true;
+    }
+    else if (!hasSnapshot || update.prevChangeId != lastChangeId)
+    {
+        return false;
+    }
+    applyLevels(update);
+    return true;
+}
+
+bool OrderBook::applyOverlapping(const BookUpdate &update)
+{
+    if (!hasSnapshot || update.prevChangeId > lastChangeId || update.changeId <= lastChangeId)
+    {
+        return false;
+    }
+    applyLevels(update);
+    return true;
+}
+
+void OrderBook::applyLevels(const BookUpdate &update)
+{
+    for (const auto &level : update.bids)
+        setLevel(bids, level, grid, std::less<int64_t>());
+    for (const auto &level : update.asks)
+        setLevel(asks, level, grid, std::greater<int64_t>());
+
+    lastChangeId = update.changeId;
+    lastTimestamp = update.timestamp;
+}
+
+void OrderBook::reset()
+{
+    bids.clear();
+    asks.clear();
+    lastChangeId = 0;
+    lastTimestamp = 0;
+    hasSnapshot = false;
+}
+
+const OrderBook *BookManager::onUpdate(uint32_t instrumentId, const BookUpdate &update)
+{
+    if (instrumentId >= entries.size())
+    {
+        entries.resize(instrumentId + 1);
+    }
+    Entry &entry = entries[instrumentId];
+    if (!entry.known)
+    {
+        entry.book = OrderBook(update.instrument, scaleLookup ? scaleLookup(update.instrument) : TickScale());
+        entry.known = true;
+    }
+
+    // A streamed snapshot (first message, or a grouped channel) always restores the book
+    if (update.snapshot)
+    {
+        entry.resyncing = false;
+        entry.bridging = false;
+        entry.buffered.clear();
+        entry.book.apply(update);
+        return &entry.book;
+    }
+
+    if (entry.resyncing)
+    {
+        // The snapshot is overdue or was lost, start over
+        if (entry.buffered.size() >= MaxBuffered)
+        {
+            entry.buffered.clear();
+            startResync(entry);
+        }
+        entry.buffered.push_back(update);
+        return nullptr;
+    }
+
+    if (entry.bridging && update.changeId <= entry.book.changeId())
+    {
+        // Already in the snapshot
+        return nullptr;
+    }
+    if (!applyDelta(entry, update))
+    {
+        gaps++;
+        entry.buffered.push_back(update);
+        startResync(entry);
+        return nullptr;
+    }
+    return &entry.book;
+}
+
+void BookManager::onSnapshot(uint32_t instrumentId, const BookUpdate &snapshot)
+{
+    if (instrumentId >= entries.size() || !entries[instrumentId].resyncing)
+        return;
+    Entry &entry = entries[instrumentId];
+
+    entry.book.apply(snapshot);
+    entry.bridging = true;
+    for (const auto &update : entry.buffered)
+    {
+        if (update.changeId <= entry.book.changeId())
+            continue;
+        if (!applyDelta(entry, update))
+        {
+            // The snapshot is older than what we buffered, ask again
+            startResync(entry);
+            return;
+        }
+    }
+    entry.buffered.clear();
+    entry.resyncing = false;
+}
+
+const OrderBook *BookManager::find(uint32_t instrumentId) const
+{
+    if (instrumentId >= entries.size())
+        return nullptr;
+    const Entry &entry = entries[instrumentId];
+    return entry.known && !entry.resyncing ? &entry.book : nullptr;
+}
+
+bool BookManager::applyDelta(Entry &entry, const BookUpdate &update)
+{
+    if (!entry.bridging)
+        return entry.book.apply(update);
+    // A REST snapshot's change_id can fall inside the interval of an
+    // aggregated channel's delta, which then does not continue from it
+    if (!entry.book.applyOverlapping(update))
+        return false;
+    entry.bridging = false;
+    return true;
+}
+
+void BookManager::startResync(Entry &entry)
+{
+    entry.resyncing = true;
+    entry.bridging = false;
+    entry.book.reset();
+    if (requestSnapshot)
+        requestSnapshot(entry.book.instrument());
+}
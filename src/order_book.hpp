@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "fixed_point.hpp"
+
+// A level on the book's integer grid; OrderBook::price and amount convert back
+struct PriceLevel
+{
+    int64_t ticks;
+    int64_t lots;
+};
+
+enum class BookAction : uint8_t
+{
+    New,
+    Change,
+    Delete
+};
+
+struct LevelUpdate
+{
+    BookAction action;
+    double price;
+    double amount;
+};
+
+// One book.* notification (or get_order_book result) in typed form
+struct BookUpdate
+{
+    std::string instrument;
+    bool snapshot = false;
+    uint64_t changeId = 0;
+    uint64_t prevChangeId = 0;
+    int64_t timestamp = 0;
+    std::vector<LevelUpdate> bids;
+    std::vector<LevelUpdate> asks;
+
+    // Keeps the vectors' capacity so a reused update does not allocate
+    void clear();
+};
+
+// Fills update from the "data" object of a book.* notification
+bool parseBookNotification(const nlohmann::json &data, BookUpdate &update);
+// Fills update from the "result" object of public/get_order_book
+bool parseBookSnapshot(const nlohmann::json &result, BookUpdate &update);
+
+// L2 book for one instrument. Each side is a flat sorted array with the best
+// level at the back, so top of book is O(1) and most updates, which land near
+// the top, only shift a few elements. Prices and amounts are kept as integer
+// ticks and lots, so finding a level is an exact comparison.
+class OrderBook
+{
+public:
+    explicit OrderBook(std::string instrument = "", const TickScale &scale = TickScale())
+        : name(std::move(instrument)), grid(scale) {}
+
+    // Applies a snapshot or delta. Returns false, leaving the book untouched,
+    // if a delta does not continue from the current change_id.
+    bool apply(const BookUpdate &update);
+    // Applies a delta whose interval contains the current change_id, i.e. the
+    // first one after a snapshot taken mid-interval on an aggregated channel.
+    // Level actions are absolute, so replaying what the snapshot has is harmless.
+    bool applyOverlapping(const BookUpdate &update);
+    void reset();
+
+    const std::string &instrument() const { return name; }
+    const TickScale &scale() const { return grid; }
+    double price(const PriceLevel &level) const { return grid.price(level.ticks); }
+    double amount(const PriceLevel &level) const { return grid.amount(level.lots); }
+    uint64_t changeId() const { return lastChangeId; }
+    int64_t timestamp() const { return lastTimestamp; }
+    bool valid() const { return hasSnapshot; }
+
+    const PriceLevel *bestBid() const { return bids.empty() ? nullptr : &bids.back(); }
+    const PriceLevel *bestAsk() const { return asks.empty() ? nullptr : &asks.back(); }
+
+    // Level i counted from the top of book, 0 being the best
+    const PriceLevel &bid(size_t i) const { return bids[bids.size() - 1 - i]; }
+    const PriceLevel &ask(size_t i) const { return asks[asks.size() - 1 - i]; }
+    size_t bidDepth() const { return bids.size(); }
+    size_t askDepth() const { return asks.size(); }
+
+private:
+    void applyLevels(const BookUpdate &update);
+
+    std::string name;
+    TickScale grid;
+    std::vector<PriceLevel> bids; // ascending, best bid at the back
+    std::vector<PriceLevel> asks; // descending, best ask at the back
+    uint64_t lastChangeId = 0;
+    int64_t lastTimestamp = 0;
+    bool hasSnapshot = false;
+};
+
+// Owns the local books and keeps them continuous. A change_id gap marks the
+// book as resyncing: deltas are buffered, a snapshot is requested through the
+// callback, and once it arrives the buffered deltas that follow it are replayed,
+// the first of them allowed to straddle the snapshot's change_id.
+// Books are indexed by the dense instrument ids of an InstrumentRegistry.
+class BookManager
+{
+public:
+    using SnapshotRequest = std::function<void(const std::string &instrument)>;
+    // Grid a new book is created with; books of instruments it does not know use the default
+    using ScaleLookup = std::function<TickScale(const std::string &instrument)>;
+
+    explicit BookManager(SnapshotRequest requestSnapshot) : requestSnapshot(std::move(requestSnapshot)) {}
+
+    // Set before the first update; books that already exist keep their grid
+    void setScaleLookup(ScaleLookup lookup) { scaleLookup = std::move(lookup); }
+
+    // Applies a streamed update. Returns the book, or nullptr while it is
+    // resyncing or if the update is older than the snapshot it resynced from.
+    const OrderBook *onUpdate(uint32_t instrumentId, const BookUpdate &update);
+    // Applies a snapshot fetched over REST after a gap
+    void onSnapshot(uint32_t instrumentId, const BookUpdate &snapshot);
+
+    const OrderBook *find(uint32_t instrumentId) const;
+    size_t size() const { return entries.size(); }
+    uint64_t gapCount() const { return gaps; }
+
+private:
+    // Deltas kept per book while waiting for a snapshot
+    static constexpr size_t MaxBuffered = 4096;
+
+    struct Entry
+    {
+        OrderBook book;
+        bool known = false; // an update has been seen for this id
+        bool resyncing = false;
+        bool bridging = false; // a REST snapshot was applied and no delta since
+        std::vector<BookUpdate> buffered;
+    };
+
+    bool applyDelta(Entry &entry, const BookUpdate &update);
+    void startResync(Entry &entry);
+
+    SnapshotRequest requestSnapshot;
+    ScaleLookup scaleLookup;
+    std::vector<Entry> entries;
+    uint64_t gaps = 0;
+};
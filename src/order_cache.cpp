@@ -0,0 +1,306 @@
+#include "order_cache.hpp"
+
+#include <algorithm>
+
+OrderCache::OrderCache() : slots(256, 0)
+{
+}
+
+void OrderCache::seed(const std::vector<OpenOrder> &orders, int64_t requestedUnixMs)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    // Open orders missing from the snapshot were closed while nobody listened
+    std::vector<bool> listed(pool.size(), false);
+    for (const OpenOrder &order : orders)
+    {
+        uint32_t record = findRecord(order.orderId, InstrumentRegistry::hash(order.orderId));
+        if (record != NoRecord)
+            listed[record] = true;
+    }
+    for (uint32_t record = 0; record < listed.size(); ++record)
+    {
+        if (pool[record].open && !listed[record] && pool[record].order.lastUpdate <= requestedUnixMs)
+        {
+            close(record);
+        }
+    }
+    for (const OpenOrder &order : orders)
+    {
+        uint64_t hash = InstrumentRegistry::hash(order.orderId);
+        uint32_t record = findRecord(order.orderId, hash);
+        if (record == NoRecord)
+        {
+            insertRecord(order, hash);
+        }
+        else if (pool[record].order.lastUpdate <= order.lastUpdate)
+        {
+            update(record, order);
+        }
+    }
+    isSeeded = true;
+}
+
+void OrderCache::invalidate()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    isSeeded = false;
+}
+
+bool OrderCache::seeded() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return isSeeded;
+}
+
+void OrderCache::onOrder(const OpenOrder &order)
+{
+    if (order.orderId.empty())
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t hash = InstrumentRegistry::hash(order.orderId);
+    uint32_t record = findRecord(order.orderId, hash);
+    if (record == NoRecord)
+    {
+        insertRecord(order, hash);
+    }
+    else if (pool[record].order.lastUpdate <= order.lastUpdate)
+    {
+        update(record, order);
+    }
+}
+
+// A fill newer than the order's last update; the next user.orders update carries the authoritative totals
+void OrderCache::onTrade(const OrderTrade &trade)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t record = findRecord(trade.orderId, InstrumentRegistry::hash(trade.orderId));
+    if (record == NoRecord || !pool[record].open || trade.timestamp <= pool[record].order.lastUpdate)
+    {
+        return;
+    }
+    OpenOrder &order = pool[record].order;
+    order.filledAmount += trade.amount;
+    order.lastUpdate = trade.timestamp;
+    if (!trade.orderState.empty())
+    {
+        order.orderState = trade.orderState;
+    }
+    if (isClosedOrderState(order.orderState) || order.filledAmount >= order.amount)
+    {
+        close(record);
+    }
+}
+
+bool OrderCache::find(std::string_view orderId, OpenOrder &order) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t record = findRecord(orderId, InstrumentRegistry::hash(orderId));
+    if (record == NoRecord || !pool[record].open)
+    {
+        return false;
+    }
+    order = pool[record].order;
+    return true;
+}
+
+bool OrderCache::isOpen(std::string_view orderId) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t record = findRecord(orderId, InstrumentRegistry::hash(orderId));
+    return record != NoRecord && pool[record].open;
+}
+
+std::vector<OpenOrder> OrderCache::openOrders() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<OpenOrder> orders;
+    orders.reserve(open);
+    for (const auto &records : byInstrument)
+    {
+        for (uint32_t record : records)
+        {
+            orders.push_back(pool[record].order);
+        }
+    }
+    return orders;
+}
+
+std::vector<OpenOrder> OrderCache::openOrders(std::string_view instrument) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<OpenOrder> orders;
+    uint32_t id = instruments.find(instrument);
+    if (id != InstrumentRegistry::NotFound)
+    {
+        for (uint32_t record : byInstrument[id])
+        {
+            orders.push_back(pool[record].order);
+        }
+    }
+    return orders;
+}
+
+size_t OrderCache::openCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return open;
+}
+
+uint32_t OrderCache::findRecord(std::string_view orderId, uint64_t hash) const
+{
+    const size_t mask = slots.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        uint32_t slot = slots[i];
+        if (slot == 0)
+            return NoRecord;
+        const Record &r = pool[slot - 1];
+        if (r.hash == hash && r.order.orderId == orderId)
+            return slot - 1;
+    }
+}
+
+uint32_t OrderCache::insertRecord(const OpenOrder &order, uint64_t hash)
+{
+    // Keep the table at most half full so probe sequences stay short
+    if ((used + 1) * 2 > slots.size())
+        grow();
+
+    uint32_t record;
+    if (!freeRecords.empty())
+    {
+        record = freeRecords.back();
+        freeRecords.pop_back();
+    }
+    else
+    {
+        record = (uint32_t)pool.size();
+        pool.emplace_back();
+    }
+    Record &r = pool[record];
+    r.hash = hash;
+    r.order.orderId = order.orderId;
+    r.instrumentId = NoRecord;
+    r.open = false;
+
+    const size_t mask = slots.size() - 1;
+    size_t i = hash & mask;
+    while (slots[i] != 0)
+        i = (i + 1) & mask;
+    slots[i] = record + 1;
+    ++used;
+
+    update(record, order);
+    return record;
+}
+
+// Linear probing delete: entries after the hole move back if the hole is on their probe path
+void OrderCache::eraseRecord(uint32_t record)
+{
+    const size_t mask = slots.size() - 1;
+    size_t hole = pool[record].hash & mask;
+    while (slots[hole] != record + 1)
+        hole = (hole + 1) & mask;
+    slots[hole] = 0;
+    for (size_t i = (hole + 1) & mask; slots[i] != 0; i = (i + 1) & mask)
+    {
+        size_t home = pool[slots[i] - 1].hash & mask;
+        // Moves back unless its home lies cyclically in (hole, i]
+        if (hole <= i ? (home <= hole || home > i) : (home <= hole && home > i))
+        {
+            slots[hole] = slots[i];
+            slots[i] = 0;
+            hole = i;
+        }
+    }
+    --used;
+    freeRecords.push_back(record);
+}
+
+void OrderCache::update(uint32_t record, const OpenOrder &order)
+{
+    Record &r = pool[record];
+    bool wasOpen = r.open;
+    // Assigned field by field so the record's strings keep their capacity
+    r.order.instrument = order.instrument;
+    r.order.direction = order.direction;
+    r.order.orderState = order.orderState;
+    r.order.price = order.price;
+    r.order.amount = order.amount;
+    r.order.filledAmount = order.filledAmount;
+    r.order.lastUpdate = order.lastUpdate;
+
+    if (isClosedOrderState(order.orderState))
+    {
+        if (wasOpen)
+        {
+            close(record);
+        }
+        else if (r.instrumentId == NoRecord)
+        {
+            // First seen already closed
+            r.instrumentId = instruments.intern(order.instrument);
+            closed.push_back(record);
+        }
+        return;
+    }
+    if (wasOpen)
+    {
+        return;
+    }
+    // Opening, or reopened by a newer update than the one that closed it
+    if (r.instrumentId != NoRecord)
+    {
+        auto it = std::find(closed.begin(), closed.end(), record);
+        if (it != closed.end())
+            closed.erase(it);
+    }
+    r.instrumentId = instruments.intern(order.instrument);
+    if (r.instrumentId >= byInstrument.size())
+        byInstrument.resize(r.instrumentId + 1);
+    auto &records = byInstrument[r.instrumentId];
+    r.instrumentSlot = (uint32_t)records.size();
+    records.push_back(record);
+    r.open = true;
+    ++open;
+}
+
+void OrderCache::close(uint32_t record)
+{
+    Record &r = pool[record];
+    if (r.open)
+    {
+        auto &records = byInstrument[r.instrumentId];
+        uint32_t last = records.back();
+        records[r.instrumentSlot] = last;
+        pool[last].instrumentSlot = r.instrumentSlot;
+        records.pop_back();
+        r.open = false;
+        --open;
+    }
+    closed.push_back(record);
+    while (closed.size() > MaxClosed)
+    {
+        uint32_t oldest = closed.front();
+        closed.pop_front();
+        eraseRecord(oldest);
+    }
+}
+
+void OrderCache::grow()
+{
+    std::vector<uint32_t> larger(slots.size() * 2, 0);
+    const size_t mask = larger.size() - 1;
+    for (uint32_t slot : slots)
+    {
+        if (slot == 0)
+            continue;
+        size_t i = pool[slot - 1].hash & mask;
+        while (larger[i] != 0)
+            i = (i + 1) & mask;
+        larger[i] = slot;
+    }
+    slots.swap(larger);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "instrument_registry.hpp"
+#include "order_messages.hpp"
+
+// Local copy of the account's orders, seeded once from private/get_open_orders
+// and kept current from the user.orders.* and user.trades.* channels, so open
+// order queries and the checks before an edit or cancel are memory reads.
+//
+// Orders live in a pool of records reused through a free list. They are found
+// by order id through an open-addressing table of record indexes, and listed
+// per instrument through a per-instrument-id index. Closed orders stay for a
+// while as tombstones so a stale snapshot or a late update cannot reopen them.
+// Every update carries the exchange's last update time and an older one never
+// overwrites a newer one. Thread safe: updated on the processing thread and
+// read from any other.
+class OrderCache
+{
+public:
+    // Closed orders remembered before the oldest is forgotten
+    static constexpr size_t MaxClosed = 1024;
+
+    OrderCache();
+
+    // Applies a private/get_open_orders result requested at requestedUnixMs.
+    // Orders the snapshot no longer lists are closed unless the stream has
+    // updated them since.
+    void seed(const std::vector<OpenOrder> &orders, int64_t requestedUnixMs);
+    // Forgets that the cache was seeded, e.g. when the stream feeding it stops
+    void invalidate();
+    bool seeded() const;
+
+    void onOrder(const OpenOrder &order);
+    void onTrade(const OrderTrade &trade);
+
+    // Open orders only
+    bool find(std::string_view orderId, OpenOrder &order) const;
+    bool isOpen(std::string_view orderId) const;
+    std::vector<OpenOrder> openOrders() const;
+    std::vector<OpenOrder> openOrders(std::string_view instrument) const;
+    size_t openCount() const;
+
+private:
+    static constexpr uint32_t NoRecord = UINT32_MAX;
+
+    struct Record
+    {
+        OpenOrder order;
+        uint64_t hash = 0;
+        uint32_t instrumentId = NoRecord;
+        uint32_t instrumentSlot = 0; // position in byInstrument[instrumentId] while open
+        bool open = false;
+    };
+
+    uint32_t findRecord(std::string_view orderId, uint64_t hash) const;
+    uint32_t insertRecord(const OpenOrder &order, uint64_t hash);
+    void eraseRecord(uint32_t record);
+    void update(uint32_t record, const OpenOrder &order);
+    void close(uint32_t record);
+    void grow();
+
+    mutable std::mutex mutex;
+    std::vector<Record> pool;
+    std::vector<uint32_t> freeRecords;
+    std::vector<uint32_t> slots; // record index + 1, 0 marks an empty slot
+    size_t used = 0;
+    InstrumentRegistry instruments;
+    std::vector<std::vector<uint32_t>> byInstrument; // open records per instrument id
+    std::deque<uint32_t> closed;                     // tombstones, oldest first
+    size_t open = 0;
+    bool isSeeded = false;
+};
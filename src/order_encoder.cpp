@@ -0,0 +1,212 @@
+#include "order_encoder.hpp"
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace
+{
+    // Longest output of the number writers below
+    constexpr size_t MaxNumber = 48;
+
+    char *appendBytes(char *out, std::string_view bytes)
+    {
+        std::memcpy(out, bytes.data(), bytes.size());
+        return out + bytes.size();
+    }
+
+    char *appendUint(char *out, uint64_t value)
+    {
+        return std::to_chars(out, out + MaxNumber, value).ptr;
+    }
+
+    // nlohmann::json writes doubles with its own Grisu2 to_chars, whose digits
+    // differ from std::to_chars' shortest form for a small share of values, so
+    // the same routine is used here to keep the bytes identical. It does not
+    // allocate either.
+    char *appendDouble(char *out, double value)
+    {
+        if (!std::isfinite(value))
+        {
+            return appendBytes(out, "null");
+        }
+        return nlohmann::detail::to_chars(out, out + MaxNumber, value);
+    }
+
+    // JSON string with the same escapes as nlohmann::json::dump()
+    char *appendString(char *out, std::string_view text)
+    {
+        static constexpr char hex[] = "0123456789abcdef";
+        *out++ = '"';
+        for (unsigned char c : text)
+        {
+            switch (c)
+            {
+            case '"':
+                out = appendBytes(out, "\\\"");
+                break;
+            case '\\':
+                out = appendBytes(out, "\\\\");
+                break;
+            case '\b':
+                out = appendBytes(out, "\\b");
+                break;
+            case '\t':
+                out = appendBytes(out, "\\t");
+                break;
+            case '\n':
+                out = appendBytes(out, "\\n");
+                break;
+            case '\f':
+                out = appendBytes(out, "\\f");
+                break;
+            case '\r':
+                out = appendBytes(out, "\\r");
+                break;
+            default:
+                if (c < 0x20)
+                {
+                    out = appendBytes(out, "\\u00");
+                    *out++ = hex[c >> 4];
+                    *out++ = hex[c & 0xf];
+                }
+                else
+                {
+                    *out++ = (char)c;
+                }
+            }
+        }
+        *out++ = '"';
+        return out;
+    }
+
+    // Worst case for appendString: every byte becomes \u00XX
+    size_t maxStringSize(std::string_view text)
+    {
+        return text.size() * 6 + 2;
+    }
+
+    constexpr std::string_view IdPrefix = "{\"id\":";
+    constexpr std::string_view EditAfterId = ",\"jsonrpc\":\"2.0\",\"method\":\"private/edit\",\"params\":{\"amount\":";
+    constexpr std::string_view EditAfterAmount = ",\"order_id\":";
+    constexpr std::string_view EditAfterOrderId = ",\"price\":";
+    constexpr std::string_view CancelAfterId = ",\"jsonrpc\":\"2.0\",\"method\":\"private/cancel\",\"params\":{\"order_id\":";
+    constexpr std::string_view Close = "}}";
+}
+
+OrderEncoder::OrderEncoder()
+{
+    buffer.resize(512);
+}
+
+char *OrderEncoder::reserve(size_t size)
+{
+    if (buffer.size() < size)
+    {
+        buffer.resize(size);
+    }
+    return &buffer[0];
+}
+
+const OrderEncoder::Template &OrderEncoder::orderTemplate(std::string_view instrument, Side side, Type type)
+{
+    uint32_t id = instruments.find(instrument);
+    if (id == InstrumentRegistry::NotFound)
+    {
+        id = instruments.intern(instrument);
+        templates.resize(instruments.size());
+    }
+    Template &t = templates[id][(size_t)side * 2 + (size_t)type];
+    if (!t.built)
+    {
+        // Rendered by nlohmann once, so names are escaped exactly as dump() does
+        const std::string method = side == Side::Buy ? "private/buy" : "private/sell";
+        const std::string name = json(std::string(instrument)).dump();
+        t.afterId = ",\"jsonrpc\":\"2.0\",\"method\":" + json(method).dump() + ",\"params\":{\"amount\":";
+        if (type == Type::Limit)
+        {
+            t.afterAmount = ",\"instrument_name\":" + name + ",\"price\":";
+            t.afterPrice = ",\"type\":\"limit\"}}";
+        }
+        else
+        {
+            t.afterAmount = ",\"instrument_name\":" + name + ",\"type\":\"market\"}}";
+        }
+        t.built = true;
+    }
+    return t;
+}
+
+template <typename WriteNumber>
+std::string_view OrderEncoder::writeOrder(uint64_t id, std::string_view instrument, Side side, Type type, WriteNumber writeNumber)
+{
+    const Template &t = orderTemplate(instrument, side, type);
+    char *start = reserve(IdPrefix.size() + t.afterId.size() + t.afterAmount.size() + t.afterPrice.size() + 3 * MaxNumber);
+    char *out = appendBytes(start, IdPrefix);
+    out = appendUint(out, id);
+    out = appendBytes(out, t.afterId);
+    out = writeNumber(out, false);
+    out = appendBytes(out, t.afterAmount);
+    if (type == Type::Limit)
+    {
+        out = writeNumber(out, true);
+        out = appendBytes(out, t.afterPrice);
+    }
+    return std::string_view(start, out - start);
+}
+
+template <typename WriteNumber>
+std::string_view OrderEncoder::writeEdit(uint64_t id, std::string_view orderId, WriteNumber writeNumber)
+{
+    char *start = reserve(IdPrefix.size() + EditAfterId.size() + EditAfterAmount.size() + EditAfterOrderId.size() +
+                          Close.size() + maxStringSize(orderId) + 3 * MaxNumber);
+    char *out = appendBytes(start, IdPrefix);
+    out = appendUint(out, id);
+    out = appendBytes(out, EditAfterId);
+    out = writeNumber(out, false);
+    out = appendBytes(out, EditAfterAmount);
+    out = appendString(out, orderId);
+    out = appendBytes(out, EditAfterOrderId);
+    out = writeNumber(out, true);
+    out = appendBytes(out, Close);
+    return std::string_view(start, out - start);
+}
+
+std::string_view OrderEncoder::encodeOrder(uint64_t id, std::string_view instrument, Side side, Type type, double price, double amount)
+{
+    return writeOrder(id, instrument, side, type, [&](char *out, bool isPrice)
+                      { return appendDouble(out, isPrice ? price : amount); });
+}
+
+std::string_view OrderEncoder::encodeOrder(uint64_t id, std::string_view instrument, Side side, Type type, const TickScale &scale,
+                                           int64_t priceTicks, int64_t amountLots)
+{
+    return writeOrder(id, instrument, side, type, [&](char *out, bool isPrice)
+                      { return isPrice ? scale.tick.write(out, priceTicks) : scale.lot.write(out, amountLots); });
+}
+
+std::string_view OrderEncoder::encodeEdit(uint64_t id, std::string_view orderId, double price, double amount)
+{
+    return writeEdit(id, orderId, [&](char *out, bool isPrice)
+                     { return appendDouble(out, isPrice ? price : amount); });
+}
+
+std::string_view OrderEncoder::encodeEdit(uint64_t id, std::string_view orderId, const TickScale &scale, int64_t priceTicks, int64_t amountLots)
+{
+    return writeEdit(id, orderId, [&](char *out, bool isPrice)
+                     { return isPrice ? scale.tick.write(out, priceTicks) : scale.lot.write(out, amountLots); });
+}
+
+std::string_view OrderEncoder::encodeCancel(uint64_t id, std::string_view orderId)
+{
+    char *start = reserve(IdPrefix.size() + CancelAfterId.size() + Close.size() + maxStringSize(orderId) + MaxNumber);
+    char *out = appendBytes(start, IdPrefix);
+    out = appendUint(out, id);
+    out = appendBytes(out, CancelAfterId);
+    out = appendString(out, orderId);
+    out = appendBytes(out, Close);
+    return std::string_view(start, out - start);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "fixed_point.hpp"
+#include "instrument_registry.hpp"
+
+// Order request bodies written straight into a reused buffer. The constant
+// bytes of each (instrument, side, type) are rendered once into a template and
+// only the id, price and amount are formatted per order, so encoding does not
+// allocate once the templates and buffer exist. The output is byte-identical
+// to makeRpcRequest(...).dump() with the matching *Params(), which is what the
+// exchange saw before. One encoder per thread: the returned view points into
+// the encoder's buffer and stays valid until the next encode call.
+class OrderEncoder
+{
+public:
+    enum class Side : uint8_t
+    {
+        Buy,
+        Sell
+    };
+    enum class Type : uint8_t
+    {
+        Limit,
+        Market // no price field
+    };
+
+    OrderEncoder();
+
+    // private/buy or private/sell
+    std::string_view encodeOrder(uint64_t id, std::string_view instrument, Side side, Type type, double price, double amount);
+    // Same with the price in ticks and the amount in lots of scale, written as
+    // exact decimals instead of through a double
+    std::string_view encodeOrder(uint64_t id, std::string_view instrument, Side side, Type type, const TickScale &scale,
+                                 int64_t priceTicks, int64_t amountLots);
+    // private/edit
+    std::string_view encodeEdit(uint64_t id, std::string_view orderId, double price, double amount);
+    std::string_view encodeEdit(uint64_t id, std::string_view orderId, const TickScale &scale, int64_t priceTicks, int64_t amountLots);
+    // private/cancel
+    std::string_view encodeCancel(uint64_t id, std::string_view orderId);
+
+private:
+    // Bytes between the patched fields, in the key order nlohmann::json writes
+    struct Template
+    {
+        bool built = false;
+        std::string afterId;     // ,"jsonrpc":"2.0","method":...,"params":{"amount":
+        std::string afterAmount; // ,"instrument_name":"...","price":   (market: through the end)
+        std::string afterPrice;  // ,"type":"limit"}}                   (market: empty)
+    };
+
+    const Template &orderTemplate(std::string_view instrument, Side side, Type type);
+    // Writes the body with writeNumber(out, isPrice) filling in each number
+    template <typename WriteNumber>
+    std::string_view writeOrder(uint64_t id, std::string_view instrument, Side side, Type type, WriteNumber writeNumber);
+    template <typename WriteNumber>
+    std::string_view writeEdit(uint64_t id, std::string_view orderId, WriteNumber writeNumber);
+    char *reserve(size_t size);
+
+    InstrumentRegistry instruments;
+    std::vector<std::array<Template, 4>> templates; // per instrument id, indexed by side * 2 + type
+    std::string buffer;
+};
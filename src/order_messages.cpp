@@ -0,0 +1,150 @@
+#include "order_messages.hpp"
+
+using json = nlohmann::json;
+
+namespace
+{
+    double numberOr(const json &object, const char *key, double fallback)
+    {
+        auto it = object.find(key);
+        return it != object.end() && it->is_number() ? it->get<double>() : fallback;
+    }
+
+    std::string stringOr(const json &object, const char *key)
+    {
+        auto it = object.find(key);
+        return it != object.end() && it->is_string() ? it->get<std::string>() : std::string();
+    }
+
+    OpenOrder parseOrder(const json &order)
+    {
+        OpenOrder parsed;
+        parsed.orderId = stringOr(order, "order_id");
+        parsed.instrument = stringOr(order, "instrument_name");
+        parsed.direction = stringOr(order, "direction");
+        parsed.orderState = stringOr(order, "order_state");
+        // Market orders report "market_price" instead of a number
+        parsed.price = numberOr(order, "price", 0);
+        parsed.amount = numberOr(order, "amount", 0);
+        parsed.filledAmount = numberOr(order, "filled_amount", 0);
+        parsed.lastUpdate = (int64_t)numberOr(order, "last_update_timestamp", 0);
+        return parsed;
+    }
+
+    // Calls parse on the object, or on each element of the array, in data
+    template <typename Parse>
+    bool forEachObject(std::string_view data, Parse parse)
+    {
+        json parsed = json::parse(data.begin(), data.end(), nullptr, false);
+        if (parsed.is_object())
+        {
+            parse(parsed);
+            return true;
+        }
+        if (!parsed.is_array())
+        {
+            return false;
+        }
+        for (const auto &object : parsed)
+        {
+            if (object.is_object())
+            {
+                parse(object);
+            }
+        }
+        return true;
+    }
+}
+
+json makeRpcRequest(uint64_t id, const std::string &method, const json &params)
+{
+    return {
+        {"jsonrpc", "2.0"},
+        {"method", method},
+        {"params", params},
+        {"id", id}};
+}
+
+json buyParams(const std::string &instrument, double price, double amount)
+{
+    return {
+        {"instrument_name", instrument},
+        {"type", "limit"},
+        {"price", price},
+        {"amount", amount}};
+}
+
+json editParams(const std::string &orderId, double price, double amount)
+{
+    return {{"order_id", orderId}, {"price", price}, {"amount", amount}};
+}
+
+json cancelParams(const std::string &orderId)
+{
+    return {{"order_id", orderId}};
+}
+
+bool parseOpenOrders(std::string_view response, std::vector<OpenOrder> &orders, std::string &error)
+{
+    orders.clear();
+    json responseJson = json::parse(response.begin(), response.end(), nullptr, false);
+    if (responseJson.is_discarded())
+    {
+        error = "malformed response";
+        return false;
+    }
+    auto result = responseJson.find("result");
+    if (result == responseJson.end() || !result->is_array())
+    {
+        error = responseJson.contains("error") ? responseJson["error"].dump() : responseJson.dump();
+        return false;
+    }
+
+    orders.reserve(result->size());
+    for (const auto &order : *result)
+    {
+        orders.push_back(parseOrder(order));
+    }
+    return true;
+}
+
+bool parseOrderUpdates(std::string_view data, std::vector<OpenOrder> &orders)
+{
+    orders.clear();
+    return forEachObject(data, [&](const json &order)
+                         { orders.push_back(parseOrder(order)); });
+}
+
+bool parseOrderResponse(const json &response, OpenOrder &order)
+{
+    auto result = response.find("result");
+    if (result == response.end() || !result->is_object())
+    {
+        return false;
+    }
+    auto placed = result->find("order");
+    if (placed == result->end() || !placed->is_object())
+    {
+        return false;
+    }
+    order = parseOrder(*placed);
+    return !order.orderId.empty();
+}
+
+bool parseOrderTrades(std::string_view data, std::vector<OrderTrade> &trades)
+{
+    trades.clear();
+    return forEachObject(data, [&](const json &trade)
+                         {
+        OrderTrade parsed;
+        parsed.orderId = stringOr(trade, "order_id");
+        parsed.orderState = stringOr(trade, "state");
+        parsed.amount = numberOr(trade, "amount", 0);
+        parsed.timestamp = (int64_t)numberOr(trade, "timestamp", 0);
+        trades.push_back(std::move(parsed)); });
+}
+
+bool isClosedOrderState(std::string_view orderState)
+{
+    return orderState == "filled" || orderState == "cancelled" || orderState == "rejected";
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// JSON-RPC request bodies for order entry and parsing of order responses,
+// shared by the REST and WebSocket paths.
+
+// {"jsonrpc":"2.0","method":...,"params":...,"id":...}
+nlohmann::json makeRpcRequest(uint64_t id, const std::string &method, const nlohmann::json &params);
+
+nlohmann::json buyParams(const std::string &instrument, double price, double amount);
+nlohmann::json editParams(const std::string &orderId, double price, double amount);
+nlohmann::json cancelParams(const std::string &orderId);
+
+// One entry of a private/get_open_orders result
+struct OpenOrder
+{
+    std::string orderId;
+    std::string instrument;
+    std::string direction;
+    std::string orderState;
+    double price = 0;
+    double amount = 0;
+    double filledAmount = 0;
+    int64_t lastUpdate = 0; // last_update_timestamp, ms
+};
+
+// One fill from a user.trades.* notification
+struct OrderTrade
+{
+    std::string orderId;
+    std::string orderState; // state of the order after the fill
+    double amount = 0;
+    int64_t timestamp = 0; // ms
+};
+
+// Fills orders from a private/get_open_orders response. Returns false, with
+// error set to the server's error object or the parse failure, otherwise.
+bool parseOpenOrders(std::string_view response, std::vector<OpenOrder> &orders, std::string &error);
+// Fills order from a successful private/buy, private/sell or private/edit
+// response, {"result": {"order": {...}, "trades": [...]}}; false for anything else
+bool parseOrderResponse(const nlohmann::json &response, OpenOrder &order);
+// Fills orders or trades from the data of a user.orders.* or user.trades.*
+// notification, which holds one object or an array of them
+bool parseOrderUpdates(std::string_view data, std::vector<OpenOrder> &orders);
+bool parseOrderTrades(std::string_view data, std::vector<OrderTrade> &trades);
+// Whether an order in this order_state can no longer trade
+bool isClosedOrderState(std::string_view orderState);
@@ -0,0 +1,348 @@
+#include "rate_limiter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "latency_histogram.hpp"
+
+namespace
+{
+    constexpr std::string_view PrivatePrefix = "private/";
+
+    size_t index(RequestKind kind)
+    {
+        return static_cast<size_t>(kind);
+    }
+
+    size_t index(CreditPool pool)
+    {
+        return static_cast<size_t>(pool);
+    }
+}
+
+RequestKind classifyRequest(std::string_view method)
+{
+    if (method.compare(0, PrivatePrefix.size(), PrivatePrefix) != 0)
+    {
+        return RequestKind::Query;
+    }
+    method.remove_prefix(PrivatePrefix.size());
+    // Not cancel_withdrawal or cancel_transfer_by_id, which are not orders
+    if (method == "cancel" || method.compare(0, 10, "cancel_all") == 0 || method == "cancel_by_label" ||
+        method == "cancel_quotes")
+    {
+        return RequestKind::Cancel;
+    }
+    if (method == "buy" || method == "sell" || method == "edit" || method == "edit_by_label" ||
+        method == "close_position" || method == "mass_quote")
+    {
+        return RequestKind::Order;
+    }
+    return RequestKind::Query;
+}
+
+RateLimiter::RateLimiter(const RateLimitConfig &config) : config(config)
+{
+    const int64_t now = steadyNanos();
+    buckets[index(CreditPool::Matching)] = {config.matching, config.matching.capacity, now};
+    buckets[index(CreditPool::NonMatching)] = {config.nonMatching, config.nonMatching.capacity, now};
+    if (config.enabled)
+    {
+        dispatcher = std::thread(&RateLimiter::dispatchLoop, this);
+    }
+}
+
+RateLimiter::~RateLimiter()
+{
+    stop();
+}
+
+double RateLimiter::creditsAt(const Bucket &bucket, int64_t now)
+{
+    double refilled = bucket.credits + double(now - bucket.refilledAt) * bucket.config.refillPerSecond / 1e9;
+    return std::min(refilled, bucket.config.capacity);
+}
+
+void RateLimiter::refill(Bucket &bucket, int64_t now)
+{
+    bucket.credits = creditsAt(bucket, now);
+    bucket.refilledAt = now;
+}
+
+double RateLimiter::needed(RequestKind kind) const
+{
+    const CreditPoolConfig &pool = buckets[index(poolOf(kind))].config;
+    if (kind != RequestKind::Order)
+    {
+        return pool.cost;
+    }
+    // A reserve the pool cannot hold beside an order would refuse every order
+    double reserve = std::max(0.0, std::min(config.cancelReserve, pool.capacity - pool.cost));
+    return pool.cost + reserve;
+}
+
+size_t RateLimiter::queuedAhead(RequestKind kind) const
+{
+    switch (kind)
+    {
+    case RequestKind::Order:
+        return queues[index(RequestKind::Cancel)].size() + queues[index(RequestKind::Order)].size();
+    default:
+        return queues[index(kind)].size();
+    }
+}
+
+bool RateLimiter::tryAcquire(RequestKind kind)
+{
+    if (!config.enabled)
+    {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (stopped)
+    {
+        return false;
+    }
+    Bucket &bucket = buckets[index(poolOf(kind))];
+    refill(bucket, steadyNanos());
+    if (queuedAhead(kind) > 0 || bucket.credits < needed(kind))
+    {
+        return false;
+    }
+    bucket.credits -= bucket.config.cost;
+    ++counters.sent;
+    return true;
+}
+
+void RateLimiter::enqueue(RequestKind kind, Send send, Reject reject)
+{
+    if (!config.enabled)
+    {
+        send();
+        return;
+    }
+    bool charged = false;
+    std::string reason;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const int64_t now = steadyNanos();
+        Bucket &bucket = buckets[index(poolOf(kind))];
+        refill(bucket, now);
+        const size_t ahead = queuedAhead(kind);
+        const double need = needed(kind);
+        if (stopped)
+        {
+            reason = "rate limiter stopped";
+        }
+        else if (ahead == 0 && bucket.credits >= need)
+        {
+            // Credit came back since the caller's tryAcquire
+            bucket.credits -= bucket.config.cost;
+            ++counters.sent;
+            charged = true;
+        }
+        else if (need > bucket.config.capacity || bucket.config.refillPerSecond <= 0)
+        {
+            reason = "too_many_requests: the request costs more credit than the pool can hold";
+        }
+        else if (queues[index(kind)].size() >= config.maxQueued)
+        {
+            reason = "too_many_requests: request queue is full";
+        }
+        else
+        {
+            // Everything ahead of it is charged first
+            double deficit = double(ahead) * bucket.config.cost + need - bucket.credits;
+            int64_t waitNs = static_cast<int64_t>(std::ceil(deficit / bucket.config.refillPerSecond * 1e9));
+            int64_t maxDelayNs = std::chrono::duration_cast<std::chrono::nanoseconds>(config.maxDelay).count();
+            if (waitNs > maxDelayNs)
+            {
+                reason = "too_many_requests: would wait " + std::to_string(waitNs / 1000000) + " ms for request credit";
+            }
+            else
+            {
+                queues[index(kind)].push_back({std::move(send), std::move(reject), now + maxDelayNs});
+            }
+        }
+        if (!reason.empty())
+        {
+            ++counters.rejected;
+        }
+    }
+    if (charged)
+    {
+        send();
+    }
+    else if (!reason.empty())
+    {
+        reject(reason);
+    }
+    else
+    {
+        wake.notify_one();
+    }
+}
+
+bool RateLimiter::acquire(RequestKind kind, std::string &reason)
+{
+    if (tryAcquire(kind))
+    {
+        return true;
+    }
+    // Empty once charged, the reason if refused
+    auto outcome = std::make_shared<std::promise<std::string>>();
+    std::future<std::string> result = outcome->get_future();
+    enqueue(kind, [outcome]
+            { outcome->set_value(std::string()); },
+            [outcome](const std::string &why)
+            { outcome->set_value(why); });
+    reason = result.get();
+    return reason.empty();
+}
+
+void RateLimiter::throttled(RequestKind kind)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Bucket &bucket = buckets[index(poolOf(kind))];
+    refill(bucket, steadyNanos());
+    bucket.credits = std::min(bucket.credits, 0.0);
+    ++counters.throttled;
+}
+
+double RateLimiter::credits(CreditPool pool) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return creditsAt(buckets[index(pool)], steadyNanos());
+}
+
+uint32_t RateLimiter::headroom(RequestKind kind) const
+{
+    if (!config.enabled)
+    {
+        return std::numeric_limits<uint32_t>::max();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    const Bucket &bucket = buckets[index(poolOf(kind))];
+    double available = creditsAt(bucket, steadyNanos()) - (needed(kind) - bucket.config.cost);
+    if (stopped || queuedAhead(kind) > 0 || available < bucket.config.cost)
+    {
+        return 0;
+    }
+    return static_cast<uint32_t>(available / bucket.config.cost);
+}
+
+const CreditPoolConfig &RateLimiter::pool(CreditPool pool) const
+{
+    return buckets[index(pool)].config;
+}
+
+RateLimiter::Stats RateLimiter::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats stats = counters;
+    for (const auto &queue : queues)
+    {
+        stats.queued += queue.size();
+    }
+    return stats;
+}
+
+void RateLimiter::stop()
+{
+    std::vector<Waiting> refused;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+        for (auto &queue : queues)
+        {
+            counters.rejected += queue.size();
+            std::move(queue.begin(), queue.end(), std::back_inserter(refused));
+            queue.clear();
+        }
+    }
+    wake.notify_one();
+    if (dispatcher.joinable())
+    {
+        dispatcher.join();
+    }
+    for (Waiting &waiting : refused)
+    {
+        waiting.reject("rate limiter stopped");
+    }
+}
+
+void RateLimiter::dispatchLoop()
+{
+    // Charged or refused under the lock, called outside it
+    std::vector<Send> ready;
+    std::vector<Reject> expired;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopped)
+    {
+        const int64_t now = steadyNanos();
+        int64_t wakeAt = std::numeric_limits<int64_t>::max();
+        // Cancels before orders, which share their pool
+        for (RequestKind kind : {RequestKind::Cancel, RequestKind::Order, RequestKind::Query})
+        {
+            std::deque<Waiting> &queue = queues[index(kind)];
+            Bucket &bucket = buckets[index(poolOf(kind))];
+            refill(bucket, now);
+            while (!queue.empty())
+            {
+                if (kind == RequestKind::Order && !queues[index(RequestKind::Cancel)].empty())
+                {
+                    break;
+                }
+                Waiting &head = queue.front();
+                if (head.deadline <= now)
+                {
+                    expired.push_back(std::move(head.reject));
+                    queue.pop_front();
+                    ++counters.rejected;
+                    continue;
+                }
+                const double need = needed(kind);
+                if (bucket.credits >= need)
+                {
+                    bucket.credits -= bucket.config.cost;
+                    ready.push_back(std::move(head.send));
+                    queue.pop_front();
+                    ++counters.delayed;
+                    continue;
+                }
+                int64_t refillNs = static_cast<int64_t>(std::ceil((need - bucket.credits) / bucket.config.refillPerSecond * 1e9));
+                wakeAt = std::min({wakeAt, now + refillNs, head.deadline});
+                break;
+            }
+        }
+        if (!ready.empty() || !expired.empty())
+        {
+            lock.unlock();
+            for (Send &send : ready)
+            {
+                send();
+            }
+            for (Reject &reject : expired)
+            {
+                reject("too_many_requests: waited too long for request credit");
+            }
+            ready.clear();
+            expired.clear();
+            lock.lock();
+            continue;
+        }
+        if (wakeAt == std::numeric_limits<int64_t>::max())
+        {
+            wake.wait(lock);
+        }
+        else
+        {
+            wake.wait_for(lock, std::chrono::nanoseconds(wakeAt - now));
+        }
+    }
+}
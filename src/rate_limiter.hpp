@@ -0,0 +1,151 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Deribit charges every request against one of two credit pools per
+// account: matching engine requests (orders, edits, cancels) against one,
+// everything else against the other. A pool refills continuously up to its
+// cap, and a request it cannot cover is refused with too_many_requests.
+enum class CreditPool
+{
+    Matching,
+    NonMatching,
+    Count
+};
+
+// What a request is, as far as credits and priority go
+enum class RequestKind
+{
+    Query,  // non-matching: market data, account queries, auth, subscriptions
+    Order,  // matching: buy, sell, edit, close_position
+    Cancel, // matching, and ahead of every queued Order
+    Count
+};
+
+struct CreditPoolConfig
+{
+    double capacity = 0;        // credits when full, i.e. the burst
+    double refillPerSecond = 0; // credits added back per second, i.e. the sustained rate
+    double cost = 0;            // credits one request spends
+};
+
+struct RateLimitConfig
+{
+    bool enabled = true;
+    // Deribit's limits for the lowest volume tier: 5 orders/s with bursts of
+    // 20. Higher tiers get more; set these to the account's.
+    CreditPoolConfig matching{20000, 5000, 1000};
+    // 20 requests/s with bursts of 100
+    CreditPoolConfig nonMatching{50000, 10000, 500};
+    // Matching credit only cancels may spend, so pulling quotes never waits
+    // behind a burst of new orders. Capped at what the pool holds beyond one order.
+    double cancelReserve = 1000;
+    size_t maxQueued = 256; // per kind; more are refused
+    // Requests expected to wait longer for credit are refused at once, and
+    // queued ones still waiting after this long are refused then
+    std::chrono::milliseconds maxDelay{1000};
+};
+
+// The kind of a JSON-RPC method, e.g. "private/cancel" is a Cancel
+RequestKind classifyRequest(std::string_view method);
+
+// Local model of the exchange's credit pools, so requests are paced here
+// instead of being refused there. A request that its pool can cover now is
+// charged and goes out at once; otherwise it waits in its kind's queue and
+// goes out from the limiter's thread as credit refills, cancels first, or is
+// refused if it could not go within maxDelay. Admission and refusal take
+// constant time. Credits are refilled lazily from the elapsed time.
+class RateLimiter
+{
+public:
+    using Send = std::function<void()>;
+    using Reject = std::function<void(const std::string &reason)>;
+
+    // Deribit's error code for a request refused for lack of credit
+    static constexpr int TooManyRequestsCode = 10028;
+
+    struct Stats
+    {
+        uint64_t sent = 0;      // charged and sent without waiting
+        uint64_t delayed = 0;   // sent after waiting in a queue
+        uint64_t rejected = 0;  // refused locally
+        uint64_t throttled = 0; // refused by the exchange anyway
+        size_t queued = 0;      // waiting now
+    };
+
+    explicit RateLimiter(const RateLimitConfig &config = RateLimitConfig());
+    ~RateLimiter();
+
+    RateLimiter(const RateLimiter &) = delete;
+    RateLimiter &operator=(const RateLimiter &) = delete;
+
+    bool enabled() const { return config.enabled; }
+
+    // Charges a request of this kind if it can go now, i.e. its pool covers it
+    // and nothing it must not overtake is queued. False leaves it to enqueue().
+    bool tryAcquire(RequestKind kind);
+    // Calls send once the request is charged, inline if it can go now and on
+    // the limiter's thread otherwise, or reject if it is refused
+    void enqueue(RequestKind kind, Send send, Reject reject);
+    // Blocks until the request is charged, or returns false with reason set if it is refused
+    bool acquire(RequestKind kind, std::string &reason);
+    // The exchange refused a request of this kind for lack of credit: its pool
+    // is taken as empty, so the model catches up with the exchange's
+    void throttled(RequestKind kind);
+
+    // Credits left in a pool now
+    double credits(CreditPool pool) const;
+    // Requests of this kind that would go out at once if sent now
+    uint32_t headroom(RequestKind kind) const;
+    const CreditPoolConfig &pool(CreditPool pool) const;
+    Stats stats() const;
+
+    // Refuses everything queued and everything sent from now on
+    void stop();
+
+private:
+    struct Bucket
+    {
+        CreditPoolConfig config;
+        double credits = 0;
+        int64_t refilledAt = 0; // steadyNanos
+    };
+
+    struct Waiting
+    {
+        Send send;
+        Reject reject;
+        int64_t deadline = 0; // steadyNanos
+    };
+
+    static CreditPool poolOf(RequestKind kind)
+    {
+        return kind == RequestKind::Query ? CreditPool::NonMatching : CreditPool::Matching;
+    }
+
+    // Credits the bucket would hold at now, without changing it
+    static double creditsAt(const Bucket &bucket, int64_t now);
+    void refill(Bucket &bucket, int64_t now);
+    // Credits a request of this kind needs in its pool before it may be charged
+    double needed(RequestKind kind) const;
+    // Requests queued that one of this kind must wait behind
+    size_t queuedAhead(RequestKind kind) const;
+    void dispatchLoop();
+
+    const RateLimitConfig config;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    bool stopped = false;
+    Bucket buckets[static_cast<size_t>(CreditPool::Count)];
+    std::deque<Waiting> queues[static_cast<size_t>(RequestKind::Count)];
+    Stats counters;
+    std::thread dispatcher;
+};
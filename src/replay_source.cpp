@@ -0,0 +1,147 @@
+#include "replay_source.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include "feed_recorder.hpp"
+#include "notification_parser.hpp"
+#include "order_book.hpp"
+
+namespace
+{
+    // Waits until deadline, sleeping while it is far away and spinning for the last stretch
+    void waitUntil(std::chrono::steady_clock::time_point deadline)
+    {
+        constexpr auto spin = std::chrono::microseconds(200);
+        auto now = std::chrono::steady_clock::now();
+        if (deadline - now > spin)
+            std::this_thread::sleep_until(deadline - spin);
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+        }
+    }
+}
+
+bool parseReplayPacing(std::string_view name, ReplayPacing &pacing)
+{
+    if (name == "fast")
+        pacing = ReplayPacing::Fast;
+    else if (name == "original")
+        pacing = ReplayPacing::Original;
+    else if (name == "scaled")
+        pacing = ReplayPacing::Scaled;
+    else
+        return false;
+    return true;
+}
+
+bool ReplaySource::load(const std::string &path, std::string &error)
+{
+    std::error_code ec;
+    if (std::filesystem::is_directory(path, ec))
+    {
+        std::vector<std::string> files = listCaptureFiles(path);
+        if (files.empty())
+        {
+            error = "no .tccap files in " + path;
+            return false;
+        }
+        for (const auto &file : files)
+        {
+            if (!loadCapture(file, error))
+                return false;
+        }
+        return true;
+    }
+    if (std::filesystem::path(path).extension() == ".tccap")
+        return loadCapture(path, error);
+    return loadLines(path, error);
+}
+
+bool ReplaySource::loadCapture(const std::string &path, std::string &error)
+{
+    CaptureReader reader(path);
+    if (!reader.valid())
+    {
+        error = path + ": " + reader.error();
+        return false;
+    }
+    CapturedFrame captured;
+    while (reader.next(captured))
+    {
+        ReplayFrame frame;
+        frame.receivedUnixNs = captured.receivedUnixNs;
+        frame.connectionId = captured.connectionId;
+        frame.payload.assign(captured.payload);
+        payloadBytes += frame.payload.size();
+        frames.push_back(std::move(frame));
+    }
+    return true;
+}
+
+// One frame per line. Book notifications are paced by their exchange timestamp.
+bool ReplaySource::loadLines(const std::string &path, std::string &error)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::string line;
+    FrameView view;
+    BookUpdate update;
+    while (std::getline(in, line))
+    {
+        if (line.empty())
+            continue;
+        ReplayFrame frame;
+        if (scanFrame(line, view) == FrameKind::Subscription && view.channel.rfind("book.", 0) == 0 &&
+            parseBookData(view.data, update))
+        {
+            frame.receivedUnixNs = update.timestamp * 1000000;
+        }
+        frame.payload = std::move(line);
+        payloadBytes += frame.payload.size();
+        frames.push_back(std::move(frame));
+    }
+    return true;
+}
+
+void ReplaySource::setRoutes(const Router &router)
+{
+    for (ReplayFrame &frame : frames)
+    {
+        frame.route = router(frame);
+    }
+}
+
+uint64_t ReplaySource::run(const ReplayConfig &config, const Sink &sink, uint32_t route) const
+{
+    const bool paced = config.pacing != ReplayPacing::Fast;
+    const double speed = config.pacing == ReplayPacing::Scaled && config.speed > 0 ? config.speed : 1.0;
+    uint64_t delivered = 0;
+
+    for (size_t loop = 0; loop < config.loops; ++loop)
+    {
+        // Each loop restarts the clock so the gap between loops is not replayed
+        auto start = std::chrono::steady_clock::now();
+        int64_t firstUnixNs = 0;
+        for (const ReplayFrame &frame : frames)
+        {
+            if (route != AllRoutes && frame.route != route)
+                continue;
+            if (paced && frame.receivedUnixNs != 0)
+            {
+                if (firstUnixNs == 0)
+                    firstUnixNs = frame.receivedUnixNs;
+                auto offset = std::chrono::nanoseconds((int64_t)((frame.receivedUnixNs - firstUnixNs) / speed));
+                waitUntil(start + offset);
+            }
+            sink(frame);
+            ++delivered;
+        }
+    }
+    return delivered;
+}
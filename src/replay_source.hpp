@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Replays recorded WebSocket frames into the client. Frames come from
+// FeedRecorder captures (.tccap) or from text files with one frame per line
+// (.jsonl, as in bench/data), and are handed to a sink in recording order,
+// either as fast as possible or paced like the original session.
+
+enum class ReplayPacing
+{
+    Fast,     // back to back, for throughput
+    Original, // same gaps between frames as when they were received
+    Scaled    // original gaps divided by speed
+};
+
+struct ReplayConfig
+{
+    ReplayPacing pacing = ReplayPacing::Fast;
+    double speed = 1.0; // only used with Scaled
+    size_t loops = 1;
+};
+
+struct ReplayFrame
+{
+    int64_t receivedUnixNs = 0; // 0 when the source has no receive time
+    uint32_t connectionId = 0;
+    uint32_t route = 0; // lets several threads replay disjoint parts, e.g. one per feed shard
+    std::string payload;
+};
+
+class ReplaySource
+{
+public:
+    using Sink = std::function<void(const ReplayFrame &frame)>;
+    using Router = std::function<uint32_t(const ReplayFrame &frame)>;
+    static constexpr uint32_t AllRoutes = UINT32_MAX;
+
+    // Adds the frames of a capture file, a .jsonl file or every capture in a directory
+    bool load(const std::string &path, std::string &error);
+
+    size_t size() const { return frames.size(); }
+    uint64_t bytes() const { return payloadBytes; }
+    // Tags every loaded frame with router(frame)
+    void setRoutes(const Router &router);
+
+    // Calls sink for every frame on route (all frames by default), config.loops
+    // times, keeping the requested pacing. Returns the number of frames delivered.
+    uint64_t run(const ReplayConfig &config, const Sink &sink, uint32_t route = AllRoutes) const;
+
+private:
+    bool loadCapture(const std::string &path, std::string &error);
+    bool loadLines(const std::string &path, std::string &error);
+
+    std::vector<ReplayFrame> frames;
+    uint64_t payloadBytes = 0;
+};
+
+bool parseReplayPacing(std::string_view name, ReplayPacing &pacing);
@@ -0,0 +1,132 @@
+#include "rpc_dispatcher.hpp"
+
+#include <vector>
+
+using json = nlohmann::json;
+
+RpcDispatcher::RpcDispatcher()
+{
+    sweeper = std::thread(&RpcDispatcher::sweepLoop, this);
+}
+
+RpcDispatcher::~RpcDispatcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    sweeper.join();
+}
+
+void RpcDispatcher::track(uint64_t id, std::chrono::milliseconds timeout, Callback callback)
+{
+    const Clock::time_point deadline = Clock::now() + timeout;
+    bool earlier;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto [it, added] = table.try_emplace(id);
+        if (!added)
+        {
+            deadlines.erase(it->second.deadline);
+        }
+        it->second = Pending{deadlines.emplace(deadline, id), std::move(callback)};
+        earlier = deadline < sweeperWakesAt;
+    }
+    if (earlier)
+    {
+        wake.notify_one();
+    }
+}
+
+bool RpcDispatcher::complete(uint64_t id, const json &response)
+{
+    Callback callback;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = table.find(id);
+        if (it == table.end())
+        {
+            return false;
+        }
+        callback = std::move(it->second.callback);
+        deadlines.erase(it->second.deadline);
+        table.erase(it);
+    }
+    // Run outside the lock so callbacks may issue new requests
+    callback(response);
+    return true;
+}
+
+bool RpcDispatcher::fail(uint64_t id, int code, const std::string &message)
+{
+    return complete(id, makeError(id, code, message));
+}
+
+void RpcDispatcher::failAll(int code, const std::string &message)
+{
+    std::unordered_map<uint64_t, Pending> failed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        failed.swap(table);
+        deadlines.clear();
+    }
+    for (auto &entry : failed)
+    {
+        entry.second.callback(makeError(entry.first, code, message));
+    }
+}
+
+size_t RpcDispatcher::pending() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return table.size();
+}
+
+json RpcDispatcher::makeError(uint64_t id, int code, const std::string &message)
+{
+    return {
+        {"jsonrpc", "2.0"},
+        {"id", id},
+        {"error", {{"code", code}, {"message", message}}}};
+}
+
+// Wakes up at the earliest deadline and times out whatever is still pending
+void RpcDispatcher::sweepLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping)
+    {
+        auto now = Clock::now();
+        std::vector<std::pair<uint64_t, Callback>> expired;
+        while (!deadlines.empty() && deadlines.begin()->first <= now)
+        {
+            auto it = table.find(deadlines.begin()->second);
+            expired.emplace_back(it->first, std::move(it->second.callback));
+            table.erase(it);
+            deadlines.erase(deadlines.begin());
+        }
+
+        if (!expired.empty())
+        {
+            lock.unlock();
+            for (auto &entry : expired)
+            {
+                entry.second(makeError(entry.first, TimeoutCode, "request timed out"));
+            }
+            lock.lock();
+            continue;
+        }
+        if (deadlines.empty())
+        {
+            sweeperWakesAt = Clock::time_point::max();
+            wake.wait(lock);
+        }
+        else
+        {
+            sweeperWakesAt = deadlines.begin()->first;
+            wake.wait_until(lock, sweeperWakesAt);
+        }
+        sweeperWakesAt = Clock::time_point::min();
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+
+// Matches JSON-RPC responses to the requests that produced them. Every request
+// gets a process-unique id and an entry in the pending table; the entry's
+// callback runs exactly once, either with the server response or with a
+// locally generated error when the request times out or the session drops.
+class RpcDispatcher
+{
+public:
+    using Callback = std::function<void(const nlohmann::json &response)>;
+
+    // Error codes used for locally generated failures
+    static constexpr int TimeoutCode = -1;
+    static constexpr int DisconnectedCode = -2;
+    static constexpr int InvalidOrderCode = -3; // order refused before sending, e.g. off the tick grid
+    static constexpr int RateLimitedCode = -4;  // refused before sending for lack of request credit
+
+    RpcDispatcher();
+    ~RpcDispatcher();
+
+    RpcDispatcher(const RpcDispatcher &) = delete;
+    RpcDispatcher &operator=(const RpcDispatcher &) = delete;
+
+    // Next JSON-RPC id, monotonically increasing
+    uint64_t nextId() { return lastId.fetch_add(1, std::memory_order_relaxed) + 1; }
+
+    // Registers a request that is about to be sent
+    void track(uint64_t id, std::chrono::milliseconds timeout, Callback callback);
+
+    // Completes the request with this id. Returns false if nothing was waiting for it.
+    bool complete(uint64_t id, const nlohmann::json &response);
+
+    // Fails one pending request, e.g. when it could not be sent
+    bool fail(uint64_t id, int code, const std::string &message);
+
+    // Fails every pending request, e.g. when the connection closes
+    void failAll(int code, const std::string &message);
+
+    size_t pending() const;
+
+    static nlohmann::json makeError(uint64_t id, int code, const std::string &message);
+
+private:
+    using Clock = std::chrono::steady_clock;
+    // Pending ids by deadline, earliest first, so the sweeper never scans the table
+    using Deadlines = std::multimap<Clock::time_point, uint64_t>;
+
+    struct Pending
+    {
+        Deadlines::iterator deadline;
+        Callback callback;
+    };
+
+    void sweepLoop();
+
+    std::atomic<uint64_t> lastId{0};
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::unordered_map<uint64_t, Pending> table;
+    Deadlines deadlines;
+    // When the sweeper wakes up next; min while it is awake and will look at
+    // deadlines again anyway, so a request only wakes it if it is due earlier
+    Clock::time_point sweeperWakesAt = Clock::time_point::min();
+    bool stopping = false;
+    std::thread sweeper;
+};
@@ -0,0 +1,316 @@
+#include "session_script.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <thread>
+#include "logger.hpp"
+#include "trading_client.hpp"
+
+using json = nlohmann::json;
+
+namespace
+{
+    struct Verb
+    {
+        const char *name;
+        size_t minArgs;
+        size_t maxArgs;
+    };
+
+    constexpr size_t Unbounded = std::numeric_limits<size_t>::max();
+
+    const Verb Verbs[] = {
+        {"timeout", 1, 1},
+        {"connect", 0, 0},
+        {"subscribe", 1, Unbounded},
+        {"unsubscribe", 1, Unbounded},
+        {"buy", 3, 3},
+        {"edit", 3, 3},
+        {"cancel", 1, 1},
+        {"ladder", 5, 5},
+        {"cancel-all", 1, 1},
+        {"run", 0, 1},
+        {"stats", 0, 0},
+    };
+
+    const Verb *findVerb(const std::string &name)
+    {
+        for (const Verb &verb : Verbs)
+        {
+            if (name == verb.name)
+                return &verb;
+        }
+        return nullptr;
+    }
+
+    bool number(const std::string &text, double &value)
+    {
+        char *end = nullptr;
+        value = std::strtod(text.c_str(), &end);
+        return !text.empty() && *end == '\0';
+    }
+
+    double numberArg(const ScriptCommand &command, size_t i)
+    {
+        double value = 0;
+        number(command.args[i], value);
+        return value;
+    }
+
+    // Which arguments must be numbers, checked at load time
+    bool numericArgs(const ScriptCommand &command, size_t &first, size_t &last)
+    {
+        first = 0;
+        last = 0;
+        if (command.verb == "timeout" || command.verb == "run")
+            last = command.args.size();
+        else if (command.verb == "buy" || command.verb == "edit")
+            first = 1, last = 3;
+        else if (command.verb == "ladder")
+            first = 1, last = 5;
+        return first < last;
+    }
+
+    bool succeeded(const json &response, const std::string &action)
+    {
+        if (response.contains("error"))
+        {
+            LOG_ERROR("{} failed: {}", action, response["error"].dump());
+            return false;
+        }
+        LOG_INFO("{}: {}", action, response["result"].dump());
+        return true;
+    }
+
+    bool allSucceeded(const std::vector<OrderResult> &results, const std::string &action)
+    {
+        size_t ok = 0;
+        for (const OrderResult &result : results)
+        {
+            if (result.ok)
+                ++ok;
+            else
+                LOG_ERROR("{} failed: {}", result.orderId.empty() ? action : result.orderId, result.error);
+        }
+        LOG_INFO("{}: {} of {} succeeded", action, ok, results.size());
+        return ok == results.size();
+    }
+}
+
+bool SessionScript::load(std::istream &in, std::string &error)
+{
+    commands.clear();
+    std::string text;
+    int line = 0;
+    while (std::getline(in, text))
+    {
+        ++line;
+        size_t comment = text.find('#');
+        if (comment != std::string::npos)
+        {
+            text.erase(comment);
+        }
+        ScriptCommand command;
+        command.line = line;
+        std::istringstream words(text);
+        if (!(words >> command.verb))
+        {
+            continue;
+        }
+        std::string word;
+        while (words >> word)
+        {
+            command.args.push_back(word);
+        }
+
+        const std::string where = "line " + std::to_string(line) + ": ";
+        const Verb *verb = findVerb(command.verb);
+        if (!verb)
+        {
+            error = where + "unknown command " + command.verb;
+            return false;
+        }
+        if (command.args.size() < verb->minArgs || command.args.size() > verb->maxArgs)
+        {
+            error = where + "wrong number of arguments for " + command.verb;
+            return false;
+        }
+        size_t first, last;
+        if (numericArgs(command, first, last))
+        {
+            for (size_t i = first; i < last; ++i)
+            {
+                double value;
+                if (!number(command.args[i], value) || value < 0)
+                {
+                    error = where + "expected a non-negative number, got " + command.args[i];
+                    return false;
+                }
+            }
+        }
+        if (command.verb == "subscribe")
+        {
+            BookChannelGroups groups;
+            if (!groupByChannel(command.args, BookChannel(), groups, error))
+            {
+                error = where + error;
+                return false;
+            }
+        }
+        commands.push_back(std::move(command));
+    }
+    return true;
+}
+
+bool SessionScript::load(const std::string &path, std::string &error)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        error = "cannot open " + path;
+        return false;
+    }
+    return load(in, error);
+}
+
+bool SessionScript::run(TradingClient &client, const BookChannel &defaultChannel, const std::atomic<bool> &stop)
+{
+    for (const ScriptCommand &command : commands)
+    {
+        if (stop)
+        {
+            LOG_INFO("Script stopped before line {}", command.line);
+            return true;
+        }
+        if (!execute(command, client, defaultChannel, stop))
+        {
+            LOG_ERROR("Script failed at line {} ({})", command.line, command.verb);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SessionScript::ensureSession(TradingClient &client)
+{
+    if (!client.connected())
+    {
+        client.connectWebSocket();
+    }
+    if (!client.waitForSession(timeout))
+    {
+        LOG_ERROR("WebSocket session not ready after {} ms", timeout.count());
+        return false;
+    }
+    return true;
+}
+
+const std::string &SessionScript::orderId(const std::string &arg) const
+{
+    return arg == "last" ? lastOrderId : arg;
+}
+
+bool SessionScript::execute(const ScriptCommand &command, TradingClient &client, const BookChannel &defaultChannel,
+                            const std::atomic<bool> &stop)
+{
+    const std::string &verb = command.verb;
+    if (verb == "timeout")
+    {
+        timeout = std::chrono::milliseconds(static_cast<int64_t>(numberArg(command, 0)));
+        return true;
+    }
+    if (verb == "connect")
+    {
+        return ensureSession(client);
+    }
+    if (verb == "subscribe")
+    {
+        BookChannelGroups groups;
+        std::string error;
+        groupByChannel(command.args, defaultChannel, groups, error);
+        std::vector<std::string> instruments;
+        for (const auto &group : groups)
+        {
+            client.subscribeToOrderBooks(group.second.second, group.second.first);
+            instruments.insert(instruments.end(), group.second.second.begin(), group.second.second.end());
+        }
+        // Subscriptions wanted before the session opens go out from on_open
+        if (!client.connected())
+        {
+            client.connectWebSocket();
+        }
+        if (!client.waitForBooks(instruments, timeout))
+        {
+            LOG_ERROR("Book subscriptions not confirmed after {} ms", timeout.count());
+            return false;
+        }
+        LOG_INFO("{} books subscribed", instruments.size());
+        return true;
+    }
+    if (verb == "unsubscribe")
+    {
+        client.unsubscribeFromOrderBooks(command.args);
+        return true;
+    }
+    if (verb == "buy")
+    {
+        if (!ensureSession(client))
+            return false;
+        json response = client.placeOrderAsync(command.args[0], numberArg(command, 1), numberArg(command, 2)).get();
+        if (!succeeded(response, "Order placed"))
+            return false;
+        const json &order = response["result"]["order"];
+        lastOrderId = order.is_object() ? order.value("order_id", "") : "";
+        return true;
+    }
+    if (verb == "edit")
+    {
+        if (!ensureSession(client))
+            return false;
+        return succeeded(client.modifyOrderAsync(orderId(command.args[0]), numberArg(command, 1), numberArg(command, 2)).get(),
+                         "Order modified");
+    }
+    if (verb == "cancel")
+    {
+        if (!ensureSession(client))
+            return false;
+        return succeeded(client.cancelOrderAsync(orderId(command.args[0])).get(), "Order cancelled");
+    }
+    if (verb == "ladder")
+    {
+        const double top = numberArg(command, 1);
+        const double step = numberArg(command, 2);
+        const double amount = numberArg(command, 3);
+        std::vector<OrderRequest> ladder;
+        for (int i = 0; i < static_cast<int>(numberArg(command, 4)); ++i)
+        {
+            ladder.push_back({command.args[0], top - i * step, amount});
+        }
+        return allSucceeded(client.placeOrders(ladder), "Order placed");
+    }
+    if (verb == "cancel-all")
+    {
+        return allSucceeded(client.cancelAllByInstrument(command.args[0]), "Order cancelled");
+    }
+    if (verb == "run")
+    {
+        // Nothing to wait for here but the clock or a stop request
+        const bool forever = command.args.empty();
+        auto until = std::chrono::steady_clock::now() +
+                     std::chrono::milliseconds(forever ? 0 : static_cast<int64_t>(numberArg(command, 0) * 1000));
+        while (!stop && (forever || std::chrono::steady_clock::now() < until))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        return true;
+    }
+    if (verb == "stats")
+    {
+        client.showPipelineStats();
+        client.showLatencyStats();
+        return true;
+    }
+    return false;
+}
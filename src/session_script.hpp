@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <istream>
+#include <string>
+#include <vector>
+#include "subscription_set.hpp"
+
+class TradingClient;
+
+// One line of a session script
+struct ScriptCommand
+{
+    int line = 0;
+    std::string verb;
+    std::vector<std::string> args;
+};
+
+// A non-interactive session: the menu's actions as a text file, one command
+// per line, # starting a comment.
+//
+//   timeout <ms>                             readiness timeout for the commands after it (default 10000)
+//   connect                                  opens the WebSocket session, waits until it is authenticated
+//   subscribe <instrument[@channel]>...      subscribes, waits until the server confirms every book
+//   unsubscribe <instrument>...
+//   buy <instrument> <price> <amount>        over the WebSocket session, waits for the response
+//   edit <orderId|last> <price> <amount>     last is the order of the most recent buy
+//   cancel <orderId|last>
+//   ladder <instrument> <top> <step> <amount> <count>   one REST batch, as menu option 17
+//   cancel-all <instrument>
+//   run [seconds]                            keeps the session going that long, or until stopped
+//   stats                                    prints the pipeline and latency stats
+//
+// Every wait is on the client's own readiness signals, so each command starts
+// as soon as the one before it has taken effect.
+class SessionScript
+{
+public:
+    // Reads and checks the whole script before anything runs; false with
+    // error naming the line otherwise
+    bool load(std::istream &in, std::string &error);
+    bool load(const std::string &path, std::string &error);
+
+    // Runs the commands in order and stops at the first that fails. stop may
+    // be set from another thread or a signal handler to end a run early.
+    bool run(TradingClient &client, const BookChannel &defaultChannel, const std::atomic<bool> &stop);
+
+    size_t size() const { return commands.size(); }
+
+private:
+    bool execute(const ScriptCommand &command, TradingClient &client, const BookChannel &defaultChannel,
+                 const std::atomic<bool> &stop);
+    // Connects if needed and waits for the authenticated session
+    bool ensureSession(TradingClient &client);
+    const std::string &orderId(const std::string &arg) const;
+
+    std::vector<ScriptCommand> commands;
+    std::chrono::milliseconds timeout{10000};
+    std::string lastOrderId;
+};
@@ -0,0 +1,701 @@
+#include "sharded_feed.hpp"
+
+#include "logger.hpp"
+#include "notification_parser.hpp"
+#include "order_messages.hpp"
+#include "thread_util.hpp"
+
+using json = nlohmann::json;
+
+namespace
+{
+    int coreFor(const std::vector<int> &cores, uint32_t index)
+    {
+        return index < cores.size() ? cores[index] : -1;
+    }
+}
+
+TopOfBookBoard::TopOfBookBoard() : slots(new Slot[Capacity])
+{
+}
+
+uint32_t TopOfBookBoard::slotFor(std::string_view instrument)
+{
+    std::lock_guard<std::mutex> lock(namesMutex);
+    uint32_t slot = names.find(instrument);
+    if (slot == InstrumentRegistry::NotFound && names.size() < Capacity)
+    {
+        slot = names.intern(instrument);
+    }
+    return slot;
+}
+
+uint32_t TopOfBookBoard::find(std::string_view instrument) const
+{
+    std::lock_guard<std::mutex> lock(namesMutex);
+    return names.find(instrument);
+}
+
+void TopOfBookBoard::requestOwner(uint32_t slot, uint32_t shard)
+{
+    slots[slot].pendingOwner.store(shard, std::memory_order_release);
+}
+
+void TopOfBookBoard::release(uint32_t slot)
+{
+    slots[slot].pendingOwner.store(NoShard, std::memory_order_relaxed);
+    slots[slot].owner.store(NoShard, std::memory_order_release);
+}
+
+bool TopOfBookBoard::tryTakeOver(uint32_t slot, uint32_t shard, uint64_t changeId, uint32_t &previous)
+{
+    Slot &s = slots[slot];
+    uint32_t pending = s.pendingOwner.load(std::memory_order_acquire);
+    uint32_t current = s.owner.load(std::memory_order_acquire);
+    if (pending != shard && !(pending == NoShard && current == NoShard))
+    {
+        return false;
+    }
+    // Wait until the new book is at least as recent as the one being replaced
+    if (current != NoShard && changeId < s.changeId.load(std::memory_order_relaxed))
+    {
+        return false;
+    }
+    previous = s.owner.exchange(shard, std::memory_order_acq_rel);
+    s.pendingOwner.compare_exchange_strong(pending, NoShard, std::memory_order_acq_rel);
+    return true;
+}
+
+bool TopOfBookBoard::publish(uint32_t slot, uint32_t shard, const OrderBook &book)
+{
+    Slot &s = slots[slot];
+    if (s.owner.load(std::memory_order_acquire) != shard)
+    {
+        return false;
+    }
+    // During a handover the old owner may still be writing; skip this one
+    // update rather than wait, the next one carries the whole top again
+    uint32_t sequence = s.sequence.load(std::memory_order_relaxed);
+    if ((sequence & 1) || !s.sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_acq_rel))
+    {
+        return false;
+    }
+    // tryTakeOver may have handed the slot on since the check above; the new
+    // owner's writes must not be overwritten with this shard's older top
+    if (s.owner.load(std::memory_order_seq_cst) != shard)
+    {
+        s.sequence.store(sequence, std::memory_order_release);
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    write(s, book);
+    s.sequence.store(sequence + 2, std::memory_order_release);
+    return true;
+}
+
+void TopOfBookBoard::publishNewer(uint32_t slot, const OrderBook &book)
+{
+    Slot &s = slots[slot];
+    // Legs write different change_ids, so unlike publish() this waits out the
+    // other writer: skipping could leave an older top published
+    uint32_t sequence = s.sequence.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        if (sequence & 1)
+        {
+            sequence = s.sequence.load(std::memory_order_relaxed);
+            continue;
+        }
+        if (s.sequence.compare_exchange_weak(sequence, sequence + 1, std::memory_order_acquire))
+        {
+            break;
+        }
+    }
+    if (book.changeId() <= s.changeId.load(std::memory_order_relaxed))
+    {
+        // Nothing was written, so readers need not retry
+        s.sequence.store(sequence, std::memory_order_release);
+        return;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    write(s, book);
+    s.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void TopOfBookBoard::write(Slot &s, const OrderBook &book)
+{
+    const PriceLevel *bid = book.bestBid();
+    const PriceLevel *ask = book.bestAsk();
+    s.bidPrice.store(bid ? book.price(*bid) : 0, std::memory_order_relaxed);
+    s.bidAmount.store(bid ? book.amount(*bid) : 0, std::memory_order_relaxed);
+    s.askPrice.store(ask ? book.price(*ask) : 0, std::memory_order_relaxed);
+    s.askAmount.store(ask ? book.amount(*ask) : 0, std::memory_order_relaxed);
+    s.changeId.store(book.changeId(), std::memory_order_relaxed);
+    s.timestamp.store(book.timestamp(), std::memory_order_relaxed);
+}
+
+bool TopOfBookBoard::read(uint32_t slot, TopOfBook &top) const
+{
+    const Slot &s = slots[slot];
+    for (;;)
+    {
+        uint32_t before = s.sequence.load(std::memory_order_acquire);
+        if (before & 1)
+        {
+            continue;
+        }
+        top.bidPrice = s.bidPrice.load(std::memory_order_relaxed);
+        top.bidAmount = s.bidAmount.load(std::memory_order_relaxed);
+        top.askPrice = s.askPrice.load(std::memory_order_relaxed);
+        top.askAmount = s.askAmount.load(std::memory_order_relaxed);
+        top.changeId = s.changeId.load(std::memory_order_relaxed);
+        top.timestamp = s.timestamp.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.sequence.load(std::memory_order_relaxed) == before)
+        {
+            return before != 0;
+        }
+    }
+}
+
+FeedShard::FeedShard(uint32_t index, const ShardedFeedConfig &config, RpcDispatcher &rpc, TopOfBookBoard &board,
+                     SnapshotFetch fetchSnapshot, Handoff handoff, BookManager::ScaleLookup scales, FeedArbiter *arbiter,
+                     SharedBookWriter *sharedBooks)
+    : shardIndex(index), wsUrl(config.wsUrl), network(config.network), ioCore(coreFor(config.ioCores, index)), rpc(rpc), board(board),
+      arbiter(arbiter), fetchSnapshot(std::move(fetchSnapshot)), handoff(std::move(handoff)), authParams(config.authParams),
+      feed(rpc, feedHistogram, [this](const std::string &instrument)
+           { requestBookSnapshot(instrument); }),
+      inbound(config.ringCapacity, config.overflow)
+{
+    wsClient.clear_access_channels(websocketpp::log::alevel::all);
+    wsClient.clear_error_channels(websocketpp::log::elevel::all);
+    // Every shard runs its own io_context
+    wsClient.init_asio();
+    wsClient.set_open_handler(std::bind(&FeedShard::on_open, this, std::placeholders::_1));
+    wsClient.set_message_handler(std::bind(&FeedShard::on_message, this, std::placeholders::_1, std::placeholders::_2));
+    wsClient.set_close_handler(std::bind(&FeedShard::on_close, this, std::placeholders::_1));
+    wsClient.set_tls_init_handler(makeTlsContext);
+    wsClient.set_socket_init_handler([this](websocketpp::connection_hdl, TlsStream &stream)
+                                     { initSocket(stream, network, tlsSessions); });
+
+    feed.setBookListener([this](uint32_t instrumentId, const OrderBook &book, const BookUpdate &)
+                         { onBook(instrumentId, book); });
+    feed.setScaleLookup(std::move(scales));
+    if (sharedBooks)
+    {
+        this->sharedBooks = std::make_unique<SharedBookPublisher>(*sharedBooks);
+    }
+
+    processingThread = std::thread(&FeedShard::processLoop, this);
+    int core = coreFor(config.processingCores, index);
+    if (!pinThreadToCore(processingThread, core))
+    {
+        LOG_WARN("Could not pin shard {} processing thread to core {}", shardIndex, core);
+    }
+}
+
+FeedShard::~FeedShard()
+{
+    stop();
+}
+
+void FeedShard::stop()
+{
+    // Their snapshots are posted to the I/O thread, so they finish while it still runs
+    snapshotWorkers.joinAll();
+    if (ioThread.joinable())
+    {
+        wsClient.stop();
+        ioThread.join();
+    }
+    processing = false;
+    if (processingThread.joinable())
+    {
+        processingThread.join();
+    }
+}
+
+void FeedShard::connect()
+{
+    if (ioRunning)
+    {
+        return;
+    }
+    if (ioThread.joinable())
+    {
+        ioThread.join();
+        wsClient.reset();
+    }
+    websocketpp::lib::error_code ec;
+    client::connection_ptr con = wsClient.get_connection(wsUrl, ec);
+    if (ec)
+    {
+        LOG_ERROR("Shard {} connection error: {}", shardIndex, ec.message());
+        return;
+    }
+    wsClient.connect(con);
+    ioRunning = true;
+    ioThread = std::thread([this]()
+                           {
+        runIoContext(wsClient.get_io_service(), network.busyPoll);
+        ioRunning = false; });
+    if (!pinThreadToCore(ioThread, ioCore))
+    {
+        LOG_WARN("Could not pin shard {} I/O thread to core {}", shardIndex, ioCore);
+    }
+}
+
+void FeedShard::on_open(websocketpp::connection_hdl hdl)
+{
+    this->hdl = hdl;
+    ++connectionId;
+    authAnswered = false;
+    isConnected = true;
+    if (network.reuseTlsSessions)
+    {
+        tlsSessions.remember(wsClient.get_con_from_hdl(hdl)->get_socket().native_handle());
+    }
+    LOG_INFO("Shard {} connected.", shardIndex);
+    if (authParams)
+    {
+        // Subscriptions go out once the grant is answered
+        authenticate();
+        return;
+    }
+    std::vector<std::string> channels = subscriptions.wanted();
+    if (!channels.empty())
+    {
+        sendSubscriptions("public/subscribe", channels);
+    }
+}
+
+void FeedShard::authenticate()
+{
+    if (!authParams || !isConnected)
+    {
+        return;
+    }
+    const uint32_t connection = connectionId;
+    uint64_t id = rpc.nextId();
+    rpc.track(id, std::chrono::milliseconds(5000), [this, connection](const json &response)
+              {
+        if (connection != connectionId)
+        {
+            return;
+        }
+        if (response.contains("error"))
+        {
+            // Non-raw channels are still served, so the subscriptions go out anyway
+            LOG_ERROR("Shard {} authentication failed: {}", shardIndex, response["error"].dump());
+        }
+        if (authAnswered.exchange(true))
+        {
+            return;
+        }
+        std::vector<std::string> channels = subscriptions.wanted();
+        if (!channels.empty())
+        {
+            sendSubscriptions("public/subscribe", channels);
+        } });
+    websocketpp::lib::error_code ec;
+    wsClient.send(hdl, makeRpcRequest(id, "public/auth", authParams()).dump(), websocketpp::frame::opcode::text, ec);
+    if (ec)
+    {
+        rpc.fail(id, RpcDispatcher::DisconnectedCode, ec.message());
+    }
+}
+
+// Same hand-over as TradingClient::on_message
+void FeedShard::on_message(websocketpp::connection_hdl, client::message_ptr msg)
+{
+    int64_t receivedAt = steadyNanos();
+    int64_t receivedUnixNs = unixNanos();
+    // Subscription responses must not be dropped, or the shard never learns they were confirmed
+    OverflowPolicy overflow = isBookNotification(msg->get_payload()) ? inbound.overflowPolicy() : OverflowPolicy::Block;
+    inbound.push([&](InboundFrame &frame)
+                 {
+        frame.kind = InboundFrame::WebSocket;
+        frame.payload.swap(msg->get_raw_payload());
+        frame.receivedAt = receivedAt;
+        frame.receivedUnixNs = receivedUnixNs;
+        frame.connectionId = connectionId; },
+                 overflow);
+}
+
+void FeedShard::on_close(websocketpp::connection_hdl)
+{
+    isConnected = false;
+    authAnswered = false;
+    subscriptions.clearConfirmed();
+    LOG_INFO("Shard {} connection closed.", shardIndex);
+}
+
+bool FeedShard::inject(std::string_view payload, int64_t receivedUnixNs)
+{
+    int64_t receivedAt = steadyNanos();
+    return inbound.push([&](InboundFrame &frame)
+                        {
+        frame.kind = InboundFrame::WebSocket;
+        frame.payload.assign(payload);
+        frame.receivedAt = receivedAt;
+        frame.receivedUnixNs = receivedUnixNs != 0 ? receivedUnixNs : unixNanos();
+        frame.connectionId = connectionId; });
+}
+
+void FeedShard::subscribe(const std::vector<std::string> &instruments, const BookChannel &channel)
+{
+    std::vector<std::string> replaced;
+    std::vector<std::string> channels = subscriptions.add(instruments, channel, replaced);
+    // Otherwise they go out from on_open or once the shard is authenticated
+    if (!readyToSubscribe())
+    {
+        return;
+    }
+    if (!replaced.empty())
+    {
+        sendSubscriptions("public/unsubscribe", replaced);
+    }
+    if (!channels.empty())
+    {
+        sendSubscriptions("public/subscribe", channels);
+    }
+}
+
+void FeedShard::unsubscribe(const std::vector<std::string> &instruments)
+{
+    std::vector<std::string> channels = subscriptions.remove(instruments);
+    if (!channels.empty() && isConnected)
+    {
+        sendSubscriptions("public/unsubscribe", channels);
+    }
+}
+
+void FeedShard::sendSubscriptions(const std::string &method, const std::vector<std::string> &channels)
+{
+    const bool subscribe = method == "public/subscribe";
+    for (const json &params : SubscriptionSet::batches(channels))
+    {
+        uint64_t id = rpc.nextId();
+        rpc.track(id, std::chrono::milliseconds(5000), [this, method, subscribe](const json &response)
+                  {
+            if (response.contains("error"))
+            {
+                LOG_ERROR("Shard {} {} failed: {}", shardIndex, method, response["error"].dump());
+                return;
+            }
+            subscriptions.confirm(response, subscribe); });
+        websocketpp::lib::error_code ec;
+        wsClient.send(hdl, makeRpcRequest(id, method, params).dump(), websocketpp::frame::opcode::text, ec);
+        if (ec)
+        {
+            rpc.fail(id, RpcDispatcher::DisconnectedCode, ec.message());
+        }
+    }
+}
+
+// Drains the shard's ring, with the same back-off as TradingClient::processLoop
+void FeedShard::processLoop()
+{
+    size_t idle = 0;
+    while (processing.load(std::memory_order_relaxed))
+    {
+        if (inbound.pop([this](InboundFrame &frame)
+                        {
+                            frameReceivedAt = frame.receivedAt;
+                            feed.handleFrame(frame);
+                            if (frame.kind == InboundFrame::WebSocket)
+                            {
+                                processingHistogram.record(steadyNanos() - frame.receivedAt);
+                            }
+                            handled.fetch_add(1, std::memory_order_relaxed);
+                            gaps.store(feed.books().gapCount(), std::memory_order_relaxed); }))
+        {
+            idle = 0;
+        }
+        else if (++idle < 1000)
+        {
+            continue;
+        }
+        else if (idle < 2000)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+}
+
+// Publishes every valid book to the board (and shared memory), taking the slot over first if this shard is its new home
+void FeedShard::onBook(uint32_t instrumentId, const OrderBook &book)
+{
+    if (instrumentId >= boardSlots.size())
+    {
+        boardSlots.resize(instrumentId + 1, InstrumentRegistry::NotFound);
+    }
+    uint32_t &slot = boardSlots[instrumentId];
+    if (slot == InstrumentRegistry::NotFound)
+    {
+        slot = board.slotFor(book.instrument());
+        if (slot == InstrumentRegistry::NotFound)
+        {
+            LOG_WARN("Top of book board is full, {} is not merged", book.instrument());
+            slot = NoSlot;
+        }
+    }
+    if (slot == NoSlot)
+    {
+        return;
+    }
+    if (arbiter)
+    {
+        if (arbiter->offer(slot, shardIndex, book.changeId(), frameReceivedAt))
+        {
+            board.publishNewer(slot, book);
+            if (sharedBooks)
+            {
+                sharedBooks->publish(instrumentId, book);
+            }
+            published.fetch_add(1, std::memory_order_relaxed);
+        }
+        return;
+    }
+    if (board.owner(slot) != shardIndex)
+    {
+        uint32_t previous;
+        if (!board.tryTakeOver(slot, shardIndex, book.changeId(), previous))
+        {
+            return;
+        }
+        if (previous != TopOfBookBoard::NoShard && previous != shardIndex && handoff)
+        {
+            handoff(book.instrument(), previous);
+        }
+    }
+    board.publish(slot, shardIndex, book);
+    if (sharedBooks)
+    {
+        sharedBooks->publish(instrumentId, book);
+    }
+    published.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Fetches the snapshot off the processing thread and queues it through the I/O thread, the ring's producer
+void FeedShard::requestBookSnapshot(const std::string &instrument)
+{
+    if (!fetchSnapshot || !ioRunning)
+    {
+        LOG_WARN("{} needs a snapshot but shard {} is offline", instrument, shardIndex);
+        return;
+    }
+    // Joined by stop(), so it never outlives the shard it posts to
+    snapshotWorkers.run([this, instrument]
+                {
+        std::string response = fetchSnapshot(instrument);
+        if (response.empty())
+        {
+            LOG_ERROR("Failed to resync order book for {}", instrument);
+            return;
+        }
+        boost::asio::post(wsClient.get_io_service(), [this, response]
+                          { inbound.push([&response](InboundFrame &frame)
+                                         {
+                                             frame.kind = InboundFrame::BookSnapshot;
+                                             frame.payload = response; },
+                                         OverflowPolicy::Block); }); });
+}
+
+ShardedFeed::ShardedFeed(const ShardedFeedConfig &config, RpcDispatcher &rpc, FeedShard::SnapshotFetch fetchSnapshot,
+                         BookManager::ScaleLookup scales, SharedBookWriter *sharedBooks)
+{
+    size_t count = config.shards > 0 ? config.shards : 1;
+    if (config.redundant)
+    {
+        arbiter = std::make_unique<FeedArbiter>((uint32_t)count, TopOfBookBoard::Capacity);
+    }
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        shards.push_back(std::make_unique<FeedShard>(i, config, rpc, board, fetchSnapshot,
+                                                     [this](const std::string &instrument, uint32_t previous)
+                                                     { handoff(instrument, previous); },
+                                                     scales, arbiter.get(), sharedBooks));
+    }
+}
+
+// A processing thread can call handoff() on another shard, so all of them stop before any is destroyed
+ShardedFeed::~ShardedFeed()
+{
+    for (auto &shard : shards)
+    {
+        shard->stop();
+    }
+}
+
+void ShardedFeed::connect()
+{
+    for (auto &shard : shards)
+    {
+        shard->connect();
+    }
+}
+
+void ShardedFeed::authenticate()
+{
+    for (auto &shard : shards)
+    {
+        shard->authenticate();
+    }
+}
+
+uint32_t ShardedFeed::placement(std::string_view instrument) const
+{
+    auto it = assignments.find(std::string(instrument));
+    if (it != assignments.end())
+    {
+        return it->second;
+    }
+    // Stable across runs, so an instrument always lands on the same shard
+    return (uint32_t)(InstrumentRegistry::hash(instrument) % shards.size());
+}
+
+uint32_t ShardedFeed::shardFor(std::string_view instrument) const
+{
+    std::lock_guard<std::mutex> lock(assignmentMutex);
+    return placement(instrument);
+}
+
+void ShardedFeed::subscribe(const std::vector<std::string> &instruments, const BookChannel &channel)
+{
+    if (arbiter)
+    {
+        // Every leg carries everything; the arbiter, not ownership, decides what is published
+        for (auto &shard : shards)
+        {
+            shard->subscribe(instruments, channel);
+        }
+        return;
+    }
+    std::vector<std::vector<std::string>> perShard(shards.size());
+    {
+        std::lock_guard<std::mutex> lock(assignmentMutex);
+        for (const auto &instrument : instruments)
+        {
+            uint32_t shard = placement(instrument);
+            uint32_t slot = board.slotFor(instrument);
+            if (slot != InstrumentRegistry::NotFound)
+            {
+                board.requestOwner(slot, shard);
+            }
+            perShard[shard].push_back(instrument);
+        }
+    }
+    for (size_t i = 0; i < shards.size(); ++i)
+    {
+        if (!perShard[i].empty())
+        {
+            shards[i]->subscribe(perShard[i], channel);
+        }
+    }
+}
+
+// An instrument may be on two shards while it moves, so every shard drops it
+void ShardedFeed::unsubscribe(const std::vector<std::string> &instruments)
+{
+    for (auto &shard : shards)
+    {
+        shard->unsubscribe(instruments);
+    }
+    for (const auto &instrument : instruments)
+    {
+        uint32_t slot = board.find(instrument);
+        if (slot != InstrumentRegistry::NotFound)
+        {
+            board.release(slot);
+        }
+    }
+}
+
+bool ShardedFeed::waitSubscribed(const std::vector<std::string> &instruments, std::chrono::steady_clock::time_point deadline) const
+{
+    for (const auto &shard : shards)
+    {
+        std::vector<std::string> carried;
+        for (const auto &instrument : instruments)
+        {
+            if (shard->wants(instrument))
+            {
+                carried.push_back(instrument);
+            }
+        }
+        if (!carried.empty() && !shard->subscribed().waitConfirmed(carried, deadline))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ShardedFeed::assign(const std::string &instrument, uint32_t shard)
+{
+    if (arbiter || shard >= shards.size())
+    {
+        return false;
+    }
+    bool subscribed = false;
+    BookChannel channel;
+    for (auto &s : shards)
+    {
+        if (!subscribed && s->wants(instrument))
+        {
+            subscribed = true;
+            channel = s->subscribed().channel(instrument);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(assignmentMutex);
+        assignments[instrument] = shard;
+    }
+    if (subscribed && !shards[shard]->wants(instrument))
+    {
+        uint32_t slot = board.slotFor(instrument);
+        if (slot != InstrumentRegistry::NotFound)
+        {
+            board.requestOwner(slot, shard);
+        }
+        shards[shard]->subscribe({instrument}, channel);
+    }
+    return true;
+}
+
+// Runs on the new shard's processing thread after it has taken the board slot over
+void ShardedFeed::handoff(const std::string &instrument, uint32_t previous)
+{
+    LOG_INFO("{} moved from shard {}", instrument, previous);
+    shards[previous]->unsubscribe({instrument});
+}
+
+bool ShardedFeed::inject(uint32_t shard, std::string_view payload, int64_t receivedUnixNs)
+{
+    return shards[shard % shards.size()]->inject(payload, receivedUnixNs);
+}
+
+size_t ShardedFeed::queuedFrames() const
+{
+    size_t depth = 0;
+    for (const auto &shard : shards)
+    {
+        depth += shard->queuedFrames();
+    }
+    return depth;
+}
+
+uint64_t ShardedFeed::bookGaps() const
+{
+    uint64_t total = 0;
+    for (const auto &shard : shards)
+    {
+        total += shard->bookGaps();
+    }
+    return total;
+}
@@ -0,0 +1,266 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "feed_arbiter.hpp"
+#include "feed_handler.hpp"
+#include "instrument_registry.hpp"
+#include "latency_histogram.hpp"
+#include "order_book.hpp"
+#include "rpc_dispatcher.hpp"
+#include "shared_book.hpp"
+#include "spsc_ring.hpp"
+#include "subscription_set.hpp"
+#include "thread_util.hpp"
+#include "ws_client.hpp"
+
+// Market data spread over several WebSocket connections. Each shard has its
+// own connection, io_context, I/O thread, inbound ring, processing thread and
+// books, so shards share nothing on the hot path and scale with cores. The
+// top of every book is merged into one TopOfBookBoard that any thread can
+// read without locking.
+//
+// In redundant mode the shards are A/B legs instead: every leg subscribes to
+// every instrument and keeps complete books of its own, and a FeedArbiter
+// publishes each update from whichever leg applies it first. A leg that
+// stalls or disconnects costs nothing while another one is up, and it comes
+// back through its own snapshot without touching the published books.
+
+struct ShardedFeedConfig
+{
+    size_t shards = 0; // 0 keeps market data on the order session
+    bool redundant = false; // every shard carries every instrument, first copy of each update wins
+    std::vector<int> ioCores;         // per shard; missing or -1 leaves the thread unpinned
+    std::vector<int> processingCores; // same for the processing threads
+    size_t ringCapacity = 8192;
+    OverflowPolicy overflow = OverflowPolicy::DropNewest;
+    std::string wsUrl = "wss://test.deribit.com/ws/api/v2/"; // TradingClient uses its endpoint's
+    NetworkTuning network; // busy polling and socket options; ioCore is not used, ioCores is
+    // public/auth params each shard's connection authenticates with before it
+    // subscribes, since raw book channels are only served to authenticated
+    // connections. Unset leaves the shards unauthenticated.
+    std::function<nlohmann::json()> authParams;
+};
+
+struct TopOfBook
+{
+    double bidPrice = 0;
+    double bidAmount = 0;
+    double askPrice = 0;
+    double askAmount = 0;
+    uint64_t changeId = 0;
+    int64_t timestamp = 0;
+};
+
+// Top of book per instrument, written by the shard that owns the slot and read
+// by anyone. Each slot is a seqlock: a reader retries instead of waiting, and a
+// writer never waits for readers. Ownership moves between shards when an
+// instrument is rebalanced.
+class TopOfBookBoard
+{
+public:
+    static constexpr uint32_t Capacity = 4096;
+    static constexpr uint32_t NoShard = UINT32_MAX;
+
+    TopOfBookBoard();
+
+    // Slot of an instrument, assigned on first use. Takes a mutex, so callers keep the result.
+    uint32_t slotFor(std::string_view instrument);
+    uint32_t find(std::string_view instrument) const;
+
+    uint32_t owner(uint32_t slot) const { return slots[slot].owner.load(std::memory_order_acquire); }
+    // Hands the slot to shard as soon as that shard's book has caught up
+    void requestOwner(uint32_t slot, uint32_t shard);
+    void release(uint32_t slot);
+    // Makes shard the writer if it was asked to take the slot over (or nobody
+    // owns it) and its book is not behind what is published. Sets previous to
+    // the shard that owned it before.
+    bool tryTakeOver(uint32_t slot, uint32_t shard, uint64_t changeId, uint32_t &previous);
+
+    // Writes the top of book if shard owns the slot; false if it did not write
+    bool publish(uint32_t slot, uint32_t shard, const OrderBook &book);
+    // Writes the top of book unless a later change_id is already there, whoever
+    // owns the slot; for redundant legs that may finish out of order
+    void publishNewer(uint32_t slot, const OrderBook &book);
+    // Returns false if nothing has been published for the slot yet
+    bool read(uint32_t slot, TopOfBook &top) const;
+
+private:
+    struct alignas(64) Slot
+    {
+        std::atomic<uint32_t> sequence{0}; // odd while a write is in progress
+        std::atomic<uint32_t> owner{NoShard};
+        std::atomic<uint32_t> pendingOwner{NoShard};
+        std::atomic<double> bidPrice{0};
+        std::atomic<double> bidAmount{0};
+        std::atomic<double> askPrice{0};
+        std::atomic<double> askAmount{0};
+        std::atomic<uint64_t> changeId{0};
+        std::atomic<int64_t> timestamp{0};
+    };
+
+    // Field stores of a write; the caller holds the slot's odd sequence
+    static void write(Slot &s, const OrderBook &book);
+
+    std::unique_ptr<Slot[]> slots;
+    mutable std::mutex namesMutex;
+    InstrumentRegistry names;
+};
+
+// One connection's worth of market data
+class FeedShard
+{
+public:
+    // Blocking REST fetch of a public/get_order_book response; empty on failure
+    using SnapshotFetch = std::function<std::string(const std::string &instrument)>;
+    // Called on the new shard's processing thread once it owns an instrument that previous had
+    using Handoff = std::function<void(const std::string &instrument, uint32_t previous)>;
+
+    // With an arbiter the shard is a redundant leg and publishes only the updates it wins. With
+    // sharedBooks, whatever it publishes to the board also goes to shared memory.
+    FeedShard(uint32_t index, const ShardedFeedConfig &config, RpcDispatcher &rpc, TopOfBookBoard &board,
+              SnapshotFetch fetchSnapshot, Handoff handoff, BookManager::ScaleLookup scales = nullptr,
+              FeedArbiter *arbiter = nullptr, SharedBookWriter *sharedBooks = nullptr);
+    ~FeedShard();
+
+    FeedShard(const FeedShard &) = delete;
+    FeedShard &operator=(const FeedShard &) = delete;
+
+    void connect();
+    // Stops the I/O and processing threads; the destructor calls it
+    void stop();
+    // Sends public/auth if the shard authenticates and is connected; the
+    // first answer on a connection sends its subscriptions
+    void authenticate();
+    void subscribe(const std::vector<std::string> &instruments, const BookChannel &channel);
+    void unsubscribe(const std::vector<std::string> &instruments);
+    bool wants(const std::string &instrument) const { return subscriptions.wants(instrument); }
+
+    // Replay entry point; the same single-producer rule as TradingClient::injectFrame applies
+    bool inject(std::string_view payload, int64_t receivedUnixNs);
+
+    uint32_t index() const { return shardIndex; }
+    bool connected() const { return isConnected; }
+    const SubscriptionSet &subscribed() const { return subscriptions; }
+    const SpscRing<InboundFrame> &ring() const { return inbound; }
+    size_t queuedFrames() const { return inbound.depth(); }
+    uint64_t handledFrames() const { return handled.load(std::memory_order_relaxed); }
+    uint64_t publishedUpdates() const { return published.load(std::memory_order_relaxed); }
+    uint64_t bookGaps() const { return gaps.load(std::memory_order_relaxed); }
+    const LatencyHistogram &feedLatency() const { return feedHistogram; }
+    const LatencyHistogram &processingLatency() const { return processingHistogram; }
+
+private:
+    void on_open(websocketpp::connection_hdl hdl);
+    void on_message(websocketpp::connection_hdl hdl, client::message_ptr msg);
+    void on_close(websocketpp::connection_hdl hdl);
+
+    void processLoop();
+    void onBook(uint32_t instrumentId, const OrderBook &book);
+    void requestBookSnapshot(const std::string &instrument);
+    void sendSubscriptions(const std::string &method, const std::vector<std::string> &channels);
+    // Whether subscriptions may go out: connected, and authenticated if it authenticates
+    bool readyToSubscribe() const { return isConnected && (!authParams || authAnswered); }
+
+    // Marks an instrument whose slot could not be assigned because the board is full
+    static constexpr uint32_t NoSlot = InstrumentRegistry::NotFound - 1;
+
+    const uint32_t shardIndex;
+    const std::string wsUrl;
+    const NetworkTuning network;
+    const int ioCore;
+    RpcDispatcher &rpc;
+    TopOfBookBoard &board;
+    FeedArbiter *arbiter;
+    SnapshotFetch fetchSnapshot;
+    Handoff handoff;
+    std::function<nlohmann::json()> authParams;
+
+    client wsClient;
+    websocketpp::connection_hdl hdl;
+    TlsSessionCache tlsSessions;
+    std::thread ioThread;
+    // Snapshot fetches, joined before the connection they post to goes
+    WorkerThreads snapshotWorkers;
+    std::atomic<bool> isConnected{false};
+    std::atomic<bool> ioRunning{false};
+    std::atomic<bool> authAnswered{false}; // this connection's public/auth has been answered
+    std::atomic<uint32_t> connectionId{0};
+    SubscriptionSet subscriptions;
+
+    LatencyHistogram feedHistogram;
+    LatencyHistogram processingHistogram;
+    std::atomic<uint64_t> handled{0};
+    std::atomic<uint64_t> published{0};
+    std::atomic<uint64_t> gaps{0};
+
+    // Processing thread only: the books and each local instrument id's board slot
+    FeedHandler feed;
+    std::vector<uint32_t> boardSlots;
+    std::unique_ptr<SharedBookPublisher> sharedBooks;
+    int64_t frameReceivedAt = 0; // receive time of the frame being handled
+
+    SpscRing<InboundFrame> inbound;
+    std::thread processingThread;
+    std::atomic<bool> processing{true};
+};
+
+class ShardedFeed
+{
+public:
+    ShardedFeed(const ShardedFeedConfig &config, RpcDispatcher &rpc, FeedShard::SnapshotFetch fetchSnapshot,
+                BookManager::ScaleLookup scales = nullptr, SharedBookWriter *sharedBooks = nullptr);
+    ~ShardedFeed();
+
+    void connect();
+    // Renews every connected shard's grant, e.g. when the session's token is renewed
+    void authenticate();
+    // Groups the instruments by shard and sends one batch per shard
+    void subscribe(const std::vector<std::string> &instruments, const BookChannel &channel = BookChannel());
+    void unsubscribe(const std::vector<std::string> &instruments);
+    // Blocks until every shard carrying one of the instruments has had it
+    // confirmed (every leg, in redundant mode); false at the deadline
+    bool waitSubscribed(const std::vector<std::string> &instruments, std::chrono::steady_clock::time_point deadline) const;
+
+    // Pins an instrument to a shard instead of its hash placement (not in
+    // redundant mode, where every shard has every instrument). A subscribed
+    // instrument moves make-before-break: the new shard subscribes, takes the
+    // board slot over once its own book has caught up, and only then is the
+    // old shard unsubscribed, so the merged book never misses an update.
+    bool assign(const std::string &instrument, uint32_t shard);
+    uint32_t shardFor(std::string_view instrument) const;
+
+    size_t size() const { return shards.size(); }
+    FeedShard &shard(size_t i) { return *shards[i]; }
+    const FeedShard &shard(size_t i) const { return *shards[i]; }
+
+    // Lock-free merged read path: look the slot up once, then read it as often as needed
+    uint32_t bookSlot(const std::string &instrument) { return board.slotFor(instrument); }
+    bool topOfBook(uint32_t slot, TopOfBook &top) const { return board.read(slot, top); }
+    uint32_t bookOwner(uint32_t slot) const { return board.owner(slot); }
+    // Per-leg win rates and lag, redundant mode only
+    const FeedArbiter *arbitration() const { return arbiter.get(); }
+
+    bool inject(uint32_t shard, std::string_view payload, int64_t receivedUnixNs);
+    size_t queuedFrames() const;
+    uint64_t bookGaps() const;
+
+private:
+    uint32_t placement(std::string_view instrument) const;
+    void handoff(const std::string &instrument, uint32_t previous);
+
+    TopOfBookBoard board;
+    std::unique_ptr<FeedArbiter> arbiter;
+    mutable std::mutex assignmentMutex;
+    std::unordered_map<std::string, uint32_t> assignments; // explicit placements
+    std::vector<std::unique_ptr<FeedShard>> shards;
+};
@@ -0,0 +1,288 @@
+#include "shared_book.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "latency_histogram.hpp"
+#include "logger.hpp"
+
+using namespace shared_book;
+
+namespace
+{
+    size_t segmentSize(uint32_t capacity)
+    {
+        // Slots start on their own cache line after the header
+        return sizeof(Slot) * (1 + size_t(capacity));
+    }
+
+    Slot *firstSlot(void *base)
+    {
+        return reinterpret_cast<Slot *>(static_cast<char *>(base) + sizeof(Slot));
+    }
+
+    static_assert(sizeof(Header) <= sizeof(Slot), "the header must fit in the space before the first slot");
+}
+
+SharedBookWriter::SharedBookWriter(const std::string &name, uint32_t capacity, uint32_t depth) : segmentName(name)
+{
+    // A segment left behind by a previous run may have another layout
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        LOG_ERROR("shm_open {} failed: {}", name, std::strerror(errno));
+        return;
+    }
+    size_t size = segmentSize(capacity);
+    void *base = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(size)) == 0)
+    {
+        base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    int error = errno;
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        LOG_ERROR("Mapping shared book segment {} failed: {}", name, std::strerror(error));
+        shm_unlink(name.c_str());
+        return;
+    }
+
+    // ftruncate zero-fills, which is every atomic's initial value
+    mappedSize = size;
+    header = static_cast<Header *>(base);
+    slots = firstSlot(base);
+    header->version = Version;
+    header->capacity = capacity;
+    header->depth = std::min(depth, MaxDepth);
+    header->createdUnixNs = unixNanos();
+    header->magic.store(Magic, std::memory_order_release);
+}
+
+SharedBookWriter::~SharedBookWriter()
+{
+    if (header)
+    {
+        munmap(header, mappedSize);
+        shm_unlink(segmentName.c_str());
+    }
+}
+
+uint32_t SharedBookWriter::slotFor(std::string_view instrument)
+{
+    std::lock_guard<std::mutex> lock(namesMutex);
+    uint32_t slot = names.find(instrument);
+    if (slot != InstrumentRegistry::NotFound || !header || names.size() >= header->capacity ||
+        instrument.size() >= NameSize)
+    {
+        return slot;
+    }
+    slot = names.intern(instrument);
+    std::memcpy(slots[slot].instrument, instrument.data(), instrument.size());
+    header->count.store(slot + 1, std::memory_order_release);
+    return slot;
+}
+
+void SharedBookWriter::publish(uint32_t slot, const OrderBook &book)
+{
+    Slot &s = slots[slot];
+    // Writers are other feed threads, briefly; wait them out, as skipping
+    // could leave an older book published
+    uint32_t sequence = s.sequence.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        if (sequence & 1)
+        {
+            sequence = s.sequence.load(std::memory_order_relaxed);
+            continue;
+        }
+        if (s.sequence.compare_exchange_weak(sequence, sequence + 1, std::memory_order_acquire))
+        {
+            break;
+        }
+    }
+    if (sequence != 0 && book.changeId() <= s.changeId.load(std::memory_order_relaxed))
+    {
+        // Nothing was written, so readers need not retry
+        s.sequence.store(sequence, std::memory_order_release);
+        return;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const TickScale &scale = book.scale();
+    const uint32_t depth = header->depth;
+    const uint32_t bids = static_cast<uint32_t>(std::min<size_t>(depth, book.bidDepth()));
+    const uint32_t asks = static_cast<uint32_t>(std::min<size_t>(depth, book.askDepth()));
+    for (uint32_t i = 0; i < bids; ++i)
+    {
+        const PriceLevel &level = book.bid(i);
+        s.bidTicks[i].store(level.ticks, std::memory_order_relaxed);
+        s.bidLots[i].store(level.lots, std::memory_order_relaxed);
+    }
+    for (uint32_t i = 0; i < asks; ++i)
+    {
+        const PriceLevel &level = book.ask(i);
+        s.askTicks[i].store(level.ticks, std::memory_order_relaxed);
+        s.askLots[i].store(level.lots, std::memory_order_relaxed);
+    }
+    s.tickMantissa.store(scale.tick.mantissa, std::memory_order_relaxed);
+    s.tickExponent.store(scale.tick.exponent, std::memory_order_relaxed);
+    s.lotMantissa.store(scale.lot.mantissa, std::memory_order_relaxed);
+    s.lotExponent.store(scale.lot.exponent, std::memory_order_relaxed);
+    s.bidLevels.store(bids, std::memory_order_relaxed);
+    s.askLevels.store(asks, std::memory_order_relaxed);
+    s.changeId.store(book.changeId(), std::memory_order_relaxed);
+    s.timestamp.store(book.timestamp(), std::memory_order_relaxed);
+    s.publishedUnixNs.store(unixNanos(), std::memory_order_relaxed);
+    s.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void SharedBookPublisher::publish(uint32_t instrumentId, const OrderBook &book)
+{
+    if (instrumentId >= slots.size())
+    {
+        slots.resize(instrumentId + 1, InstrumentRegistry::NotFound);
+    }
+    uint32_t &slot = slots[instrumentId];
+    if (slot == InstrumentRegistry::NotFound)
+    {
+        slot = writer.slotFor(book.instrument());
+        if (slot == InstrumentRegistry::NotFound)
+        {
+            LOG_WARN("Shared book segment is full, {} is not published", book.instrument());
+            slot = NoSlot;
+        }
+    }
+    if (slot != NoSlot)
+    {
+        writer.publish(slot, book);
+    }
+}
+
+SharedBookReader::~SharedBookReader()
+{
+    if (header)
+    {
+        munmap(const_cast<Header *>(header), mappedSize);
+    }
+}
+
+bool SharedBookReader::open(const std::string &name, std::string &error)
+{
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+    {
+        error = name + ": " + std::strerror(errno);
+        return false;
+    }
+    struct stat info;
+    void *base = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= segmentSize(0))
+    {
+        base = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        error = name + ": not a shared book segment";
+        return false;
+    }
+    const Header *mapped = static_cast<const Header *>(base);
+    if (mapped->magic.load(std::memory_order_acquire) != Magic || mapped->version != Version ||
+        segmentSize(mapped->capacity) > static_cast<size_t>(info.st_size))
+    {
+        munmap(base, info.st_size);
+        error = name + ": not a shared book segment of this version";
+        return false;
+    }
+    if (header)
+    {
+        munmap(const_cast<Header *>(header), mappedSize);
+    }
+    mappedSize = info.st_size;
+    header = mapped;
+    slots = firstSlot(base);
+    return true;
+}
+
+uint32_t SharedBookReader::size() const
+{
+    return header ? header->count.load(std::memory_order_acquire) : 0;
+}
+
+std::string_view SharedBookReader::instrument(uint32_t slot) const
+{
+    const char *name = slots[slot].instrument;
+    return std::string_view(name, strnlen(name, NameSize));
+}
+
+uint32_t SharedBookReader::find(std::string_view name) const
+{
+    const uint32_t count = size();
+    for (uint32_t slot = 0; slot < count; ++slot)
+    {
+        if (instrument(slot) == name)
+        {
+            return slot;
+        }
+    }
+    return NotFound;
+}
+
+bool SharedBookReader::read(uint32_t slot, SharedBookSnapshot &out, uint32_t levels) const
+{
+    const Slot &s = slots[slot];
+    levels = std::min(levels, MaxDepth);
+    // Raw grid units, converted once the copy is known to be consistent
+    int64_t bidTicks[MaxDepth], bidLots[MaxDepth], askTicks[MaxDepth], askLots[MaxDepth];
+    TickScale scale;
+    uint32_t before;
+    for (;;)
+    {
+        before = s.sequence.load(std::memory_order_acquire);
+        if (before & 1)
+        {
+            continue;
+        }
+        out.changeId = s.changeId.load(std::memory_order_relaxed);
+        out.timestamp = s.timestamp.load(std::memory_order_relaxed);
+        out.publishedUnixNs = s.publishedUnixNs.load(std::memory_order_relaxed);
+        out.bidLevels = std::min(s.bidLevels.load(std::memory_order_relaxed), levels);
+        out.askLevels = std::min(s.askLevels.load(std::memory_order_relaxed), levels);
+        scale.tick.mantissa = s.tickMantissa.load(std::memory_order_relaxed);
+        scale.tick.exponent = s.tickExponent.load(std::memory_order_relaxed);
+        scale.lot.mantissa = s.lotMantissa.load(std::memory_order_relaxed);
+        scale.lot.exponent = s.lotExponent.load(std::memory_order_relaxed);
+        for (uint32_t i = 0; i < out.bidLevels; ++i)
+        {
+            bidTicks[i] = s.bidTicks[i].load(std::memory_order_relaxed);
+            bidLots[i] = s.bidLots[i].load(std::memory_order_relaxed);
+        }
+        for (uint32_t i = 0; i < out.askLevels; ++i)
+        {
+            askTicks[i] = s.askTicks[i].load(std::memory_order_relaxed);
+            askLots[i] = s.askLots[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.sequence.load(std::memory_order_relaxed) == before)
+        {
+            break;
+        }
+    }
+    for (uint32_t i = 0; i < out.bidLevels; ++i)
+    {
+        out.bids[i].price = scale.price(bidTicks[i]);
+        out.bids[i].amount = scale.amount(bidLots[i]);
+    }
+    for (uint32_t i = 0; i < out.askLevels; ++i)
+    {
+        out.asks[i].price = scale.price(askTicks[i]);
+        out.asks[i].amount = scale.amount(askLots[i]);
+    }
+    return before != 0;
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "instrument_registry.hpp"
+#include "order_book.hpp"
+
+// Books published into a POSIX shared-memory segment for other processes.
+// The segment is a header followed by one slot per instrument. Each slot is a
+// seqlock like TopOfBookBoard's: the writer makes the sequence odd, stores the
+// fields and makes it even again. Readers copy the slot and retry if the
+// sequence moved, so they never lock, wait for the writer or make a system
+// call after open().
+namespace shared_book
+{
+    constexpr uint64_t Magic = 0x4b4f424d48534354ull; // "TCSHMBOK"
+    constexpr uint32_t Version = 1; // bump on any layout change
+    constexpr uint32_t MaxDepth = 20;
+    constexpr size_t NameSize = 64;
+
+    struct Header
+    {
+        std::atomic<uint64_t> magic; // stored last, so a reader never sees a half-made header
+        uint32_t version;
+        uint32_t capacity; // slots
+        uint32_t depth;    // levels per side the writer fills, at most MaxDepth
+        std::atomic<uint32_t> count; // slots in use; their names are final
+        int64_t createdUnixNs;
+    };
+
+    struct alignas(64) Slot
+    {
+        std::atomic<uint32_t> sequence; // odd while a write is in progress
+        char instrument[NameSize];      // written once, before count covers the slot
+        std::atomic<uint64_t> changeId;
+        std::atomic<int64_t> timestamp;       // exchange time of the update, ms
+        std::atomic<int64_t> publishedUnixNs; // when it was written here
+        std::atomic<uint32_t> bidLevels;
+        std::atomic<uint32_t> askLevels;
+        // The book's own grid; readers convert, so a publish is plain integer stores
+        std::atomic<int64_t> tickMantissa;
+        std::atomic<int64_t> lotMantissa;
+        std::atomic<int32_t> tickExponent;
+        std::atomic<int32_t> lotExponent;
+        std::atomic<int64_t> bidTicks[MaxDepth]; // best first
+        std::atomic<int64_t> bidLots[MaxDepth];
+        std::atomic<int64_t> askTicks[MaxDepth];
+        std::atomic<int64_t> askLots[MaxDepth];
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<int64_t>::is_always_lock_free,
+                  "shared-memory atomics must be lock-free to work across processes");
+}
+
+struct SharedBookLevel
+{
+    double price = 0;
+    double amount = 0;
+};
+
+// A consistent copy of one slot
+struct SharedBookSnapshot
+{
+    uint64_t changeId = 0;
+    int64_t timestamp = 0;
+    int64_t publishedUnixNs = 0;
+    uint32_t bidLevels = 0;
+    uint32_t askLevels = 0;
+    SharedBookLevel bids[shared_book::MaxDepth]; // best first
+    SharedBookLevel asks[shared_book::MaxDepth];
+};
+
+// Where PipelineConfig publishes books; an empty name leaves it off
+struct SharedBookConfig
+{
+    std::string name;        // POSIX shared-memory name, e.g. "/trading_books"
+    uint32_t capacity = 1024; // instruments
+    uint32_t depth = 10;      // levels per side, at most shared_book::MaxDepth
+};
+
+// Owns the segment. Several threads may publish (feed shards, redundant
+// legs); a slot keeps the highest change_id offered to it, since Deribit
+// change_ids only grow.
+class SharedBookWriter
+{
+public:
+    // Replaces any segment of that name, e.g. "/trading_books"; check ok()
+    SharedBookWriter(const std::string &name, uint32_t capacity = 1024, uint32_t depth = 10);
+    // Unmaps and unlinks; readers keep their mapping but see no more updates
+    ~SharedBookWriter();
+
+    SharedBookWriter(const SharedBookWriter &) = delete;
+    SharedBookWriter &operator=(const SharedBookWriter &) = delete;
+
+    bool ok() const { return header != nullptr; }
+    const std::string &name() const { return segmentName; }
+
+    // Slot of an instrument, assigned on first use; NotFound when full. Takes a mutex, so callers keep the result.
+    uint32_t slotFor(std::string_view instrument);
+    // Writes the top depth levels of book, unless the slot already has this change_id or a later one
+    void publish(uint32_t slot, const OrderBook &book);
+
+private:
+    std::string segmentName;
+    size_t mappedSize = 0;
+    shared_book::Header *header = nullptr;
+    shared_book::Slot *slots = nullptr;
+    std::mutex namesMutex;
+    InstrumentRegistry names;
+};
+
+// One publishing thread's view of the writer: caches the slot of each of its
+// own instrument ids, so a publish after the first is an array lookup
+class SharedBookPublisher
+{
+public:
+    explicit SharedBookPublisher(SharedBookWriter &writer) : writer(writer) {}
+
+    void publish(uint32_t instrumentId, const OrderBook &book);
+
+private:
+    // An instrument that got no slot because the segment is full
+    static constexpr uint32_t NoSlot = InstrumentRegistry::NotFound - 1;
+
+    SharedBookWriter &writer;
+    std::vector<uint32_t> slots; // by instrument id
+};
+
+// Read side, for any process on the host
+class SharedBookReader
+{
+public:
+    static constexpr uint32_t NotFound = InstrumentRegistry::NotFound;
+
+    SharedBookReader() = default;
+    ~SharedBookReader();
+
+    SharedBookReader(const SharedBookReader &) = delete;
+    SharedBookReader &operator=(const SharedBookReader &) = delete;
+
+    // Maps the segment read-only; false with error set if it does not exist
+    // or has another layout. A restarted writer makes a new segment, so long
+    // running readers reopen when the writer is restarted.
+    bool open(const std::string &name, std::string &error);
+
+    // Instruments published so far
+    uint32_t size() const;
+    std::string_view instrument(uint32_t slot) const;
+    // Linear scan of the names; look an instrument up once and keep the slot
+    uint32_t find(std::string_view instrument) const;
+
+    // Changes with every publish, so a poller can skip unchanged slots without copying them
+    uint32_t version(uint32_t slot) const { return slots[slot].sequence.load(std::memory_order_acquire); }
+    // Copies up to levels levels per side; false if nothing is published yet
+    bool read(uint32_t slot, SharedBookSnapshot &out, uint32_t levels = shared_book::MaxDepth) const;
+
+private:
+    size_t mappedSize = 0;
+    const shared_book::Header *header = nullptr;
+    const shared_book::Slot *slots = nullptr;
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// What push() does when the ring is full
+enum class OverflowPolicy
+{
+    DropNewest, // reject the new element and count it as dropped
+    Block       // spin until the consumer frees a slot
+};
+
+// Bounded lock-free single-producer/single-consumer ring. Slots are allocated
+// once up front and reused: the producer fills a slot in place and the
+// consumer reads it in place, so elements that own buffers (strings, vectors)
+// keep their capacity from lap to lap.
+template <typename T>
+class SpscRing
+{
+public:
+    explicit SpscRing(size_t capacity, OverflowPolicy policy = OverflowPolicy::DropNewest)
+        : slots(roundUp(capacity)), mask(slots.size() - 1), policy(policy) {}
+
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    // Producer side. fill(T &) writes the element into its slot. Returns false
+    // if the element was dropped.
+    template <typename F>
+    bool push(F &&fill)
+    {
+        return push(std::forward<F>(fill), policy);
+    }
+
+    // Same, overriding the ring's policy for this element, e.g. Block for one that must not be lost
+    template <typename F>
+    bool push(F &&fill, OverflowPolicy overflow)
+    {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if (h - cachedTail > mask)
+        {
+            cachedTail = tail.load(std::memory_order_acquire);
+            while (h - cachedTail > mask)
+            {
+                if (overflow == OverflowPolicy::DropNewest)
+                {
+                    dropCount.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                std::this_thread::yield();
+                cachedTail = tail.load(std::memory_order_acquire);
+            }
+        }
+
+        fill(slots[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+
+        const size_t depth = h + 1 - cachedTail;
+        if (depth > highWater.load(std::memory_order_relaxed))
+        {
+            highWater.store(depth, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    // Consumer side. consume(T &) reads the oldest element in place. Returns
+    // false if the ring was empty.
+    template <typename F>
+    bool pop(F &&consume)
+    {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t == cachedHead)
+        {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t == cachedHead)
+            {
+                return false;
+            }
+        }
+
+        consume(slots[t & mask]);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t capacity() const { return slots.size(); }
+    OverflowPolicy overflowPolicy() const { return policy; }
+    size_t depth() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+    size_t highWaterMark() const { return highWater.load(std::memory_order_relaxed); }
+    uint64_t drops() const { return dropCount.load(std::memory_order_relaxed); }
+    uint64_t pushed() const { return head.load(std::memory_order_relaxed); }
+
+private:
+    static size_t roundUp(size_t n)
+    {
+        size_t size = 2;
+        while (size < n)
+            size <<= 1;
+        return size;
+    }
+
+    std::vector<T> slots;
+    const size_t mask;
+    const OverflowPolicy policy;
+
+    // Producer and consumer indices live on separate cache lines, each next to
+    // the side's cached copy of the other index
+    alignas(64) std::atomic<size_t> head{0};
+    size_t cachedTail = 0;
+    alignas(64) std::atomic<size_t> tail{0};
+    size_t cachedHead = 0;
+
+    alignas(64) std::atomic<size_t> highWater{0};
+    std::atomic<uint64_t> dropCount{0};
+};
@@ -0,0 +1,223 @@
+#include "subscription_set.hpp"
+
+#include <algorithm>
+#include "notification_parser.hpp"
+
+using json = nlohmann::json;
+
+namespace
+{
+    bool isInterval(const std::string &interval)
+    {
+        return interval == "raw" || interval == "100ms" || interval == "agg2";
+    }
+
+    bool isGroup(const std::string &group)
+    {
+        return group == "none" || (!group.empty() && std::all_of(group.begin(), group.end(), [](char c)
+                                                                  { return c >= '0' && c <= '9'; }));
+    }
+}
+
+bool BookChannel::parse(const std::string &spec, BookChannel &channel, std::string &error)
+{
+    BookChannel parsed;
+    size_t first = spec.find('.');
+    if (first == std::string::npos)
+    {
+        parsed.interval = spec;
+    }
+    else
+    {
+        size_t second = spec.find('.', first + 1);
+        if (second == std::string::npos)
+        {
+            error = "expected <group>.<depth>.<interval>: " + spec;
+            return false;
+        }
+        parsed.group = spec.substr(0, first);
+        std::string depth = spec.substr(first + 1, second - first - 1);
+        parsed.interval = spec.substr(second + 1);
+        parsed.depth = depth == "1" ? 1 : depth == "10" ? 10 : depth == "20" ? 20 : 0;
+        if (!isGroup(parsed.group))
+        {
+            error = "unknown price grouping: " + parsed.group;
+            return false;
+        }
+        if (parsed.depth == 0)
+        {
+            error = "depth must be 1, 10 or 20: " + depth;
+            return false;
+        }
+    }
+    if (!isInterval(parsed.interval))
+    {
+        error = "interval must be raw, 100ms or agg2: " + parsed.interval;
+        return false;
+    }
+    channel = parsed;
+    return true;
+}
+
+bool groupByChannel(const std::vector<std::string> &entries, const BookChannel &defaultChannel, BookChannelGroups &groups,
+                    std::string &error)
+{
+    for (const auto &entry : entries)
+    {
+        size_t at = entry.find('@');
+        std::string spec = at == std::string::npos ? "" : entry.substr(at + 1);
+        BookChannel channel = defaultChannel;
+        if (!spec.empty() && !BookChannel::parse(spec, channel, error))
+        {
+            return false;
+        }
+        auto &group = groups[spec];
+        group.first = channel;
+        group.second.push_back(entry.substr(0, at));
+    }
+    return true;
+}
+
+std::string BookChannel::spec() const
+{
+    return group.empty() ? interval : group + "." + std::to_string(depth) + "." + interval;
+}
+
+std::string BookChannel::name(const std::string &instrument) const
+{
+    return "book." + instrument + "." + spec();
+}
+
+std::vector<json> SubscriptionSet::batches(const std::vector<std::string> &channels)
+{
+    std::vector<json> params;
+    for (size_t first = 0; first < channels.size(); first += MaxChannelsPerRequest)
+    {
+        size_t last = std::min(channels.size(), first + MaxChannelsPerRequest);
+        params.push_back({{"channels", std::vector<std::string>(channels.begin() + first, channels.begin() + last)}});
+    }
+    return params;
+}
+
+std::vector<std::string> SubscriptionSet::add(const std::vector<std::string> &instruments, const BookChannel &channel,
+                                              std::vector<std::string> &replaced)
+{
+    std::vector<std::string> channels;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto &instrument : instruments)
+    {
+        auto inserted = wantedBooks.emplace(instrument, channel);
+        if (!inserted.second)
+        {
+            if (inserted.first->second == channel)
+            {
+                continue;
+            }
+            replaced.push_back(inserted.first->second.name(instrument));
+            inserted.first->second = channel;
+        }
+        channels.push_back(channel.name(instrument));
+    }
+    return channels;
+}
+
+std::vector<std::string> SubscriptionSet::remove(const std::vector<std::string> &instruments)
+{
+    std::vector<std::string> channels;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto &instrument : instruments)
+    {
+        auto it = wantedBooks.find(instrument);
+        if (it != wantedBooks.end())
+        {
+            channels.push_back(it->second.name(instrument));
+            wantedBooks.erase(it);
+        }
+    }
+    return channels;
+}
+
+std::vector<std::string> SubscriptionSet::wanted() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string> channels;
+    channels.reserve(wantedBooks.size());
+    for (const auto &book : wantedBooks)
+    {
+        channels.push_back(book.second.name(book.first));
+    }
+    return channels;
+}
+
+bool SubscriptionSet::wants(const std::string &instrument) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return wantedBooks.count(instrument) != 0;
+}
+
+BookChannel SubscriptionSet::channel(const std::string &instrument) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = wantedBooks.find(instrument);
+    return it != wantedBooks.end() ? it->second : BookChannel();
+}
+
+void SubscriptionSet::confirm(const json &response, bool subscribed)
+{
+    if (!response.contains("result") || !response["result"].is_array())
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto &channel : response["result"])
+    {
+        if (!channel.is_string())
+            continue;
+        const std::string &name = channel.get_ref<const std::string &>();
+        std::string instrument(bookChannelInstrument(name));
+        if (instrument.empty())
+            continue;
+        if (subscribed)
+        {
+            confirmedInstruments.insert(std::move(instrument));
+            continue;
+        }
+        // The old channel of an instrument that moved to another one; the new channel's answer decides
+        auto wanted = wantedBooks.find(instrument);
+        if (wanted == wantedBooks.end() || wanted->second.name(instrument) == name)
+            confirmedInstruments.erase(instrument);
+    }
+    confirmedChanged.notify_all();
+}
+
+void SubscriptionSet::clearConfirmed()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    confirmedInstruments.clear();
+}
+
+std::vector<std::string> SubscriptionSet::confirmed() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::vector<std::string>(confirmedInstruments.begin(), confirmedInstruments.end());
+}
+
+size_t SubscriptionSet::wantedCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return wantedBooks.size();
+}
+
+size_t SubscriptionSet::confirmedCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return confirmedInstruments.size();
+}
+
+bool SubscriptionSet::waitConfirmed(const std::vector<std::string> &instruments, std::chrono::steady_clock::time_point deadline) const
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return confirmedChanged.wait_until(lock, deadline, [&]
+                                       { return std::all_of(instruments.begin(), instruments.end(), [this](const std::string &instrument)
+                                                            { return confirmedInstruments.count(instrument) > 0; }); });
+}
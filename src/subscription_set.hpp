@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// Which book.* channel an instrument is streamed on. The incremental channels
+// book.<instrument>.<interval> send deltas every raw change, every 100ms or
+// aggregated (agg2); raw needs an authenticated session. The grouped channels
+// book.<instrument>.<group>.<depth>.<interval> send the top depth levels, with
+// prices grouped, as a full snapshot each time.
+struct BookChannel
+{
+    std::string interval = "100ms"; // raw, 100ms or agg2
+    std::string group;              // empty for the incremental channel, else none or a grouping such as 1, 5, 10
+    int depth = 0;                  // grouped channel only: 1, 10 or 20 levels
+
+    // "raw", "100ms", "agg2" or "<group>.<depth>.<interval>", e.g. "none.10.100ms"
+    static bool parse(const std::string &spec, BookChannel &channel, std::string &error);
+    std::string spec() const;
+    std::string name(const std::string &instrument) const;
+    bool operator==(const BookChannel &other) const
+    {
+        return interval == other.interval && group == other.group && depth == other.depth;
+    }
+    bool operator!=(const BookChannel &other) const { return !(*this == other); }
+};
+
+// Instruments of a subscription, grouped by channel spec (empty for the default channel)
+using BookChannelGroups = std::map<std::string, std::pair<BookChannel, std::vector<std::string>>>;
+
+// Groups entries of the form name or name@channel, e.g. BTC-PERPETUAL@raw or
+// ETH-PERPETUAL@none.10.100ms, so each group can go out as one subscription
+bool groupByChannel(const std::vector<std::string> &entries, const BookChannel &defaultChannel, BookChannelGroups &groups,
+                    std::string &error);
+
+// Book channels wanted on one WebSocket session and the instruments the server
+// has confirmed. The wanted set outlives the connection and is re-sent when it
+// comes back; the confirmed set only changes on a server answer and is cleared
+// on close. Thread safe: changed by the caller, confirmed from the processing
+// thread and cleared from the I/O thread.
+class SubscriptionSet
+{
+public:
+    // Channels per public/subscribe request, keeping each frame well under the server's size limit
+    static constexpr size_t MaxChannelsPerRequest = 256;
+
+    // Params objects of at most MaxChannelsPerRequest channels each
+    static std::vector<nlohmann::json> batches(const std::vector<std::string> &channels);
+
+    // Return the channels that were not already wanted (add) or still wanted
+    // (remove). An instrument wanted on another channel moves to the new one
+    // and its old channel goes into replaced, to be unsubscribed.
+    std::vector<std::string> add(const std::vector<std::string> &instruments, const BookChannel &channel,
+                                 std::vector<std::string> &replaced);
+    std::vector<std::string> remove(const std::vector<std::string> &instruments);
+    std::vector<std::string> wanted() const;
+    bool wants(const std::string &instrument) const;
+    // Channel the instrument is wanted on; the default if it is not wanted
+    BookChannel channel(const std::string &instrument) const;
+
+    // Applies a public/subscribe or public/unsubscribe response, which lists the channels acted on
+    void confirm(const nlohmann::json &response, bool subscribed);
+    void clearConfirmed();
+
+    std::vector<std::string> confirmed() const;
+    size_t wantedCount() const;
+    size_t confirmedCount() const;
+    // Blocks until the server has confirmed every instrument or the deadline
+    // passes; woken by each confirm, so it returns as soon as the answer arrives
+    bool waitConfirmed(const std::vector<std::string> &instruments, std::chrono::steady_clock::time_point deadline) const;
+
+private:
+    mutable std::mutex mutex;
+    mutable std::condition_variable confirmedChanged;
+    std::map<std::string, BookChannel> wantedBooks; // by instrument
+    std::unordered_set<std::string> confirmedInstruments;
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <sched.h>
+#include <thread>
+#include <vector>
+
+// Pins a thread to one CPU core. A negative core leaves it unpinned.
+inline bool pinThreadToCore(std::thread &thread, int core)
+{
+    if (core < 0)
+    {
+        return true;
+    }
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core, &cpus);
+    return pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus) == 0;
+}
+
+// Short-lived threads that must not outlive their owner, e.g. REST fetches
+// that post their result back to it. Finished threads are joined by the next
+// run(); joinAll() waits for the rest and refuses new ones, and is called by
+// the owner before the members the tasks use go away.
+class WorkerThreads
+{
+public:
+    WorkerThreads() = default;
+    ~WorkerThreads() { joinAll(); }
+
+    WorkerThreads(const WorkerThreads &) = delete;
+    WorkerThreads &operator=(const WorkerThreads &) = delete;
+
+    // Starts task on its own thread; false, without running it, once joinAll() has been called
+    bool run(std::function<void()> task)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopped)
+        {
+            return false;
+        }
+        for (auto it = workers.begin(); it != workers.end();)
+        {
+            if (it->done->load(std::memory_order_acquire))
+            {
+                it->thread.join();
+                it = workers.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        auto done = std::make_shared<std::atomic<bool>>(false);
+        workers.push_back({std::thread([task = std::move(task), done]
+                                       {
+                                           task();
+                                           done->store(true, std::memory_order_release); }),
+                           done});
+        return true;
+    }
+
+    // Tasks that retry or wait can check this to give up early
+    bool stopping() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stopped;
+    }
+
+    void joinAll()
+    {
+        std::vector<Worker> running;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopped = true;
+            running.swap(workers);
+        }
+        for (Worker &worker : running)
+        {
+            worker.thread.join();
+        }
+    }
+
+private:
+    struct Worker
+    {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> done;
+    };
+
+    mutable std::mutex mutex;
+    bool stopped = false;
+    std::vector<Worker> workers;
+};
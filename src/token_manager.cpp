@@ -0,0 +1,146 @@
+#include "token_manager.hpp"
+
+#include <algorithm>
+#include "logger.hpp"
+
+using json = nlohmann::json;
+
+namespace
+{
+    const std::string NoToken;
+
+    int64_t nowUnixMs()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+}
+
+TokenManager::TokenManager(Fetch fetch) : fetch(std::move(fetch))
+{
+}
+
+TokenManager::~TokenManager()
+{
+    stop();
+}
+
+bool TokenManager::authenticate(const std::string &id, const std::string &secret)
+{
+    stop();
+    clientId = id;
+    clientSecret = secret;
+    if (!grant({{"grant_type", "client_credentials"}, {"client_id", clientId}, {"client_secret", clientSecret}}, true))
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    running = true;
+    refresher = std::thread(&TokenManager::refreshLoop, this);
+    return true;
+}
+
+void TokenManager::setListener(Listener newListener)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    listener = std::move(newListener);
+}
+
+void TokenManager::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    wake.notify_all();
+    if (refresher.joinable())
+    {
+        refresher.join();
+    }
+}
+
+const std::string &TokenManager::token() const
+{
+    const AccessToken *token = current();
+    return token ? token->accessToken : NoToken;
+}
+
+// Requests a token and publishes it. Only the caller of authenticate and then the refresh thread get here.
+bool TokenManager::grant(const json &params, bool initial)
+{
+    json request = {{"jsonrpc", "2.0"}, {"id", nextRequestId++}, {"method", "public/auth"}, {"params", params}};
+    int64_t requestedAt = nowUnixMs();
+    std::string response = fetch(request);
+    json parsed = json::parse(response, nullptr, false);
+    if (parsed.is_discarded() || !parsed.contains("result") || !parsed["result"].contains("access_token"))
+    {
+        LOG_ERROR("{} failed: {}", initial ? "Authentication" : "Token renewal",
+                  parsed.is_object() && parsed.contains("error") ? parsed["error"].dump() : std::string("no response"));
+        return false;
+    }
+
+    const json &result = parsed["result"];
+    auto token = std::make_unique<AccessToken>();
+    token->accessToken = result["access_token"].get<std::string>();
+    token->refreshToken = result.value("refresh_token", std::string());
+    // Counted from the request so the clock runs out early rather than late
+    token->expiresAtUnixMs = requestedAt + result.value("expires_in", int64_t(900)) * 1000;
+
+    published.store(token.get(), std::memory_order_release);
+    tokens.push_back(std::move(token));
+    if (tokens.size() > RetiredTokens + 1)
+    {
+        tokens.pop_front();
+    }
+    return true;
+}
+
+void TokenManager::refreshLoop()
+{
+    auto renewalDelay = [](const AccessToken &token)
+    {
+        int64_t lifetime = token.expiresAtUnixMs - nowUnixMs();
+        return std::chrono::milliseconds(std::max<int64_t>(0, (int64_t)(lifetime * RenewAt)));
+    };
+
+    std::chrono::milliseconds wait = renewalDelay(*tokens.back());
+    std::chrono::milliseconds backoff(1000);
+    std::unique_lock<std::mutex> lock(mutex);
+    while (running)
+    {
+        if (wake.wait_for(lock, wait, [this]
+                          { return !running; }))
+        {
+            break;
+        }
+
+        std::string refreshToken = tokens.back()->refreshToken;
+        lock.unlock();
+        bool renewed = !refreshToken.empty() &&
+                       grant({{"grant_type", "refresh_token"}, {"refresh_token", refreshToken}}, false);
+        if (!renewed)
+        {
+            // The refresh token may have expired or been revoked; start over from the credentials
+            renewed = grant({{"grant_type", "client_credentials"}, {"client_id", clientId}, {"client_secret", clientSecret}}, false);
+        }
+        lock.lock();
+
+        if (!renewed)
+        {
+            // The current token is still valid for a while, so retry well before it runs out
+            wait = backoff;
+            backoff = std::min(backoff * 2, std::chrono::milliseconds(30000));
+            continue;
+        }
+        backoff = std::chrono::milliseconds(1000);
+        wait = renewalDelay(*tokens.back());
+        renewCount.fetch_add(1, std::memory_order_relaxed);
+        LOG_INFO("Access token renewed, expires in {} s", (tokens.back()->expiresAtUnixMs - nowUnixMs()) / 1000);
+        if (listener)
+        {
+            Listener notify = listener;
+            lock.unlock();
+            notify(*tokens.back());
+            lock.lock();
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <nlohmann/json.hpp>
+
+// One public/auth grant
+struct AccessToken
+{
+    std::string accessToken;
+    std::string refreshToken;
+    int64_t expiresAtUnixMs = 0;
+};
+
+// Keeps an access token valid for the life of the client. authenticate()
+// does the one blocking client_credentials grant; after that a background
+// thread renews the token with its refresh_token well before it expires
+// (falling back to client_credentials if the refresh is refused) and
+// publishes each new token with a single atomic pointer store. Readers load
+// the pointer and never lock or wait.
+class TokenManager
+{
+public:
+    // Posts a public/auth request over REST and returns the response body, empty on failure
+    using Fetch = std::function<std::string(const nlohmann::json &request)>;
+    // Called on the refresh thread after every renewal
+    using Listener = std::function<void(const AccessToken &token)>;
+
+    // Published tokens kept alive after they are replaced. With renewals
+    // minutes apart, a reference obtained from current() stays valid for
+    // hours, far longer than any request that uses it.
+    static constexpr size_t RetiredTokens = 8;
+    // Renew once this share of the lifetime has passed
+    static constexpr double RenewAt = 0.75;
+
+    explicit TokenManager(Fetch fetch);
+    ~TokenManager();
+
+    TokenManager(const TokenManager &) = delete;
+    TokenManager &operator=(const TokenManager &) = delete;
+
+    // Blocking first grant; starts the refresh thread on success
+    bool authenticate(const std::string &clientId, const std::string &clientSecret);
+    void setListener(Listener listener);
+    void stop();
+
+    // Current token, nullptr before the first grant
+    const AccessToken *current() const { return published.load(std::memory_order_acquire); }
+    // Empty before the first grant
+    const std::string &token() const;
+    uint64_t renewals() const { return renewCount.load(std::memory_order_relaxed); }
+
+private:
+    bool grant(const nlohmann::json &params, bool initial);
+    void refreshLoop();
+
+    Fetch fetch;
+    std::string clientId;
+    std::string clientSecret;
+    uint64_t nextRequestId = 1;
+
+    std::atomic<const AccessToken *> published{nullptr};
+    std::deque<std::unique_ptr<AccessToken>> tokens; // newest at the back, refresh thread only after the first grant
+    std::atomic<uint64_t> renewCount{0};
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool running = false;
+    Listener listener;
+    std::thread refresher;
+};
@@ -0,0 +1,1369 @@
+#include "trading_client.hpp"
+
+#include <iostream>
+#include "logger.hpp"
+#include "notification_parser.hpp"
+#include "order_encoder.hpp"
+#include "order_messages.hpp"
+#include "thread_util.hpp"
+
+using json = nlohmann::json;
+
+namespace
+{
+    // Order bodies are encoded on the calling thread; REST sends block on the buffer until they return
+    OrderEncoder &orderEncoder()
+    {
+        thread_local OrderEncoder encoder;
+        return encoder;
+    }
+
+    // Order updates and fills of every instrument, as they happen
+    const std::vector<std::string> OrderChannels = {"user.orders.any.any.raw", "user.trades.any.any.raw"};
+
+    std::future<nlohmann::json> rejectedOrder(uint64_t id, const std::string &error)
+    {
+        // Rejected locally; the exchange would have refused it anyway
+        std::promise<nlohmann::json> rejected;
+        rejected.set_value(RpcDispatcher::makeError(id, RpcDispatcher::InvalidOrderCode, error));
+        return rejected.get_future();
+    }
+
+    // A REST response for a request the rate limiter refused, as the exchange would have answered it
+    std::string rateLimitedResponse(const std::string &reason)
+    {
+        json response = RpcDispatcher::makeError(0, RpcDispatcher::RateLimitedCode, "too_many_requests");
+        response["error"]["data"] = {{"reason", reason}};
+        return response.dump();
+    }
+
+    // Whether the exchange refused a request for lack of credit, without parsing the response
+    bool isTooManyRequests(std::string_view response)
+    {
+        static const std::string code = "\"code\":" + std::to_string(RateLimiter::TooManyRequestsCode);
+        return response.find(code) != std::string_view::npos;
+    }
+
+    void printOpenOrders(const std::vector<OpenOrder> &orders)
+    {
+        std::cout << "All Open Orders:" << std::endl;
+        for (const OpenOrder &order : orders)
+        {
+            std::cout << "Order ID: " << order.orderId << std::endl;
+            std::cout << "Instrument: " << order.instrument << std::endl;
+            std::cout << "Direction: " << order.direction << std::endl;
+            std::cout << "Price: " << order.price << std::endl;
+            std::cout << "Amount: " << order.amount << " (filled " << order.filledAmount << ")\n"
+                      << std::endl;
+        }
+    }
+}
+
+// Function to send a cURL request
+std::string TradingClient::sendRequest(const std::string &endpoint, const json &payload, const std::string &token)
+{
+    std::string reason;
+    if (!rateLimiter.acquire(classifyRequest(endpoint), reason))
+    {
+        // Empty, as for a request that got no response, so callers retry or give up as they would then
+        LOG_WARN("{} not sent: {}", endpoint, reason);
+        return std::string();
+    }
+    return httpPool.post(endpoint, payload.dump(), token);
+}
+
+// Same, recording the round trip of an order request
+std::string TradingClient::sendOrderRequest(LatencyStats::Op op, const std::string &endpoint, std::string_view body, const std::string &token)
+{
+    RequestKind kind = classifyRequest(endpoint);
+    std::string reason;
+    if (!rateLimiter.acquire(kind, reason))
+    {
+        return rateLimitedResponse(reason);
+    }
+    int64_t start = steadyNanos();
+    std::string response = httpPool.post(endpoint, body, token);
+    if (!response.empty())
+    {
+        latency.restRtt[op].record(steadyNanos() - start);
+        if (isTooManyRequests(response))
+        {
+            rateLimiter.throttled(kind);
+        }
+    }
+    return response;
+}
+
+void TradingClient::sendOrderBatch(LatencyStats::Op op, const std::vector<HttpRequest> &requests, const std::vector<size_t> &slots,
+                                   std::vector<OrderResult> &results)
+{
+    // Every request is charged before the batch goes out, so it leaves once the last one's credit is there
+    std::vector<HttpRequest> charged;
+    std::vector<size_t> chargedSlots;
+    std::vector<RequestKind> kinds;
+    for (size_t i = 0; i < requests.size(); ++i)
+    {
+        RequestKind kind = classifyRequest(requests[i].endpoint);
+        if (!rateLimiter.acquire(kind, results[slots[i]].error))
+        {
+            continue;
+        }
+        charged.push_back(requests[i]);
+        chargedSlots.push_back(slots[i]);
+        kinds.push_back(kind);
+    }
+    std::vector<HttpResult> responses = httpPool.postBatch(charged, tokens.token());
+    for (size_t i = 0; i < responses.size(); ++i)
+    {
+        OrderResult &result = results[chargedSlots[i]];
+        if (!responses[i].ok)
+        {
+            result.error = responses[i].error;
+            continue;
+        }
+        latency.restRtt[op].record(responses[i].elapsedNs);
+        if (isTooManyRequests(responses[i].response))
+        {
+            rateLimiter.throttled(kinds[i]);
+        }
+        result.response = json::parse(responses[i].response, nullptr, false);
+        if (result.response.is_discarded() || !result.response.is_object())
+        {
+            result.error = "malformed response";
+        }
+        else if (result.response.contains("error"))
+        {
+            result.error = result.response["error"].dump();
+        }
+        else
+        {
+            result.ok = true;
+            // private/buy answers {"order": {...}, "trades": [...]}, private/cancel the order itself
+            auto found = result.response.find("result");
+            const json &body = found != result.response.end() ? *found : result.response;
+            const json &order = body.is_object() && body.contains("order") ? body["order"] : body;
+            if (order.is_object() && order.contains("order_id") && order["order_id"].is_string())
+            {
+                result.orderId = order["order_id"].get<std::string>();
+            }
+            if (op != LatencyStats::Cancel)
+            {
+                recordOrderResponse(result.response);
+            }
+        }
+    }
+}
+
+ExchangeEndpoint ExchangeEndpoint::forHost(const std::string &host)
+{
+    ExchangeEndpoint endpoint;
+    endpoint.restUrl = "https://" + host + "/api/v2/";
+    endpoint.wsUrl = "wss://" + host + "/ws/api/v2/";
+    return endpoint;
+}
+
+TradingClient::TradingClient(const std::string &id, const std::string &secretId, const PipelineConfig &pipeline)
+    : clientId(id), clientSecretId(secretId), baseUrl(pipeline.endpoint.restUrl), wsUrl(pipeline.endpoint.wsUrl), network(pipeline.network), rateLimiter(pipeline.rateLimits), offline(pipeline.offline), instrumentConfig(pipeline.instruments),
+      latencyReportInterval(pipeline.latencyReportInterval), defaultBookChannel(pipeline.bookChannel),
+      bookConsumer(pipeline.bookConsumer), inbound(pipeline.ringCapacity, pipeline.overflow)
+{
+    wsClient.clear_access_channels(websocketpp::log::alevel::all);
+    wsClient.clear_error_channels(websocketpp::log::elevel::all);
+    wsClient.init_asio();
+    wsClient.set_open_handler(std::bind(&TradingClient::on_open, this, std::placeholders::_1));
+    wsClient.set_message_handler(std::bind(&TradingClient::on_message, this, std::placeholders::_1, std::placeholders::_2));
+    wsClient.set_close_handler(std::bind(&TradingClient::on_close, this, std::placeholders::_1));
+    wsClient.set_socket_init_handler([this](websocketpp::connection_hdl, TlsStream &stream)
+                                     { initSocket(stream, network, tlsSessions); });
+    httpPool.setSocketOptions(network.socket);
+    httpPool.setVerifyPeer(pipeline.endpoint.verifyPeer);
+    // Pay for the TCP+TLS handshakes now instead of on the first order
+    if (!offline)
+    {
+        httpPool.prewarm();
+    }
+
+    BookManager::ScaleLookup scales = [this](const std::string &instrument)
+    { return scaleFor(instrument); };
+    feed.setScaleLookup(scales);
+    feed.setOrderCache(&orderCache);
+    feed.setAnalytics(pipeline.analytics);
+
+    if (!pipeline.sharedBooks.name.empty())
+    {
+        sharedBookWriter = std::make_unique<SharedBookWriter>(pipeline.sharedBooks.name, pipeline.sharedBooks.capacity,
+                                                              pipeline.sharedBooks.depth);
+        if (sharedBookWriter->ok())
+        {
+            sharedBooks = std::make_unique<SharedBookPublisher>(*sharedBookWriter);
+            LOG_INFO("Publishing books to shared memory {}", sharedBookWriter->name());
+        }
+        else
+        {
+            sharedBookWriter.reset();
+        }
+    }
+
+    if (pipeline.sharding.shards > 0)
+    {
+        FeedShard::SnapshotFetch fetch;
+        if (!offline)
+        {
+            fetch = [this](const std::string &instrument)
+            { return fetchBookSnapshot(instrument); };
+        }
+        ShardedFeedConfig sharding = pipeline.sharding;
+        sharding.wsUrl = wsUrl;
+        sharding.network = network;
+        // Shards authenticate like the session, so they can carry raw channels
+        sharding.authParams = [this]
+        { return credentialsGrant(); };
+        shardedFeed = std::make_unique<ShardedFeed>(sharding, rpc, fetch, scales, sharedBookWriter.get());
+        if (pipeline.sharding.redundant)
+        {
+            LOG_INFO("Market data arbitrated over {} redundant connections", shardedFeed->size());
+        }
+        else
+        {
+            LOG_INFO("Market data sharded over {} connections", shardedFeed->size());
+        }
+    }
+
+    if (pipeline.record)
+    {
+        recorder = std::make_unique<FeedRecorder>(pipeline.recorder);
+        feed.setRecorder(recorder.get());
+        LOG_INFO("Recording WebSocket frames to {}", recorder->currentFile());
+    }
+
+    if (bookConsumer || sharedBooks)
+    {
+        feed.setBookListener([this](uint32_t instrumentId, const OrderBook &book, const BookUpdate &update)
+                             {
+                                 if (sharedBooks)
+                                 {
+                                     sharedBooks->publish(instrumentId, book);
+                                 }
+                                 if (bookConsumer)
+                                 {
+                                     conflator.push(instrumentId, book, update);
+                                 } });
+    }
+    if (bookConsumer)
+    {
+        bookConsumerThread = std::thread(&TradingClient::consumeBooksLoop, this);
+    }
+
+    processingThread = std::thread(&TradingClient::processLoop, this);
+    if (!pinThreadToCore(processingThread, pipeline.consumerCore))
+    {
+        LOG_WARN("Could not pin processing thread to core {}", pipeline.consumerCore);
+    }
+    if (latencyReportInterval.count() > 0)
+    {
+        latencyReporter = std::thread(&TradingClient::reportLatencyLoop, this);
+    }
+}
+
+TradingClient::~TradingClient()
+{
+    // Its listener uses the WebSocket session, so it goes first
+    tokens.stop();
+    // Queued requests are refused while the session they were for is still there
+    rateLimiter.stop();
+    // Snapshot fetches post to the WebSocket thread, so they finish while it still runs
+    workers.joinAll();
+    if (wsThread.joinable())
+    {
+        wsClient.stop();
+        wsThread.join();
+    }
+    // The producer is gone, so the processing thread can stop
+    processing = false;
+    processingThread.join();
+    if (bookConsumerThread.joinable())
+    {
+        conflator.stop();
+        bookConsumerThread.join();
+    }
+    if (latencyReporter.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(reporterMutex);
+            latencyReportInterval = std::chrono::seconds(0);
+        }
+        reporterWake.notify_one();
+        latencyReporter.join();
+    }
+}
+
+void TradingClient::on_open(websocketpp::connection_hdl hdl)
+{
+    this->hdl = hdl;
+    ++connectionId;
+    {
+        std::lock_guard<std::mutex> lock(sessionMutex);
+        sessionAuthenticated = false;
+        isConnected = true;
+    }
+    sessionChanged.notify_all();
+    if (network.reuseTlsSessions)
+    {
+        tlsSessions.remember(wsClient.get_con_from_hdl(hdl)->get_socket().native_handle());
+    }
+    LOG_INFO("WebSocket connection established.");
+    authenticateWebSocket();
+    subscribeOrderUpdates();
+
+    // Restore the book subscriptions of the previous session, if any
+    std::vector<std::string> channels = subscriptions.wanted();
+    if (!channels.empty())
+    {
+        sendSubscriptions("public/subscribe", channels);
+    }
+}
+
+// Output From websocket. Runs on the WebSocket thread, so it only hands the frame over.
+void TradingClient::on_message(websocketpp::connection_hdl hdl, client::message_ptr msg)
+{
+    int64_t receivedAt = steadyNanos();
+    int64_t receivedUnixNs = unixNanos();
+    // Order acks, auth answers and user.orders/user.trades cannot be recovered
+    // if dropped, so they wait for room; only book frames follow the ring's policy
+    OverflowPolicy overflow = isBookNotification(msg->get_payload()) ? inbound.overflowPolicy() : OverflowPolicy::Block;
+    inbound.push([&](InboundFrame &frame)
+                 {
+        frame.kind = InboundFrame::WebSocket;
+        frame.payload.swap(msg->get_raw_payload());
+        frame.receivedAt = receivedAt;
+        frame.receivedUnixNs = receivedUnixNs;
+        frame.connectionId = connectionId; },
+                 overflow);
+}
+
+bool TradingClient::injectFrame(std::string_view payload, int64_t receivedUnixNs, uint32_t connectionId)
+{
+    int64_t receivedAt = steadyNanos();
+    return inbound.push([&](InboundFrame &frame)
+                        {
+        frame.kind = InboundFrame::WebSocket;
+        frame.payload.assign(payload);
+        frame.receivedAt = receivedAt;
+        frame.receivedUnixNs = receivedUnixNs != 0 ? receivedUnixNs : unixNanos();
+        frame.connectionId = connectionId; });
+}
+
+void TradingClient::resetLatencyStats()
+{
+    for (int op = 0; op < LatencyStats::OpCount; ++op)
+    {
+        latency.restRtt[op].reset();
+        latency.wsRtt[op].reset();
+    }
+    latency.feed.reset();
+    latency.processing.reset();
+}
+
+// Drains the inbound ring, backing off from spinning to sleeping while it stays empty
+void TradingClient::processLoop()
+{
+    size_t idle = 0;
+    while (processing.load(std::memory_order_relaxed))
+    {
+        if (inbound.pop([this](InboundFrame &frame)
+                        {
+                            feed.handleFrame(frame);
+                            if (frame.kind == InboundFrame::WebSocket)
+                            {
+                                latency.processing.record(steadyNanos() - frame.receivedAt);
+                            } }))
+        {
+            idle = 0;
+        }
+        else if (++idle < 1000)
+        {
+            continue;
+        }
+        else if (idle < 2000)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+}
+
+// Hands each instrument's conflated changes to the book consumer, away from the processing thread
+void TradingClient::consumeBooksLoop()
+{
+    ConflatedBook book;
+    while (processing.load(std::memory_order_relaxed))
+    {
+        if (conflator.pop(book, std::chrono::milliseconds(100)))
+        {
+            bookConsumer(book);
+        }
+    }
+}
+
+// Fetches a fresh snapshot off the processing thread and queues it behind the frames already received
+void TradingClient::requestBookSnapshot(const std::string &instrument)
+{
+    if (offline)
+    {
+        LOG_WARN("{} needs a snapshot but the client is offline", instrument);
+        return;
+    }
+    // Joined by the destructor, so it never outlives the members it posts to
+    workers.run([this, instrument]
+                {
+        std::string response = fetchBookSnapshot(instrument);
+        if (response.empty())
+        {
+            LOG_ERROR("Failed to resync order book for {}", instrument);
+            return;
+        }
+        // The WebSocket thread is the ring's only producer
+        boost::asio::post(wsClient.get_io_service(), [this, response]
+                          { inbound.push([&response](InboundFrame &frame)
+                                         {
+                                             frame.kind = InboundFrame::BookSnapshot;
+                                             frame.payload = response; },
+                                         OverflowPolicy::Block); }); });
+}
+
+// Full-depth public/get_order_book over REST, retried with back-off. Empty if every attempt failed.
+std::string TradingClient::fetchBookSnapshot(const std::string &instrument)
+{
+    for (int attempt = 0; attempt < 3 && !workers.stopping(); ++attempt)
+    {
+        json payload = {
+            {"jsonrpc", "2.0"},
+            {"method", "public/get_order_book"},
+            {"params", {{"instrument_name", instrument}, {"depth", 10000}}},
+            {"id", rpc.nextId()}};
+        std::string response = sendRequest("public/get_order_book", payload);
+        if (!response.empty())
+        {
+            return response;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(200 << attempt));
+    }
+    return "";
+}
+
+// Function to show the WebSocket to processing thread hand-off
+void TradingClient::showPipelineStats()
+{
+    std::cout << "Inbound ring: depth " << inbound.depth() << "/" << inbound.capacity()
+              << ", high-water mark " << inbound.highWaterMark()
+              << ", received " << inbound.pushed()
+              << ", dropped " << inbound.drops() << std::endl;
+    std::cout << "Session TLS: " << tlsSessions.fullHandshakes() << " full handshakes, " << tlsSessions.resumed()
+              << " resumed" << (network.busyPoll ? ", I/O thread busy-polling" : "") << std::endl;
+    if (rateLimiter.enabled())
+    {
+        RateLimiter::Stats limits = rateLimiter.stats();
+        std::cout << "Request credits: matching " << long(rateLimiter.credits(CreditPool::Matching)) << "/"
+                  << long(rateLimiter.pool(CreditPool::Matching).capacity) << ", non-matching "
+                  << long(rateLimiter.credits(CreditPool::NonMatching)) << "/" << long(rateLimiter.pool(CreditPool::NonMatching).capacity)
+                  << "; " << limits.sent << " sent at once, " << limits.delayed << " delayed, " << limits.queued << " queued, "
+                  << limits.rejected << " refused locally, " << limits.throttled << " refused by the exchange" << std::endl;
+    }
+    for (size_t i = 0; shardedFeed && i < shardedFeed->size(); ++i)
+    {
+        const FeedShard &shard = shardedFeed->shard(i);
+        const auto &ring = shard.ring();
+        std::cout << "Shard " << i << (shard.connected() ? "" : " (disconnected)")
+                  << ": depth " << ring.depth() << "/" << ring.capacity()
+                  << ", high-water mark " << ring.highWaterMark()
+                  << ", received " << ring.pushed()
+                  << ", dropped " << ring.drops()
+                  << ", handled " << shard.handledFrames()
+                  << ", published " << shard.publishedUpdates()
+                  << ", gaps " << shard.bookGaps() << std::endl;
+    }
+    if (const FeedArbiter *arbiter = shardedFeed ? shardedFeed->arbitration() : nullptr)
+    {
+        for (uint32_t leg = 0; leg < arbiter->legs(); ++leg)
+        {
+            std::cout << "Leg " << leg << ": won " << arbiter->wins(leg) << " updates ("
+                      << arbiter->winRate(leg) * 100 << "%), duplicates " << arbiter->duplicates(leg) << " ("
+                      << arbiter->unmeasured(leg) << " too far behind to time)" << std::endl;
+        }
+    }
+    if (bookConsumer)
+    {
+        BookConflator::Stats books = conflator.stats();
+        std::cout << "Book consumer: " << books.updates << " updates, " << books.delivered << " delivered, "
+                  << books.conflated << " conflated, " << books.fullBooks << " full books, "
+                  << books.pending << " instruments pending (" << books.pendingLevels << " levels, peak "
+                  << books.peakPendingLevels << ")" << std::endl;
+    }
+    if (recorder)
+    {
+        std::cout << "Recorder: " << recorder->frames() << " frames, " << recorder->bytes() << " bytes in "
+                  << recorder->files() << " files, dropped " << recorder->drops()
+                  << ", writing " << recorder->currentFile() << std::endl;
+    }
+}
+
+// Function to show order round trips, feed latency and processing latency
+void TradingClient::showLatencyStats()
+{
+    for (int op = 0; op < LatencyStats::OpCount; ++op)
+    {
+        std::cout << "REST " << LatencyStats::OpNames[op] << ": " << latency.restRtt[op].describe() << std::endl;
+        std::cout << "WebSocket " << LatencyStats::OpNames[op] << ": " << latency.wsRtt[op].describe() << std::endl;
+    }
+    std::cout << "Feed (exchange to receive): " << latency.feed.describe() << std::endl;
+    std::cout << "Processing (receive to handled): " << latency.processing.describe() << std::endl;
+    for (size_t i = 0; shardedFeed && i < shardedFeed->size(); ++i)
+    {
+        std::cout << "Shard " << i << " feed: " << shardedFeed->shard(i).feedLatency().describe() << std::endl;
+        std::cout << "Shard " << i << " processing: " << shardedFeed->shard(i).processingLatency().describe() << std::endl;
+    }
+    if (const FeedArbiter *arbiter = shardedFeed ? shardedFeed->arbitration() : nullptr)
+    {
+        for (uint32_t leg = 0; leg < arbiter->legs(); ++leg)
+        {
+            std::cout << "Leg " << leg << " behind the winner: " << arbiter->lag(leg).describe() << ", "
+                      << arbiter->unmeasured(leg) << " more too far behind to time" << std::endl;
+        }
+    }
+}
+
+// Writes the non-empty histograms to the log every latencyReportInterval
+void TradingClient::reportLatencyLoop()
+{
+    std::unique_lock<std::mutex> lock(reporterMutex);
+    while (latencyReportInterval.count() > 0)
+    {
+        if (reporterWake.wait_for(lock, latencyReportInterval) == std::cv_status::no_timeout)
+        {
+            continue;
+        }
+        for (int op = 0; op < LatencyStats::OpCount; ++op)
+        {
+            if (latency.restRtt[op].count())
+                LOG_INFO("Latency REST {}: {}", LatencyStats::OpNames[op], latency.restRtt[op].describe());
+            if (latency.wsRtt[op].count())
+                LOG_INFO("Latency WebSocket {}: {}", LatencyStats::OpNames[op], latency.wsRtt[op].describe());
+        }
+        if (latency.feed.count())
+            LOG_INFO("Latency feed: {}", latency.feed.describe());
+        if (latency.processing.count())
+            LOG_INFO("Latency processing: {}", latency.processing.describe());
+    }
+}
+
+void TradingClient::on_close(websocketpp::connection_hdl hdl)
+{
+    {
+        std::lock_guard<std::mutex> lock(sessionMutex);
+        sessionAuthenticated = false;
+        isConnected = false;
+    }
+    sessionChanged.notify_all();
+    // Subscriptions die with the connection; the wanted set is re-sent on the next one
+    subscriptions.clearConfirmed();
+    // Order updates missed while disconnected are picked up by the next seed
+    orderCache.invalidate();
+    LOG_INFO("WebSocket connection closed.");
+    rpc.failAll(RpcDispatcher::DisconnectedCode, "WebSocket connection closed");
+}
+
+// Function to connect websocket
+void TradingClient::connectWebSocket()
+{
+    if (shardedFeed)
+    {
+        shardedFeed->connect();
+    }
+    // One session at a time: already connected or still connecting
+    if (wsRunning)
+    {
+        return;
+    }
+    // The previous session has ended, reap its thread before starting a new one
+    if (wsThread.joinable())
+    {
+        wsThread.join();
+        wsClient.reset();
+    }
+    websocketpp::lib::error_code ec;
+    wsClient.set_tls_init_handler(makeTlsContext);
+
+    client::connection_ptr con = wsClient.get_connection(wsUrl, ec);
+    if (ec)
+    {
+        LOG_ERROR("WebSocket connection error: {}", ec.message());
+        return;
+    }
+
+    wsClient.connect(con);
+    wsRunning = true;
+    wsThread = std::thread([this]()
+                           {
+        runIoContext(wsClient.get_io_service(), network.busyPoll);
+        wsRunning = false; });
+    if (!pinThreadToCore(wsThread, network.ioCore))
+    {
+        LOG_WARN("Could not pin the WebSocket thread to core {}", network.ioCore);
+    }
+}
+
+// Function to send message through websocket
+void TradingClient::sendWebSocketMessage(const std::string &message)
+{
+    if (isConnected)
+    {
+        wsClient.send(hdl, message, websocketpp::frame::opcode::text);
+    }
+    else
+    {
+        LOG_ERROR("Cannot send message. WebSocket not connected.");
+    }
+}
+
+// Sends a JSON-RPC request over the WebSocket; callback receives the matching response
+uint64_t TradingClient::sendRpc(const std::string &method, const json &params, RpcDispatcher::Callback callback)
+{
+    uint64_t id = rpc.nextId();
+    return sendEncodedRpc(id, classifyRequest(method), makeRpcRequest(id, method, params).dump(), std::move(callback));
+}
+
+uint64_t TradingClient::sendEncodedRpc(uint64_t id, RequestKind kind, std::string_view body, RpcDispatcher::Callback callback)
+{
+    rpc.track(id, rpcTimeout, std::move(callback));
+    // Failed before it is charged, so a dropped session does not use up credit
+    if (!isConnected)
+    {
+        rpc.fail(id, RpcDispatcher::DisconnectedCode, "WebSocket not connected");
+        return id;
+    }
+    if (rateLimiter.tryAcquire(kind))
+    {
+        writeRpc(id, body);
+        return id;
+    }
+    // The body may be the encoder's buffer, which the next order reuses, so a queued request keeps a copy
+    rateLimiter.enqueue(kind, [this, id, request = std::string(body)]
+                        { writeRpc(id, request); },
+                        [this, id](const std::string &reason)
+                        { rpc.fail(id, RpcDispatcher::RateLimitedCode, reason); });
+    return id;
+}
+
+void TradingClient::writeRpc(uint64_t id, std::string_view body)
+{
+    if (!isConnected)
+    {
+        rpc.fail(id, RpcDispatcher::DisconnectedCode, "WebSocket not connected");
+        return;
+    }
+    websocketpp::lib::error_code ec;
+    wsClient.send(hdl, body.data(), body.size(), websocketpp::frame::opcode::text, ec);
+    if (ec)
+    {
+        rpc.fail(id, RpcDispatcher::DisconnectedCode, ec.message());
+    }
+}
+
+// Same as above, completing a future instead of calling back
+std::future<json> TradingClient::sendRpc(const std::string &method, const json &params)
+{
+    auto promise = std::make_shared<std::promise<json>>();
+    std::future<json> result = promise->get_future();
+    sendRpc(method, params, [promise](const json &response)
+            { promise->set_value(response); });
+    return result;
+}
+
+// Order request over the WebSocket, recording its round trip unless it failed locally
+std::future<json> TradingClient::sendOrderRpc(LatencyStats::Op op, uint64_t id, std::string_view body)
+{
+    auto promise = std::make_shared<std::promise<json>>();
+    std::future<json> result = promise->get_future();
+    int64_t start = steadyNanos();
+    RequestKind kind = op == LatencyStats::Cancel ? RequestKind::Cancel : RequestKind::Order;
+    sendEncodedRpc(id, kind, body, [this, op, kind, start, promise](const json &response)
+            {
+        int code = response.contains("error") ? response["error"].value("code", 0) : 0;
+        if (code != RpcDispatcher::TimeoutCode && code != RpcDispatcher::DisconnectedCode &&
+            code != RpcDispatcher::RateLimitedCode)
+        {
+            latency.wsRtt[op].record(steadyNanos() - start);
+        }
+        if (code == RateLimiter::TooManyRequestsCode)
+        {
+            rateLimiter.throttled(kind);
+        }
+        if (op != LatencyStats::Cancel)
+        {
+            recordOrderResponse(response);
+        }
+        promise->set_value(response); });
+    return result;
+}
+
+// public/auth params of a client_credentials grant. WebSocket connections get
+// a grant of their own: refresh tokens are single use, and the TokenManager's
+// is spent on its next renewal.
+json TradingClient::credentialsGrant() const
+{
+    return {{"grant_type", "client_credentials"}, {"client_id", clientId}, {"client_secret", clientSecretId}};
+}
+
+// Authenticates the WebSocket session so private methods can go over it
+void TradingClient::authenticateWebSocket()
+{
+    sendRpc("public/auth", credentialsGrant(), [this](const json &response)
+            {
+        if (response.contains("error"))
+        {
+            LOG_ERROR("WebSocket authentication failed: {}", response["error"].dump());
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(sessionMutex);
+            sessionAuthenticated = isConnected;
+        }
+        sessionChanged.notify_all(); });
+}
+
+bool TradingClient::waitForSession(std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(sessionMutex);
+    return sessionChanged.wait_for(lock, timeout, [this]
+                                   { return isConnected && sessionAuthenticated; });
+}
+
+bool TradingClient::waitForBooks(const std::vector<std::string> &instruments, std::chrono::milliseconds timeout)
+{
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    if (shardedFeed)
+    {
+        return shardedFeed->waitSubscribed(instruments, deadline);
+    }
+    return subscriptions.waitConfirmed(instruments, deadline);
+}
+
+std::string_view TradingClient::encodeBuy(uint64_t id, const std::string &instrument, double price, double amount, std::string &error)
+{
+    std::shared_ptr<const InstrumentTable> table = instruments();
+    const InstrumentSpec *spec = table ? table->find(instrument) : nullptr;
+    if (!spec)
+    {
+        return orderEncoder().encodeOrder(id, instrument, OrderEncoder::Side::Buy, OrderEncoder::Type::Limit, price, amount);
+    }
+    if (!spec->validateOrder(price, amount, error))
+    {
+        return std::string_view();
+    }
+    return orderEncoder().encodeOrder(id, instrument, OrderEncoder::Side::Buy, OrderEncoder::Type::Limit, spec->scale,
+                                      spec->scale.ticks(price), spec->scale.lots(amount));
+}
+
+TickScale TradingClient::scaleFor(const std::string &instrument) const
+{
+    std::shared_ptr<const InstrumentTable> table = instruments();
+    const InstrumentSpec *spec = table ? table->find(instrument) : nullptr;
+    return spec ? spec->scale : TickScale();
+}
+
+// Non-blocking order entry over the WebSocket
+std::future<json> TradingClient::placeOrderAsync(const std::string &instrument, double price, double amount)
+{
+    uint64_t id = rpc.nextId();
+    std::string error;
+    std::string_view body = encodeBuy(id, instrument, price, amount, error);
+    if (body.empty())
+    {
+        return rejectedOrder(id, error);
+    }
+    return sendOrderRpc(LatencyStats::Buy, id, body);
+}
+
+std::future<json> TradingClient::modifyOrderAsync(const std::string &orderId, double newPrice, double newAmount)
+{
+    uint64_t id = rpc.nextId();
+    std::string error;
+    std::string_view body = encodeEdit(id, orderId, newPrice, newAmount, error);
+    if (body.empty())
+    {
+        return rejectedOrder(id, error);
+    }
+    return sendOrderRpc(LatencyStats::Edit, id, body);
+}
+
+std::future<json> TradingClient::cancelOrderAsync(const std::string &orderId)
+{
+    uint64_t id = rpc.nextId();
+    OpenOrder order;
+    std::string error;
+    if (!checkOpenOrder(orderId, order, error))
+    {
+        return rejectedOrder(id, error);
+    }
+    return sendOrderRpc(LatencyStats::Cancel, id, orderEncoder().encodeCancel(id, orderId));
+}
+
+// The order as a buy or edit response left it, so a cancel or edit sent right
+// after is not refused before the user.orders update for it arrives
+void TradingClient::recordOrderResponse(const json &response)
+{
+    OpenOrder order;
+    if (parseOrderResponse(response, order))
+    {
+        orderCache.onOrder(order);
+    }
+}
+
+bool TradingClient::checkOpenOrder(const std::string &orderId, OpenOrder &order, std::string &error) const
+{
+    order = OpenOrder();
+    if (!orderCache.seeded() || orderCache.find(orderId, order))
+    {
+        return true;
+    }
+    error = "order " + orderId + " is not open";
+    return false;
+}
+
+std::string_view TradingClient::encodeEdit(uint64_t id, const std::string &orderId, double price, double amount, std::string &error)
+{
+    OpenOrder order;
+    if (!checkOpenOrder(orderId, order, error))
+    {
+        return std::string_view();
+    }
+    std::shared_ptr<const InstrumentTable> table = instruments();
+    const InstrumentSpec *spec = table && !order.instrument.empty() ? table->find(order.instrument) : nullptr;
+    if (!spec)
+    {
+        return orderEncoder().encodeEdit(id, orderId, price, amount);
+    }
+    if (!spec->validateOrder(price, amount, error))
+    {
+        return std::string_view();
+    }
+    return orderEncoder().encodeEdit(id, orderId, spec->scale, spec->scale.ticks(price), spec->scale.lots(amount));
+}
+
+// Streams order changes on this session, then seeds the cache once the server has confirmed
+void TradingClient::subscribeOrderUpdates()
+{
+    sendRpc("private/subscribe", json{{"channels", OrderChannels}}, [this](const json &response)
+            {
+        if (response.contains("error"))
+        {
+            LOG_ERROR("Order update subscription failed: {}", response["error"].dump());
+            return;
+        }
+        seedOrderCache(); });
+}
+
+// private/get_open_orders over REST on a helper thread, so neither the I/O nor the processing thread blocks
+void TradingClient::seedOrderCache()
+{
+    if (offline)
+    {
+        return;
+    }
+    // Joined by the destructor; in script mode main can return while the seed is still in flight
+    workers.run([this]
+                {
+        int64_t requestedUnixMs = unixNanos() / 1000000;
+        json payload = {
+            {"jsonrpc", "2.0"},
+            {"method", "private/get_open_orders"},
+            {"params", json::object()},
+            {"id", rpc.nextId()}};
+        std::vector<OpenOrder> orders;
+        std::string error;
+        if (!parseOpenOrders(sendRequest("private/get_open_orders", payload, tokens.token()), orders, error))
+        {
+            LOG_ERROR("Failed to seed the order cache: {}", error);
+            return;
+        }
+        orderCache.seed(orders, requestedUnixMs);
+        LOG_INFO("Order cache seeded with {} open orders", orders.size()); });
+}
+
+// Function for Subscribing to orderBooks
+void TradingClient::subscribeToOrderBooks(const std::vector<std::string> &instruments)
+{
+    subscribeToOrderBooks(instruments, defaultBookChannel);
+}
+
+void TradingClient::subscribeToOrderBooks(const std::vector<std::string> &instruments, const BookChannel &channel)
+{
+    if (shardedFeed)
+    {
+        shardedFeed->subscribe(instruments, channel);
+        return;
+    }
+    std::vector<std::string> replaced;
+    std::vector<std::string> channels = subscriptions.add(instruments, channel, replaced);
+    // While disconnected the channels go out from on_open instead
+    if (!isConnected)
+    {
+        return;
+    }
+    if (!replaced.empty())
+    {
+        sendSubscriptions("public/unsubscribe", replaced);
+    }
+    if (!channels.empty())
+    {
+        sendSubscriptions("public/subscribe", channels);
+    }
+}
+
+void TradingClient::unsubscribeFromOrderBooks(const std::vector<std::string> &instruments)
+{
+    if (shardedFeed)
+    {
+        shardedFeed->unsubscribe(instruments);
+        return;
+    }
+    std::vector<std::string> channels = subscriptions.remove(instruments);
+    if (!channels.empty() && isConnected)
+    {
+        sendSubscriptions("public/unsubscribe", channels);
+    }
+}
+
+bool TradingClient::assignInstrumentToShard(const std::string &instrument, uint32_t shard)
+{
+    return shardedFeed && shardedFeed->assign(instrument, shard);
+}
+
+// Sends the channels in as few requests as possible. The confirmed set is
+// only changed by the server's answer, which lists the channels it acted on.
+void TradingClient::sendSubscriptions(const std::string &method, const std::vector<std::string> &channels)
+{
+    const bool subscribe = method == "public/subscribe";
+    for (const json &params : SubscriptionSet::batches(channels))
+    {
+        sendRpc(method, params, [this, method, subscribe](const json &response)
+                {
+            if (!response.contains("result") || !response["result"].is_array())
+            {
+                LOG_ERROR("{} failed: {}", method, response.contains("error") ? response["error"].dump() : response.dump());
+                return;
+            }
+            subscriptions.confirm(response, subscribe);
+            LOG_INFO("{}: {} channels confirmed, {} books subscribed", method, response["result"].size(), subscriptions.confirmedCount()); });
+    }
+}
+
+namespace
+{
+    void printSubscriptions(const std::string &title, const SubscriptionSet &subscriptions)
+    {
+        std::vector<std::string> confirmed = subscriptions.confirmed();
+        size_t wanted = subscriptions.wantedCount();
+        std::cout << title << " " << confirmed.size() << " books";
+        if (wanted != confirmed.size())
+        {
+            std::cout << " (" << wanted << " requested)";
+        }
+        std::cout << ":" << std::endl;
+        for (const auto &instrument : confirmed)
+        {
+            std::cout << instrument << std::endl;
+        }
+    }
+}
+
+// Function to show subscription
+void TradingClient::showSubscriptions()
+{
+    if (!shardedFeed)
+    {
+        printSubscriptions("Subscribed to", subscriptions);
+        return;
+    }
+    for (size_t i = 0; i < shardedFeed->size(); ++i)
+    {
+        printSubscriptions("Shard " + std::to_string(i) + " subscribed to", shardedFeed->shard(i).subscribed());
+    }
+}
+
+// Function to authenticate and get accesstoken
+void TradingClient::authenticate()
+{
+    if (!tokens.authenticate(clientId, clientSecretId))
+    {
+        LOG_ERROR("Failed to authenticate.");
+        return;
+    }
+    LOG_INFO("Access token retrieved successfully.");
+    // A renewed REST token means the WebSocket session's grant is about to run out too
+    tokens.setListener([this](const AccessToken &)
+                       {
+        if (isConnected)
+        {
+            authenticateWebSocket();
+        }
+        if (shardedFeed)
+        {
+            shardedFeed->authenticate();
+        } });
+}
+
+bool TradingClient::loadInstruments()
+{
+    auto table = std::make_shared<InstrumentTable>();
+    const std::string &cacheFile = instrumentConfig.cacheFile;
+    if (!cacheFile.empty() && table->load(cacheFile, instrumentConfig.currencies, instrumentConfig.maxAge))
+    {
+        LOG_INFO("Loaded {} instruments from {}", table->size(), cacheFile);
+        std::atomic_store(&instrumentTable, std::shared_ptr<const InstrumentTable>(table));
+        return true;
+    }
+    if (offline)
+    {
+        return false;
+    }
+
+    for (const std::string &currency : instrumentConfig.currencies)
+    {
+        json payload = {
+            {"jsonrpc", "2.0"},
+            {"method", "public/get_instruments"},
+            {"params", {{"currency", currency}, {"expired", false}}},
+            {"id", rpc.nextId()}};
+        std::string error;
+        if (!parseInstruments(sendRequest("public/get_instruments", payload), *table, error))
+        {
+            LOG_ERROR("Failed to load {} instruments: {}", currency, error);
+            return false;
+        }
+    }
+    table->currencies = instrumentConfig.currencies;
+    table->fetchedUnixSeconds = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    LOG_INFO("Loaded {} instruments over REST", table->size());
+    if (!cacheFile.empty() && !table->save(cacheFile))
+    {
+        LOG_WARN("Could not write instrument cache {}", cacheFile);
+    }
+    std::atomic_store(&instrumentTable, std::shared_ptr<const InstrumentTable>(table));
+    return true;
+}
+
+// For placing order
+void TradingClient::placeOrder(const std::string &instrument, const std::string &accessToken, double price, double amount)
+{
+    std::string error;
+    std::string_view body = encodeBuy(rpc.nextId(), instrument, price, amount, error);
+    if (body.empty())
+    {
+        LOG_ERROR("Order not sent: {}", error);
+        return;
+    }
+    std::string response = sendOrderRequest(LatencyStats::Buy, "private/buy", body, accessToken);
+    if (!response.empty())
+    {
+        try
+        {
+            auto responseJson = json::parse(response);
+            if (responseJson.contains("error") && responseJson["error"].contains("data") && responseJson["error"]["data"].contains("reason"))
+            {
+                LOG_ERROR("Error Details: {}", responseJson["error"]["data"]["reason"].dump());
+            }
+            else if (responseJson.contains("message"))
+            {
+                LOG_ERROR("Error Details: {}", responseJson["message"].dump());
+            }
+            else
+            {
+                recordOrderResponse(responseJson);
+                LOG_INFO("Order placed successfully.");
+            }
+        }
+        catch (const std::exception &e)
+        {
+            LOG_ERROR("Error parsing JSON response: {}", e.what());
+        }
+    }
+    else
+    {
+        LOG_ERROR("No response received or error occurred.");
+    }
+}
+
+// Function to get all orders
+void TradingClient::getAllOpenOrders()
+{
+    // The cache is current once seeded, so no round trip is needed
+    if (orderCache.seeded())
+    {
+        std::vector<OpenOrder> orders = orderCache.openOrders();
+        if (orders.empty())
+        {
+            std::cout << "No open orders found." << std::endl;
+            return;
+        }
+        printOpenOrders(orders);
+        return;
+    }
+
+    json payload = {
+        {"jsonrpc", "2.0"},
+        {"method", "private/get_open_orders"},
+        {"params", {}},
+        {"id", rpc.nextId()}};
+
+    std::string res = sendRequest("private/get_open_orders", payload, tokens.token());
+    std::vector<OpenOrder> orders;
+    std::string error;
+    if (!parseOpenOrders(res, orders, error))
+    {
+        std::cerr << "Failed to retrieve open orders: " << error << std::endl;
+        return;
+    }
+    if (orders.empty())
+    {
+        std::cout << "No open orders found." << std::endl;
+        return;
+    }
+    printOpenOrders(orders);
+}
+
+std::vector<OrderResult> TradingClient::placeOrders(const std::vector<OrderRequest> &orders)
+{
+    std::vector<OrderResult> results(orders.size());
+    std::vector<HttpRequest> requests;
+    std::vector<size_t> slots;
+    for (size_t i = 0; i < orders.size(); ++i)
+    {
+        const OrderRequest &order = orders[i];
+        std::string_view body = encodeBuy(rpc.nextId(), order.instrument, order.price, order.amount, results[i].error);
+        if (!body.empty())
+        {
+            // The encoder's buffer is reused by the next order, so each body is copied out
+            requests.push_back({"private/buy", std::string(body)});
+            slots.push_back(i);
+        }
+    }
+    sendOrderBatch(LatencyStats::Buy, requests, slots, results);
+    return results;
+}
+
+std::vector<OrderResult> TradingClient::cancelOrders(const std::vector<std::string> &orderIds)
+{
+    std::vector<OrderResult> results(orderIds.size());
+    std::vector<HttpRequest> requests;
+    std::vector<size_t> slots;
+    for (size_t i = 0; i < orderIds.size(); ++i)
+    {
+        results[i].orderId = orderIds[i];
+        OpenOrder order;
+        if (checkOpenOrder(orderIds[i], order, results[i].error))
+        {
+            requests.push_back({"private/cancel", std::string(orderEncoder().encodeCancel(rpc.nextId(), orderIds[i]))});
+            slots.push_back(i);
+        }
+    }
+    sendOrderBatch(LatencyStats::Cancel, requests, slots, results);
+    return results;
+}
+
+std::vector<OrderResult> TradingClient::cancelAllByInstrument(const std::string &instrument)
+{
+    if (orderCache.seeded())
+    {
+        std::vector<std::string> orderIds;
+        for (const OpenOrder &order : orderCache.openOrders(instrument))
+        {
+            orderIds.push_back(order.orderId);
+        }
+        return cancelOrders(orderIds);
+    }
+
+    json payload = {
+        {"jsonrpc", "2.0"},
+        {"method", "private/cancel_all_by_instrument"},
+        {"params", {{"instrument_name", instrument}}},
+        {"id", rpc.nextId()}};
+    std::vector<OrderResult> results(1);
+    sendOrderBatch(LatencyStats::Cancel, {{"private/cancel_all_by_instrument", payload.dump()}}, {0}, results);
+    return results;
+}
+
+// Function to cancel order
+void TradingClient::cancelOrder(const std::string &accesstoken, const std::string &orderId)
+{
+    OpenOrder order;
+    std::string error;
+    if (!checkOpenOrder(orderId, order, error))
+    {
+        LOG_ERROR("Cancel not sent: {}", error);
+        return;
+    }
+    std::string_view body = orderEncoder().encodeCancel(rpc.nextId(), orderId);
+    std::string response = sendOrderRequest(LatencyStats::Cancel, "private/cancel", body, tokens.token());
+    json responseJson = json::parse(response, nullptr, false);
+    if (responseJson.is_discarded())
+    {
+        LOG_ERROR("No response received or error occurred.");
+    }
+    else if (responseJson.contains("error"))
+    {
+        LOG_ERROR("Error cancelling order: {}", responseJson["error"]["message"].dump());
+    }
+    else
+    {
+        LOG_INFO("Cancelled Order: {}", orderId);
+    }
+}
+
+// Function to modify order
+void TradingClient::modifyOrder(const std::string &accesstoken, const std::string &orderId, double newPrice, double newAmount)
+{
+    std::string error;
+    std::string_view body = encodeEdit(rpc.nextId(), orderId, newPrice, newAmount, error);
+    if (body.empty())
+    {
+        LOG_ERROR("Edit not sent: {}", error);
+        return;
+    }
+    std::string response = sendOrderRequest(LatencyStats::Edit, "private/edit", body, tokens.token());
+    if (!response.empty())
+    {
+        try
+        {
+            auto responseJson = json::parse(response);
+            if (responseJson.contains("error") && responseJson["error"].contains("data") && responseJson["error"]["data"].contains("reason"))
+            {
+                LOG_ERROR("Error Details: {}", responseJson["error"]["data"]["reason"].dump());
+            }
+            else if (responseJson.contains("message"))
+            {
+                LOG_ERROR("Error Details: {}", responseJson["message"].dump());
+            }
+            else
+            {
+                recordOrderResponse(responseJson);
+                LOG_INFO("Order modified successfully.");
+            }
+        }
+        catch (const std::exception &e)
+        {
+            LOG_ERROR("Error parsing JSON response: {}", e.what());
+        }
+    }
+    else
+    {
+        LOG_ERROR("No response received or error occurred.");
+    }
+}
+
+// Function to get orderbook
+void TradingClient::getOrderBook(const std::string &instrument, int depth)
+{
+    json payload = {
+        {"jsonrpc", "2.0"},
+        {"method", "public/get_order_book"},
+        {"params", {{"instrument_name", instrument}, {"depth", depth}}},
+        {"id", rpc.nextId()}};
+
+    // Empty if the rate limiter refused it or nothing came back
+    std::string response = sendRequest("public/get_order_book", payload);
+    json responseJson = json::parse(response, nullptr, false);
+    if (responseJson.is_discarded())
+    {
+        std::cerr << "Failed to retrieve order book: no response." << std::endl;
+        return;
+    }
+
+    if (responseJson.contains("result"))
+    {
+        const auto &result = responseJson["result"];
+        std::cout << "Order Book for " << instrument << ":\n";
+        // Print general details
+        std::cout << result.dump(4) << std::endl;
+        // Print bids
+        if (result.contains("bids"))
+        {
+            std::cout << "\nBids:\n";
+            for (const auto &bid : result["bids"])
+            {
+                std::cout << "Price: " << bid[0] << ", Amount: " << bid[1] << '\n';
+            }
+        }
+        // Print asks
+        if (result.contains("asks"))
+        {
+            std::cout << "\nAsks:\n";
+            for (const auto &ask : result["asks"])
+            {
+                std::cout << "Price: " << ask[0] << ", Amount: " << ask[1] << '\n';
+            }
+        }
+    }
+    else
+    {
+        std::cerr << "Failed to retrieve order book." << std::endl;
+        if (responseJson.contains("error"))
+        {
+            std::cerr << "Error Details: " << responseJson["error"].dump() << std::endl;
+        }
+    }
+}
+
+// Function to get position
+void TradingClient::getPositions(const std::string &accessToken, const std::string &currency, const std::string &kind)
+{
+    json payload = {
+        {"jsonrpc", "2.0"},
+        {"method", "private/get_positions"},
+        {"params", {
+                       {"currency", currency},
+                       {"kind", kind},
+                   }},
+        {"id", rpc.nextId()}};
+
+    std::string response = sendRequest("private/get_positions", payload, accessToken);
+
+    if (response.empty())
+    {
+        std::cout << "Currency is unavailable.\n";
+        return;
+    }
+    else
+    {
+        try
+        {
+            auto responseJson = json::parse(response);
+
+            if (responseJson.contains("result"))
+            {
+                auto positions = responseJson["result"];
+                std::cout << positions.dump(4) << std::endl;
+            }
+            else if (responseJson.contains("error") && responseJson["error"].contains("data") && responseJson["error"]["data"].contains("reason"))
+            {
+                LOG_ERROR("Error Details: {}", responseJson["error"]["data"]["reason"].dump());
+            }
+            else if (responseJson.contains("message"))
+            {
+                LOG_ERROR("Error Details: {}", responseJson["message"].dump());
+            }
+            else
+            {
+                std::cerr << "Unexpected response format: " << response << "\n";
+            }
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Failed to parse response: " << e.what() << "\n";
+            std::cerr << "Raw response: " << response << "\n";
+        }
+    }
+}
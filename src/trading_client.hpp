@@ -0,0 +1,334 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "book_conflator.hpp"
+#include "feed_handler.hpp"
+#include "feed_recorder.hpp"
+#include "http_pool.hpp"
+#include "instrument_table.hpp"
+#include "latency_histogram.hpp"
+#include "net_tuning.hpp"
+#include "rate_limiter.hpp"
+#include "order_cache.hpp"
+#include "rpc_dispatcher.hpp"
+#include "shared_book.hpp"
+#include "sharded_feed.hpp"
+#include "spsc_ring.hpp"
+#include "subscription_set.hpp"
+#include "thread_util.hpp"
+#include "token_manager.hpp"
+#include "ws_client.hpp"
+
+// Where the client connects: the Deribit testnet unless pointed elsewhere, e.g. at MockExchange
+struct ExchangeEndpoint
+{
+    std::string restUrl = "https://test.deribit.com/api/v2/";
+    std::string wsUrl = "wss://test.deribit.com/ws/api/v2/";
+    // False accepts any REST certificate, e.g. MockExchange's self-signed one
+    bool verifyPeer = true;
+
+    // Both URLs on host, which may carry a port, e.g. "localhost:8443"
+    static ExchangeEndpoint forHost(const std::string &host);
+};
+
+// Settings for the stage between the WebSocket thread and message processing
+struct PipelineConfig
+{
+    ExchangeEndpoint endpoint; // REST and WebSocket URLs of the session and of any feed shards
+    NetworkTuning network;     // busy polling, I/O core and socket options, for the shards too
+    RateLimitConfig rateLimits; // the account's request credit pools, spent locally before requests go out
+    size_t ringCapacity = 8192;
+    OverflowPolicy overflow = OverflowPolicy::DropNewest;
+    int consumerCore = -1; // -1 leaves the processing thread unpinned
+    std::chrono::seconds latencyReportInterval{60}; // 0 disables the periodic latency log
+    bool record = false;     // capture every inbound WebSocket frame
+    RecorderConfig recorder; // where captures go and when they roll over
+    bool offline = false;    // no REST prewarm or resync snapshots, e.g. when replaying captures
+    ShardedFeedConfig sharding; // shards > 0 moves book subscriptions onto dedicated connections
+    InstrumentCacheConfig instruments; // currencies loaded by loadInstruments() and their cache file
+    BookChannel bookChannel;           // book channel used when a subscription names none
+    BookAnalyticsConfig analytics;     // figures kept for every book on this session; depth 0 turns them off
+    SharedBookConfig sharedBooks;      // a name publishes every book to shared memory for other processes
+    // Called on its own thread with each instrument's book changes; when it
+    // falls behind, the changes are conflated instead of queued
+    BookConflator::Consumer bookConsumer;
+};
+
+// One limit buy of a placeOrders batch
+struct OrderRequest
+{
+    std::string instrument;
+    double price = 0;
+    double amount = 0;
+};
+
+// Outcome of one order of a batch, in the order the batch was given
+struct OrderResult
+{
+    std::string orderId; // the order acted on; for placements, the id the exchange assigned
+    bool ok = false;
+    nlohmann::json response; // the JSON-RPC response, if one arrived
+    std::string error;       // why it failed: local check, transport or exchange error
+};
+
+// Latency histograms in nanoseconds, recorded from the I/O, processing and caller threads
+struct LatencyStats
+{
+    enum Op
+    {
+        Buy,
+        Edit,
+        Cancel,
+        OpCount
+    };
+    static constexpr const char *OpNames[OpCount] = {"buy", "edit", "cancel"};
+
+    LatencyHistogram restRtt[OpCount]; // request sent to response received over REST
+    LatencyHistogram wsRtt[OpCount];   // same over the WebSocket session
+    LatencyHistogram feed;             // exchange timestamp of a book notification to local receive
+    LatencyHistogram processing;       // on_message to the end of handleFrame
+};
+
+class TradingClient
+{
+public:
+    using json = nlohmann::json;
+
+    TradingClient(const std::string &id, const std::string &secretId, const PipelineConfig &pipeline = PipelineConfig());
+    ~TradingClient();
+
+    // The current token; it changes as it is renewed, so read it per request rather than keeping a copy
+    const std::string &getAccessToken() const
+    {
+        return tokens.token();
+    }
+
+    // Function to authenticate and get accesstoken. The token is then renewed
+    // in the background, and the WebSocket session re-authenticated with it.
+    void authenticate();
+
+    // Loads tick sizes and trade amounts for the configured currencies, from
+    // the cache file if it is fresh and over REST otherwise. Books created
+    // afterwards use the instruments' tick and lot grids and orders are checked
+    // against them before they are sent.
+    bool loadInstruments();
+    // The loaded table, or nullptr; safe from any thread
+    std::shared_ptr<const InstrumentTable> instruments() const
+    {
+        return std::atomic_load(&instrumentTable);
+    }
+
+    // REST order entry and queries
+    void placeOrder(const std::string &instrument, const std::string &accessToken, double price, double amount);
+    void modifyOrder(const std::string &accesstoken, const std::string &orderId, double newPrice, double newAmount);
+    void cancelOrder(const std::string &accesstoken, const std::string &orderId);
+    // Served from the order cache once it is seeded, otherwise over REST
+    void getAllOpenOrders();
+
+    // Bulk order entry over REST. Every request of a batch is in flight at
+    // once (see HttpConnectionPool::postBatch), so a batch takes about one
+    // round trip instead of one per order. Orders failing the local checks
+    // are not sent and report why.
+    std::vector<OrderResult> placeOrders(const std::vector<OrderRequest> &orders);
+    std::vector<OrderResult> cancelOrders(const std::vector<std::string> &orderIds);
+    // Cancels the instrument's open orders from the order cache, one result
+    // each. Before the cache is seeded this falls back to a single
+    // private/cancel_all_by_instrument, whose only result is the count.
+    std::vector<OrderResult> cancelAllByInstrument(const std::string &instrument);
+    void getOrderBook(const std::string &instrument, int depth);
+    void getPositions(const std::string &accessToken, const std::string &currency, const std::string &kind);
+
+    // WebSocket session
+    void connectWebSocket();
+    void sendWebSocketMessage(const std::string &message);
+    // Sends a JSON-RPC request over the WebSocket; callback receives the matching response
+    uint64_t sendRpc(const std::string &method, const json &params, RpcDispatcher::Callback callback);
+    // Same as above, completing a future instead of calling back
+    std::future<json> sendRpc(const std::string &method, const json &params);
+
+    // Non-blocking order entry over the WebSocket
+    std::future<json> placeOrderAsync(const std::string &instrument, double price, double amount);
+    std::future<json> modifyOrderAsync(const std::string &orderId, double newPrice, double newAmount);
+    std::future<json> cancelOrderAsync(const std::string &orderId);
+
+    // Open orders as of the latest user.orders update; see OrderCache
+    const OrderCache &orders() const
+    {
+        return orderCache;
+    }
+
+    // Book subscriptions on the one WebSocket session. Each call is batched into
+    // as few RPCs as possible; the set is kept and re-sent after a reconnect.
+    void subscribeToOrderBooks(const std::vector<std::string> &instruments);
+    // Same, on the given channel; a subscribed instrument moves to it
+    void subscribeToOrderBooks(const std::vector<std::string> &instruments, const BookChannel &channel);
+    void unsubscribeFromOrderBooks(const std::vector<std::string> &instruments);
+    // Sharded feed only: moves an instrument to another shard without dropping updates
+    bool assignInstrumentToShard(const std::string &instrument, uint32_t shard);
+    size_t feedShards() const
+    {
+        return shardedFeed ? shardedFeed->size() : 0;
+    }
+    void showSubscriptions();
+    void showPipelineStats();
+    void showLatencyStats();
+
+    // Queues a recorded frame exactly as on_message queues a live one. Only for
+    // replays: the ring has a single producer, so the WebSocket must not be running.
+    bool injectFrame(std::string_view payload, int64_t receivedUnixNs, uint32_t connectionId);
+    // Frames queued but not yet handled
+    size_t queuedFrames() const
+    {
+        return inbound.depth();
+    }
+    const LatencyStats &latencyStats() const
+    {
+        return latency;
+    }
+    void resetLatencyStats();
+    BookConflator::Stats bookConflation() const
+    {
+        return conflator.stats();
+    }
+    uint64_t bookGaps() const
+    {
+        return feed.books().gapCount() + (shardedFeed ? shardedFeed->bookGaps() : 0);
+    }
+
+    size_t pendingRequests() const
+    {
+        return rpc.pending();
+    }
+    // Request credits left, queued and refused; a strategy can check
+    // headroom(RequestKind::Order) before quoting instead of being refused
+    const RateLimiter &rateLimits() const
+    {
+        return rateLimiter;
+    }
+    bool connected() const
+    {
+        return isConnected;
+    }
+    // Blocks until the WebSocket session is open and authenticated, false on
+    // timeout. Woken by on_open and the auth response rather than polled, so
+    // private requests can go out as soon as the server will take them.
+    bool waitForSession(std::chrono::milliseconds timeout);
+    // Blocks until the server has confirmed the book subscriptions of all the instruments, false on timeout
+    bool waitForBooks(const std::vector<std::string> &instruments, std::chrono::milliseconds timeout);
+
+private:
+    void on_open(websocketpp::connection_hdl hdl);
+    void on_message(websocketpp::connection_hdl hdl, client::message_ptr msg);
+    void on_close(websocketpp::connection_hdl hdl);
+
+    void processLoop();
+    void consumeBooksLoop();
+    void reportLatencyLoop();
+    void requestBookSnapshot(const std::string &instrument);
+    std::string fetchBookSnapshot(const std::string &instrument);
+    json credentialsGrant() const;
+    void authenticateWebSocket();
+    void sendSubscriptions(const std::string &method, const std::vector<std::string> &channels);
+
+    std::string sendRequest(const std::string &endpoint, const json &payload, const std::string &token = "");
+    std::string sendOrderRequest(LatencyStats::Op op, const std::string &endpoint, std::string_view body, const std::string &token);
+    // Sends the requests whose results are still pending as one batch and fills those results in
+    void sendOrderBatch(LatencyStats::Op op, const std::vector<HttpRequest> &requests, const std::vector<size_t> &slots,
+                        std::vector<OrderResult> &results);
+    // Sends an already encoded request whose id is id, once its credit allows
+    uint64_t sendEncodedRpc(uint64_t id, RequestKind kind, std::string_view body, RpcDispatcher::Callback callback);
+    void writeRpc(uint64_t id, std::string_view body);
+    std::future<json> sendOrderRpc(LatencyStats::Op op, uint64_t id, std::string_view body);
+    // Encodes a limit buy, on the instrument's grid when its spec is loaded.
+    // Returns an empty view with error set if the spec rejects the order.
+    std::string_view encodeBuy(uint64_t id, const std::string &instrument, double price, double amount, std::string &error);
+    // Same for an edit, which is also refused if the seeded cache does not list the order as open
+    std::string_view encodeEdit(uint64_t id, const std::string &orderId, double price, double amount, std::string &error);
+    // Fills order from the cache. False, with error set, only if the cache is seeded and the order is not open.
+    bool checkOpenOrder(const std::string &orderId, OpenOrder &order, std::string &error) const;
+    // Takes the order of a successful buy or edit response into the order cache
+    void recordOrderResponse(const json &response);
+    void subscribeOrderUpdates();
+    void seedOrderCache();
+    TickScale scaleFor(const std::string &instrument) const;
+
+    std::string clientId;
+    std::string clientSecretId;
+    const std::string baseUrl;
+    const std::string wsUrl;
+    const NetworkTuning network;
+    client wsClient;
+    // The session's last TLS session, resumed on reconnect
+    TlsSessionCache tlsSessions;
+    websocketpp::connection_hdl hdl;
+    std::thread wsThread;
+    std::atomic<bool> isConnected{false};
+    std::atomic<bool> wsRunning{false}; // wsThread is connecting or connected
+    // Set once the session's public/auth succeeds, cleared on open and close
+    bool sessionAuthenticated = false;
+    std::mutex sessionMutex;
+    std::condition_variable sessionChanged;
+    uint32_t connectionId = 0; // bumped by on_open, stamped on frames by on_message
+    // Book subscriptions on this session, when the feed is not sharded
+    SubscriptionSet subscriptions;
+    // Open orders, kept current from user.orders.* and user.trades.* on this session
+    OrderCache orderCache;
+
+    // Credits every REST and WebSocket request is charged against; outlives
+    // tokens, whose renewal thread sends through it
+    RateLimiter rateLimiter;
+    // Keep-alive connections reused by every REST call
+    HttpConnectionPool httpPool{baseUrl};
+    // Access token for REST calls, renewed ahead of expiry on its own thread
+    TokenManager tokens{[this](const json &request)
+                        { return sendRequest("public/auth", request); }};
+    // Pending WebSocket requests keyed by JSON-RPC id
+    RpcDispatcher rpc;
+    std::chrono::milliseconds rpcTimeout{5000};
+    bool offline;
+    InstrumentCacheConfig instrumentConfig;
+    // Replaced as a whole by loadInstruments, read through std::atomic_load
+    std::shared_ptr<const InstrumentTable> instrumentTable;
+    // Books for other processes; outlives the shards and processingThread that publish to it
+    std::unique_ptr<SharedBookWriter> sharedBookWriter;
+    // Market data connections, when sharding is enabled
+    std::unique_ptr<ShardedFeed> shardedFeed;
+    // Snapshot fetches and the order cache seed, off the threads that asked for them
+    WorkerThreads workers;
+
+    LatencyStats latency;
+    std::chrono::seconds latencyReportInterval;
+    std::thread latencyReporter;
+    std::mutex reporterMutex;
+    std::condition_variable reporterWake;
+
+    // Raw frame capture, written from processingThread
+    std::unique_ptr<FeedRecorder> recorder;
+
+    BookChannel defaultBookChannel;
+    // Book changes from processingThread to the book consumer, conflated per instrument
+    BookConflator conflator;
+    BookConflator::Consumer bookConsumer;
+    std::thread bookConsumerThread;
+    // processingThread's slots in sharedBookWriter
+    std::unique_ptr<SharedBookPublisher> sharedBooks;
+
+    // Book and response handling, only ever touched by processingThread
+    FeedHandler feed{rpc, latency.feed, [this](const std::string &instrument)
+                     { requestBookSnapshot(instrument); }};
+
+    // The WebSocket thread only queues frames; processingThread does the rest
+    SpscRing<InboundFrame> inbound;
+    std::thread processingThread;
+    std::atomic<bool> processing{true};
+};
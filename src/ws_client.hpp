@@ -0,0 +1,42 @@
+#pragma once
+
+#include <exception>
+#include <websocketpp/config/asio_client.hpp>
+#include <websocketpp/client.hpp>
+#include "logger.hpp"
+#include "net_tuning.hpp"
+
+typedef websocketpp::client<websocketpp::config::asio_tls_client> client;
+// The stream under a wss:// connection, as socket init handlers get it
+typedef boost::asio::ssl::stream<boost::asio::ip::tcp::socket> TlsStream;
+
+// TLS context for a wss:// connection. Certificates are not verified.
+inline websocketpp::lib::shared_ptr<boost::asio::ssl::context> makeTlsContext(websocketpp::connection_hdl)
+{
+    websocketpp::lib::shared_ptr<boost::asio::ssl::context> ctx =
+        websocketpp::lib::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::tlsv12_client);
+    try
+    {
+        ctx->set_verify_mode(boost::asio::ssl::context::verify_none);
+        // Load certificates if needed
+        // ctx->load_verify_file("path_to_certificate.pem");
+    }
+    catch (const std::exception &e)
+    {
+        LOG_ERROR("Error initializing SSL context: {}", e.what());
+    }
+    return ctx;
+}
+
+// Socket init handler: runs once the TCP connection is up, before the TLS handshake
+inline void initSocket(TlsStream &stream, const NetworkTuning &network, TlsSessionCache &sessions)
+{
+    if (!applySocketOptions(stream.lowest_layer().native_handle(), network.socket))
+    {
+        LOG_WARN("Could not apply socket options to the WebSocket connection");
+    }
+    if (network.reuseTlsSessions)
+    {
+        sessions.resume(stream.native_handle());
+    }
+}
@@ -0,0 +1,156 @@
+// Follows the books a TradingClient publishes to shared memory (--shm) from
+// another process, printing each instrument's top levels when they change.
+//
+//   ./TradingBookReader [--levels N] [--interval-ms N] [--once] <name> [instrument]...
+//
+// With no instruments it follows every one in the segment, including those
+// added later. Reads never block the publisher; --interval-ms 0 busy-polls.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "latency_histogram.hpp"
+#include "shared_book.hpp"
+
+namespace
+{
+    void usage(const char *program)
+    {
+        std::cerr << "Usage: " << program << " [--levels N] [--interval-ms N] [--once] <name> [instrument]..." << std::endl;
+    }
+
+    void print(const std::string_view instrument, const SharedBookSnapshot &book, uint32_t levels)
+    {
+        int64_t ageUs = (unixNanos() - book.publishedUnixNs) / 1000;
+        std::cout << instrument << " change " << book.changeId << ", published " << ageUs << " us ago" << std::endl;
+        for (uint32_t i = 0; i < levels && (i < book.bidLevels || i < book.askLevels); ++i)
+        {
+            std::cout << "  ";
+            if (i < book.bidLevels)
+            {
+                std::cout << book.bids[i].amount << " @ " << book.bids[i].price;
+            }
+            else
+            {
+                std::cout << "-";
+            }
+            std::cout << "  |  ";
+            if (i < book.askLevels)
+            {
+                std::cout << book.asks[i].price << " x " << book.asks[i].amount;
+            }
+            else
+            {
+                std::cout << "-";
+            }
+            std::cout << std::endl;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t levels = 1;
+    long intervalMs = 100;
+    bool once = false;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--levels" && i + 1 < argc)
+        {
+            levels = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--interval-ms" && i + 1 < argc)
+        {
+            intervalMs = std::strtol(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--once")
+        {
+            once = true;
+        }
+        else if (arg.rfind("--", 0) == 0)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+        else
+        {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.empty())
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    SharedBookReader reader;
+    std::string error;
+    if (!reader.open(positional[0], error))
+    {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    std::vector<std::string> wanted(positional.begin() + 1, positional.end());
+    const bool followAll = wanted.empty();
+
+    // Last version printed, by slot; 0 is never a published version
+    std::vector<uint32_t> seen;
+    std::vector<uint32_t> slots;
+    SharedBookSnapshot book;
+    for (;;)
+    {
+        if (followAll)
+        {
+            for (uint32_t slot = static_cast<uint32_t>(slots.size()); slot < reader.size(); ++slot)
+            {
+                slots.push_back(slot);
+            }
+        }
+        else
+        {
+            // Instruments that are not published yet are looked up again on the next pass
+            for (auto it = wanted.begin(); it != wanted.end();)
+            {
+                uint32_t slot = reader.find(*it);
+                if (slot == SharedBookReader::NotFound)
+                {
+                    ++it;
+                    continue;
+                }
+                slots.push_back(slot);
+                it = wanted.erase(it);
+            }
+        }
+        for (uint32_t slot : slots)
+        {
+            if (slot >= seen.size())
+            {
+                seen.resize(slot + 1, 0);
+            }
+            uint32_t version = reader.version(slot);
+            if (version == seen[slot] || (version & 1))
+            {
+                continue;
+            }
+            if (reader.read(slot, book, levels))
+            {
+                print(reader.instrument(slot), book, levels);
+                seen[slot] = version;
+            }
+        }
+        if (once)
+        {
+            break;
+        }
+        if (intervalMs > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,174 @@
+// Turns a binary TradingClient log into text, one line per entry.
+//
+//   ./TradingLogDecoder trading_client.tclog [min-level]
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "logger.hpp"
+
+namespace
+{
+    struct Site
+    {
+        LogLevel level;
+        std::string format;
+    };
+
+    struct Calibration
+    {
+        uint64_t tsc;
+        int64_t unixNs;
+    };
+
+    struct Entry
+    {
+        uint64_t tsc;
+        uint32_t site;
+        const char *args;
+        uint16_t size;
+    };
+
+    template <typename T>
+    bool read(const char *&p, const char *end, T &value)
+    {
+        if ((size_t)(end - p) < sizeof(T))
+            return false;
+        std::memcpy(&value, p, sizeof(T));
+        p += sizeof(T);
+        return true;
+    }
+
+    // Maps a TSC reading to wall-clock time using the nearest pair of calibration points
+    int64_t toUnixNs(const std::vector<Calibration> &calibrations, uint64_t tsc)
+    {
+        if (calibrations.empty())
+            return 0;
+        if (calibrations.size() == 1)
+            return calibrations[0].unixNs;
+        auto it = std::upper_bound(calibrations.begin(), calibrations.end(), tsc, [](uint64_t value, const Calibration &c)
+                                   { return value < c.tsc; });
+        size_t hi = std::clamp<size_t>(it - calibrations.begin(), 1, calibrations.size() - 1);
+        const Calibration &a = calibrations[hi - 1];
+        const Calibration &b = calibrations[hi];
+        if (b.tsc == a.tsc)
+            return a.unixNs;
+        double nsPerTick = double(b.unixNs - a.unixNs) / double(b.tsc - a.tsc);
+        return a.unixNs + (int64_t)((double(tsc) - double(a.tsc)) * nsPerTick);
+    }
+
+    std::string formatTime(int64_t unixNs)
+    {
+        std::time_t seconds = unixNs / 1000000000;
+        std::tm utc;
+        gmtime_r(&seconds, &utc);
+        char text[64];
+        size_t n = std::strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &utc);
+        std::snprintf(text + n, sizeof(text) - n, ".%09lld", (long long)(unixNs % 1000000000));
+        return text;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <log file> [DEBUG|INFO|WARN|ERROR]" << std::endl;
+        return 1;
+    }
+    LogLevel minLevel = LogLevel::Debug;
+    if (argc > 2)
+    {
+        for (LogLevel level : {LogLevel::Debug, LogLevel::Info, LogLevel::Warn, LogLevel::Error})
+        {
+            if (std::strcmp(argv[2], logLevelName(level)) == 0)
+                minLevel = level;
+        }
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(LogFile::Magic) || std::memcmp(data.data(), LogFile::Magic, sizeof(LogFile::Magic)) != 0)
+    {
+        std::cerr << argv[1] << " is not a TradingClient log" << std::endl;
+        return 1;
+    }
+
+    std::unordered_map<uint32_t, Site> sites;
+    std::vector<Calibration> calibrations;
+    std::vector<Entry> entries;
+
+    const char *p = data.data() + sizeof(LogFile::Magic);
+    const char *end = data.data() + data.size();
+    bool truncated = false;
+    while (p < end && !truncated)
+    {
+        char type = *p++;
+        if (type == LogFile::SiteRecord)
+        {
+            uint32_t id;
+            uint8_t level;
+            uint16_t length;
+            if (!read(p, end, id) || !read(p, end, level) || !read(p, end, length) || end - p < length)
+                truncated = true;
+            else
+            {
+                sites[id] = Site{(LogLevel)level, std::string(p, length)};
+                p += length;
+            }
+        }
+        else if (type == LogFile::CalibrationRecord)
+        {
+            Calibration calibration;
+            if (!read(p, end, calibration.tsc) || !read(p, end, calibration.unixNs))
+                truncated = true;
+            else
+                calibrations.push_back(calibration);
+        }
+        else if (type == LogFile::LogEntryRecord)
+        {
+            Entry entry;
+            if (!read(p, end, entry.tsc) || !read(p, end, entry.site) || !read(p, end, entry.size) || end - p < entry.size)
+                truncated = true;
+            else
+            {
+                entry.args = p;
+                p += entry.size;
+                entries.push_back(entry);
+            }
+        }
+        else
+        {
+            std::cerr << "Unknown record type at offset " << (p - 1 - data.data()) << std::endl;
+            return 1;
+        }
+    }
+    if (truncated)
+        std::cerr << "Log ends with a partial record (still being written?)" << std::endl;
+
+    std::sort(calibrations.begin(), calibrations.end(), [](const Calibration &a, const Calibration &b)
+              { return a.tsc < b.tsc; });
+
+    for (const Entry &entry : entries)
+    {
+        auto site = sites.find(entry.site);
+        if (site == sites.end())
+        {
+            std::cout << formatTime(toUnixNs(calibrations, entry.tsc)) << " ?     <unknown site " << entry.site << ">\n";
+            continue;
+        }
+        if (site->second.level < minLevel)
+            continue;
+        std::string level = logLevelName(site->second.level);
+        level.resize(5, ' ');
+        std::cout << formatTime(toUnixNs(calibrations, entry.tsc)) << ' ' << level << ' '
+                  << formatLogMessage(site->second.format, entry.args, entry.size) << '\n';
+    }
+    return 0;
+}
@@ -0,0 +1,1181 @@
+// Local stand-in for the Deribit test exchange, for load tests, profiling and
+// regression runs without the testnet. One port serves the JSON-RPC methods
+// the client uses over HTTPS (POST /api/v2/<method>) and over a WebSocket
+// (/ws/api/v2/), with a self-signed certificate, and streams synthetic book.*
+// updates to whoever subscribes.
+//
+//   ./MockExchange [--port N] [--rate N] [--latency-us N] [--token-ttl S] [--instruments A,B,...] [--stamp]
+//
+// --rate is book updates per second over all subscribed books, taken in turn;
+// each update goes to every channel subscribed to its book. --latency-us holds
+// every response and notification back that long after it is produced, and
+// notifications carry the time they were produced, so the client's feed
+// latency shows it. --stamp adds "sent_ns", the wall-clock time the frame
+// was handed to the socket, to every book notification, for measuring the
+// client's wakeup-to-handler latency (FeedWakeupBench). Books move at random
+// around a fixed mid. Orders rest without ever filling, so positions stay flat.
+//
+// Point the client at it with --endpoint localhost:8443 --insecure.
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <nlohmann/json.hpp>
+#include <openssl/evp.h>
+#include "latency_histogram.hpp"
+#include "local_https_server.hpp"
+#include "notification_parser.hpp"
+#include "subscription_set.hpp"
+
+namespace
+{
+    namespace asio = boost::asio;
+    using json = nlohmann::json;
+    using Clock = std::chrono::steady_clock;
+
+    struct MockConfig
+    {
+        unsigned short port = 8443;
+        double rate = 1000; // book updates per second, over all subscribed books
+        std::chrono::microseconds latency{0};
+        int tokenTtl = 900; // seconds an access token is valid for
+        std::vector<std::string> instruments{"BTC-PERPETUAL", "ETH-PERPETUAL"};
+        bool stamp = false; // "sent_ns" in book notifications
+    };
+
+    // Placeholder for a sent_ns value, overwritten in place as the frame is written
+    const std::string SentStamp = "0000000000000000000";
+
+    // A connection is closed once this much is queued for it, as the real
+    // exchange drops consumers that cannot keep up
+    constexpr size_t MaxQueuedBytes = 64 << 20;
+
+    struct RpcError
+    {
+        int code;
+        std::string message;
+    };
+
+    int64_t unixMillis()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    void appendNumber(std::string &out, double value)
+    {
+        char buffer[32];
+        int n = std::snprintf(buffer, sizeof(buffer), "%.10g", value);
+        out.append(buffer, n);
+    }
+
+    void appendInteger(std::string &out, uint64_t value)
+    {
+        char buffer[24];
+        int n = std::snprintf(buffer, sizeof(buffer), "%llu", static_cast<unsigned long long>(value));
+        out.append(buffer, n);
+    }
+
+    // Server to client WebSocket frame: unmasked, never fragmented
+    std::string wsFrame(const std::string &payload, uint8_t opcode = 0x1)
+    {
+        std::string frame;
+        frame.reserve(payload.size() + 10);
+        frame.push_back(static_cast<char>(0x80 | opcode));
+        if (payload.size() < 126)
+        {
+            frame.push_back(static_cast<char>(payload.size()));
+        }
+        else if (payload.size() < 65536)
+        {
+            frame.push_back(126);
+            frame.push_back(static_cast<char>(payload.size() >> 8));
+            frame.push_back(static_cast<char>(payload.size()));
+        }
+        else
+        {
+            frame.push_back(127);
+            for (int shift = 56; shift >= 0; shift -= 8)
+                frame.push_back(static_cast<char>(static_cast<uint64_t>(payload.size()) >> shift));
+        }
+        frame += payload;
+        return frame;
+    }
+
+    // Sec-WebSocket-Accept for a handshake's Sec-WebSocket-Key
+    std::string wsAccept(const std::string &key)
+    {
+        std::string input = key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int size = 0;
+        EVP_Digest(input.data(), input.size(), digest, &size, EVP_sha1(), nullptr);
+        unsigned char encoded[4 * ((EVP_MAX_MD_SIZE + 2) / 3) + 1];
+        int n = EVP_EncodeBlock(encoded, digest, static_cast<int>(size));
+        return std::string(reinterpret_cast<char *>(encoded), n);
+    }
+
+    // One instrument's book. Each side holds up to Levels levels within
+    // Levels ticks of a fixed mid, so the book can never cross.
+    class SyntheticBook
+    {
+    public:
+        static constexpr int64_t Levels = 20;
+
+        SyntheticBook(std::string name, double tick, double minAmount, double mid, std::mt19937_64 &rng)
+            : name(std::move(name)), tick(tick), minAmount(minAmount), midTicks(static_cast<int64_t>(mid / tick))
+        {
+            for (int64_t offset = 1; offset <= Levels; ++offset)
+            {
+                bids[midTicks - offset] = randomLots(rng);
+                asks[midTicks + offset] = randomLots(rng);
+            }
+        }
+
+        const std::string &instrument() const { return name; }
+        double tickSize() const { return tick; }
+        double minTradeAmount() const { return minAmount; }
+        uint64_t changeId() const { return change; }
+
+        // One level changes: added, resized or, while the side stays deep enough, removed
+        void step(std::mt19937_64 &rng)
+        {
+            last.bid = rng() & 1;
+            auto &side = last.bid ? bids : asks;
+            int64_t offset = 1 + static_cast<int64_t>(rng() % Levels);
+            last.ticks = last.bid ? midTicks - offset : midTicks + offset;
+            auto it = side.find(last.ticks);
+            if (it == side.end())
+            {
+                last.action = "new";
+                last.lots = randomLots(rng);
+                side[last.ticks] = last.lots;
+            }
+            else if (rng() % 4 == 0 && side.size() > Levels / 2)
+            {
+                last.action = "delete";
+                last.lots = 0;
+                side.erase(it);
+            }
+            else
+            {
+                last.action = "change";
+                last.lots = randomLots(rng);
+                it->second = last.lots;
+            }
+            ++change;
+        }
+
+        // data of a book.<instrument>.<interval> notification for the last step
+        void appendDelta(std::string &out, int64_t timestampMs) const
+        {
+            out += "{\"type\":\"change\",\"timestamp\":";
+            appendInteger(out, timestampMs);
+            out += ",\"prev_change_id\":";
+            appendInteger(out, change - 1);
+            out += ",\"instrument_name\":\"";
+            out += name;
+            out += "\",\"change_id\":";
+            appendInteger(out, change);
+            std::string level = "[[\"";
+            level += last.action;
+            level += "\",";
+            appendNumber(level, last.ticks * tick);
+            level += ',';
+            appendNumber(level, last.lots * minAmount);
+            level += "]]";
+            out += last.bid ? ",\"bids\":" + level + ",\"asks\":[]}" : ",\"bids\":[],\"asks\":" + level + "}";
+        }
+
+        // Whole book as the first notification of an incremental channel
+        // (typed, with "new" actions), or the top depth levels as every
+        // notification of a grouped channel
+        void appendSnapshot(std::string &out, int64_t timestampMs, size_t depth, bool typed) const
+        {
+            out += typed ? "{\"type\":\"snapshot\",\"timestamp\":" : "{\"timestamp\":";
+            appendInteger(out, timestampMs);
+            out += ",\"instrument_name\":\"";
+            out += name;
+            out += "\",\"change_id\":";
+            appendInteger(out, change);
+            out += ",\"bids\":";
+            appendLevels(out, bids.rbegin(), bids.rend(), depth, typed);
+            out += ",\"asks\":";
+            appendLevels(out, asks.begin(), asks.end(), depth, typed);
+            out += '}';
+        }
+
+        // public/get_order_book result
+        json orderBook(size_t depth) const
+        {
+            json result = {{"instrument_name", name}, {"change_id", change}, {"timestamp", unixMillis()}, {"state", "open"}};
+            json bidLevels = json::array();
+            json askLevels = json::array();
+            for (auto it = bids.rbegin(); it != bids.rend() && bidLevels.size() < depth; ++it)
+                bidLevels.push_back({it->first * tick, it->second * minAmount});
+            for (auto it = asks.begin(); it != asks.end() && askLevels.size() < depth; ++it)
+                askLevels.push_back({it->first * tick, it->second * minAmount});
+            result["best_bid_price"] = bids.empty() ? 0.0 : bids.rbegin()->first * tick;
+            result["best_ask_price"] = asks.empty() ? 0.0 : asks.begin()->first * tick;
+            result["bids"] = std::move(bidLevels);
+            result["asks"] = std::move(askLevels);
+            return result;
+        }
+
+    private:
+        struct Change
+        {
+            bool bid = true;
+            const char *action = "new";
+            int64_t ticks = 0;
+            int64_t lots = 0;
+        };
+
+        static int64_t randomLots(std::mt19937_64 &rng)
+        {
+            return 1 + static_cast<int64_t>(rng() % 200);
+        }
+
+        template <typename It>
+        void appendLevels(std::string &out, It begin, It end, size_t depth, bool typed) const
+        {
+            out += '[';
+            size_t count = 0;
+            for (It it = begin; it != end && count < depth; ++it, ++count)
+            {
+                if (count)
+                    out += ',';
+                out += typed ? "[\"new\"," : "[";
+                appendNumber(out, it->first * tick);
+                out += ',';
+                appendNumber(out, it->second * minAmount);
+                out += ']';
+            }
+            out += ']';
+        }
+
+        std::string name;
+        double tick;
+        double minAmount;
+        int64_t midTicks;
+        uint64_t change = 1;
+        std::map<int64_t, int64_t> bids; // ticks -> lots
+        std::map<int64_t, int64_t> asks;
+        Change last;
+    };
+
+    class Exchange;
+
+    // One client connection: HTTP/1.1 keep-alive until it asks for a WebSocket upgrade
+    class Connection : public std::enable_shared_from_this<Connection>
+    {
+    public:
+        Connection(Exchange &exchange, asio::ip::tcp::socket socket, asio::ssl::context &ssl)
+            : exchange(exchange), stream(std::move(socket), ssl), timer(stream.get_executor()) {}
+
+        void start()
+        {
+            auto self = shared_from_this();
+            stream.async_handshake(asio::ssl::stream_base::server, [self](const boost::system::error_code &ec)
+                                   {
+                if (!ec)
+                    self->read(); });
+        }
+
+        // Queues bytes (an HTTP response or a WebSocket frame) to go out at due.
+        // stampAt is the offset of a SentStamp placeholder in bytes, if any.
+        void send(std::string bytes, Clock::time_point due, size_t stampAt = std::string::npos);
+        void sendText(const std::string &text, Clock::time_point due, size_t stampAt = std::string::npos)
+        {
+            std::string frame = wsFrame(text);
+            if (stampAt != std::string::npos)
+                stampAt += frame.size() - text.size();
+            send(std::move(frame), due, stampAt);
+        }
+        bool open() const { return !closed; }
+
+        bool websocket = false;
+        bool authenticated = false;
+        bool orderUpdates = false;
+        // Book channels subscribed on this connection, by instrument
+        std::map<std::string, std::vector<std::pair<std::string, BookChannel>>> books;
+
+    private:
+        struct Pending
+        {
+            Clock::time_point due;
+            std::string bytes;
+            size_t stampAt;
+        };
+
+        void read();
+        void pump();
+        void close();
+        void parseHttp();
+        void parseFrames();
+        void onText(const std::string &text);
+
+        Exchange &exchange;
+        asio::ssl::stream<asio::ip::tcp::socket> stream;
+        asio::steady_timer timer;
+        std::array<char, 16384> chunk;
+        std::string in;
+        std::string fragments;
+        std::deque<Pending> queue; // in due order: the latency is the same for everything
+        size_t queuedBytes = 0;
+        std::string out;
+        std::vector<size_t> stamps; // SentStamp offsets in out
+        bool writing = false;
+        bool timerArmed = false;
+        bool closing = false; // a close frame is queued; nothing more goes out
+        bool closed = false;
+    };
+
+    class Exchange
+    {
+    public:
+        Exchange(asio::io_context &io, const MockConfig &config)
+            : config(config), feedTimer(io), statsTimer(io), rng(42)
+        {
+            for (const auto &name : config.instruments)
+            {
+                // Tick sizes, lot sizes and a mid in line with the real instruments
+                bool btc = name.rfind("BTC", 0) == 0;
+                bool eth = name.rfind("ETH", 0) == 0;
+                books.emplace(name, SyntheticBook(name, btc ? 0.5 : eth ? 0.05 : 0.01, btc ? 10 : 1, btc ? 96000 : eth ? 2650 : 100, rng));
+            }
+        }
+
+        void start()
+        {
+            feedStart = Clock::now();
+            tick();
+            reportStats();
+        }
+
+        Clock::time_point dueNow() const { return Clock::now() + config.latency; }
+
+        void attach(const std::shared_ptr<Connection> &connection) { sessions.push_back(connection); }
+        void detach(Connection &connection)
+        {
+            connection.books.clear();
+            refreshActive();
+        }
+
+        // Answers one request. session is the WebSocket it came on, nullptr
+        // over HTTP, where bearer is the Authorization token instead.
+        // Notifications to follow the response on the session go to after.
+        json call(const std::string &method, const json &params, const std::string &bearer, Connection *session,
+                  std::vector<std::string> &after);
+
+        uint64_t rpcCount = 0;
+
+    private:
+        void tick();
+        void reportStats();
+        void publish(const SyntheticBook &book, Clock::time_point producedAt, int64_t timestampMs);
+        void refreshActive();
+        void broadcastOrder(const json &order);
+        json subscribe(const json &params, Connection *session, bool subscribing, std::vector<std::string> &after);
+        json auth(const json &params);
+        json placeOrder(const json &params, const char *direction);
+        json &findOrder(const json &params);
+        const SyntheticBook &book(const json &params) const;
+
+        static const json &param(const json &params, const char *key)
+        {
+            static const json missing;
+            auto it = params.is_object() ? params.find(key) : params.end();
+            return it != params.end() ? *it : missing;
+        }
+        static std::string stringParam(const json &params, const char *key)
+        {
+            const json &value = param(params, key);
+            return value.is_string() ? value.get<std::string>() : std::string();
+        }
+        static double numberParam(const json &params, const char *key)
+        {
+            const json &value = param(params, key);
+            if (!value.is_number())
+                throw RpcError{-32602, std::string("Invalid params: ") + key};
+            return value.get<double>();
+        }
+
+        const MockConfig &config;
+        asio::steady_timer feedTimer;
+        asio::steady_timer statsTimer;
+        std::mt19937_64 rng;
+        std::map<std::string, SyntheticBook> books;
+        std::vector<std::string> active; // instruments with at least one subscriber
+        std::vector<std::weak_ptr<Connection>> sessions;
+        std::unordered_set<std::string> accessTokens;
+        std::unordered_set<std::string> refreshTokens;
+        uint64_t nextToken = 0;
+        std::map<std::string, json> orders; // open orders by id
+        uint64_t nextOrder = 0;
+
+        Clock::time_point feedStart;
+        uint64_t generated = 0; // updates produced since feedStart
+        uint64_t notifications = 0;
+        uint64_t notificationBytes = 0;
+        uint64_t skipped = 0; // updates dropped from the schedule because the feed fell behind
+    };
+
+    void Connection::read()
+    {
+        auto self = shared_from_this();
+        stream.async_read_some(asio::buffer(chunk), [self](const boost::system::error_code &ec, size_t n)
+                               {
+            if (ec)
+            {
+                self->close();
+                return;
+            }
+            self->in.append(self->chunk.data(), n);
+            if (self->websocket)
+                self->parseFrames();
+            else
+                self->parseHttp();
+            if (!self->closed)
+                self->read(); });
+    }
+
+    void Connection::send(std::string bytes, Clock::time_point due, size_t stampAt)
+    {
+        if (closed || closing)
+            return;
+        queuedBytes += bytes.size();
+        if (queuedBytes > MaxQueuedBytes)
+        {
+            // Closed from the executor: the caller may be walking the session list
+            std::cerr << "Closing a connection with " << queuedBytes << " bytes queued" << std::endl;
+            closing = true;
+            auto self = shared_from_this();
+            asio::post(stream.get_executor(), [self]
+                       { self->close(); });
+            return;
+        }
+        queue.push_back({due, std::move(bytes), stampAt});
+        if (!writing && !timerArmed)
+            pump();
+    }
+
+    // Writes everything that is due in one go, or waits for the first item that is not
+    void Connection::pump()
+    {
+        if (writing || closed)
+            return;
+        Clock::time_point now = Clock::now();
+        while (!queue.empty() && queue.front().due <= now)
+        {
+            if (queue.front().stampAt != std::string::npos)
+                stamps.push_back(out.size() + queue.front().stampAt);
+            out += queue.front().bytes;
+            queuedBytes -= queue.front().bytes.size();
+            queue.pop_front();
+        }
+        auto self = shared_from_this();
+        if (out.empty())
+        {
+            if (!queue.empty() && !timerArmed)
+            {
+                timerArmed = true;
+                timer.expires_at(queue.front().due);
+                timer.async_wait([self](const boost::system::error_code &)
+                                 {
+                    self->timerArmed = false;
+                    self->pump(); });
+            }
+            return;
+        }
+        if (!stamps.empty())
+        {
+            char sentNs[24];
+            std::snprintf(sentNs, sizeof(sentNs), "%019lld", static_cast<long long>(unixNanos()));
+            for (size_t at : stamps)
+                out.replace(at, SentStamp.size(), sentNs, SentStamp.size());
+            stamps.clear();
+        }
+        writing = true;
+        asio::async_write(stream, asio::buffer(out), [self](const boost::system::error_code &ec, size_t)
+                          {
+            self->writing = false;
+            self->out.clear();
+            if (ec || (self->closing && self->queue.empty()))
+            {
+                self->close();
+                return;
+            }
+            self->pump(); });
+    }
+
+    void Connection::close()
+    {
+        if (closed)
+            return;
+        closed = true;
+        queue.clear();
+        timer.cancel();
+        boost::system::error_code ec;
+        stream.lowest_layer().close(ec);
+        exchange.detach(*this);
+    }
+
+    void Connection::parseHttp()
+    {
+        while (!websocket && !closed)
+        {
+            size_t headerEnd = in.find("\r\n\r\n");
+            if (headerEnd == std::string::npos)
+                return;
+            std::istringstream lines(in.substr(0, headerEnd));
+            std::string requestLine, target, line;
+            std::getline(lines, requestLine);
+            std::istringstream(requestLine) >> target >> target;
+            std::map<std::string, std::string> headers;
+            while (std::getline(lines, line))
+            {
+                size_t colon = line.find(':');
+                if (colon == std::string::npos)
+                    continue;
+                std::string key = line.substr(0, colon);
+                for (char &c : key)
+                    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+                size_t start = line.find_first_not_of(' ', colon + 1);
+                size_t end = line.find_last_not_of("\r ");
+                headers[key] = start == std::string::npos ? "" : line.substr(start, end - start + 1);
+            }
+
+            std::string upgrade = headers["upgrade"];
+            for (char &c : upgrade)
+                c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            if (upgrade == "websocket")
+            {
+                in.erase(0, headerEnd + 4);
+                send("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: " +
+                         wsAccept(headers["sec-websocket-key"]) + "\r\n\r\n",
+                     Clock::now());
+                websocket = true;
+                exchange.attach(shared_from_this());
+                parseFrames();
+                return;
+            }
+
+            size_t length = headers.count("content-length") ? std::strtoul(headers["content-length"].c_str(), nullptr, 10) : 0;
+            if (in.size() < headerEnd + 4 + length)
+                return;
+            std::string body = in.substr(headerEnd + 4, length);
+            in.erase(0, headerEnd + 4 + length);
+
+            const std::string prefix = "/api/v2/";
+            std::string method = target.compare(0, prefix.size(), prefix) == 0 ? target.substr(prefix.size()) : target;
+            method = method.substr(0, method.find('?'));
+            std::string bearer = headers["authorization"];
+            bearer = bearer.compare(0, 7, "Bearer ") == 0 ? bearer.substr(7) : "";
+
+            json request = json::parse(body, nullptr, false);
+            json response = {{"jsonrpc", "2.0"}, {"id", request.is_object() && request.contains("id") ? request["id"] : json()}};
+            std::vector<std::string> after;
+            bool ok = true;
+            try
+            {
+                if (request.is_discarded())
+                    throw RpcError{-32700, "Parse error"};
+                response["result"] = exchange.call(method, request.value("params", json::object()), bearer, nullptr, after);
+            }
+            catch (const RpcError &e)
+            {
+                ok = false;
+                response["error"] = {{"code", e.code}, {"message", e.message}};
+            }
+            std::string text = response.dump();
+            send(std::string(ok ? "HTTP/1.1 200 OK" : "HTTP/1.1 400 Bad Request") +
+                     "\r\nContent-Type: application/json\r\nConnection: keep-alive\r\nContent-Length: " +
+                     std::to_string(text.size()) + "\r\n\r\n" + text,
+                 exchange.dueNow());
+        }
+    }
+
+    void Connection::parseFrames()
+    {
+        size_t offset = 0;
+        while (!closed && in.size() - offset >= 2)
+        {
+            const unsigned char *p = reinterpret_cast<const unsigned char *>(in.data() + offset);
+            size_t available = in.size() - offset;
+            bool fin = p[0] & 0x80;
+            uint8_t opcode = p[0] & 0x0f;
+            bool masked = p[1] & 0x80;
+            uint64_t length = p[1] & 0x7f;
+            size_t header = 2;
+            if (length == 126)
+            {
+                if (available < 4)
+                    break;
+                length = (uint64_t(p[2]) << 8) | p[3];
+                header = 4;
+            }
+            else if (length == 127)
+            {
+                if (available < 10)
+                    break;
+                length = 0;
+                for (int i = 0; i < 8; ++i)
+                    length = (length << 8) | p[2 + i];
+                header = 10;
+            }
+            const unsigned char *mask = p + header;
+            header += masked ? 4 : 0;
+            if (available < header + length)
+                break;
+            std::string payload(in.data() + offset + header, length);
+            if (masked)
+            {
+                for (size_t i = 0; i < payload.size(); ++i)
+                    payload[i] ^= mask[i % 4];
+            }
+            offset += header + length;
+
+            switch (opcode)
+            {
+            case 0x0: // continuation
+                fragments += payload;
+                if (fin)
+                {
+                    onText(fragments);
+                    fragments.clear();
+                }
+                break;
+            case 0x1:
+            case 0x2:
+                if (fin)
+                    onText(payload);
+                else
+                    fragments = payload;
+                break;
+            case 0x8:
+                send(wsFrame(payload.substr(0, 2), 0x8), Clock::now());
+                closing = true;
+                break;
+            case 0x9:
+                send(wsFrame(payload, 0xA), Clock::now());
+                break;
+            default:
+                break;
+            }
+        }
+        in.erase(0, offset);
+    }
+
+    void Connection::onText(const std::string &text)
+    {
+        json request = json::parse(text, nullptr, false);
+        json response = {{"jsonrpc", "2.0"}, {"id", request.is_object() && request.contains("id") ? request["id"] : json()}};
+        std::vector<std::string> after;
+        try
+        {
+            if (request.is_discarded() || !request.is_object() || !request.contains("method"))
+                throw RpcError{-32700, "Parse error"};
+            response["result"] = exchange.call(request["method"].get<std::string>(), request.value("params", json::object()), "", this, after);
+        }
+        catch (const RpcError &e)
+        {
+            response["error"] = {{"code", e.code}, {"message", e.message}};
+        }
+        Clock::time_point due = exchange.dueNow();
+        sendText(response.dump(), due);
+        for (const std::string &notification : after)
+        {
+            sendText(notification, due);
+        }
+    }
+
+    json Exchange::call(const std::string &method, const json &params, const std::string &bearer, Connection *session,
+                        std::vector<std::string> &after)
+    {
+        ++rpcCount;
+        if (method.compare(0, 8, "private/") == 0 && !(session ? session->authenticated : accessTokens.count(bearer) > 0))
+        {
+            throw RpcError{13009, "unauthorized"};
+        }
+        if (method == "public/auth")
+        {
+            json result = auth(params);
+            if (session)
+                session->authenticated = true;
+            return result;
+        }
+        if (method == "public/test")
+            return {{"version", "mock"}};
+        if (method == "public/get_time")
+            return unixMillis();
+        if (method == "public/set_heartbeat" || method == "public/disable_heartbeat")
+            return "ok";
+        if (method == "public/get_instruments")
+        {
+            std::string currency = stringParam(params, "currency");
+            json result = json::array();
+            for (const auto &entry : books)
+            {
+                if (!currency.empty() && currency != "any" && entry.first.compare(0, currency.size(), currency) != 0)
+                    continue;
+                const SyntheticBook &b = entry.second;
+                result.push_back({{"instrument_name", b.instrument()},
+                                  {"kind", "future"},
+                                  {"tick_size", b.tickSize()},
+                                  {"min_trade_amount", b.minTradeAmount()},
+                                  {"contract_size", b.minTradeAmount()},
+                                  {"is_active", true},
+                                  {"settlement_period", "perpetual"},
+                                  {"expiration_timestamp", int64_t(32503680000000)}});
+            }
+            return result;
+        }
+        if (method == "public/get_order_book")
+        {
+            const json &depth = param(params, "depth");
+            return book(params).orderBook(depth.is_number() ? depth.get<size_t>() : 20);
+        }
+        if (method == "public/subscribe" || method == "private/subscribe")
+            return subscribe(params, session, true, after);
+        if (method == "public/unsubscribe" || method == "private/unsubscribe")
+            return subscribe(params, session, false, after);
+        if (method == "private/buy")
+            return placeOrder(params, "buy");
+        if (method == "private/sell")
+            return placeOrder(params, "sell");
+        if (method == "private/edit")
+        {
+            json &order = findOrder(params);
+            order["price"] = numberParam(params, "price");
+            order["amount"] = numberParam(params, "amount");
+            order["last_update_timestamp"] = unixMillis();
+            order["replaced"] = true;
+            broadcastOrder(order);
+            return {{"order", order}, {"trades", json::array()}};
+        }
+        if (method == "private/cancel")
+        {
+            json order = findOrder(params);
+            orders.erase(order["order_id"].get<std::string>());
+            order["order_state"] = "cancelled";
+            order["last_update_timestamp"] = unixMillis();
+            broadcastOrder(order);
+            return order;
+        }
+        if (method == "private/cancel_all" || method == "private/cancel_all_by_instrument")
+        {
+            std::string instrument = stringParam(params, "instrument_name");
+            size_t cancelled = 0;
+            for (auto it = orders.begin(); it != orders.end();)
+            {
+                if (!instrument.empty() && it->second["instrument_name"] != instrument)
+                {
+                    ++it;
+                    continue;
+                }
+                json order = it->second;
+                it = orders.erase(it);
+                order["order_state"] = "cancelled";
+                order["last_update_timestamp"] = unixMillis();
+                broadcastOrder(order);
+                ++cancelled;
+            }
+            return cancelled;
+        }
+        if (method == "private/get_open_orders" || method == "private/get_open_orders_by_instrument")
+        {
+            std::string instrument = stringParam(params, "instrument_name");
+            json result = json::array();
+            for (const auto &entry : orders)
+            {
+                if (instrument.empty() || entry.second["instrument_name"] == instrument)
+                    result.push_back(entry.second);
+            }
+            return result;
+        }
+        if (method == "private/get_positions")
+        {
+            std::string currency = stringParam(params, "currency");
+            json result = json::array();
+            for (const auto &entry : books)
+            {
+                if (!currency.empty() && currency != "any" && entry.first.compare(0, currency.size(), currency) != 0)
+                    continue;
+                result.push_back({{"instrument_name", entry.first},
+                                  {"kind", "future"},
+                                  {"size", 0.0},
+                                  {"direction", "zero"},
+                                  {"average_price", 0.0},
+                                  {"floating_profit_loss", 0.0},
+                                  {"realized_profit_loss", 0.0},
+                                  {"total_profit_loss", 0.0}});
+            }
+            return result;
+        }
+        throw RpcError{-32601, "Method not found"};
+    }
+
+    json Exchange::auth(const json &params)
+    {
+        std::string grant = stringParam(params, "grant_type");
+        if (grant == "client_credentials")
+        {
+            if (stringParam(params, "client_id").empty() || stringParam(params, "client_secret").empty())
+                throw RpcError{13004, "invalid_credentials"};
+        }
+        else if (grant == "refresh_token")
+        {
+            if (!refreshTokens.erase(stringParam(params, "refresh_token")))
+                throw RpcError{13004, "invalid_credentials"};
+        }
+        else
+        {
+            throw RpcError{-32602, "Invalid params: grant_type"};
+        }
+        std::string id = std::to_string(++nextToken);
+        accessTokens.insert("mock-access-" + id);
+        refreshTokens.insert("mock-refresh-" + id);
+        return {{"access_token", "mock-access-" + id},
+                {"refresh_token", "mock-refresh-" + id},
+                {"expires_in", config.tokenTtl},
+                {"scope", "connection mainaccount"},
+                {"token_type", "bearer"}};
+    }
+
+    const SyntheticBook &Exchange::book(const json &params) const
+    {
+        auto it = books.find(stringParam(params, "instrument_name"));
+        if (it == books.end())
+            throw RpcError{10028, "instrument_not_found"};
+        return it->second;
+    }
+
+    json Exchange::placeOrder(const json &params, const char *direction)
+    {
+        const SyntheticBook &b = book(params);
+        double amount = numberParam(params, "amount");
+        double price = numberParam(params, "price");
+        if (amount <= 0 || price <= 0)
+            throw RpcError{-32602, "Invalid params: amount and price must be positive"};
+        const std::string &instrument = b.instrument();
+        std::string id = instrument.substr(0, instrument.find('-')) + "-" + std::to_string(++nextOrder);
+        int64_t now = unixMillis();
+        json order = {{"order_id", id},
+                      {"instrument_name", instrument},
+                      {"direction", direction},
+                      {"price", price},
+                      {"amount", amount},
+                      {"filled_amount", 0.0},
+                      {"average_price", 0.0},
+                      {"order_state", "open"},
+                      {"order_type", param(params, "type").is_string() ? params["type"] : json("limit")},
+                      {"time_in_force", "good_til_cancelled"},
+                      {"label", stringParam(params, "label")},
+                      {"post_only", false},
+                      {"reduce_only", false},
+                      {"replaced", false},
+                      {"api", true},
+                      {"creation_timestamp", now},
+                      {"last_update_timestamp", now}};
+        orders[id] = order;
+        broadcastOrder(order);
+        return {{"order", order}, {"trades", json::array()}};
+    }
+
+    json &Exchange::findOrder(const json &params)
+    {
+        auto it = orders.find(stringParam(params, "order_id"));
+        if (it == orders.end())
+            throw RpcError{11044, "not_open_order"};
+        return it->second;
+    }
+
+    void Exchange::broadcastOrder(const json &order)
+    {
+        std::string notification = json{{"jsonrpc", "2.0"},
+                                        {"method", "subscription"},
+                                        {"params", {{"channel", "user.orders.any.any.raw"}, {"data", order}}}}
+                                       .dump();
+        for (const auto &weak : sessions)
+        {
+            if (auto session = weak.lock())
+            {
+                if (session->orderUpdates)
+                    session->sendText(notification, dueNow());
+            }
+        }
+    }
+
+    json Exchange::subscribe(const json &params, Connection *session, bool subscribing, std::vector<std::string> &after)
+    {
+        if (!session)
+            throw RpcError{-32601, "Method not found"}; // subscriptions only exist on a WebSocket
+        json result = json::array();
+        const json &channels = param(params, "channels");
+        if (!channels.is_array())
+            return result;
+        for (const json &entry : channels)
+        {
+            if (!entry.is_string())
+                continue;
+            const std::string &name = entry.get_ref<const std::string &>();
+            if (name.compare(0, 12, "user.orders.") == 0 || name.compare(0, 12, "user.trades.") == 0)
+            {
+                if (name[5] == 'o')
+                    session->orderUpdates = subscribing;
+                result.push_back(name);
+                continue;
+            }
+            std::string instrument(bookChannelInstrument(name));
+            auto book = books.find(instrument);
+            BookChannel channel;
+            std::string error;
+            if (instrument.empty() || book == books.end() ||
+                !BookChannel::parse(name.substr(5 + instrument.size() + 1), channel, error) ||
+                (channel.interval == "raw" && !session->authenticated))
+            {
+                continue;
+            }
+            auto &subscribed = session->books[instrument];
+            auto it = std::find_if(subscribed.begin(), subscribed.end(), [&](const auto &s)
+                                   { return s.first == name; });
+            if (subscribing && it == subscribed.end())
+            {
+                subscribed.emplace_back(name, channel);
+                // An incremental channel starts from a snapshot; a grouped one is a snapshot every time
+                std::string data;
+                book->second.appendSnapshot(data, unixMillis(), channel.group.empty() ? SIZE_MAX : channel.depth, channel.group.empty());
+                after.push_back("{\"jsonrpc\":\"2.0\",\"method\":\"subscription\",\"params\":{\"channel\":\"" + name +
+                                "\",\"data\":" + data + "}}");
+            }
+            else if (!subscribing && it != subscribed.end())
+            {
+                subscribed.erase(it);
+            }
+            if (subscribed.empty())
+                session->books.erase(instrument);
+            result.push_back(name);
+        }
+        refreshActive();
+        return result;
+    }
+
+    void Exchange::refreshActive()
+    {
+        std::unordered_set<std::string> wanted;
+        std::vector<std::weak_ptr<Connection>> live;
+        for (const auto &weak : sessions)
+        {
+            auto session = weak.lock();
+            if (!session || !session->open())
+                continue;
+            live.push_back(session);
+            for (const auto &entry : session->books)
+                wanted.insert(entry.first);
+        }
+        sessions.swap(live);
+        active.assign(wanted.begin(), wanted.end());
+        std::sort(active.begin(), active.end());
+    }
+
+    // Produces the updates the schedule says are due, each stamped with the
+    // time it was due, and comes back every millisecond
+    void Exchange::tick()
+    {
+        Clock::time_point now = Clock::now();
+        if (active.empty())
+        {
+            feedStart = now;
+            generated = 0;
+        }
+        else
+        {
+            uint64_t due = static_cast<uint64_t>(std::chrono::duration<double>(now - feedStart).count() * config.rate);
+            // After a stall, skip ahead rather than send a second's worth at once
+            uint64_t limit = static_cast<uint64_t>(config.rate / 10) + 1;
+            if (due > generated + limit)
+            {
+                skipped += due - generated - limit;
+                generated = due - limit;
+            }
+            int64_t nowMs = unixMillis();
+            while (generated < due)
+            {
+                auto producedAt = feedStart + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(generated / config.rate));
+                SyntheticBook &book = books.at(active[generated % active.size()]);
+                book.step(rng);
+                publish(book, producedAt, nowMs - std::chrono::duration_cast<std::chrono::milliseconds>(now - producedAt).count());
+                ++generated;
+            }
+        }
+        feedTimer.expires_after(std::chrono::milliseconds(1));
+        feedTimer.async_wait([this](const boost::system::error_code &ec)
+                             {
+            if (!ec)
+                tick(); });
+    }
+
+    void Exchange::publish(const SyntheticBook &book, Clock::time_point producedAt, int64_t timestampMs)
+    {
+        std::string delta;
+        std::string notification;
+        for (const auto &weak : sessions)
+        {
+            auto session = weak.lock();
+            if (!session)
+                continue;
+            auto found = session->books.find(book.instrument());
+            if (found == session->books.end())
+                continue;
+            for (const auto &subscribed : found->second)
+            {
+                const BookChannel &channel = subscribed.second;
+                std::string grouped;
+                if (channel.group.empty() && delta.empty())
+                    book.appendDelta(delta, timestampMs);
+                else if (!channel.group.empty())
+                    book.appendSnapshot(grouped, timestampMs, channel.depth, false);
+                notification = "{\"jsonrpc\":\"2.0\",\"method\":\"subscription\",\"params\":{\"channel\":\"";
+                notification += subscribed.first;
+                notification += "\",\"data\":";
+                notification += channel.group.empty() ? delta : grouped;
+                notification += "}";
+                size_t stampAt = std::string::npos;
+                if (config.stamp)
+                {
+                    notification += ",\"sent_ns\":";
+                    stampAt = notification.size();
+                    notification += SentStamp;
+                }
+                notification += "}";
+                notifications++;
+                notificationBytes += notification.size();
+                session->sendText(notification, producedAt + config.latency, stampAt);
+            }
+        }
+    }
+
+    void Exchange::reportStats()
+    {
+        static uint64_t lastNotifications = 0, lastBytes = 0, lastRpc = 0, lastSkipped = 0;
+        if (notifications != lastNotifications || rpcCount != lastRpc)
+        {
+            std::cout << "books " << active.size() << ", sessions " << sessions.size() << ", notifications "
+                      << notifications - lastNotifications << "/s (" << (notificationBytes - lastBytes) / 1024 << " KiB/s), requests "
+                      << rpcCount - lastRpc << "/s, open orders " << orders.size();
+            if (skipped != lastSkipped)
+                std::cout << ", " << skipped - lastSkipped << " updates skipped behind schedule";
+            std::cout << std::endl;
+        }
+        lastNotifications = notifications;
+        lastBytes = notificationBytes;
+        lastRpc = rpcCount;
+        lastSkipped = skipped;
+        statsTimer.expires_after(std::chrono::seconds(1));
+        statsTimer.async_wait([this](const boost::system::error_code &ec)
+                              {
+            if (!ec)
+                reportStats(); });
+    }
+
+    void usage(const char *program)
+    {
+        std::cerr << "Usage: " << program << " [--port N] [--rate N] [--latency-us N] [--token-ttl S] [--instruments A,B,...] [--stamp]" << std::endl;
+    }
+
+    void accept(asio::ip::tcp::acceptor &acceptor, asio::ssl::context &ssl, Exchange &exchange)
+    {
+        acceptor.async_accept([&](const boost::system::error_code &ec, asio::ip::tcp::socket socket)
+                              {
+            if (!ec)
+            {
+                socket.set_option(asio::ip::tcp::no_delay(true));
+                std::make_shared<Connection>(exchange, std::move(socket), ssl)->start();
+            }
+            accept(acceptor, ssl, exchange); });
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    MockConfig config;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--port" && i + 1 < argc)
+        {
+            config.port = static_cast<unsigned short>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--rate" && i + 1 < argc)
+        {
+            config.rate = std::strtod(argv[++i], nullptr);
+        }
+        else if (arg == "--latency-us" && i + 1 < argc)
+        {
+            config.latency = std::chrono::microseconds(std::strtol(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--token-ttl" && i + 1 < argc)
+        {
+            config.tokenTtl = std::atoi(argv[++i]);
+        }
+        else if (arg == "--stamp")
+        {
+            config.stamp = true;
+        }
+        else if (arg == "--instruments" && i + 1 < argc)
+        {
+            config.instruments.clear();
+            std::istringstream names(argv[++i]);
+            std::string name;
+            while (std::getline(names, name, ','))
+            {
+                if (!name.empty())
+                    config.instruments.push_back(name);
+            }
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (config.rate <= 0 || config.instruments.empty())
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    asio::io_context io;
+    asio::ssl::context ssl(asio::ssl::context::tls_server);
+    bench::useSelfSignedCertificate(ssl);
+    asio::ip::tcp::acceptor acceptor(io, asio::ip::tcp::endpoint(asio::ip::tcp::v4(), config.port));
+    Exchange exchange(io, config);
+    accept(acceptor, ssl, exchange);
+    exchange.start();
+
+    asio::signal_set signals(io, SIGINT, SIGTERM);
+    signals.async_wait([&](const boost::system::error_code &, int)
+                       { io.stop(); });
+
+    std::cout << "Mock exchange on port " << config.port << ": " << config.instruments.size() << " instruments, "
+              << config.rate << " book updates/s, " << config.latency.count() << " us latency" << std::endl;
+    // Everything runs on this one thread, so the exchange state needs no locks
+    io.run();
+    return 0;
+}
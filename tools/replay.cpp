@@ -0,0 +1,229 @@
+// Drives an offline TradingClient from recorded frames and reports throughput
+// and the receive-to-handled latency distribution.
+//
+//   ./TradingReplay [--pacing fast|original|scaled] [--speed N] [--loops N] [--shards N | --legs N]
+//                 [--consumer-delay-us N] <capture|dir|.jsonl>...
+//
+// With --shards the frames go to a ShardedFeed instead, split by instrument the
+// way live subscriptions are, with one replay thread feeding each shard.
+// --legs replays every frame into each of N redundant legs, as an A/B feed
+// would receive them, and reports how the arbiter split the updates.
+// --consumer-delay-us N adds a book consumer that takes N us per update, to
+// see how much the conflation stage merges for a consumer that slow.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "logger.hpp"
+#include "notification_parser.hpp"
+#include "replay_source.hpp"
+#include "sharded_feed.hpp"
+#include "trading_client.hpp"
+
+namespace
+{
+    void usage(const char *program)
+    {
+        std::cerr << "Usage: " << program << " [--pacing fast|original|scaled] [--speed N] [--loops N] [--shards N | --legs N] [--consumer-delay-us N] <capture|dir|.jsonl>..." << std::endl;
+    }
+
+    int replaySharded(ReplaySource &source, const ReplayConfig &config, size_t shardCount, bool redundant)
+    {
+        ShardedFeedConfig sharding;
+        sharding.shards = shardCount;
+        sharding.redundant = redundant;
+        sharding.overflow = OverflowPolicy::Block; // a replay must not lose frames
+        RpcDispatcher rpc;
+        ShardedFeed feed(sharding, rpc, nullptr);
+
+        // Book frames go to their instrument's shard, anything else to shard 0;
+        // redundant legs each get everything
+        FrameView view;
+        if (!redundant)
+        {
+            source.setRoutes([&](const ReplayFrame &frame) -> uint32_t
+                             {
+                if (scanFrame(frame.payload, view) != FrameKind::Subscription)
+                    return 0;
+                std::string_view instrument = bookChannelInstrument(view.channel);
+                return instrument.empty() ? 0 : feed.shardFor(instrument); });
+        }
+
+        std::atomic<uint64_t> sent{0};
+        std::vector<std::thread> injectors;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < feed.size(); ++i)
+        {
+            injectors.emplace_back([&, i]
+                                   { sent += source.run(config, [&feed, i](const ReplayFrame &frame)
+                                                        { feed.inject(i, frame.payload, frame.receivedUnixNs); },
+                                                        redundant ? ReplaySource::AllRoutes : i); });
+        }
+        for (auto &injector : injectors)
+        {
+            injector.join();
+        }
+        while (feed.queuedFrames() > 0)
+        {
+            std::this_thread::yield();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "Replayed " << sent << " frames over " << feed.size() << " shards in " << seconds << " s: "
+                  << (seconds > 0 ? sent / seconds : 0) << " msg/s, "
+                  << (seconds > 0 ? source.bytes() * config.loops / seconds / 1e6 : 0) << " MB/s" << std::endl;
+        for (uint32_t i = 0; i < feed.size(); ++i)
+        {
+            const FeedShard &shard = feed.shard(i);
+            std::cout << "Shard " << i << ": " << shard.handledFrames() << " frames, "
+                      << shard.publishedUpdates() << " published, receive to handled "
+                      << shard.processingLatency().describe() << std::endl;
+        }
+        if (const FeedArbiter *arbiter = feed.arbitration())
+        {
+            for (uint32_t leg = 0; leg < arbiter->legs(); ++leg)
+            {
+                std::cout << "Leg " << leg << ": won " << arbiter->winRate(leg) * 100 << "% of its updates, behind the winner "
+                          << arbiter->lag(leg).describe() << ", " << arbiter->unmeasured(leg) << " more too far behind to time" << std::endl;
+            }
+        }
+        std::cout << "Book gaps: " << feed.bookGaps() << std::endl;
+        return 0;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    ReplayConfig config;
+    size_t shards = 0;
+    bool redundant = false;
+    long consumerDelayUs = -1;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--pacing" && i + 1 < argc)
+        {
+            if (!parseReplayPacing(argv[++i], config.pacing))
+            {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "--speed" && i + 1 < argc)
+        {
+            config.speed = std::strtod(argv[++i], nullptr);
+        }
+        else if (arg == "--loops" && i + 1 < argc)
+        {
+            config.loops = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--shards" && i + 1 < argc)
+        {
+            shards = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--legs" && i + 1 < argc)
+        {
+            shards = std::strtoul(argv[++i], nullptr, 10);
+            redundant = true;
+        }
+        else if (arg == "--consumer-delay-us" && i + 1 < argc)
+        {
+            consumerDelayUs = std::strtol(argv[++i], nullptr, 10);
+        }
+        else if (arg.rfind("--", 0) == 0)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+        else
+        {
+            inputs.push_back(arg);
+        }
+    }
+    if (inputs.empty())
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    ReplaySource source;
+    for (const auto &input : inputs)
+    {
+        std::string error;
+        if (!source.load(input, error))
+        {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+    }
+    std::cout << "Loaded " << source.size() << " frames (" << source.bytes() << " bytes)" << std::endl;
+
+    // Log as the live client does, but keep per-update lines off the console
+    Logger::instance().start("trading_replay.tclog", LogLevel::Info, LogLevel::Warn);
+    if (shards > 0)
+    {
+        int status = replaySharded(source, config, shards, redundant);
+        Logger::instance().stop();
+        return status;
+    }
+
+    PipelineConfig pipeline;
+    pipeline.offline = true;
+    pipeline.overflow = OverflowPolicy::Block; // a replay must not lose frames
+    pipeline.latencyReportInterval = std::chrono::seconds(0);
+    // The consumer keeps its own books from the conflated updates; each must continue the last
+    std::vector<OrderBook> consumerBooks;
+    std::atomic<uint64_t> consumerRejects{0};
+    if (consumerDelayUs >= 0)
+    {
+        pipeline.bookConsumer = [&](const ConflatedBook &book)
+        {
+            if (book.instrumentId >= consumerBooks.size())
+            {
+                consumerBooks.resize(book.instrumentId + 1);
+            }
+            if (!consumerBooks[book.instrumentId].apply(book.update))
+            {
+                consumerRejects++;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(consumerDelayUs));
+        };
+    }
+    TradingClient client("", "", pipeline);
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t sent = source.run(config, [&client](const ReplayFrame &frame)
+                               { client.injectFrame(frame.payload, frame.receivedUnixNs, frame.connectionId); });
+    while (client.queuedFrames() > 0)
+    {
+        std::this_thread::yield();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const LatencyStats &latency = client.latencyStats();
+    std::cout << "Replayed " << sent << " frames in " << seconds << " s: "
+              << (seconds > 0 ? sent / seconds : 0) << " msg/s, "
+              << (seconds > 0 ? source.bytes() * config.loops / seconds / 1e6 : 0) << " MB/s" << std::endl;
+    std::cout << "Receive to handled: " << latency.processing.describe() << std::endl;
+    std::cout << "Book gaps: " << client.bookGaps() << std::endl;
+    if (consumerDelayUs >= 0)
+    {
+        while (client.bookConflation().pending > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        BookConflator::Stats books = client.bookConflation();
+        std::cout << "Book consumer: " << books.updates << " updates, " << books.delivered << " delivered, "
+                  << books.conflated << " conflated, " << books.fullBooks << " full books, peak "
+                  << books.peakPendingLevels << " pending levels, " << consumerRejects << " rejected" << std::endl;
+    }
+
+    Logger::instance().stop();
+    return 0;
+}